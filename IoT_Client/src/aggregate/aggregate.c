@@ -0,0 +1,139 @@
+/*
+ * aggregate.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <string.h>			// For memset() and memcpy()
+
+#include "iot_codec.h"
+#include "aggregate.h"
+
+
+
+static uint16_t		sample_channel		(uint8_t* sample, int channel);
+static void			aggregate_include	(window_aggregate* aggregate, uint8_t* sample);
+static bool			aggregate_anomaly	(window_aggregate* aggregate, uint8_t* sample);
+
+
+
+void aggregate_init(window_aggregate* aggregate, uint8_t sensor_id) {
+
+	memset(aggregate, 0, sizeof(*aggregate));
+	aggregate->sensor_id = sensor_id;
+}
+
+
+
+/*
+ * Adds one wire-encoded sample (tagged with sensor id). Each sample is held back by one step: if the next sample is anomalous,
+ * the held one goes out raw with it as context; otherwise it joins the window summary.
+ * returns number of samples copied into raw (0 to 2), to be forwarded as regular sample data
+ */
+int aggregate_add(window_aggregate* aggregate, uint8_t* sample, uint8_t raw[2][DATAGRAM_TAGGED_SAMPLE_SIZE]) {
+	int n_raw = 0;
+	bool anomaly = aggregate_anomaly(aggregate, sample);
+
+	if (anomaly || (aggregate->tail_remaining > 0)) {
+		if (aggregate->held_valid)
+			memcpy(raw[n_raw++], aggregate->held, DATAGRAM_TAGGED_SAMPLE_SIZE);
+		memcpy(raw[n_raw++], sample, DATAGRAM_TAGGED_SAMPLE_SIZE);
+		aggregate->held_valid = false;
+
+		if (anomaly)
+			aggregate->tail_remaining = AGGREGATE_ANOMALY_TAIL;
+		else
+			aggregate->tail_remaining--;
+		return n_raw;
+	}
+
+	if (aggregate->held_valid)
+		aggregate_include(aggregate, aggregate->held);
+	memcpy(aggregate->held, sample, DATAGRAM_TAGGED_SAMPLE_SIZE);
+	aggregate->held_valid = true;
+
+	return n_raw;
+}
+
+
+
+/*
+ * Ends current window: encodes its summary record (DATAGRAM_SUMMARY_SIZE bytes, LSB first) and starts a new one.
+ * returns 1 if a summary was written, 0 if window had no summarized samples
+ */
+int aggregate_close(window_aggregate* aggregate, uint8_t* summary) {
+
+	if (aggregate->held_valid) {
+		aggregate_include(aggregate, aggregate->held);
+		aggregate->held_valid = false;
+	}
+	if (aggregate->count == 0)
+		return 0;
+
+	codec_summary_set_sensor(summary, aggregate->sensor_id);
+	codec_summary_set_window_start(summary, aggregate->window_start);
+	codec_summary_set_count(summary, aggregate->count);
+
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		uint8_t* record = codec_summary_channel(summary, channel);
+		codec_summary_channel_set_minimum(record, aggregate->minimum[channel]);
+		codec_summary_channel_set_maximum(record, aggregate->maximum[channel]);
+		codec_summary_channel_set_sum(record, aggregate->sum[channel]);
+	}
+
+	int tail_remaining = aggregate->tail_remaining;
+	aggregate_init(aggregate, aggregate->sensor_id);
+	aggregate->tail_remaining = tail_remaining;
+
+	return 1;
+}
+
+
+
+static uint16_t sample_channel(uint8_t* sample, int channel) {
+
+	return codec_sample_get_channel(codec_tagged_sample_sample(sample), channel);
+}
+
+
+
+static void aggregate_include(window_aggregate* aggregate, uint8_t* sample) {
+
+	// 16-bit count and 32-bit sums: 65535 samples of 16-bit values per window at most
+	if (aggregate->count == UINT16_MAX)
+		return;
+
+	if (aggregate->count == 0)
+		aggregate->window_start = codec_sample_get_timestamp(codec_tagged_sample_sample(sample));
+
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		uint16_t value = sample_channel(sample, channel);
+		if ((aggregate->count == 0) || (value < aggregate->minimum[channel]))
+			aggregate->minimum[channel] = value;
+		if ((aggregate->count == 0) || (value > aggregate->maximum[channel]))
+			aggregate->maximum[channel] = value;
+		aggregate->sum[channel] += value;
+	}
+	aggregate->count++;
+}
+
+
+
+static bool aggregate_anomaly(window_aggregate* aggregate, uint8_t* sample) {
+
+	if (aggregate->count < AGGREGATE_MIN_SAMPLES)
+		return false;
+
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		long int mean = aggregate->sum[channel] / aggregate->count;
+		long int delta = (long int) sample_channel(sample, channel) - mean;
+		if ((delta > AGGREGATE_ANOMALY_DELTA) || (delta < -AGGREGATE_ANOMALY_DELTA))
+			return true;
+	}
+	return false;
+}
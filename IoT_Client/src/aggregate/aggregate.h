@@ -0,0 +1,53 @@
+/*
+ * aggregate.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef AGGREGATE_H_
+#define AGGREGATE_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define AGGREGATE_MIN_SAMPLES		4		// Window samples needed before anomaly detection starts
+#define AGGREGATE_ANOMALY_DELTA		6554	// Channel deviation from window mean flagged as anomaly (10% of full scale)
+#define AGGREGATE_ANOMALY_TAIL		2		// Samples following an anomaly also forwarded raw
+
+
+
+/* TYPE DEFINITIONS */
+
+// Running summary of one sensor's window. Samples forwarded raw are not part of it, so the server can merge both exactly.
+typedef struct {
+	uint8_t		sensor_id;
+	uint16_t	window_start;		// Timestamp (sample timestamp unit) of first summarized sample
+	uint16_t	count;
+	uint16_t	minimum		[DATAGRAM_CHANNELS];
+	uint16_t	maximum		[DATAGRAM_CHANNELS];
+	uint32_t	sum			[DATAGRAM_CHANNELS];
+
+	uint8_t		held		[DATAGRAM_TAGGED_SAMPLE_SIZE];		// Latest sample, kept out of the window in case it precedes an anomaly
+	bool		held_valid;
+	int			tail_remaining;
+} window_aggregate;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	aggregate_init		(window_aggregate* aggregate, uint8_t sensor_id);
+int		aggregate_add		(window_aggregate* aggregate, uint8_t* sample, uint8_t raw[2][DATAGRAM_TAGGED_SAMPLE_SIZE]);	// returns samples to forward raw
+int		aggregate_close		(window_aggregate* aggregate, uint8_t* summary);		// returns 1 if summary record was written
+
+
+
+#endif /* AGGREGATE_H_ */
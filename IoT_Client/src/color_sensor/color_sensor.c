@@ -14,24 +14,22 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>			// for clock_gettime()
 
 #include "color_sensor.h"
 #include "color_sensor_interface.h"
+#include "print_error_color_sensor.h"
 
 
 
-float integration_time_secs;	// Integration Time = 2.4 ms × (256 − ATIME)
-float waiting_time_secs;		// Waiting Time 	= 2.4 ms × (256 − WTIME)
-
-
-
-int tcs34725_setup(tcs34725_setup_params* setup) {
-	int fd_i2c;
+void tcs34725_setup(tcs34725_sensor* sensor, tcs34725_setup_params* setup) {
+	int fd_i2c = sensor->fd_i2c;
 	uint8_t ena_reg_byte;
 
-	/* Step 1: Create instance of I2C interface's descriptor */
+	/* Step 1: Route bus to the sensor (mux channel stays selected for the configuration writes below) */
 
-	fd_i2c = get_i2c_descriptor();
+	if (i2c_mux_select(fd_i2c, sensor->mux_channel) < 0)
+		return;
 
 
 
@@ -40,8 +38,8 @@ int tcs34725_setup(tcs34725_setup_params* setup) {
 	printf("COLOR_SENSOR: Writing ATIME register\n");
 	write_config_byte(fd_i2c, TCS_REG_ATIME, setup->a_time);
 
-	integration_time_secs = (2.4 * (256 - (int) setup->a_time));
-	printf("COLOR_SENSOR: Integration time: %f ms\n", integration_time_secs);
+	sensor->integration_time_ms = (2.4 * (256 - (int) setup->a_time));
+	printf("COLOR_SENSOR: Integration time: %f ms\n", sensor->integration_time_ms);
 
 
 
@@ -51,10 +49,10 @@ int tcs34725_setup(tcs34725_setup_params* setup) {
 		printf("COLOR_SENSOR: Writing WTIME register\n");
 		write_config_byte(fd_i2c, TCS_REG_WTIME, setup->w_time);
 
-		waiting_time_secs = (2.4 * (256 - (int) setup->w_time));
-		printf("COLOR_SENSOR: Waiting time: %f ms\n", waiting_time_secs);
+		sensor->waiting_time_ms = (2.4 * (256 - (int) setup->w_time));
+		printf("COLOR_SENSOR: Waiting time: %f ms\n", sensor->waiting_time_ms);
 	} else {
-		waiting_time_secs = 0;
+		sensor->waiting_time_ms = 0;
 		printf("COLOR_SENSOR: No waiting state configuration.\n");
 	}
 
@@ -67,6 +65,15 @@ int tcs34725_setup(tcs34725_setup_params* setup) {
 
 
 
+	/* Step 4b: Write to Persistence Register (0x0C) to interrupt on every RGBC cycle (data-ready) */
+
+	if (setup->i_enable == true) {
+		printf("COLOR_SENSOR: Writing Persistence register\n");
+		write_config_byte(fd_i2c, TCS_REG_PERS, 0x00);
+	}
+
+
+
 	/* Step 5: Write to Enable Register (0x00) to set PON bit: sets sensor to "idle" state */
 
 	printf("COLOR_SENSOR: Writing Enable register: PON bits \n");
@@ -79,45 +86,133 @@ int tcs34725_setup(tcs34725_setup_params* setup) {
 
 	/* Step 6: Write to Enable Register (0x00) to set AEN bit (without WEN bit) to start sensor cycles */
 
-	ena_reg_byte = (setup->w_enable == true) ? 0x0C : 0x03;
+	ena_reg_byte = (setup->w_enable == true) ? 0x0B : 0x03;
+	if (setup->i_enable == true)
+		ena_reg_byte |= TCS_ENABLE_AIEN;
 	printf("COLOR_SENSOR: Writing Enable register\n");
-	write_config_byte(fd_i2c, TCS_REG_ENABLE, ena_reg_byte);		// NOTE: to set PON, AEN and WEN bits: 0, 1 and 3 respectively (0x0C)
+	write_config_byte(fd_i2c, TCS_REG_ENABLE, ena_reg_byte);		// NOTE: to set PON, AEN and WEN bits: 0, 1 and 3 respectively (0x0B)
+
+	clock_gettime(CLOCK_MONOTONIC, &sensor->last_ready);
+}
+
+
 
 
-	return fd_i2c;
+
+/*
+ * Fit ATIME/WTIME to the sampling period, so that every sample comes from a fresh integration cycle:
+ * cycle time = 2.4 ms (init) + integration time (ATIME) + waiting time (WTIME, only if needed)
+ */
+void tcs34725_timing_for_period(tcs34725_setup_params* setup, int period_ms) {
+	long int period_us = (long int) period_ms * 1000;
+
+	/* Integration: as long as the period allows (longest integration gives the best resolution) */
+	long int a_cycles = (period_us - TCS34725_CYCLE_US) / TCS34725_CYCLE_US;
+	if (a_cycles < 1)
+		a_cycles = 1;
+	if (a_cycles > TCS34725_MAX_CYCLES)
+		a_cycles = TCS34725_MAX_CYCLES;
+	setup->a_time = (uint8_t) (TCS34725_MAX_CYCLES - a_cycles);
+
+	/* Waiting: fill remaining period, if it is at least one step long */
+	long int w_cycles = (period_us - TCS34725_CYCLE_US - (a_cycles * TCS34725_CYCLE_US)) / TCS34725_CYCLE_US;
+	if (w_cycles > TCS34725_MAX_CYCLES)
+		w_cycles = TCS34725_MAX_CYCLES;
+	setup->w_enable = (w_cycles >= 1);
+	setup->w_time = setup->w_enable ? (uint8_t) (TCS34725_MAX_CYCLES - w_cycles) : 0xFF;
 }
 
 
 
 
 
-void tcs34725_read(int fd_i2c, uint8_t* data) {
-	uint8_t read_ptr_reg;
-	uint8_t data_byte;
+int tcs34725_read(tcs34725_sensor* sensor, uint8_t* data) {
 
 
-	// printf("\nCOLOR_SENSOR: Integration and Waiting time hold-up (%.1f ms)\n", integration_time_secs + waiting_time_secs);
-	// usleep((integration_time_secs + waiting_time_secs) * 1000);		// We are to wait the amount of time defined as integration time + waiting time
+	// printf("\nCOLOR_SENSOR: Integration and Waiting time hold-up (%.1f ms)\n", sensor->integration_time_ms + sensor->waiting_time_ms);
+	// usleep((sensor->integration_time_ms + sensor->waiting_time_ms) * 1000);		// We are to wait the amount of time defined as integration time + waiting time
 
 
-	// printf("COLOR_SENSOR: TCS - read sequence begun.\n");
-	read_ptr_reg = TCS_CMD_BYTE | TCS_REG_DATA_C_LOW; // TCS_CMD_AUTOINC | TCS_REG_DATA_C_LOW;
-	int i;
-	for (i = 0; i < TCS34725_SAMPLE_SIZE; i++) {
-		// Write request to perform read operation
-		i2c_write(fd_i2c, &read_ptr_reg, 1);
+	/* Read all data registers (CDATAL to BDATAH) in one auto-increment I2C_RDWR transaction (mux channel selected beforehand when it changed) */
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int read_status = i2c_read_block(sensor->fd_i2c, sensor->mux_channel, TCS_REG_DATA_C_LOW, data, TCS34725_SAMPLE_SIZE);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sensor->last_read_us = (uint32_t) (((end.tv_sec - start.tv_sec) * 1000000L) + ((end.tv_nsec - start.tv_nsec) / 1000L));
 
-		// Read from queried register
-		data_byte = i2c_read(fd_i2c);
-		if (data_byte != -1) {
-			data[i] = data_byte;
-		}
+	return read_status;
+
+}
 
-		// Increase read pointer register
-		read_ptr_reg++;
+
+
+
+/*
+ * Data-ready driven read: waits until the sensor completes a new RGBC integration cycle (AINT), reads it
+ * and clears the interrupt, so exactly one sample is taken per cycle. With a GPIO line wired to the INT pin
+ * (fd_gpio >= 0) the wait blocks on the edge event; otherwise the STATUS register is polled, starting only
+ * once most of the cycle time has elapsed.
+ */
+int tcs34725_read_ready(tcs34725_sensor* sensor, int fd_gpio, uint8_t* data) {
+	float cycle_ms = 2.4 + sensor->integration_time_ms + sensor->waiting_time_ms;
+	int timeout_ms = (int) (2 * cycle_ms) + 100;
+	uint8_t status = 0;
+
+
+	if (fd_gpio >= 0) {
+		if (gpio_wait_event(fd_gpio, timeout_ms) < 0) {
+			// An interrupt left asserted holds INT low: without a clear no falling edge would ever come again
+			print_error_color_sensor(9);
+			tcs34725_clear_interrupt(sensor);
+			return -1;
+		}
+	} else {
+		// Most of the cycle is spent integrating: sleep through what is left of it, then poll at 1/4 step resolution
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long int since_ready_us = ((now.tv_sec - sensor->last_ready.tv_sec) * 1000000L) + ((now.tv_nsec - sensor->last_ready.tv_nsec) / 1000L);
+		long int idle_us = (long int) (cycle_ms * 1000 * 0.75) - since_ready_us;
+		if (idle_us > 0)
+			usleep(idle_us);
+
+		int polled_us = 0;
+		while (1) {
+			if (i2c_read_block(sensor->fd_i2c, sensor->mux_channel, TCS_REG_STATUS, &status, 1) < 0)
+				return -1;
+			if ((status & TCS_STATUS_AINT) && (status & TCS_STATUS_AVALID))
+				break;
+			if (polled_us >= timeout_ms * 1000) {
+				print_error_color_sensor(9);
+				return -1;
+			}
+			usleep(TCS34725_CYCLE_US / 4);
+			polled_us += TCS34725_CYCLE_US / 4;
+		}
 	}
-	// printf("COLOR_SENSOR: TCS - read sequence done:\n");
 
+	int read_status = tcs34725_read(sensor, data);
+
+	/* Clear RGBC interrupt: next AINT (and INT pin edge) signals the next cycle (mux channel still selected by the read) */
+	uint8_t clear_cmd = TCS_CMD_CLEAR_INT;
+	i2c_write(sensor->fd_i2c, &clear_cmd, 1);
+	clock_gettime(CLOCK_MONOTONIC, &sensor->last_ready);
+
+	return read_status;
+}
+
+
+
+
+/*
+ * Clears RGBC interrupt (releasing the INT pin), selecting the sensor's mux channel first
+ */
+int tcs34725_clear_interrupt(tcs34725_sensor* sensor) {
+	uint8_t clear_cmd = TCS_CMD_CLEAR_INT;
+
+	if (i2c_mux_select(sensor->fd_i2c, sensor->mux_channel) < 0)
+		return -1;
+	i2c_write(sensor->fd_i2c, &clear_cmd, 1);
+	return 0;
 }
 
 
@@ -7,13 +7,20 @@
  ============================================================================
  */
 
+#ifndef COLOR_SENSOR_H_
+#define COLOR_SENSOR_H_
+
+
 #include <stdbool.h>
 #include <stdint.h>			// For register types (e.g. uint8_t)
+#include <time.h>			// For timespec struct
 
 
 /* CONSTANTS AND MACROS */
 
 #define TCS34725_SAMPLE_SIZE	8
+#define TCS34725_CYCLE_US		2400	// ATIME/WTIME step and power-on initialization time (2.4 ms)
+#define TCS34725_MAX_CYCLES		256
 
 
 /* TYPE DEFINITIONS */
@@ -23,13 +30,31 @@ typedef struct {
 	uint8_t w_time;
 	uint8_t ctrl_reg;
 	bool	w_enable;
+	bool	i_enable;		// Interrupt (AINT) on every RGBC cycle, for data-ready driven sampling
 } tcs34725_setup_params;
 
 
+// One sensor: bus descriptor (shared with other sensors on the same bus), mux channel and its timing configuration
+typedef struct {
+	int				fd_i2c;
+	int				mux_channel;			// TCA9548A channel the sensor sits behind (-1: wired directly to the bus)
+	float			integration_time_ms;	// Integration Time = 2.4 ms × (256 − ATIME)
+	float			waiting_time_ms;		// Waiting Time 	= 2.4 ms × (256 − WTIME)
+	struct timespec	last_ready;				// Time of last data-ready read (interrupt cleared)
+	uint32_t		last_read_us;			// Duration of last register block read
+} tcs34725_sensor;
+
+
 
 /* FUNCTION DECLARATIONS */
 
-int		tcs34725_setup				(tcs34725_setup_params* setup); // returns file descriptor to I2C interface
-void 	tcs34725_read				(int fd_i2c, uint8_t* data);
+void	tcs34725_setup				(tcs34725_sensor* sensor, tcs34725_setup_params* setup);	// sensor's fd_i2c and mux_channel set by caller
+void	tcs34725_timing_for_period	(tcs34725_setup_params* setup, int period_ms);
+int 	tcs34725_read				(tcs34725_sensor* sensor, uint8_t* data);	// returns 0 on success, -1 on read failure
+int		tcs34725_read_ready			(tcs34725_sensor* sensor, int fd_gpio, uint8_t* data);	// waits for new RGBC cycle (fd_gpio < 0: status polling)
+int		tcs34725_clear_interrupt	(tcs34725_sensor* sensor);
 void 	tcs34725_print				(uint8_t* data_in);
 
+
+
+#endif /* COLOR_SENSOR_H_ */
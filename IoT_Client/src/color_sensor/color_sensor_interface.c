@@ -10,26 +10,34 @@
 #include <sys/stat.h>		// for open()
 #include <fcntl.h>			// for open()
 #include <sys/ioctl.h>		// for ioctl()
-#include <linux/i2c-dev.h>	// for i2c interfacing
+#include <linux/i2c.h>		// for I2C_RDWR combined transactions
+#include <linux/gpio.h>		// for GPIO line events
+#include <poll.h>			// for poll()
+#include <string.h>			// for memset() and strncpy()
 #include <unistd.h>			// for write and read operations
 
 #include "color_sensor_interface.h"
+#include "i2c_backend.h"
 #include "print_error_color_sensor.h"
 
 
 
-int get_i2c_descriptor() {
+/* TCA9548A channel last selected on each bus, indexed by bus descriptor (0: unknown, otherwise channel + 1) */
+#define MUX_CACHE_FDS		64
+static uint8_t mux_selected[MUX_CACHE_FDS];
+
+
+
+int get_i2c_descriptor(const char* bus) {
 	int fd_i2c;
 
-	/* Open descriptor to i2c bus' device file */
-	fd_i2c = open(I2C_INTERFACE, O_RDWR);
+	/* Open descriptor to i2c bus (device file, or simulated bus), as a slave to the sensor's address */
+	fd_i2c = i2c_backend_for_bus(bus)->open(bus);
 
 	if (fd_i2c < 0)
 		print_error_color_sensor(1);
-
-	/* Specify descriptor as a slave to the sensor's address */
-	if (ioctl(fd_i2c, I2C_SLAVE, TCS34725_ADDR) < 0)
-		print_error_color_sensor(2);
+	else if (fd_i2c < MUX_CACHE_FDS)
+		mux_selected[fd_i2c] = 0;			// mux state of a newly opened bus is unknown
 
 	// Since PON is not enabled, the device will return to the Sleep state.
 
@@ -51,7 +59,7 @@ void write_config_byte(int fd_i2c, uint8_t reg, uint8_t byte) {
 
 void i2c_write(int fd_i2c, uint8_t* registers, int length) {
 
-	int sent_bytes = write(fd_i2c, registers, length);
+	int sent_bytes = i2c_backend_for_fd(fd_i2c)->write(fd_i2c, registers, length);
 
 	if (sent_bytes < 0)
 		print_error_color_sensor(3);
@@ -65,7 +73,7 @@ void i2c_write(int fd_i2c, uint8_t* registers, int length) {
 int i2c_read(int fd_i2c) {
 	uint8_t data_byte;
 
-	int read_bytes = read(fd_i2c, &data_byte, 1);
+	int read_bytes = i2c_backend_for_fd(fd_i2c)->read(fd_i2c, &data_byte, 1);
 	if (read_bytes != 1) {
 		print_error_color_sensor(5);
 		return -1;
@@ -74,3 +82,110 @@ int i2c_read(int fd_i2c) {
 	}
 }
 
+
+
+
+int i2c_mux_select(int fd_i2c, int mux_channel) {
+	uint8_t channel_mask;
+	struct i2c_msg message;
+
+	if (mux_channel < 0)
+		return 0;
+	if ((fd_i2c < MUX_CACHE_FDS) && (mux_selected[fd_i2c] == mux_channel + 1))
+		return 0;
+
+	/* TCA9548A control register: one bit per downstream channel, switched at the STOP ending this transaction */
+	channel_mask = (uint8_t) (1 << mux_channel);
+
+	message.addr = TCA9548A_ADDR;
+	message.flags = 0;
+	message.len = 1;
+	message.buf = &channel_mask;
+
+	if (i2c_backend_for_fd(fd_i2c)->transfer(fd_i2c, &message, 1) != 1) {
+		if (fd_i2c < MUX_CACHE_FDS)
+			mux_selected[fd_i2c] = 0;
+		print_error_color_sensor(3);
+		return -1;
+	}
+
+	if (fd_i2c < MUX_CACHE_FDS)
+		mux_selected[fd_i2c] = (uint8_t) (mux_channel + 1);
+	return 0;
+}
+
+
+
+int i2c_read_block(int fd_i2c, int mux_channel, uint8_t reg, uint8_t* data, int length) {
+	uint8_t read_ptr_reg;
+	struct i2c_msg messages[2];
+
+	/* Sensor behind mux: select its channel first, in a transaction of its own (the mux only switches after a STOP) */
+	if (i2c_mux_select(fd_i2c, mux_channel) < 0)
+		return -1;
+
+	/* Combined transaction: write auto-increment command with start register, repeated start, burst read */
+	read_ptr_reg = TCS_CMD_AUTOINC | reg;
+
+	messages[0].addr = TCS34725_ADDR;
+	messages[0].flags = 0;
+	messages[0].len = 1;
+	messages[0].buf = &read_ptr_reg;
+
+	messages[1].addr = TCS34725_ADDR;
+	messages[1].flags = I2C_M_RD;
+	messages[1].len = length;
+	messages[1].buf = data;
+
+	if (i2c_backend_for_fd(fd_i2c)->transfer(fd_i2c, messages, 2) != 2) {
+		print_error_color_sensor(7);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+int get_gpio_event_descriptor(int gpio_line) {
+	int fd_chip;
+	struct gpioevent_request request;
+
+	/* Open descriptor to GPIO chip's device file */
+	fd_chip = open(GPIO_INTERFACE, O_RDONLY);
+	if (fd_chip < 0) {
+		print_error_color_sensor(8);
+		return -1;
+	}
+
+	/* Request falling-edge events on line wired to sensor's (active low) INT pin */
+	memset(&request, 0, sizeof(request));
+	request.lineoffset = gpio_line;
+	request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+	request.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+	strncpy(request.consumer_label, "tcs34725_int", sizeof(request.consumer_label) - 1);
+
+	if (ioctl(fd_chip, GPIO_GET_LINEEVENT_IOCTL, &request) < 0) {
+		print_error_color_sensor(8);
+		close(fd_chip);
+		return -1;
+	}
+	close(fd_chip);
+
+	return request.fd;
+}
+
+
+
+int gpio_wait_event(int fd_gpio, int timeout_ms) {
+	struct pollfd fd_poll = { fd_gpio, POLLIN, 0 };
+	struct gpioevent_data event;
+
+	if (poll(&fd_poll, 1, timeout_ms) <= 0)
+		return -1;
+
+	if (read(fd_gpio, &event, sizeof(event)) != sizeof(event))
+		return -1;
+
+	return 0;
+}
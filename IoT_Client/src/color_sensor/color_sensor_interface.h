@@ -16,24 +16,38 @@
 /* MACROS AND CONSTANTS */
 
 #define I2C_INTERFACE			"/dev/i2c-1"
+#define GPIO_INTERFACE			"/dev/gpiochip0"
 #define TCS34725_ADDR			0x29
+#define TCA9548A_ADDR			0x70	// I2C mux for several sensors (fixed TCS34725 address) on one bus
+#define TCA9548A_CHANNELS		8
 
 #define TCS_CMD_BYTE			0x80
 #define TCS_CMD_AUTOINC			0xa0
+#define TCS_CMD_CLEAR_INT		0xe6	// Special function: clear RGBC interrupt
 #define TCS_REG_ENABLE			0x00
 #define TCS_REG_ATIME			0x01
 #define TCS_REG_WTIME			0x03
+#define TCS_REG_PERS			0x0C
 #define TCS_REG_CONTROL			0x0F
+#define TCS_REG_STATUS			0x13
 #define TCS_REG_DATA_C_LOW		0x14
 
+#define TCS_ENABLE_AIEN			0x10
+#define TCS_STATUS_AVALID		0x01
+#define TCS_STATUS_AINT			0x10
+
 
 
 /* FUNCTION DECLARATION */
 
-int		get_i2c_descriptor	();
+int		get_i2c_descriptor	(const char* bus);
 void 	write_config_byte	(int fd_i2c, uint8_t reg, uint8_t byte);
 void 	i2c_write			(int fd_i2c, uint8_t* registers, int length);
 int 	i2c_read			(int fd_i2c);
+int		i2c_mux_select		(int fd_i2c, int mux_channel);		// mux_channel < 0: no mux, nothing to do; already selected: no bus traffic
+int		i2c_read_block		(int fd_i2c, int mux_channel, uint8_t reg, uint8_t* data, int length);
+int		get_gpio_event_descriptor	(int gpio_line);
+int		gpio_wait_event		(int fd_gpio, int timeout_ms);
 
 
 
@@ -0,0 +1,89 @@
+/*
+ * i2c_backend.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <sys/types.h>		// for open()
+#include <sys/stat.h>		// for open()
+#include <fcntl.h>			// for open()
+#include <sys/ioctl.h>		// for ioctl()
+#include <linux/i2c-dev.h>	// for i2c interfacing
+#include <string.h>			// for strncmp()
+#include <unistd.h>			// for write and read operations
+
+#include "i2c_backend.h"
+#include "tcs34725_sim.h"
+#include "color_sensor_interface.h"
+#include "print_error_color_sensor.h"
+
+
+
+static int		dev_open		(const char* bus);
+static int		dev_write		(int fd_i2c, uint8_t* bytes, int length);
+static int		dev_read		(int fd_i2c, uint8_t* bytes, int length);
+static int		dev_transfer	(int fd_i2c, struct i2c_msg* messages, int n_messages);
+
+
+static const i2c_backend i2c_backend_dev = { "i2c-dev", dev_open, dev_write, dev_read, dev_transfer };
+
+
+
+const i2c_backend* i2c_backend_for_bus(const char* bus) {
+
+	if (strncmp(bus, TCS_SIM_BUS_PREFIX, strlen(TCS_SIM_BUS_PREFIX)) == 0)
+		return &i2c_backend_sim;
+	return &i2c_backend_dev;
+}
+
+
+
+const i2c_backend* i2c_backend_for_fd(int fd_i2c) {
+
+	if (tcs34725_sim_owns(fd_i2c))
+		return &i2c_backend_sim;
+	return &i2c_backend_dev;
+}
+
+
+
+static int dev_open(const char* bus) {
+
+	/* Open descriptor to i2c bus' device file */
+	int fd_i2c = open(bus, O_RDWR);
+	if (fd_i2c < 0)
+		return -1;
+
+	/* Specify descriptor as a slave to the sensor's address */
+	if (ioctl(fd_i2c, I2C_SLAVE, TCS34725_ADDR) < 0)
+		print_error_color_sensor(2);
+
+	return fd_i2c;
+}
+
+
+
+static int dev_write(int fd_i2c, uint8_t* bytes, int length) {
+
+	return (int) write(fd_i2c, bytes, length);
+}
+
+
+
+static int dev_read(int fd_i2c, uint8_t* bytes, int length) {
+
+	return (int) read(fd_i2c, bytes, length);
+}
+
+
+
+static int dev_transfer(int fd_i2c, struct i2c_msg* messages, int n_messages) {
+	struct i2c_rdwr_ioctl_data transaction;
+
+	transaction.msgs = messages;
+	transaction.nmsgs = n_messages;
+
+	return ioctl(fd_i2c, I2C_RDWR, &transaction);
+}
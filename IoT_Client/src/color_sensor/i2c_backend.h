@@ -0,0 +1,37 @@
+/*
+ * i2c_backend.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef I2C_BACKEND_H_
+#define I2C_BACKEND_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <linux/i2c.h>		// For i2c_msg struct
+
+
+
+/* TYPE DEFINITIONS */
+
+// Bus access primitives under the sensor interface: Linux i2c-dev device files or simulated sensors
+typedef struct {
+	const char*	name;
+	int			(*open)			(const char* bus);										// returns descriptor, -1 on failure
+	int			(*write)		(int fd_i2c, uint8_t* bytes, int length);				// to slave selected at open, returns bytes written
+	int			(*read)			(int fd_i2c, uint8_t* bytes, int length);				// from slave selected at open, returns bytes read
+	int			(*transfer)		(int fd_i2c, struct i2c_msg* messages, int n_messages);	// combined transaction, returns messages transferred
+} i2c_backend;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+const i2c_backend*	i2c_backend_for_bus		(const char* bus);		// bus paths starting with TCS_SIM_BUS_PREFIX are simulated
+const i2c_backend*	i2c_backend_for_fd		(int fd_i2c);
+
+
+
+#endif /* I2C_BACKEND_H_ */
@@ -33,5 +33,14 @@ void print_error_color_sensor(int error_code) {
 		case 6:
 			printf(">> Data headers are incorrect (Function code & Number of bytes queried)");
 			break;
+		case 7:
+			printf(">> Burst read transaction from I2C slave failed\n");
+			break;
+		case 8:
+			printf(">> Could not request GPIO line events for sensor interrupt\n");
+			break;
+		case 9:
+			printf(">> Timed out waiting for sensor data-ready\n");
+			break;
 	}
 }
@@ -0,0 +1,104 @@
+/*
+ * sensor_array.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For strtol()
+#include <string.h>			// For memset(), strcmp() and strncpy()
+
+#include "sensor_array.h"
+#include "color_sensor_interface.h"
+
+
+
+static sensor_bus*	sensor_array_bus	(sensor_array* array, const char* path);
+
+
+
+/*
+ * Parses comma-separated sensor list "<bus>[:<mux channel>],...", e.g. "/dev/i2c-1:0,/dev/i2c-1:1,/dev/i2c-3".
+ * Sensor ids follow list order; sensors sharing a bus path share its descriptor.
+ */
+int sensor_array_parse(sensor_array* array, const char* spec) {
+	char entries[SENSOR_ARRAY_MAX * (SENSOR_BUS_PATH_SIZE + 4)];
+	char* saveptr = NULL;
+
+	memset(array, 0, sizeof(*array));
+	if (strlen(spec) >= sizeof(entries))
+		return -1;
+	strcpy(entries, spec);
+
+	char* entry;
+	for (entry = strtok_r(entries, ",", &saveptr); entry != NULL; entry = strtok_r(NULL, ",", &saveptr)) {
+		if (array->n_sensors == SENSOR_ARRAY_MAX)
+			return -1;
+
+		int mux_channel = -1;
+		char* channel = strchr(entry, ':');
+		if (channel != NULL) {
+			char* end;
+			*channel++ = '\0';
+			mux_channel = (int) strtol(channel, &end, 10);
+			if ((*end != '\0') || (mux_channel < 0) || (mux_channel >= TCA9548A_CHANNELS))
+				return -1;
+		}
+		if ((entry[0] == '\0') || (strlen(entry) >= SENSOR_BUS_PATH_SIZE))
+			return -1;
+
+		sensor_bus* bus = sensor_array_bus(array, entry);
+		if (bus == NULL)
+			return -1;
+
+		int sensor_id = array->n_sensors++;
+		array->sensors[sensor_id].fd_i2c = -1;
+		array->sensors[sensor_id].mux_channel = mux_channel;
+		bus->sensor_ids[bus->n_sensors++] = sensor_id;
+	}
+
+	return (array->n_sensors > 0) ? 0 : -1;
+}
+
+
+
+/*
+ * Opens every bus once and configures each of its sensors with the same setup parameters
+ */
+void sensor_array_setup(sensor_array* array, tcs34725_setup_params* setup) {
+
+	int bus_index, sensor;
+	for (bus_index = 0; bus_index < array->n_buses; bus_index++) {
+		sensor_bus* bus = &array->buses[bus_index];
+		bus->fd_i2c = get_i2c_descriptor(bus->path);
+
+		for (sensor = 0; sensor < bus->n_sensors; sensor++) {
+			tcs34725_sensor* handle = &array->sensors[bus->sensor_ids[sensor]];
+			handle->fd_i2c = bus->fd_i2c;
+
+			printf("COLOR_SENSOR: Setting up sensor %d (%s, mux channel %d)\n", bus->sensor_ids[sensor], bus->path, handle->mux_channel);
+			tcs34725_setup(handle, setup);
+		}
+	}
+}
+
+
+
+static sensor_bus* sensor_array_bus(sensor_array* array, const char* path) {
+
+	int bus_index;
+	for (bus_index = 0; bus_index < array->n_buses; bus_index++) {
+		if (strcmp(array->buses[bus_index].path, path) == 0)
+			return &array->buses[bus_index];
+	}
+
+	if (array->n_buses == SENSOR_ARRAY_MAX_BUSES)
+		return NULL;
+
+	sensor_bus* bus = &array->buses[array->n_buses++];
+	strncpy(bus->path, path, SENSOR_BUS_PATH_SIZE - 1);
+	bus->fd_i2c = -1;
+	return bus;
+}
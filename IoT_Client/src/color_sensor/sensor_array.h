@@ -0,0 +1,52 @@
+/*
+ * sensor_array.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef SENSOR_ARRAY_H_
+#define SENSOR_ARRAY_H_
+
+
+#include "color_sensor.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define SENSOR_ARRAY_MAX			16		// Sensors per station (sensor ids 0 to 15)
+#define SENSOR_ARRAY_MAX_BUSES		4
+#define SENSOR_BUS_PATH_SIZE		32
+
+
+
+/* TYPE DEFINITIONS */
+
+// One I2C bus: its sensors are read one after the other (round-robin), by a single thread
+typedef struct {
+	char				path		[SENSOR_BUS_PATH_SIZE];
+	int					fd_i2c;
+	int					n_sensors;
+	int					sensor_ids	[SENSOR_ARRAY_MAX];
+} sensor_bus;
+
+
+// All sensors of a station, indexed by sensor id (order given in the array specification)
+typedef struct {
+	int					n_sensors;
+	int					n_buses;
+	tcs34725_sensor		sensors		[SENSOR_ARRAY_MAX];
+	sensor_bus			buses		[SENSOR_ARRAY_MAX_BUSES];
+} sensor_array;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		sensor_array_parse		(sensor_array* array, const char* spec);		// returns -1 on malformed specification
+void	sensor_array_setup		(sensor_array* array, tcs34725_setup_params* setup);
+
+
+
+#endif /* SENSOR_ARRAY_H_ */
@@ -0,0 +1,497 @@
+/*
+ * tcs34725_sim.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For fopen() and sscanf()
+#include <stdlib.h>			// For strtof() and realloc()
+#include <string.h>			// For memset(), strcmp() and strtok_r()
+#include <math.h>			// For sin(), log() and sqrt()
+#include <fcntl.h>			// For open()
+#include <time.h>			// For clock_gettime()
+#include <unistd.h>			// For close()
+
+#include "tcs34725_sim.h"
+#include "color_sensor.h"
+#include "color_sensor_interface.h"
+
+
+
+/* Simulated bus: TCA9548A mux with one sensor per channel (channel 0 sensor also answers without mux) */
+typedef struct {
+	int				fd_i2c;			// Placeholder descriptor (/dev/null) identifying the bus
+	uint8_t			mux_mask;
+	uint8_t			mux_pending;	// Control register written in the current transaction, latched at its STOP
+	bool			mux_written;
+	tcs_sim_sensor	sensors		[TCA9548A_CHANNELS];
+} tcs_sim_bus;
+
+
+static tcs_sim_config	sim_config = { TCS_SIM_SINE, 50, 25, 10, 0.5, 1, NULL, 0, 0 };
+static tcs_sim_bus		sim_buses	[TCS_SIM_MAX_BUSES];
+static int				sim_n_buses = 0;
+static struct timespec	sim_epoch;
+
+
+static int				sim_open			(const char* bus);
+static int				sim_write			(int fd_i2c, uint8_t* bytes, int length);
+static int				sim_read			(int fd_i2c, uint8_t* bytes, int length);
+static int				sim_transfer		(int fd_i2c, struct i2c_msg* messages, int n_messages);
+static int				sim_transfer_end	(tcs_sim_bus* bus, int transferred);
+
+static tcs_sim_bus*		sim_bus				(int fd_i2c);
+static int				sim_selected		(tcs_sim_bus* bus);
+static void				sim_command			(tcs_sim_sensor* sensor, uint8_t* bytes, int length);
+static void				sim_register_read	(tcs_sim_sensor* sensor, int sensor_index, uint8_t* bytes, int length);
+static void				sim_update			(tcs_sim_sensor* sensor, int sensor_index);
+static float			sim_signal			(tcs_sim_sensor* sensor, int sensor_index, int channel, long long int cycle, double t_secs);
+static long long int	sim_now_us			(void);
+static int				sim_load_trace		(const char* path);
+static int				sim_check_read		(int fd_i2c, struct i2c_msg* messages, int n_messages, uint8_t expected, const char* check);
+
+
+const i2c_backend i2c_backend_sim = { "tcs34725-sim", sim_open, sim_write, sim_read, sim_transfer };
+
+
+
+/*
+ * Parses comma-separated "key=value" settings: wave=constant|sine|square|ramp, level=<%>, amplitude=<%>,
+ * period=<seconds>, noise=<%>, speed=<factor>, trace=<file> (rows of clarity/red/green/blue %, 4 columns per sensor)
+ */
+int tcs34725_sim_configure(const char* spec) {
+	char settings[256];
+	char* saveptr = NULL;
+
+	if (strlen(spec) >= sizeof(settings))
+		return -1;
+	strcpy(settings, spec);
+
+	char* setting;
+	for (setting = strtok_r(settings, ",", &saveptr); setting != NULL; setting = strtok_r(NULL, ",", &saveptr)) {
+		char* value = strchr(setting, '=');
+		if (value == NULL)
+			return -1;
+		*value++ = '\0';
+
+		if (strcmp(setting, "wave") == 0) {
+			if (strcmp(value, "constant") == 0)
+				sim_config.waveform = TCS_SIM_CONSTANT;
+			else if (strcmp(value, "sine") == 0)
+				sim_config.waveform = TCS_SIM_SINE;
+			else if (strcmp(value, "square") == 0)
+				sim_config.waveform = TCS_SIM_SQUARE;
+			else if (strcmp(value, "ramp") == 0)
+				sim_config.waveform = TCS_SIM_RAMP;
+			else
+				return -1;
+		} else if (strcmp(setting, "level") == 0) {
+			sim_config.level = strtof(value, NULL);
+		} else if (strcmp(setting, "amplitude") == 0) {
+			sim_config.amplitude = strtof(value, NULL);
+		} else if (strcmp(setting, "period") == 0) {
+			sim_config.period_secs = strtof(value, NULL);
+		} else if (strcmp(setting, "noise") == 0) {
+			sim_config.noise = strtof(value, NULL);
+		} else if (strcmp(setting, "speed") == 0) {
+			sim_config.speed = strtof(value, NULL);
+		} else if (strcmp(setting, "trace") == 0) {
+			if (sim_load_trace(value) < 0)
+				return -1;
+			sim_config.waveform = TCS_SIM_TRACE;
+		} else {
+			return -1;
+		}
+	}
+
+	if ((sim_config.period_secs <= 0) || (sim_config.speed <= 0) || (sim_config.noise < 0))
+		return -1;
+	return 0;
+}
+
+
+
+/*
+ * Checks the sensor interface against a simulated bus, its sensors told apart by their ATIME register: a channel
+ * select sharing the read's transaction must read the previously selected sensor (mux switched at STOP), and
+ * i2c_read_block must read the sensor of the channel asked for, whatever was selected before
+ * returns number of failed checks
+ */
+int tcs34725_sim_check(void) {
+	uint8_t channel_mask, command, value;
+	int channel, failures = 0;
+
+	int fd_i2c = get_i2c_descriptor(TCS_SIM_BUS_PREFIX);
+	if (fd_i2c < 0)
+		return 1;
+
+	for (channel = 0; channel < TCA9548A_CHANNELS; channel++) {
+		if (i2c_mux_select(fd_i2c, channel) < 0)
+			return 1;
+		write_config_byte(fd_i2c, TCS_REG_ATIME, (uint8_t) (0xC0 + channel));
+	}
+
+	// Channel 7 left selected: select of channel 1 behind a repeated start, then read in a transaction of its own
+	channel_mask = 1 << 1;
+	command = TCS_CMD_AUTOINC | TCS_REG_ATIME;
+	struct i2c_msg shared[3] = { { TCA9548A_ADDR, 0, 1, &channel_mask }, { TCS34725_ADDR, 0, 1, &command }, { TCS34725_ADDR, I2C_M_RD, 1, &value } };
+	failures += sim_check_read(fd_i2c, shared, 3, 0xC0 + 7, "select and read in one transaction read previous channel");
+	failures += sim_check_read(fd_i2c, &shared[1], 2, 0xC0 + 1, "read after that transaction reads selected channel");
+
+	// Interface: every read switching channels (channel 1 left selected by the transaction above)
+	int order[] = { 0, 5, 2, 7, 1, 6, 3, 4, 0, 7 };
+	int index;
+	for (index = 0; index < (int) (sizeof(order) / sizeof(int)); index++) {
+		char check[64];
+		snprintf(check, sizeof(check), "i2c_read_block reads channel %d", order[index]);
+		value = 0;
+		if (i2c_read_block(fd_i2c, order[index], TCS_REG_ATIME, &value, 1) < 0)
+			value = 0;
+		if (value != (uint8_t) (0xC0 + order[index])) {
+			printf("COLOR_SENSOR: Check failed: %s (ATIME 0x%02x)\n", check, value);
+			failures++;
+		}
+	}
+
+	printf("COLOR_SENSOR: Simulated bus check: %s (%d failed)\n", (failures == 0) ? "passed" : "FAILED", failures);
+	return failures;
+}
+
+
+
+bool tcs34725_sim_owns(int fd_i2c) {
+
+	return (sim_bus(fd_i2c) != NULL);
+}
+
+
+
+static int sim_open(const char* bus) {
+
+	if (sim_n_buses == TCS_SIM_MAX_BUSES)
+		return -1;
+	if (sim_n_buses == 0)
+		clock_gettime(CLOCK_MONOTONIC, &sim_epoch);
+
+	// Real descriptor as identifier: never collides with other buses' descriptors
+	int fd_i2c = open("/dev/null", O_RDWR);
+	if (fd_i2c < 0)
+		return -1;
+
+	tcs_sim_bus* sim = &sim_buses[sim_n_buses];
+	memset(sim, 0, sizeof(*sim));
+	sim->fd_i2c = fd_i2c;
+
+	int channel;
+	for (channel = 0; channel < TCA9548A_CHANNELS; channel++) {
+		tcs_sim_sensor* sensor = &sim->sensors[channel];
+		sensor->registers[TCS_REG_ATIME] = 0xFF;
+		sensor->registers[TCS_REG_WTIME] = 0xFF;
+		sensor->registers[0x12] = TCS_SIM_ID;
+		sensor->seed = (unsigned int) ((sim_n_buses * TCA9548A_CHANNELS) + channel + 1);
+	}
+	sim_n_buses++;
+
+	printf("COLOR_SENSOR: Simulated sensor bus %s (descriptor %d)\n", bus, fd_i2c);
+	return fd_i2c;
+}
+
+
+
+static int sim_write(int fd_i2c, uint8_t* bytes, int length) {
+
+	tcs_sim_bus* bus = sim_bus(fd_i2c);
+	if ((bus == NULL) || (length < 1))
+		return -1;
+
+	sim_command(&bus->sensors[sim_selected(bus)], bytes, length);
+	return length;
+}
+
+
+
+static int sim_read(int fd_i2c, uint8_t* bytes, int length) {
+
+	tcs_sim_bus* bus = sim_bus(fd_i2c);
+	if (bus == NULL)
+		return -1;
+
+	int channel = sim_selected(bus);
+	sim_register_read(&bus->sensors[channel], ((bus - sim_buses) * TCA9548A_CHANNELS) + channel, bytes, length);
+	return length;
+}
+
+
+
+/*
+ * Combined transaction: messages to the sensor address go to the selected sensor; a write to the mux takes effect
+ * at the STOP ending the transaction, as on a TCA9548A (messages after it, behind the repeated start, still go to
+ * the previously selected sensor). Any other address is not acknowledged, ending the transaction.
+ */
+static int sim_transfer(int fd_i2c, struct i2c_msg* messages, int n_messages) {
+
+	tcs_sim_bus* bus = sim_bus(fd_i2c);
+	if (bus == NULL)
+		return -1;
+
+	int message;
+	for (message = 0; message < n_messages; message++) {
+		struct i2c_msg* msg = &messages[message];
+		bool read = (msg->flags & I2C_M_RD);
+
+		if ((msg->addr == TCA9548A_ADDR) && !read && (msg->len == 1)) {
+			bus->mux_pending = msg->buf[0];
+			bus->mux_written = true;
+		} else if (msg->addr == TCS34725_ADDR) {
+			int channel = sim_selected(bus);
+			if (read)
+				sim_register_read(&bus->sensors[channel], ((bus - sim_buses) * TCA9548A_CHANNELS) + channel, msg->buf, msg->len);
+			else
+				sim_command(&bus->sensors[channel], msg->buf, msg->len);
+		} else {
+			return sim_transfer_end(bus, (message > 0) ? message : -1);
+		}
+	}
+
+	return sim_transfer_end(bus, n_messages);
+}
+
+
+
+static int sim_transfer_end(tcs_sim_bus* bus, int transferred) {
+
+	if (bus->mux_written)
+		bus->mux_mask = bus->mux_pending;
+	bus->mux_written = false;
+	return transferred;
+}
+
+
+
+static tcs_sim_bus* sim_bus(int fd_i2c) {
+
+	int bus;
+	for (bus = 0; bus < sim_n_buses; bus++) {
+		if (sim_buses[bus].fd_i2c == fd_i2c)
+			return &sim_buses[bus];
+	}
+	return NULL;
+}
+
+
+
+static int sim_selected(tcs_sim_bus* bus) {
+
+	int channel;
+	for (channel = 0; channel < TCA9548A_CHANNELS; channel++) {
+		if (bus->mux_mask & (1 << channel))
+			return channel;
+	}
+	return 0;
+}
+
+
+
+/*
+ * Command byte (CMD bit set): either a special function (clear interrupt) or register address and transaction
+ * type, followed by bytes written from that address on.
+ */
+static void sim_command(tcs_sim_sensor* sensor, uint8_t* bytes, int length) {
+
+	if (!(bytes[0] & TCS_CMD_BYTE))
+		return;
+
+	if ((bytes[0] & 0x60) == 0x60) {
+		if (bytes[0] == TCS_CMD_CLEAR_INT)
+			sensor->registers[TCS_REG_STATUS] &= ~TCS_STATUS_AINT;
+		return;
+	}
+
+	sensor->pointer = bytes[0] & 0x1F;
+	sensor->auto_increment = ((bytes[0] & 0x60) == 0x20);
+
+	int index;
+	for (index = 1; index < length; index++) {
+		uint8_t previous_enable = sensor->registers[TCS_REG_ENABLE];
+		sensor->registers[sensor->pointer] = bytes[index];
+
+		// RGBC cycles (re)start when AEN gets set
+		if ((sensor->pointer == TCS_REG_ENABLE) && (bytes[index] & 0x02) && !(previous_enable & 0x02)) {
+			sensor->cycle_start_us = sim_now_us();
+			sensor->cycles_done = 0;
+			sensor->registers[TCS_REG_STATUS] = 0;
+		}
+		if (sensor->auto_increment)
+			sensor->pointer = (sensor->pointer + 1) % TCS_SIM_REGISTERS;
+	}
+}
+
+
+
+static void sim_register_read(tcs_sim_sensor* sensor, int sensor_index, uint8_t* bytes, int length) {
+
+	sim_update(sensor, sensor_index);
+
+	int index;
+	for (index = 0; index < length; index++) {
+		bytes[index] = sensor->registers[sensor->pointer];
+		if (sensor->auto_increment)
+			sensor->pointer = (sensor->pointer + 1) % TCS_SIM_REGISTERS;
+	}
+}
+
+
+
+/*
+ * Completes RGBC cycles elapsed since last access: cycle time = 2.4 ms (init) + integration time + waiting time
+ * (x12 with WLONG). Data registers latch the signal at the end of the last completed cycle; AVALID is set and,
+ * with AIEN, AINT raised (persistence filter assumed to be 0: every cycle).
+ */
+static void sim_update(tcs_sim_sensor* sensor, int sensor_index) {
+
+	uint8_t enable = sensor->registers[TCS_REG_ENABLE];
+	if ((enable & 0x03) != 0x03)
+		return;
+
+	int a_cycles = TCS34725_MAX_CYCLES - sensor->registers[TCS_REG_ATIME];
+	long long int cycle_us = TCS34725_CYCLE_US + ((long long int) a_cycles * TCS34725_CYCLE_US);
+	if (enable & 0x08) {
+		long long int wait_us = (long long int) (TCS34725_MAX_CYCLES - sensor->registers[TCS_REG_WTIME]) * TCS34725_CYCLE_US;
+		cycle_us += (sensor->registers[0x0D] & 0x02) ? (wait_us * 12) : wait_us;
+	}
+
+	long long int cycles = (sim_now_us() - sensor->cycle_start_us) / cycle_us;
+	if (cycles <= sensor->cycles_done)
+		return;
+	sensor->cycles_done = cycles;
+
+	// Full scale counts: 1024 per integration step, up to 16 bits
+	long int max_count = (long int) a_cycles * 1024;
+	if (max_count > 65535)
+		max_count = 65535;
+
+	double t_secs = (double) (sensor->cycle_start_us + (cycles * cycle_us)) / 1000000.0;
+	int channel;
+	for (channel = 0; channel < 4; channel++) {
+		float percent = sim_signal(sensor, sensor_index, channel, cycles, t_secs);
+		uint16_t count = (uint16_t) ((percent / 100) * max_count);
+		sensor->registers[TCS_REG_DATA_C_LOW + (channel * 2)] = (uint8_t) count;
+		sensor->registers[TCS_REG_DATA_C_LOW + (channel * 2) + 1] = (uint8_t) (count >> 8);
+	}
+
+	sensor->registers[TCS_REG_STATUS] |= TCS_STATUS_AVALID;
+	if (enable & TCS_ENABLE_AIEN)
+		sensor->registers[TCS_REG_STATUS] |= TCS_STATUS_AINT;
+}
+
+
+
+static float sim_signal(tcs_sim_sensor* sensor, int sensor_index, int channel, long long int cycle, double t_secs) {
+
+	double value;
+	if (sim_config.waveform == TCS_SIM_TRACE) {
+		// One trace row per cycle (looping); sensors without their own columns share the first four
+		int column = ((sensor_index * 4) + channel < sim_config.trace_columns) ? (sensor_index * 4) + channel : channel;
+		value = sim_config.trace[((cycle % sim_config.trace_rows) * sim_config.trace_columns) + column];
+	} else {
+		// Channels and sensors phase-shifted so they can be told apart
+		double phase = (t_secs / sim_config.period_secs) + (channel * 0.1) + (sensor_index * 0.25);
+		double fraction = phase - floor(phase);
+		double shape = 0;
+		switch(sim_config.waveform) {
+			case TCS_SIM_SINE:
+				shape = sin(2 * M_PI * fraction);
+				break;
+			case TCS_SIM_SQUARE:
+				shape = (fraction < 0.5) ? 1 : -1;
+				break;
+			case TCS_SIM_RAMP:
+				shape = (2 * fraction) - 1;
+				break;
+			default:
+				break;
+		}
+		value = sim_config.level + (sim_config.amplitude * shape);
+	}
+
+	// Gaussian noise (Box-Muller)
+	if (sim_config.noise > 0) {
+		double u1 = ((double) rand_r(&sensor->seed) + 1) / ((double) RAND_MAX + 2);
+		double u2 = ((double) rand_r(&sensor->seed) + 1) / ((double) RAND_MAX + 2);
+		value += sim_config.noise * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+	}
+
+	if (value < 0)
+		value = 0;
+	if (value > 100)
+		value = 100;
+	return (float) value;
+}
+
+
+
+static long long int sim_now_us(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long int real_us = ((long long int) (now.tv_sec - sim_epoch.tv_sec) * 1000000LL) + ((now.tv_nsec - sim_epoch.tv_nsec) / 1000);
+	return (long long int) (real_us * sim_config.speed);
+}
+
+
+
+static int sim_check_read(int fd_i2c, struct i2c_msg* messages, int n_messages, uint8_t expected, const char* check) {
+
+	uint8_t* value = messages[n_messages - 1].buf;
+	*value = 0;
+	if ((sim_transfer(fd_i2c, messages, n_messages) != n_messages) || (*value != expected)) {
+		printf("COLOR_SENSOR: Check failed: %s (ATIME 0x%02x)\n", check, *value);
+		return 1;
+	}
+	return 0;
+}
+
+
+
+/*
+ * Loads trace file: one row per integration cycle, whitespace or comma separated values, '#' comment lines
+ */
+static int sim_load_trace(const char* path) {
+
+	FILE* trace_file = fopen(path, "r");
+	if (trace_file == NULL)
+		return -1;
+
+	char line[1024];
+	while (fgets(line, sizeof(line), trace_file) != NULL) {
+		if (line[0] == '#')
+			continue;
+
+		float values[TCA9548A_CHANNELS * TCS_SIM_MAX_BUSES * 4];
+		int n_values = 0;
+		char* saveptr = NULL;
+		char* token;
+		for (token = strtok_r(line, " \t,\r\n", &saveptr); (token != NULL) && (n_values < (int) (sizeof(values) / sizeof(float))); token = strtok_r(NULL, " \t,\r\n", &saveptr))
+			values[n_values++] = strtof(token, NULL);
+		if (n_values < 4)
+			continue;
+
+		// Column count set by first row; shorter rows are skipped
+		if (sim_config.trace_rows == 0)
+			sim_config.trace_columns = n_values - (n_values % 4);
+		if (n_values < sim_config.trace_columns)
+			continue;
+
+		float* trace = realloc(sim_config.trace, (size_t) (sim_config.trace_rows + 1) * sim_config.trace_columns * sizeof(float));
+		if (trace == NULL)
+			break;
+		sim_config.trace = trace;
+		memcpy(&trace[sim_config.trace_rows * sim_config.trace_columns], values, sim_config.trace_columns * sizeof(float));
+		sim_config.trace_rows++;
+	}
+	fclose(trace_file);
+
+	return (sim_config.trace_rows > 0) ? 0 : -1;
+}
@@ -0,0 +1,76 @@
+/*
+ * tcs34725_sim.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef TCS34725_SIM_H_
+#define TCS34725_SIM_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>			// For register types (e.g. uint8_t)
+
+#include "i2c_backend.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define TCS_SIM_BUS_PREFIX		"sim"	// Bus paths selecting simulated sensors (e.g. "sim", "sim1:0")
+#define TCS_SIM_MAX_BUSES		4
+#define TCS_SIM_REGISTERS		0x20
+#define TCS_SIM_ID				0x44	// ID register value of TCS34721/TCS34725
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef enum {
+	TCS_SIM_CONSTANT,
+	TCS_SIM_SINE,
+	TCS_SIM_SQUARE,
+	TCS_SIM_RAMP,
+	TCS_SIM_TRACE
+} tcs_sim_waveform;
+
+
+// Signal fed to every simulated sensor (percent of full scale counts for current integration time)
+typedef struct {
+	tcs_sim_waveform	waveform;
+	float				level;			// Mean value (%)
+	float				amplitude;		// Waveform amplitude (%)
+	float				period_secs;
+	float				noise;			// Gaussian noise standard deviation (%)
+	float				speed;			// Simulated clock speed factor (integration cycles run this many times faster)
+	float*				trace;			// Recorded trace rows (4 values per sensor and row, %)
+	int					trace_rows;
+	int					trace_columns;
+} tcs_sim_config;
+
+
+// Register model of one simulated TCS34725
+typedef struct {
+	uint8_t				registers	[TCS_SIM_REGISTERS];
+	uint8_t				pointer;			// Register address of last command
+	bool				auto_increment;
+	long long int		cycle_start_us;		// Simulated time RGBC cycles started (AEN set)
+	long long int		cycles_done;
+	unsigned int		seed;
+} tcs_sim_sensor;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		tcs34725_sim_configure	(const char* spec);		// returns -1 on malformed specification or unreadable trace
+int		tcs34725_sim_check		(void);					// returns number of failed checks
+bool	tcs34725_sim_owns		(int fd_i2c);
+
+
+extern const i2c_backend i2c_backend_sim;
+
+
+
+#endif /* TCS34725_SIM_H_ */
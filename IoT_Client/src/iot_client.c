@@ -16,6 +16,9 @@
 #include <netinet/udp.h>	// For socket()
 #include <unistd.h>			// For close()
 #include <arpa/inet.h>		// For inet_aton()
+#include <pthread.h>		// For sampling and network threads
+#include <sched.h>			// For SCHED_FIFO
+#include <time.h>			// For clock_gettime()
 
 #include "iot_lib.h"
 #include "iot_client.h"
@@ -23,69 +26,579 @@
 
 
 
-int main(void) {
+int main(int argc, char* argv[]) {
 
-	/* STEP 1 - Initialize both sensor and communication socket */
+	/* STEP 1 - Parse command line options and initialize communication socket */
 
-	struct sockaddr_in server_addr;
-	tcs34725_setup_params sensor_setup = {0x00, 0xFF, 0x01, false};
+	client_options options;
+	parse_param_options(&options, argc, argv);
 
-	int fd_sensor = tcs34725_setup(&sensor_setup);
-	int client_socket = client_socket_init(&server_addr);
+	static client_context context;		// Static: shared with network thread, sample ring too large for the stack
+	context.server_addr = options.server_addr;
+	context.client_socket = client_socket_init(&context.server_addr);
 
 
 	/* STEP 2 - Send communication request to server to ensure communication and parse timing parameters */
 
-	timing_rates timings;
 	uint8_t buffer_send[DATAGRAM_SIZE] = {'\0'};
 	uint8_t buffer_recv[DATAGRAM_SIZE] = {'\0'};
 
-	client_tcs34725_build_data(DATAGRAM_REQ_COMM, 0, NULL, buffer_send);
-	client_send_data(client_socket, &server_addr, buffer_send, buffer_recv);
-	client_parse_timing_params(&timings, buffer_recv);
+	uint8_t capabilities = COMM_CAP_RATES_MS | COMM_CAP_RATE_CONTROL | COMM_CAP_TIMESTAMP_MS | (options.aggregate ? COMM_CAP_AGGREGATE : 0) | (options.trace ? COMM_CAP_TRACE : 0)
+			| (options.checksum ? COMM_CAP_CRC32C : 0);
+	if (sensor_array_parse(&context.sensors, (options.sensors != NULL) ? options.sensors : I2C_INTERFACE) < 0) {
+		print_error_client(4);
+		exit(EXIT_FAILURE);
+	}
+	if (context.sensors.n_sensors > 1)
+		capabilities |= COMM_CAP_SENSOR_ID;
+
+	// Every attempt stamped on its own: a retry's stamps paired with an earlier attempt's would skew the clock offset
+	client_build_comm_request(capabilities, buffer_send);
+	int64_t comm_sent_us, comm_replied_us;
+	int recv_len;
+	do {
+		comm_sent_us = client_now_us();
+		recv_len = client_send_once(context.client_socket, &context.server_addr, buffer_send, buffer_recv, 0);
+		comm_replied_us = client_now_us();
+	} while (recv_len < 0);
+	memset(buffer_send, 0, DATAGRAM_SIZE);
+	context.capabilities = client_parse_timing_params(&context.timings, buffer_recv);
+	atomic_init(&context.sampling_ms, context.timings.sampling);
+	atomic_init(&context.stream_ms, context.timings.server_stream);
+	client_trace_handshake(&context, buffer_recv, comm_sent_us, comm_replied_us);
+
+	// Samples of several sensors can only be told apart by servers accepting sensor ids
+	if ((context.sensors.n_sensors > 1) && !(context.capabilities & COMM_CAP_SENSOR_ID)) {
+		print_error_client(8);
+		exit(EXIT_FAILURE);
+	}
+
+
+	/* STEP 3 - Initialize sensors with integration/waiting times matching the sampling rate */
+
+	if ((options.simulation != NULL) && (tcs34725_sim_configure(options.simulation) < 0)) {
+		print_error_client(4);
+		exit(EXIT_FAILURE);
+	}
+
+	tcs34725_setup_params sensor_setup = {0x00, 0xFF, 0x01, false, false};
+	tcs34725_timing_for_period(&sensor_setup, context.timings.sampling);
+	sensor_setup.i_enable = options.data_ready;
+	sensor_array_setup(&context.sensors, &sensor_setup);
+
+	// Data-ready mode with INT pin wired to a GPIO line: block on its edge events instead of polling STATUS
+	int fd_gpio = -1;
+	if (options.data_ready && (options.gpio_line >= 0)) {
+		if (context.sensors.n_sensors > 1) {
+			print_error_client(9);
+			exit(EXIT_FAILURE);
+		}
+		fd_gpio = get_gpio_event_descriptor(options.gpio_line);
+
+		// INT may already be asserted (low) from cycles completed before the line was requested: its edge is gone
+		tcs34725_clear_interrupt(&context.sensors.sensors[context.sensors.buses[0].sensor_ids[0]]);
+	}
 
-	// Set server stream buffer to twice the sampling ratio in case of sending datagram failure
-	// int sampling_ratio = timings.server_stream / timings.sampling + 1;
-	uint8_t server_buffer[MAX_SAMPLING_RATIO][DATAGRAM_SAMPLE_SIZE] = {{'\0'}};
 
+	/* STEP 4 - Start network thread: stores ring samples into spool and forwards them, so network stalls never stop sampling */
+
+	int bus;
+	for (bus = 0; bus < context.sensors.n_buses; bus++)
+		sample_ring_init(&context.rings[bus]);
+	context.catchup_rate = options.catchup_rate;
+	if (spool_open(&context.spool, options.spool_path, DATAGRAM_TAGGED_SAMPLE_SIZE, (options.spool_path != NULL) ? SPOOL_FILE_CAPACITY : SPOOL_MEMORY_CAPACITY) < 0) {
+		print_error_client(7);
+		exit(EXIT_FAILURE);
+	}
+
+	// Aggregation accepted by server: window summaries get their own spool (<spool file>.summary)
+	if (context.capabilities & COMM_CAP_AGGREGATE) {
+		char summary_path[256];
+		if (options.spool_path != NULL)
+			snprintf(summary_path, sizeof(summary_path), "%s.summary", options.spool_path);
+		if (spool_open(&context.summary_spool, (options.spool_path != NULL) ? summary_path : NULL, DATAGRAM_SUMMARY_SIZE, SPOOL_SUMMARY_CAPACITY) < 0) {
+			print_error_client(7);
+			exit(EXIT_FAILURE);
+		}
+		printf("IOT_CLIENT: Edge aggregation enabled: one summary per %d ms window\n", context.timings.server_stream);
+	}
+
+	pthread_t network_thread;
+	if (pthread_create(&network_thread, NULL, client_network_thread, &context) != 0) {
+		print_error_client(6);
+		exit(EXIT_FAILURE);
+	}
+
+
+	/* STEP 5 - Sample: one thread per bus, so buses are read in parallel (first bus on main thread) */
+
+	static client_sampler samplers[SENSOR_ARRAY_MAX_BUSES];
+	for (bus = 0; bus < context.sensors.n_buses; bus++) {
+		samplers[bus].context = &context;
+		samplers[bus].bus = &context.sensors.buses[bus];
+		samplers[bus].ring = &context.rings[bus];
+		samplers[bus].data_ready = options.data_ready;
+		samplers[bus].quiet = options.quiet;
+		samplers[bus].fd_gpio = fd_gpio;
+		samplers[bus].setup = sensor_setup;
+	}
+	printf("IOT_CLIENT: Sampling %d sensors on %d buses\n", context.sensors.n_sensors, context.sensors.n_buses);
+
+	for (bus = 1; bus < context.sensors.n_buses; bus++) {
+		pthread_t sampling_thread;
+		if (pthread_create(&sampling_thread, NULL, client_sampling_thread, &samplers[bus]) != 0) {
+			print_error_client(6);
+			exit(EXIT_FAILURE);
+		}
+	}
+	client_sampling_thread(&samplers[0]);
+
+	close(context.client_socket);
+
+	return EXIT_SUCCESS;
+
+}
+
+
+
+
+
+/**
+ * client_sampling_thread
+ * reads the sensors of one bus round-robin on every tick of a drift-free periodic schedule (or, in data-ready mode,
+ * once per sensor integration cycle) and pushes tagged samples into the bus' ring for the network thread.
+ * Sampling rate changes from the server take effect on the next tick.
+ */
+void* client_sampling_thread(void* arg) {
+
+	client_sampler* sampler = (client_sampler*) arg;
+	client_context* context = sampler->context;
+	client_set_realtime();
+
+	/* Drift-free periodic schedule: one tick per sampling period, absolute deadlines */
+	sampling_scheduler sched;
+	int sampling_ms = atomic_load(&context->sampling_ms);
+	scheduler_init(&sched, (long int) sampling_ms * 1000);
+	long int next_report_ms = atomic_load(&context->stream_ms);
 
-	long int seconds = 0; int server_buffer_index = 0;
 	while(1) {
+		if (atomic_load(&context->sampling_ms) != sampling_ms) {
+			sampling_ms = atomic_load(&context->sampling_ms);
+			scheduler_set_period(&sched, (long int) sampling_ms * 1000);
+			client_retime_sensors(sampler, sampling_ms);
+		}
 		uint8_t sensor_data[TCS34725_SAMPLE_SIZE];
+		uint8_t sample[DATAGRAM_TAGGED_SAMPLE_SIZE];
 
-		/* STEP 3 - Read data from sensor */
+		/* STEP 1 - Read data from every sensor of the bus */
 
-		if (seconds % timings.sampling == 0) {
-			printf("\nIOT_CLIENT: Sampling sensor at %ld seconds\n", seconds);
-			tcs34725_read(fd_sensor, sensor_data);
-			tcs34725_print(sensor_data);
+		long int elapsed_ms = 0;
+		if (!sampler->data_ready) {
+			scheduler_wait_next(&sched);
+			elapsed_ms = scheduler_elapsed_ms(&sched);
+		}
 
-			// Push sensor reading into server buffer for subsequent streaming
-			client_push_server_buffer(seconds, server_buffer_index, sensor_data, server_buffer);
-			server_buffer_index++;
+		int sensor;
+		for (sensor = 0; sensor < sampler->bus->n_sensors; sensor++) {
+			int sensor_id = sampler->bus->sensor_ids[sensor];
+			tcs34725_sensor* handle = &context->sensors.sensors[sensor_id];
+
+			int read_status;
+			if (sampler->data_ready) {
+				read_status = tcs34725_read_ready(handle, sampler->fd_gpio, sensor_data);
+				elapsed_ms = scheduler_now_ms(&sched);
+			} else {
+				read_status = tcs34725_read(handle, sensor_data);
+			}
+			sample_trace trace = { client_now_us(), handle->last_read_us };
+
+			if (!sampler->quiet)
+				printf("\nIOT_CLIENT: Sampled sensor %d at %ld ms\n", sensor_id, elapsed_ms);
+			if (read_status == 0) {
+				if (!sampler->quiet)
+					tcs34725_print(sensor_data);
+
+				// Push sensor reading into sample ring for network thread (dropped and counted if ring is full), stamped
+				// in milliseconds if the server tells them apart (COMM_CAP_TIMESTAMP_MS), whole seconds otherwise
+				sample[0] = (uint8_t) sensor_id;
+				client_encode_sample((context->capabilities & COMM_CAP_TIMESTAMP_MS) ? elapsed_ms : elapsed_ms / 1000, sensor_data, &sample[1]);
+				sample_ring_push(sampler->ring, sample, &trace);
+			}
 		}
 
 
-		/* STEP 4 - Build message from sensor data and send to server */
+		/* STEP 2 - Report timing quality and ring state once per streaming period */
+
+		if (elapsed_ms >= next_report_ms) {
+			if (!sampler->data_ready)
+				scheduler_print_jitter(&sched);
+			printf("IOT_CLIENT: %s sample ring depth %lu - dropped %lu\n", sampler->bus->path, sample_ring_depth(sampler->ring), atomic_load(&sampler->ring->dropped));
+
+			while (next_report_ms <= elapsed_ms)
+				next_report_ms += atomic_load(&context->stream_ms);
+		}
+	}
+
+	return NULL;
+}
+
+
+
+
+
+/**
+ * client_network_thread
+ * moves samples from the sampling threads' rings into the spool (through each sensor's window aggregate when
+ * aggregation is enabled), and sends spooled records to server: at the streaming rate while live, at the catch-up rate while
+ * a backlog is pending. Records leave the spool only once acknowledged; unacknowledged datagrams are retried
+ * with exponential backoff.
+ */
+void* client_network_thread(void* arg) {
+
+	client_context* context = (client_context*) arg;
+	bool aggregate_enabled = (context->capabilities & COMM_CAP_AGGREGATE);
+	uint8_t server_buffer[MAX_SAMPLING_RATIO][DATAGRAM_TAGGED_SAMPLE_SIZE];
+	sample_trace traces[MAX_SAMPLING_RATIO];
+
+	window_aggregate aggregates[SENSOR_ARRAY_MAX];
+	int sensor;
+	for (sensor = 0; sensor < SENSOR_ARRAY_MAX; sensor++)
+		aggregate_init(&aggregates[sensor], (uint8_t) sensor);
+
+	sampling_scheduler net_sched;
+	scheduler_init(&net_sched, CLIENT_NETWORK_TICK_MS * 1000L);
+
+	long int next_send_ms = atomic_load(&context->stream_ms);
+	long int next_window_ms = atomic_load(&context->stream_ms);
+	long int backoff_ms = CLIENT_BACKOFF_MIN_MS;
+	while(1) {
+		scheduler_wait_next(&net_sched);
+		long int now_ms = scheduler_now_ms(&net_sched);
+
+		/* STEP 1 - Store: move sampled data from rings into spool (batched flash writes) */
+
+		int n_samples, sample, bus;
+		for (bus = 0; bus < context->sensors.n_buses; bus++) {
+			while ((n_samples = sample_ring_pop(&context->rings[bus], server_buffer, traces, MAX_SAMPLING_RATIO)) > 0) {
+				for (sample = 0; sample < n_samples; sample++) {
+					if (aggregate_enabled) {
+						// Only samples around anomalies are kept raw, the rest go into the sensor's window summary
+						uint8_t raw[2][DATAGRAM_TAGGED_SAMPLE_SIZE];
+						int n_raw = aggregate_add(&aggregates[server_buffer[sample][0]], server_buffer[sample], raw);
+						int raw_index;
+						for (raw_index = 0; raw_index < n_raw; raw_index++)
+							client_spool_sample(context, raw[raw_index], &traces[sample]);
+					} else {
+						client_spool_sample(context, server_buffer[sample], &traces[sample]);
+					}
+				}
+			}
+		}
+
+		if (aggregate_enabled && (now_ms >= next_window_ms)) {
+			uint8_t summary[DATAGRAM_SUMMARY_SIZE];
+			for (sensor = 0; sensor < context->sensors.n_sensors; sensor++) {
+				if (aggregate_close(&aggregates[sensor], summary))
+					spool_append(&context->summary_spool, summary);
+			}
+			while (next_window_ms <= now_ms)
+				next_window_ms += atomic_load(&context->stream_ms);
+		}
 
-		if ((seconds > 0) && (seconds % timings.server_stream == 0)) {
-			printf("\nIOT_CLIENT: Sending data to server at %ld seconds\n", seconds);
-			client_tcs34725_build_data(DATAGRAM_REQ_SEND_DATA, server_buffer_index, server_buffer, buffer_send);
-			client_send_data(client_socket, &server_addr, buffer_send, buffer_recv);
+		spool_sync(&context->spool, false);
+		if (aggregate_enabled)
+			spool_sync(&context->summary_spool, false);
+
+
+		/* STEP 2 - Forward: send oldest spooled records when due (summaries first) */
+
+		if (now_ms < next_send_ms)
+			continue;
+
+		int n_sent = 0;
+		if (aggregate_enabled && (spool_depth(&context->summary_spool) > 0))
+			n_sent = client_forward_spool(context, &context->summary_spool, DATAGRAM_REQ_SEND_SUMMARY);
+		else
+			n_sent = client_forward_spool(context, &context->spool, DATAGRAM_REQ_SEND_DATA);
+
+		if (n_sent == 0) {
+			next_send_ms = now_ms + atomic_load(&context->stream_ms);
+		} else if (n_sent > 0) {
+			context->datagrams_sent++;
+			backoff_ms = CLIENT_BACKOFF_MIN_MS;
+
+			// Backlog still pending: drain at catch-up rate, otherwise back to streaming rate
+			bool backlog = (spool_depth(&context->spool) >= MAX_SAMPLING_RATIO) || (aggregate_enabled && (spool_depth(&context->summary_spool) > 0));
+			if (backlog)
+				next_send_ms = scheduler_now_ms(&net_sched) + (1000 / context->catchup_rate);
+			else
+				next_send_ms = now_ms + atomic_load(&context->stream_ms);
+
+			unsigned long ring_dropped = 0;
+			for (bus = 0; bus < context->sensors.n_buses; bus++)
+				ring_dropped += atomic_load(&context->rings[bus].dropped);
+			printf("IOT_CLIENT: Sent %d records - datagrams %lu - retries %lu - spool backlog %llu - ring dropped %lu - spool overwritten %llu\n\n",
+					n_sent, context->datagrams_sent, context->retries, (unsigned long long) spool_depth(&context->spool),
+					ring_dropped, (unsigned long long) context->spool.overwritten);
+		} else {
+			context->retries++;
+			printf("IOT_CLIENT: No reply from server, retrying in %ld ms (spool backlog %llu)\n", backoff_ms, (unsigned long long) spool_depth(&context->spool));
+			next_send_ms = scheduler_now_ms(&net_sched) + backoff_ms;
 
-			memset(buffer_send, 0, DATAGRAM_SIZE); // sizeof(*message) ??
-			memset(server_buffer, 0, (DATAGRAM_SAMPLE_SIZE * MAX_SAMPLING_RATIO));
-			server_buffer_index = 0;
+			backoff_ms *= 2;
+			if (backoff_ms > CLIENT_BACKOFF_MAX_MS)
+				backoff_ms = CLIENT_BACKOFF_MAX_MS;
 		}
+	}
+
+	return NULL;
+}
+
 
-		sleep(1);
-		seconds++;
+
+
+
+/**
+ * client_forward_spool
+ * sends as many of the oldest spooled records as fit in one datagram, releasing them once acknowledged.
+ * Spooled samples are tagged with sensor id: sent as tagged data if the server accepted sensor ids,
+ * otherwise (single sensor) the tag is stripped and they go out as regular sample data.
+ * returns number of records sent, 0 if spool is empty, -1 if server did not reply
+ */
+int client_forward_spool(client_context* context, sample_spool* spool, uint8_t request_type) {
+
+	uint8_t records[MAX_SAMPLING_RATIO * DATAGRAM_TAGGED_SAMPLE_SIZE];
+	uint8_t buffer_send[DATAGRAM_SIZE];
+	uint8_t buffer_recv[DATAGRAM_SIZE];
+
+	int record_size = (int) spool->header->record_size;
+	int wire_size = record_size;
+	if (request_type == DATAGRAM_REQ_SEND_DATA) {
+		if (context->capabilities & COMM_CAP_SENSOR_ID)
+			request_type = DATAGRAM_REQ_SEND_TAGGED_DATA;
+		else
+			wire_size = DATAGRAM_SAMPLE_SIZE;
 	}
 
-	close(client_socket);
+	// Traced samples leave room for the trace trailer, checksummed datagrams for the checksum
+	bool traced = (context->capabilities & COMM_CAP_TRACE) && (request_type != DATAGRAM_REQ_SEND_SUMMARY);
+	bool checksummed = (context->capabilities & COMM_CAP_CRC32C);
+	int trailer_size = traced ? DATAGRAM_TRACE_SIZE : 0;
+	uint64_t position = spool->tail;
+	int n_records = spool_peek(spool, records, (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 1 - trailer_size - (checksummed ? DATAGRAM_CRC_SIZE : 0)) / wire_size);
+	if (n_records == 0)
+		return 0;
 
-	return EXIT_SUCCESS;
+	int record;
+	for (record = 0; (wire_size != record_size) && (record < n_records); record++)
+		memmove(&records[record * wire_size], &records[(record * record_size) + (record_size - wire_size)], wire_size);
 
+	memset(buffer_send, 0, DATAGRAM_SIZE);
+	client_build_records(request_type, n_records, wire_size, records, buffer_send);
+	if (traced)
+		client_build_trace(context, position, n_records, buffer_send);
+	int data_end = DATAGRAM_HEADER_SIZE + (n_records * wire_size) + 1;
+	if (checksummed)
+		trailer_size = datagram_seal_crc32c(buffer_send, data_end + trailer_size) - data_end;
+
+	int recv_len = client_send_once(context->client_socket, &context->server_addr, buffer_send, buffer_recv, trailer_size);
+	if (recv_len < 0)
+		return -1;
+
+	// Corrupted acknowledgement: records stay spooled and are sent again
+	if (checksummed && (datagram_check_crc32c(buffer_recv, recv_len) != 1)) {
+		context->corrupt_replies++;
+		printf("IOT_CLIENT: Reply failed CRC32C check (%lu so far)\n", context->corrupt_replies);
+		return -1;
+	}
+
+	spool_consume(spool, n_records);
+	client_apply_rate_update(context, buffer_recv);
+	return n_records;
+}
+
+
+
+
+
+/**
+ * client_spool_sample
+ * appends sample to the spool, keeping its trace by spool position for the datagram that will carry it
+ */
+void client_spool_sample(client_context* context, uint8_t* sample, sample_trace* trace) {
+
+	uint64_t position = context->spool.head;
+	spool_append(&context->spool, sample);
+
+	client_trace_mark* mark = &context->trace_marks[position % CLIENT_TRACE_MARKS];
+	mark->position = position;
+	mark->trace = *trace;
+}
+
+
+
+
+
+/**
+ * client_build_trace
+ * appends trace trailer after the End-Of-Package byte for the n_records samples spooled from position on:
+ * oldest capture time (0 if the first sample's trace is no longer kept), longest sensor read, send time and
+ * the handshake clock offset, for the server to place the stamps on its own clock
+ */
+void client_build_trace(client_context* context, uint64_t position, int n_records, uint8_t* buffer_send) {
+
+	int64_t captured_us = 0;
+	uint32_t read_us = 0;
+	int record;
+	for (record = 0; record < n_records; record++) {
+		client_trace_mark* mark = &context->trace_marks[(position + record) % CLIENT_TRACE_MARKS];
+		if (mark->position != (position + record)) {
+			if (record == 0)
+				break;
+			continue;
+		}
+		if ((captured_us == 0) || (mark->trace.captured_us < captured_us))
+			captured_us = mark->trace.captured_us;
+		if (mark->trace.read_us > read_us)
+			read_us = mark->trace.read_us;
+	}
+
+	uint8_t* trailer = &buffer_send[codec_datagram_size(buffer_send)];
+	codec_trace_set_marker(trailer, DATAGRAM_TRACE_MARKER);
+	codec_trace_set_captured_us(trailer, (uint64_t) captured_us);
+	codec_trace_set_read_us(trailer, read_us);
+	codec_trace_set_sent_us(trailer, (uint64_t) client_now_us());
+	codec_trace_set_offset_us(trailer, (uint64_t) context->trace_offset_us);
+	codec_trace_set_rtt_us(trailer, context->trace_rtt_us);
+}
+
+
+
+
+
+/**
+ * client_trace_handshake
+ * estimates server clock offset from the handshake stamps (NTP-style: request sent, server receive and send, reply
+ * received), or drops COMM_CAP_TRACE if the server did not accept it
+ */
+void client_trace_handshake(client_context* context, uint8_t* buffer_recv, int64_t sent_us, int64_t replied_us) {
+
+	if (!(context->capabilities & COMM_CAP_TRACE) || (codec_datagram_length(buffer_recv) < (DATAGRAM_COMM_REPLY_SIZE + DATAGRAM_COMM_TRACE_SIZE))) {
+		context->capabilities &= ~COMM_CAP_TRACE;
+		return;
+	}
+
+	uint8_t* stamps = codec_datagram_payload(buffer_recv) + DATAGRAM_COMM_REPLY_SIZE;
+	int64_t server_received_us = (int64_t) codec_comm_trace_get_received_us(stamps);
+	int64_t server_sent_us = (int64_t) codec_comm_trace_get_sent_us(stamps);
+	context->trace_offset_us = ((server_received_us - sent_us) + (server_sent_us - replied_us)) / 2;
+	context->trace_rtt_us = (uint32_t) ((replied_us - sent_us) - (server_sent_us - server_received_us));
+	printf("IOT_CLIENT: Latency tracing enabled: server clock offset %lld us (handshake RTT %u us)\n",
+			(long long) context->trace_offset_us, context->trace_rtt_us);
+}
+
+
+
+
+
+/**
+ * client_set_realtime
+ * raises calling (sampling) thread to real-time FIFO priority, if permitted
+ */
+void client_set_realtime(void) {
+
+	struct sched_param param;
+	param.sched_priority = sched_get_priority_max(SCHED_FIFO) / 2;
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+		printf("IOT_CLIENT: Real-time priority not permitted, sampling with default priority\n");
+}
+
+
+
+
+
+/**
+ * parse_param_options
+ * parses command line options: -d data-ready sampling (STATUS polling), -g <line> data-ready sampling on GPIO interrupt line,
+ * -s <file> spool file for store-and-forward, -c <rate> backlog catch-up rate (datagrams per second),
+ * -a request edge aggregation (window summaries instead of raw samples), -m <sensors> sensor array ("<bus>[:<mux channel>],...", "sim" buses are simulated),
+ * -v <settings> simulated sensor signal ("key=value,...": wave, level, amplitude, period, noise, speed, trace), -q quiet sample output,
+ * -t latency tracing (trace trailer on sample datagrams), -k CRC32C checksum on datagrams and replies,
+ * -V check sensor interface against simulated mux and sensors and exit, -S <ip>[:<port>] server address
+ */
+void parse_param_options(client_options* options, int argc, char* argv[]) {
+
+	options->data_ready = false;
+	options->gpio_line = -1;
+	options->spool_path = NULL;
+	options->catchup_rate = CLIENT_DEFAULT_CATCHUP_RATE;
+	options->aggregate = false;
+	options->sensors = NULL;
+	options->simulation = NULL;
+	options->quiet = false;
+	options->trace = false;
+	options->checksum = false;
+	memset(&options->server_addr, 0, sizeof(options->server_addr));
+	options->server_addr.sin_family = AF_INET;
+	options->server_addr.sin_port = htons(SERVER_PORT);
+	inet_aton(SERVER_ADDR, &options->server_addr.sin_addr); // server_addr.sin_addr.s_addr = htonl(SERVER_ADDR_32T);
+
+	int option;
+	char server_ip[32];
+	int server_port;
+	while ((option = getopt(argc, argv, "dg:s:c:am:v:qtkVS:")) != -1) {
+		switch(option) {
+			case 'S':
+				server_port = SERVER_PORT;
+				if ((sscanf(optarg, "%31[^:]:%d", server_ip, &server_port) < 1) || (inet_aton(server_ip, &options->server_addr.sin_addr) == 0)
+						|| (server_port < 1) || (server_port > 65535)) {
+					print_error_client(4);
+					exit(EXIT_FAILURE);
+				}
+				options->server_addr.sin_port = htons((uint16_t) server_port);
+				break;
+			case 'V':
+				exit((tcs34725_sim_check() == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+			case 'k':
+				options->checksum = true;
+				break;
+			case 't':
+				options->trace = true;
+				break;
+			case 'v':
+				options->simulation = optarg;
+				break;
+			case 'q':
+				options->quiet = true;
+				break;
+			case 'm':
+				options->sensors = optarg;
+				break;
+			case 'a':
+				options->aggregate = true;
+				break;
+			case 's':
+				options->spool_path = optarg;
+				break;
+			case 'c':
+				options->catchup_rate = atoi(optarg);
+				if ((options->catchup_rate < 1) || (options->catchup_rate > 1000)) {
+					print_error_client(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'd':
+				options->data_ready = true;
+				break;
+			case 'g':
+				options->data_ready = true;
+				options->gpio_line = atoi(optarg);
+				break;
+			default:
+				print_error_client(4);
+				exit(EXIT_FAILURE);
+		}
+	}
 }
 
 
@@ -94,7 +607,7 @@ int main(void) {
 
 /**
  * client_socket_init
- * returns socket descriptor to communicate with server
+ * returns socket descriptor to communicate with server (server_addr given by caller)
  */
 int client_socket_init(struct sockaddr_in* server_addr) {
 
@@ -116,14 +629,6 @@ int client_socket_init(struct sockaddr_in* server_addr) {
 	printf("IOT_CLIENT: Initialized client UDP socket (descriptor %d)\n", client_socket);
 
 
-	/* Configure address structure to send datagrams to server */
-
-	// Fill sockaddr structure
-	memset(server_addr, 0, sizeof(*server_addr));
-	server_addr->sin_family = AF_INET;
-	server_addr->sin_port =  htons(SERVER_PORT);
-	inet_aton(SERVER_ADDR, &server_addr->sin_addr); // server_addr.sin_addr.s_addr = htonl(SERVER_ADDR_32T);
-
 	client_socket_print_info(server_addr);
 	return client_socket;
 }
@@ -168,40 +673,52 @@ void client_socket_print_info(struct sockaddr_in* sockaddr) {
  */
 void client_send_data(int client_socket, struct sockaddr_in* server_addr, uint8_t* buffer_send, uint8_t* buffer_recv) {
 
-	size_t buffer_send_len = (size_t) ((buffer_send[2] << 8) + buffer_send[1]) + DATAGRAM_HEADER_SIZE + 1;
-
 	ssize_t recv_len = -1;
 	while (recv_len < 0) {
+		recv_len = client_send_once(client_socket, server_addr, buffer_send, buffer_recv, 0);
+	}
 
-		/* Send Packet to Server */
-		ssize_t send_len = sendto(client_socket, buffer_send, buffer_send_len, 0, (const struct sockaddr *) server_addr, sizeof(*server_addr));
-		printf("IOT_CLIENT: Sent %d-byte datagram to server\n", (int) send_len);
-		/*
-		int i;
-		for (i = 0; i < buffer_send_len; i++)
-			printf("	>> %u", buffer_send[i]);
-		printf("\n");
-		*/
+	memset(buffer_send, 0, DATAGRAM_SIZE);
 
+	// printf("IOT_CLIENT: Message sent to			: %lld\n", (unsigned long long int) ntohl(server_reply_addr.sin_addr.s_addr));
+	// printf("IOT_CLIENT: Reply received from		: %lld\n", (unsigned long long int) ntohl(server_addr->sin_addr.s_addr));
+}
 
-		/* Receive Reply */
 
-		struct sockaddr_in server_reply_addr;
-		memset(&server_reply_addr, 0, sizeof(server_reply_addr));
-		socklen_t server_reply_addr_len = sizeof(server_reply_addr);
 
-		recv_len = recvfrom(client_socket, buffer_recv, DATAGRAM_SIZE, 0, (struct sockaddr *) &server_reply_addr, &server_reply_addr_len);
-	}
 
-	printf("IOT_CLIENT: Received %d-byte reply from server\n\n", (int) recv_len);
-	memset(buffer_send, 0, DATAGRAM_SIZE);
 
-	// printf("IOT_CLIENT: Message sent to			: %lld\n", (unsigned long long int) ntohl(server_reply_addr.sin_addr.s_addr));
-	// printf("IOT_CLIENT: Reply received from		: %lld\n", (unsigned long long int) ntohl(server_addr->sin_addr.s_addr));
+/**
+ * client_send_once
+ * sends data (and trailer_size bytes of trailer after the End-Of-Package byte) to server and waits (socket timeout) for its reply
+ * returns reply length, -1 if no reply was received
+ */
+int client_send_once(int client_socket, struct sockaddr_in* server_addr, uint8_t* buffer_send, uint8_t* buffer_recv, int trailer_size) {
+
+	size_t buffer_send_len = (size_t) (codec_datagram_size(buffer_send) + trailer_size);
+
+	/* Send Packet to Server */
+	ssize_t send_len = sendto(client_socket, buffer_send, buffer_send_len, 0, (const struct sockaddr *) server_addr, sizeof(*server_addr));
+	printf("IOT_CLIENT: Sent %d-byte datagram to server\n", (int) send_len);
+	/*
+	int i;
+	for (i = 0; i < buffer_send_len; i++)
+		printf("	>> %u", buffer_send[i]);
+	printf("\n");
+	*/
 
 
+	/* Receive Reply */
 
+	struct sockaddr_in server_reply_addr;
+	memset(&server_reply_addr, 0, sizeof(server_reply_addr));
+	socklen_t server_reply_addr_len = sizeof(server_reply_addr);
 
+	ssize_t recv_len = recvfrom(client_socket, buffer_recv, DATAGRAM_SIZE, 0, (struct sockaddr *) &server_reply_addr, &server_reply_addr_len);
+	if (recv_len >= 0)
+		printf("IOT_CLIENT: Received %d-byte reply from server\n\n", (int) recv_len);
+
+	return (int) recv_len;
 }
 
 
@@ -210,21 +727,68 @@ void client_send_data(int client_socket, struct sockaddr_in* server_addr, uint8_
 
 /**
  * client_parse_timing_params
- * Detects sampling and server streaming rates from server's communication "acceptance"
+ * Detects sampling and server streaming rates (milliseconds) from server's communication "acceptance"
+ * returns capabilities accepted by server (COMM_CAP_* flags)
  */
-void client_parse_timing_params(timing_rates* timings, uint8_t* buffer_recv) {
-
-	if ((buffer_recv[0] == DATAGRAM_REP_COMM_OK)) {
-		int data_length = (int) ((buffer_recv[2] << 8) | (buffer_recv[1]));
-		if (data_length == 2) {
-			timings->sampling = (int) buffer_recv[3];
-			timings->server_stream = (int) buffer_recv[4];
+uint8_t client_parse_timing_params(timing_rates* timings, uint8_t* buffer_recv) {
+
+	uint8_t capabilities = 0;
+	if (codec_header_get_type(buffer_recv) == DATAGRAM_REP_COMM_OK) {
+		int data_length = codec_datagram_length(buffer_recv);
+		uint8_t* reply = codec_datagram_payload(buffer_recv);
+		if ((data_length >= DATAGRAM_COMM_REPLY_SIZE) && (codec_comm_reply_get_capabilities(reply) & COMM_CAP_RATES_MS)) {
+			capabilities = codec_comm_reply_get_capabilities(reply);
+			timings->sampling = (int) codec_comm_reply_get_sampling(reply);
+			timings->server_stream = (int) codec_comm_reply_get_server_stream(reply);
+		} else if (data_length == DATAGRAM_COMM_REPLY_LEGACY_SIZE) {
+			// Legacy server: rates in whole seconds
+			timings->sampling = (int) codec_comm_reply_legacy_get_sampling(reply) * 1000;
+			timings->server_stream = (int) codec_comm_reply_legacy_get_server_stream(reply) * 1000;
 		} else {
 			timings->sampling = DEFAULT_RATE_SAMPLING;
 			timings->server_stream = DEFAULT_RATE_SERVER_STREAM;
 		}
-		printf("IOT CLIENT: sampling rate: %d - server streaming rate: %d\n", timings->sampling, timings->server_stream);
+	} else {
+		timings->sampling = DEFAULT_RATE_SAMPLING;
+		timings->server_stream = DEFAULT_RATE_SERVER_STREAM;
+	}
+
+	if ((timings->sampling < MIN_RATE_SAMPLING) || (timings->server_stream < timings->sampling)
+			|| ((timings->server_stream / timings->sampling) > MAX_SAMPLING_RATIO)) {
+		timings->sampling = DEFAULT_RATE_SAMPLING;
+		timings->server_stream = DEFAULT_RATE_SERVER_STREAM;
 	}
+	printf("IOT CLIENT: sampling rate: %d ms - server streaming rate: %d ms\n", timings->sampling, timings->server_stream);
+
+	return capabilities;
+}
+
+
+
+
+
+/**
+ * client_apply_rate_update
+ * Takes rates piggybacked on a data acknowledgement (COMM_CAP_RATE_CONTROL): sampling (4B) + streaming (4B),
+ * milliseconds LSB first. Rates breaking the handshake constraints are ignored.
+ */
+void client_apply_rate_update(client_context* context, uint8_t* buffer_recv) {
+
+	if (!(context->capabilities & COMM_CAP_RATE_CONTROL) || (codec_header_get_type(buffer_recv) != DATAGRAM_REP_SEND_DATA_OK)
+			|| (codec_datagram_length(buffer_recv) < DATAGRAM_RATE_UPDATE_SIZE))
+		return;
+
+	uint8_t* update = codec_datagram_payload(buffer_recv);
+	int sampling = (int) codec_rate_update_get_sampling(update);
+	int server_stream = (int) codec_rate_update_get_server_stream(update);
+	if ((sampling < MIN_RATE_SAMPLING) || (server_stream < sampling) || ((server_stream / sampling) > MAX_SAMPLING_RATIO))
+		return;
+	if ((sampling == atomic_load(&context->sampling_ms)) && (server_stream == atomic_load(&context->stream_ms)))
+		return;
+
+	atomic_store(&context->sampling_ms, sampling);
+	atomic_store(&context->stream_ms, server_stream);
+	printf("IOT_CLIENT: Server changed rates: sampling rate: %d ms - server streaming rate: %d ms\n", sampling, server_stream);
 }
 
 
@@ -232,20 +796,74 @@ void client_parse_timing_params(timing_rates* timings, uint8_t* buffer_recv) {
 
 
 /**
- *
+ * client_retime_sensors
+ * sets integration/waiting times of the sampler's sensors for a new sampling rate (sampling thread only: it owns the bus)
+ */
+void client_retime_sensors(client_sampler* sampler, int sampling_ms) {
+
+	tcs34725_timing_for_period(&sampler->setup, sampling_ms);
+
+	int sensor;
+	for (sensor = 0; sensor < sampler->bus->n_sensors; sensor++)
+		tcs34725_setup(&sampler->context->sensors.sensors[sampler->bus->sensor_ids[sensor]], &sampler->setup);
+}
+
+
+
+
+
+/**
+ * client_now_us
+ * returns monotonic clock in microseconds (latency trace time base)
+ */
+int64_t client_now_us(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+
+
+
+
+/**
+ * client_build_comm_request
+ * Build communication request advertising client capabilities (COMM_CAP_* flags)
+ */
+void client_build_comm_request(uint8_t capabilities, uint8_t* buffer_send) {
+
+	codec_datagram_begin(buffer_send, DATAGRAM_REQ_COMM, 1);
+	codec_datagram_payload(buffer_send)[0] = capabilities;
+}
+
+
+
+
+
+/**
+ * client_push_server_buffer
+ * encodes sensor reading into server buffer row
  */
 void client_push_server_buffer(int timestamp, int server_buffer_index, uint8_t* sensor_data, uint8_t server_buffer[MAX_SAMPLING_RATIO][DATAGRAM_SAMPLE_SIZE]) {
 
-	// bytes 0-1: timestamp
-	uint16_t seconds_16t = (uint16_t) timestamp;
-	server_buffer[server_buffer_index][0] = (uint8_t) seconds_16t;			// LSB
-	server_buffer[server_buffer_index][1] = (uint8_t) (seconds_16t >> 8);	// MSB
+	client_encode_sample(timestamp, sensor_data, server_buffer[server_buffer_index]);
+}
+
 
-	// bytes 2-10: sensor data
-	int reg_index;
-	for (reg_index = 0; reg_index < TCS34725_SAMPLE_SIZE; reg_index++) {
-		server_buffer[server_buffer_index][reg_index + 2] = sensor_data[reg_index];
-	}
+
+
+
+/**
+ * client_encode_sample
+ * encodes timestamp and sensor reading into DATAGRAM_SAMPLE_SIZE wire bytes
+ */
+void client_encode_sample(int timestamp, uint8_t* sensor_data, uint8_t* sample) {
+
+	codec_sample_set_timestamp(sample, (uint16_t) timestamp);
+
+	// Sensor data registers (clarity, red, green, blue, LSB first) are already laid out as the sample's channels
+	memcpy(&sample[codec_sample_clarity_offset], sensor_data, TCS34725_SAMPLE_SIZE);
 }
 
 
@@ -258,26 +876,24 @@ void client_push_server_buffer(int timestamp, int server_buffer_index, uint8_t*
  */
 void client_tcs34725_build_data(uint8_t request_type, int n_samples, uint8_t server_buffer[MAX_SAMPLING_RATIO][DATAGRAM_SAMPLE_SIZE], uint8_t* buffer_send) {
 
-	// First byte: Request type
-	buffer_send[0] = request_type;
-
-	// Second and Third bytes: message size (without headers and End-Of-Package)
-	uint16_t message_size = (uint16_t) ((n_samples * DATAGRAM_SAMPLE_SIZE));
-	buffer_send[1] = (uint8_t) message_size;		// LSB
-	buffer_send[2] = (uint8_t) (message_size >> 8);	// MSB
-	printf("IOT_CLIENT: size of message: %d\n", (int) ((buffer_send[2] * 256) + buffer_send[1]));
-
-	// Fourth-to-last bytes: message data
-	int sample;
-	if (n_samples > 0) {
-		for (sample = 0; sample < n_samples; sample++) {
-			int byte;
-			for (byte = 0; byte < DATAGRAM_SAMPLE_SIZE; byte++) {
-				buffer_send[(sample * DATAGRAM_SAMPLE_SIZE) + byte + DATAGRAM_HEADER_SIZE] = server_buffer[sample][byte];
-			}
-		}
-	}
+	client_build_records(request_type, n_samples, DATAGRAM_SAMPLE_SIZE, server_buffer[0], buffer_send);
+}
+
+
+
 
+
+/**
+ * client_build_records
+ * Build datagram from contiguous fixed-size records (samples or summaries)
+ */
+void client_build_records(uint8_t request_type, int n_records, int record_size, uint8_t* records, uint8_t* buffer_send) {
+
+	// Request type and message size (without headers and End-Of-Package), then message data
+	int message_size = n_records * record_size;
+	codec_datagram_begin(buffer_send, request_type, message_size);
+	printf("IOT_CLIENT: size of message: %d\n", codec_datagram_length(buffer_send));
+	memcpy(codec_datagram_payload(buffer_send), records, message_size);
 }
 
 
@@ -300,6 +916,27 @@ void print_error_client(int error_code) {
 		case 3:
 			printf(">> \n");
 			break;
+		case 4:
+			printf(">> Incorrect options provided:\n -d Data-ready sampling: one sample per sensor integration cycle (STATUS polling)\n -g <line> Data-ready sampling on GPIO line wired to sensor INT pin\n -s <file> Spool file (e.g. on SD card) keeping samples across network outages\n -c <rate> Backlog catch-up rate in datagrams per second (1-1000, default %d)\n -a Edge aggregation: send window summaries, raw samples only around anomalies\n -m <sensors> Sensor array, comma-separated <bus>[:<mux channel>] (e.g. /dev/i2c-1:0,/dev/i2c-1:1), up to %d sensors on %d buses\n"
+					" -v <settings> Simulated sensors on \"%s\" buses: comma-separated wave=constant|sine|square|ramp, level, amplitude, noise (%%),\n"
+					"    period (seconds), speed (clock factor), trace=<file> (rows of clarity/red/green/blue %%, 4 columns per sensor)\n"
+					" -q Quiet sample output\n -t Latency tracing: stamp sample datagrams with capture, sensor read and send times\n -k CRC32C checksum on every datagram and reply after the handshake\n"
+					" -V Check sensor interface against simulated mux and sensors (channel select before reads) and exit\n"
+					" -S <ip>[:<port>] Server, gateway or cluster node to send to (default %s:%d)\n\n",
+					CLIENT_DEFAULT_CATCHUP_RATE, SENSOR_ARRAY_MAX, SENSOR_ARRAY_MAX_BUSES, TCS_SIM_BUS_PREFIX, SERVER_ADDR, SERVER_PORT);
+			break;
+		case 6:
+			printf(">> Could not start network thread.\n");
+			break;
+		case 7:
+			printf(">> Could not open or map spool file.\n");
+			break;
+		case 8:
+			printf(">> Server does not accept sensor ids: only single-sensor clients supported.\n");
+			break;
+		case 9:
+			printf(">> GPIO data-ready line supports a single sensor (use -d for STATUS polling).\n");
+			break;
 	}
 }
 
@@ -5,19 +5,118 @@
 
 /* Libraries */
 
+#include <netinet/in.h> 	// For sockaddr_in struct
+
 #include "iot_lib.h"
+#include "crc32c.h"
+#include "iot_codec.h"
 #include "color_sensor/color_sensor.h"
+#include "color_sensor/color_sensor_interface.h"
+#include "color_sensor/sensor_array.h"
+#include "color_sensor/tcs34725_sim.h"
+#include "scheduler/scheduler.h"
+#include "ring/sample_ring.h"
+#include "spool/spool.h"
+#include "aggregate/aggregate.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define CLIENT_BACKOFF_MIN_MS		100		// First retry delay after an unacknowledged datagram
+#define CLIENT_BACKOFF_MAX_MS		10000	// Retry delay cap (doubling from minimum)
+#define CLIENT_NETWORK_TICK_MS		10		// Network thread period: ring to spool transfer and send checks
+#define CLIENT_DEFAULT_CATCHUP_RATE	20		// Datagrams per second while draining spool backlog
+#define CLIENT_TRACE_MARKS			8192	// Traces kept for spooled samples (older backlog is sent with unknown capture time)
+
+#if SENSOR_ARRAY_MAX > DATAGRAM_MAX_SENSORS
+#error "Sensor ids of the array do not fit in the datagram sensor id range"
+#endif
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	bool	data_ready;		// Sample once per sensor integration cycle instead of on the scheduler period
+	int		gpio_line;		// GPIO line wired to sensor INT pin (-1: poll STATUS register)
+	char*	spool_path;		// Spool file for store-and-forward (NULL: memory only)
+	int		catchup_rate;	// Datagrams per second while draining spool backlog
+	bool	aggregate;		// Request edge aggregation (COMM_CAP_AGGREGATE)
+	char*	sensors;		// Sensor array specification (NULL: single sensor on I2C_INTERFACE)
+	char*	simulation;		// Simulated sensor signal settings, for TCS_SIM_BUS_PREFIX buses (NULL: defaults)
+	bool	quiet;			// Do not print every sample
+	bool	trace;			// Request latency tracing (COMM_CAP_TRACE)
+	bool	checksum;		// Request CRC32C checksums (COMM_CAP_CRC32C)
+	struct sockaddr_in	server_addr;	// Server (or gateway, or cluster node) datagrams are sent to
+} client_options;
+
+
+// Trace of the sample stored at an absolute spool position (slot: position % CLIENT_TRACE_MARKS)
+typedef struct {
+	uint64_t		position;
+	sample_trace	trace;
+} client_trace_mark;
+
+
+typedef struct {
+	int					client_socket;
+	struct sockaddr_in	server_addr;
+	timing_rates		timings;			// Given in handshake
+	atomic_int			sampling_ms;		// Current rates: handshake ones, then as updated by server (COMM_CAP_RATE_CONTROL)
+	atomic_int			stream_ms;
+	uint8_t				capabilities;		// Accepted by server in handshake (COMM_CAP_* flags)
+	sensor_array		sensors;
+	sample_ring			rings	[SENSOR_ARRAY_MAX_BUSES];		// Sampling thread of each bus -> network thread
+	sample_spool		spool;				// Network thread only: samples pending acknowledgement
+	sample_spool		summary_spool;		// Network thread only: window summaries pending acknowledgement
+	int					catchup_rate;
+	unsigned long		datagrams_sent;		// Network thread only
+	unsigned long		retries;			// Network thread only
+	unsigned long		corrupt_replies;	// Network thread only: replies failing CRC32C check (retried)
+	client_trace_mark	trace_marks	[CLIENT_TRACE_MARKS];	// Network thread only
+	int64_t				trace_offset_us;	// Server clock minus client clock, estimated in handshake
+	uint32_t			trace_rtt_us;		// Handshake round-trip time (offset error is at most half of it)
+} client_context;
+
+
+// Sampling thread of one bus: reads its sensors round-robin on every tick, into its own ring
+typedef struct {
+	client_context*		context;
+	sensor_bus*			bus;
+	sample_ring*		ring;
+	bool				data_ready;
+	bool				quiet;
+	int					fd_gpio;			// Data-ready on GPIO interrupt line (single sensor only, -1: STATUS polling)
+	tcs34725_setup_params	setup;			// Sensor setup, retimed when the sampling rate changes
+} client_sampler;
 
 
 
 /* FUNCTION DECLARATION */
 
+void		parse_param_options			(client_options* options, int argc, char* argv[]);
+
 int 		client_socket_init			(struct sockaddr_in* server_addr);
 void 		client_socket_print_info	(struct sockaddr_in* sockaddr);
+void*		client_sampling_thread		(void* arg);
+void*		client_network_thread		(void* arg);
+int			client_forward_spool		(client_context* context, sample_spool* spool, uint8_t request_type);
+void		client_set_realtime			(void);
 void 		client_send_data			(int client_socket, struct sockaddr_in* server_addr, uint8_t* buffer_send, uint8_t* buffer_recv);
-void		client_parse_timing_params	(timing_rates* timings, uint8_t* buffer_recv);
+int			client_send_once			(int client_socket, struct sockaddr_in* server_addr, uint8_t* buffer_send, uint8_t* buffer_recv, int trailer_size);
+void		client_trace_handshake		(client_context* context, uint8_t* buffer_recv, int64_t sent_us, int64_t replied_us);
+void		client_build_trace			(client_context* context, uint64_t position, int n_records, uint8_t* buffer_send);
+int64_t		client_now_us				(void);
+void		client_spool_sample			(client_context* context, uint8_t* sample, sample_trace* trace);
+uint8_t		client_parse_timing_params	(timing_rates* timings, uint8_t* buffer_recv);
+void		client_apply_rate_update	(client_context* context, uint8_t* buffer_recv);
+void		client_retime_sensors		(client_sampler* sampler, int sampling_ms);
+void		client_build_comm_request	(uint8_t capabilities, uint8_t* buffer_send);
 void		client_push_server_buffer	(int timestamp, int server_buffer_index, uint8_t* sensor_data, uint8_t server_buffer[MAX_SAMPLING_RATIO][DATAGRAM_SAMPLE_SIZE]);
+void		client_encode_sample		(int timestamp, uint8_t* sensor_data, uint8_t* sample);
 void 		client_tcs34725_build_data	(uint8_t request_type, int n_samples, uint8_t server_buffer[MAX_SAMPLING_RATIO][DATAGRAM_SAMPLE_SIZE], uint8_t* buffer_send);
+void		client_build_records		(uint8_t request_type, int n_records, int record_size, uint8_t* records, uint8_t* buffer_send);
 void		print_error_client			(int error_code);
 
 
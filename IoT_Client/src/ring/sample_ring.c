@@ -0,0 +1,73 @@
+/*
+ * sample_ring.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <string.h>			// For memcpy()
+
+#include "sample_ring.h"
+
+
+
+void sample_ring_init(sample_ring* ring) {
+
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->dropped, 0);
+}
+
+
+
+/*
+ * Producer side: never blocks. Sample is published to the consumer by the release store on head.
+ */
+int sample_ring_push(sample_ring* ring, uint8_t* sample, sample_trace* trace) {
+	unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if ((head - tail) >= SAMPLE_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+		return -1;
+	}
+
+	memcpy(ring->samples[head & (SAMPLE_RING_SIZE - 1)], sample, DATAGRAM_TAGGED_SAMPLE_SIZE);
+	ring->traces[head & (SAMPLE_RING_SIZE - 1)] = *trace;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	return 0;
+}
+
+
+
+/*
+ * Consumer side: copies up to max_samples oldest samples and releases their slots.
+ * returns number of samples copied
+ */
+int sample_ring_pop(sample_ring* ring, uint8_t samples[][DATAGRAM_TAGGED_SAMPLE_SIZE], sample_trace* traces, int max_samples) {
+	unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	int n_samples = (int) (head - tail);
+	if (n_samples > max_samples)
+		n_samples = max_samples;
+
+	int sample;
+	for (sample = 0; sample < n_samples; sample++) {
+		memcpy(samples[sample], ring->samples[(tail + sample) & (SAMPLE_RING_SIZE - 1)], DATAGRAM_TAGGED_SAMPLE_SIZE);
+		if (traces != NULL)
+			traces[sample] = ring->traces[(tail + sample) & (SAMPLE_RING_SIZE - 1)];
+	}
+	atomic_store_explicit(&ring->tail, tail + n_samples, memory_order_release);
+
+	return n_samples;
+}
+
+
+
+unsigned long sample_ring_depth(sample_ring* ring) {
+
+	return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
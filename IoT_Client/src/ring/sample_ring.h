@@ -0,0 +1,54 @@
+/*
+ * sample_ring.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef SAMPLE_RING_H_
+#define SAMPLE_RING_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdatomic.h>		// For lock-free head/tail indexes
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define SAMPLE_RING_SIZE		8192	// Samples buffered between sampling and network threads (power of 2)
+
+
+
+/* TYPE DEFINITIONS */
+
+// Latency trace of one sample (COMM_CAP_TRACE), client monotonic clock
+typedef struct {
+	int64_t		captured_us;		// Sensor read completed
+	uint32_t	read_us;			// Duration of the register read
+} sample_trace;
+
+
+// Single-producer (sampling thread) / single-consumer (network thread) ring of wire-encoded samples, tagged with sensor id
+typedef struct {
+	uint8_t				samples	[SAMPLE_RING_SIZE][DATAGRAM_TAGGED_SAMPLE_SIZE];
+	sample_trace		traces	[SAMPLE_RING_SIZE];
+	atomic_ulong		head;		// Next slot to write (producer only)
+	atomic_ulong		tail;		// Next slot to read (consumer only)
+	atomic_ulong		dropped;	// Samples discarded because ring was full
+} sample_ring;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void			sample_ring_init		(sample_ring* ring);
+int				sample_ring_push		(sample_ring* ring, uint8_t* sample, sample_trace* trace);	// returns -1 (and counts drop) if full
+int				sample_ring_pop			(sample_ring* ring, uint8_t samples[][DATAGRAM_TAGGED_SAMPLE_SIZE], sample_trace* traces, int max_samples);	// traces may be NULL
+unsigned long	sample_ring_depth		(sample_ring* ring);
+
+
+
+#endif /* SAMPLE_RING_H_ */
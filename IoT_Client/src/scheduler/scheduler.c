@@ -0,0 +1,151 @@
+/*
+ * scheduler.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset()
+#include <math.h>			// For sqrt()
+#include <errno.h>			// For EINTR
+#include <time.h>			// For clock_nanosleep()
+
+#include "scheduler.h"
+
+
+
+static long int		timespec_diff_us	(struct timespec* later, struct timespec* earlier);
+static void			timespec_add_us		(struct timespec* result, struct timespec* base, long int offset_us);
+
+
+
+/**
+ * scheduler_init
+ * starts periodic schedule at current time; first call to scheduler_wait_next() returns tick 0 immediately
+ */
+void scheduler_init(sampling_scheduler* sched, long int period_us) {
+
+	memset(sched, 0, sizeof(*sched));
+	sched->period_us = period_us;
+	sched->tick = -1;
+	clock_gettime(CLOCK_MONOTONIC, &sched->start);
+}
+
+
+
+/**
+ * scheduler_set_period
+ * changes period from next tick on: next deadline is one new period after the last tick, and elapsed time carries
+ * on from it (ticks keep counting, deadlines stay absolute)
+ */
+void scheduler_set_period(sampling_scheduler* sched, long int period_us) {
+
+	if (sched->tick >= 0) {
+		sched->origin_us += (sched->tick - sched->origin_tick) * sched->period_us;
+		sched->origin_tick = sched->tick;
+	}
+	sched->period_us = period_us;
+}
+
+
+
+/**
+ * scheduler_wait_next
+ * sleeps until absolute deadline of next tick (start + tick * period), so loop work never accumulates drift.
+ * If loop work overran one or more periods, missed ticks are skipped and counted as overruns.
+ * returns index of tick reached
+ */
+long int scheduler_wait_next(sampling_scheduler* sched) {
+
+	struct timespec now, deadline;
+	long int next_tick = sched->tick + 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long int behind_ticks = sched->origin_tick + ((timespec_diff_us(&now, &sched->start) - sched->origin_us) / sched->period_us) - next_tick;
+	if (behind_ticks > 0) {
+		sched->overruns += behind_ticks;
+		next_tick += behind_ticks;
+	}
+
+	/* Sleep until absolute deadline (restarted if interrupted by a signal) */
+	timespec_add_us(&deadline, &sched->start, sched->origin_us + ((next_tick - sched->origin_tick) * sched->period_us));
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+	/* Accumulate wake-up lateness (Welford's running mean and variance) */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double late_us = (double) timespec_diff_us(&now, &deadline);
+	sched->jitter_n++;
+	double delta = late_us - sched->jitter_mean_us;
+	sched->jitter_mean_us += delta / sched->jitter_n;
+	sched->jitter_m2 += delta * (late_us - sched->jitter_mean_us);
+	if (late_us > sched->jitter_max_us)
+		sched->jitter_max_us = late_us;
+
+	sched->tick = next_tick;
+	return next_tick;
+}
+
+
+
+/**
+ * scheduler_elapsed_ms
+ * returns scheduled time of last tick since start, in milliseconds
+ */
+long int scheduler_elapsed_ms(sampling_scheduler* sched) {
+
+	return (sched->origin_us + ((sched->tick - sched->origin_tick) * sched->period_us)) / 1000;
+}
+
+
+
+/**
+ * scheduler_now_ms
+ * returns current time since start, in milliseconds (for unscheduled, event-driven loops)
+ */
+long int scheduler_now_ms(sampling_scheduler* sched) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_diff_us(&now, &sched->start) / 1000;
+}
+
+
+
+/**
+ * scheduler_print_jitter
+ * prints wake-up jitter statistics and overruns since last call, then resets them
+ */
+void scheduler_print_jitter(sampling_scheduler* sched) {
+
+	double stddev_us = (sched->jitter_n > 1) ? sqrt(sched->jitter_m2 / (sched->jitter_n - 1)) : 0;
+
+	printf("IOT_CLIENT: Scheduler jitter over %ld ticks: mean %.1f us - stddev %.1f us - max %.1f us - overruns %ld\n",
+			sched->jitter_n, sched->jitter_mean_us, stddev_us, sched->jitter_max_us, sched->overruns);
+
+	sched->jitter_n = 0;
+	sched->jitter_mean_us = 0;
+	sched->jitter_m2 = 0;
+	sched->jitter_max_us = 0;
+	sched->overruns = 0;
+}
+
+
+
+static long int timespec_diff_us(struct timespec* later, struct timespec* earlier) {
+
+	return ((later->tv_sec - earlier->tv_sec) * 1000000L) + ((later->tv_nsec - earlier->tv_nsec) / 1000L);
+}
+
+
+
+static void timespec_add_us(struct timespec* result, struct timespec* base, long int offset_us) {
+
+	result->tv_sec = base->tv_sec + (offset_us / 1000000L);
+	result->tv_nsec = base->tv_nsec + ((offset_us % 1000000L) * 1000L);
+	if (result->tv_nsec >= 1000000000L) {
+		result->tv_sec++;
+		result->tv_nsec -= 1000000000L;
+	}
+}
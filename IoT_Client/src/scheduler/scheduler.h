@@ -0,0 +1,46 @@
+/*
+ * scheduler.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+
+#include <time.h>			// For timespec struct
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	struct timespec	start;				// Absolute (CLOCK_MONOTONIC) time of tick 0
+	long int		period_us;
+	long int		origin_tick;		// Tick from which current period applies (0 unless period was changed)
+	long int		origin_us;			// ...and its scheduled time since start
+	long int		tick;				// Index of last tick returned
+	long int		overruns;			// Ticks skipped because loop work exceeded the period (since last jitter report)
+
+	// Wake-up lateness against deadline (jitter), reset by scheduler_print_jitter()
+	long int		jitter_n;
+	double			jitter_mean_us;
+	double			jitter_m2;
+	double			jitter_max_us;
+} sampling_scheduler;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void		scheduler_init				(sampling_scheduler* sched, long int period_us);
+void		scheduler_set_period		(sampling_scheduler* sched, long int period_us);
+long int	scheduler_wait_next			(sampling_scheduler* sched);	// returns tick index (skips missed ticks)
+long int	scheduler_elapsed_ms		(sampling_scheduler* sched);
+long int	scheduler_now_ms			(sampling_scheduler* sched);
+void		scheduler_print_jitter		(sampling_scheduler* sched);
+
+
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,167 @@
+/*
+ * spool.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memcpy() and memcmp()
+#include <fcntl.h>			// For open()
+#include <unistd.h>			// For ftruncate() and close()
+#include <sys/mman.h>		// For mmap() and msync()
+#include <sys/stat.h>		// For fstat()
+
+#include "spool.h"
+
+
+
+static long int		spool_ms_since		(struct timespec* since);
+
+
+
+/*
+ * Maps spool file (created or resized as needed) or anonymous memory. An existing file with a valid
+ * header keeps its backlog across restarts; anything else is reinitialized empty.
+ */
+int spool_open(sample_spool* spool, const char* path, uint32_t record_size, uint64_t capacity) {
+	void* map;
+
+	memset(spool, 0, sizeof(*spool));
+	spool->map_size = SPOOL_HEADER_SIZE + (capacity * record_size);
+	spool->persistent = (path != NULL);
+
+	if (spool->persistent) {
+		int fd_spool = open(path, O_RDWR | O_CREAT, 0644);
+		if (fd_spool < 0)
+			return -1;
+
+		// Sparse file: blocks are only allocated on the SD card as samples are written
+		struct stat spool_stat;
+		if ((fstat(fd_spool, &spool_stat) < 0)
+				|| (((size_t) spool_stat.st_size != spool->map_size) && (ftruncate(fd_spool, spool->map_size) < 0))) {
+			close(fd_spool);
+			return -1;
+		}
+
+		map = mmap(NULL, spool->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_spool, 0);
+		close(fd_spool);
+	} else {
+		map = mmap(NULL, spool->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+
+	if (map == MAP_FAILED)
+		return -1;
+
+	spool->header = (spool_header*) map;
+	spool->records = (uint8_t*) map + SPOOL_HEADER_SIZE;
+
+	spool_header* header = spool->header;
+	if ((memcmp(header->magic, SPOOL_MAGIC, sizeof(header->magic)) != 0) || (header->version != SPOOL_VERSION)
+			|| (header->record_size != record_size) || (header->capacity != capacity)
+			|| (header->tail > header->head) || ((header->head - header->tail) > capacity)) {
+		memcpy(header->magic, SPOOL_MAGIC, sizeof(header->magic));
+		header->version = SPOOL_VERSION;
+		header->record_size = record_size;
+		header->capacity = capacity;
+		header->head = 0;
+		header->tail = 0;
+	} else {
+		printf("IOT_CLIENT: Spool %s recovered with %llu records backlog\n", path, (unsigned long long) (header->head - header->tail));
+	}
+	spool->head = header->head;
+	spool->tail = header->tail;
+
+	clock_gettime(CLOCK_MONOTONIC, &spool->last_sync);
+	spool_sync(spool, true);
+
+	return 0;
+}
+
+
+
+/*
+ * Appends record; when spool is full the oldest record is overwritten (newest data is kept). The mapped header is
+ * left as is: page writeback may persist it before the record pages, so head only reaches it in spool_sync().
+ */
+void spool_append(sample_spool* spool, uint8_t* record) {
+	spool_header* header = spool->header;
+
+	if ((spool->head - spool->tail) >= header->capacity) {
+		spool->tail++;
+		spool->overwritten++;
+	}
+
+	memcpy(&spool->records[(spool->head % header->capacity) * header->record_size], record, header->record_size);
+	spool->head++;
+}
+
+
+
+/*
+ * Copies up to max_records oldest records (contiguously into records), leaving them spooled until spool_consume().
+ * returns number of records copied
+ */
+int spool_peek(sample_spool* spool, uint8_t* records, int max_records) {
+	spool_header* header = spool->header;
+
+	int n_records = (int) ((spool_depth(spool) < (uint64_t) max_records) ? spool_depth(spool) : (uint64_t) max_records);
+
+	int record;
+	for (record = 0; record < n_records; record++) {
+		memcpy(&records[record * header->record_size], &spool->records[((spool->tail + record) % header->capacity) * header->record_size], header->record_size);
+	}
+
+	return n_records;
+}
+
+
+
+/*
+ * Releases oldest records once acknowledged by server.
+ */
+void spool_consume(sample_spool* spool, int n_records) {
+
+	if ((uint64_t) n_records > spool_depth(spool))
+		n_records = (int) spool_depth(spool);
+	spool->tail += n_records;
+}
+
+
+
+uint64_t spool_depth(sample_spool* spool) {
+
+	return spool->head - spool->tail;
+}
+
+
+
+/*
+ * Flushes dirty records, then publishes head and tail into the header and flushes it: the file's header never
+ * covers records not yet on it. Unless forced, this happens at most once per SPOOL_SYNC_INTERVAL_MS, so flash sees
+ * few large writes. A crash or power loss loses at most that interval of samples, and may re-send samples acknowledged
+ * during it (at-least-once delivery).
+ */
+void spool_sync(sample_spool* spool, bool force) {
+
+	if (!spool->persistent)
+		return;
+	if (!force && (spool_ms_since(&spool->last_sync) < SPOOL_SYNC_INTERVAL_MS))
+		return;
+
+	msync((uint8_t*) spool->header + SPOOL_HEADER_SIZE, spool->map_size - SPOOL_HEADER_SIZE, MS_SYNC);
+	spool->header->head = spool->head;
+	spool->header->tail = spool->tail;
+	msync(spool->header, SPOOL_HEADER_SIZE, MS_SYNC);
+	clock_gettime(CLOCK_MONOTONIC, &spool->last_sync);
+}
+
+
+
+static long int spool_ms_since(struct timespec* since) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - since->tv_sec) * 1000L) + ((now.tv_nsec - since->tv_nsec) / 1000000L);
+}
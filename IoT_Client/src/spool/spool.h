@@ -0,0 +1,71 @@
+/*
+ * spool.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef SPOOL_H_
+#define SPOOL_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <stddef.h>			// For size_t
+#include <time.h>			// For timespec struct
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define SPOOL_MAGIC					"IOTSPOOL"
+#define SPOOL_VERSION				1
+#define SPOOL_HEADER_SIZE			4096		// Header page, records start right after it
+#define SPOOL_FILE_CAPACITY			8388608		// Samples kept on file (92 MB of tagged samples: ~1 day at 100 Hz, ~10 days at 10 Hz)
+#define SPOOL_MEMORY_CAPACITY		65536		// Samples kept without spool file (anonymous memory)
+#define SPOOL_SUMMARY_CAPACITY		65536		// Window summaries kept (~7 days at 10 s windows)
+#define SPOOL_SYNC_INTERVAL_MS		10000		// Batch flash writes: flush dirty pages at most this often
+
+
+
+/* TYPE DEFINITIONS */
+
+// On-file header. head/tail are absolute sample counters (slot = counter % capacity), as of the last sync.
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	record_size;
+	uint64_t	capacity;
+	uint64_t	head;		// Next record to write
+	uint64_t	tail;		// Oldest record not acknowledged by server
+} spool_header;
+
+
+// mmap-backed ring of fixed-size wire-encoded records (samples or summaries), owned by the network thread
+typedef struct {
+	spool_header*	header;
+	uint8_t*		records;
+	uint64_t		head;			// Current counters: only published to the header once the records they cover are synced
+	uint64_t		tail;
+	size_t			map_size;
+	bool			persistent;		// File-backed (false: anonymous memory)
+	uint64_t		overwritten;	// Oldest records lost because spool was full
+	struct timespec	last_sync;
+} sample_spool;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int			spool_open		(sample_spool* spool, const char* path, uint32_t record_size, uint64_t capacity);	// path NULL: memory only; returns -1 on failure
+void		spool_append	(sample_spool* spool, uint8_t* record);
+int			spool_peek		(sample_spool* spool, uint8_t* records, int max_records);
+void		spool_consume	(sample_spool* spool, int n_records);
+uint64_t	spool_depth		(sample_spool* spool);
+void		spool_sync		(sample_spool* spool, bool force);
+
+
+
+#endif /* SPOOL_H_ */
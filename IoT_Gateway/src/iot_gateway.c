@@ -0,0 +1,532 @@
+/*
+ ============================================================================
+ Name        : iot_gateway.c
+ Author      : Nicolas Villanueva
+ Version     : 1.0.0 (October 2026)
+ Description : IoT edge gateway: serves local clients as the server would, and
+               relays their samples to the central server in multi-client frames.
+ ============================================================================
+ */
+
+#include <stdio.h>			// For printf() and basic C utilities
+#include <stdlib.h>			// For exit code
+#include <string.h>			// For memset()
+#include <stdbool.h>		// For bool
+#include <sys/socket.h> 	// For socket()
+#include <unistd.h>			// For close() and getopt()
+#include <arpa/inet.h>		// For inet_aton()
+#include <sys/time.h>		// For timeval struct
+#include <time.h>			// For clock_gettime()
+#include <poll.h>			// For poll()
+#include <signal.h>			// For sigaction()
+
+#include "iot_lib.h"
+#include "iot_gateway.h"
+
+
+
+static volatile sig_atomic_t gateway_running = 1;
+
+static void sig_handler(int signum) {
+	(void) signum;
+	gateway_running = 0;
+}
+
+
+
+int main(int argc, char* argv[]) {
+
+	/* STEP 1 - Parse command line options: central server address */
+	gateway_options options;
+	parse_param_options(&options, argc, argv);
+
+	static gateway_state state;		// Static: device table and frame queue descriptor
+	memset(&state, 0, sizeof(state));
+
+
+	/* STEP 2 - Handshake with central server: its rates are handed on to local clients */
+	state.upstream_socket = gateway_upstream_init(&options.upstream_addr);
+	gateway_upstream_handshake(&state);
+	if (relay_queue_init(&state.queue, (state.upstream_capabilities & COMM_CAP_CRC32C)) < 0) {
+		print_error_gateway(7);
+		exit(EXIT_FAILURE);
+	}
+
+
+	/* STEP 3 - Initialize UDP socket for local clients */
+	struct sigaction stop_action;
+	memset(&stop_action, 0, sizeof(stop_action));
+	stop_action.sa_handler = sig_handler;
+	sigaction(SIGINT, &stop_action, NULL);
+	sigaction(SIGTERM, &stop_action, NULL);
+
+	state.local_socket = gateway_socket_init(options.local_port);
+	printf("IOT_GATEWAY: Relaying local clients on port %d to %s:%d (frames flushed after %d ms, up to %d in flight)\n",
+			options.local_port, inet_ntoa(options.upstream_addr.sin_addr), ntohs(options.upstream_addr.sin_port), options.flush_ms, RELAY_WINDOW);
+
+
+	struct pollfd fds[2];
+	fds[0].fd = state.local_socket;
+	fds[0].events = POLLIN;
+	fds[1].fd = state.upstream_socket;
+	fds[1].events = POLLIN;
+
+	int64_t next_report_us = gateway_now_us() + (GATEWAY_REPORT_SECS * 1000000LL);
+	while (gateway_running) {
+		/* STEP 4 - Acknowledge local clients at once (samples appended to open frame, unless the upstream queue is full),
+		 * and take upstream acknowledgements */
+		poll(fds, 2, GATEWAY_TICK_MS);
+		int64_t now_us = gateway_now_us();
+		uint8_t buffer_recv[DATAGRAM_SIZE];
+
+		while (fds[0].revents & POLLIN) {
+			struct sockaddr_in client_addr;
+			socklen_t client_addr_len = sizeof(client_addr);
+			ssize_t recv_len = recvfrom(state.local_socket, buffer_recv, DATAGRAM_SIZE, MSG_DONTWAIT, (struct sockaddr *) &client_addr, &client_addr_len);
+			if (recv_len < 0)
+				break;
+			gateway_local_datagram(&state, buffer_recv, (int) recv_len, &client_addr, now_us, options.quiet);
+		}
+
+		while (fds[1].revents & POLLIN) {
+			ssize_t recv_len = recv(state.upstream_socket, buffer_recv, DATAGRAM_SIZE, MSG_DONTWAIT);
+			if (recv_len < 0)
+				break;
+			state.upstream_replies++;
+
+			// Frame refused: server restarted (or expired the session), frames are only read after a new handshake
+			// (unacknowledged ones are resent)
+			if ((recv_len >= (DATAGRAM_HEADER_SIZE + 1)) && (codec_header_get_type(buffer_recv) == DATAGRAM_REP_ERROR)
+					&& (!state.queue.checksummed || (datagram_check_crc32c(buffer_recv, (int) recv_len) == 1))) {
+				printf("IOT_GATEWAY: Central server refused frame without relay session, handshaking again\n");
+				gateway_upstream_handshake(&state);
+				state.upstream_handshakes++;
+				continue;
+			}
+			relay_queue_ack(&state.queue, buffer_recv, (int) recv_len, now_us);
+		}
+
+
+		/* STEP 5 - Forward full or flush-due frames upstream, resending unacknowledged ones */
+		if (relay_queue_due(&state.queue, now_us, options.flush_ms * 1000LL))
+			relay_queue_seal(&state.queue);
+		relay_queue_send(&state.queue, state.upstream_socket, now_us);
+
+		if (now_us >= next_report_us) {
+			gateway_print_stats(&state);
+			next_report_us += GATEWAY_REPORT_SECS * 1000000LL;
+		}
+	}
+
+
+	// Frames still unacknowledged are lost with the process: local clients were already acknowledged
+	relay_queue_seal(&state.queue);
+	relay_queue_send(&state.queue, state.upstream_socket, gateway_now_us());
+	gateway_print_stats(&state);
+	relay_queue_free(&state.queue);
+	close(state.local_socket);
+	close(state.upstream_socket);
+	return EXIT_SUCCESS;
+}
+
+
+
+
+
+/**
+ * parse_param_options
+ * parses optional flags and the central server address (<ip>[:<port>])
+ */
+void parse_param_options(gateway_options* options, int argc, char* argv[]) {
+
+	options->local_port = SERVER_PORT;
+	options->flush_ms = GATEWAY_DEFAULT_FLUSH_MS;
+	options->quiet = false;
+
+	int option;
+	while ((option = getopt(argc, argv, "+l:f:q")) != -1) {
+		switch(option) {
+			case 'f':
+				options->flush_ms = atoi(optarg);
+				if ((options->flush_ms < GATEWAY_TICK_MS) || (options->flush_ms > 60000)) {
+					print_error_gateway(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'l':
+				options->local_port = atoi(optarg);
+				if ((options->local_port < 1) || (options->local_port > 65535)) {
+					print_error_gateway(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'q':
+				options->quiet = true;
+				break;
+			default:
+				print_error_gateway(4);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if (optind != (argc - 1)) {
+		print_error_gateway(4);
+		exit(EXIT_FAILURE);
+	}
+
+	char upstream_ip[32];
+	int upstream_port = SERVER_PORT;
+	memset(&options->upstream_addr, 0, sizeof(options->upstream_addr));
+	if ((sscanf(argv[optind], "%31[^:]:%d", upstream_ip, &upstream_port) < 1) || (inet_aton(upstream_ip, &options->upstream_addr.sin_addr) == 0)
+			|| (upstream_port < 1) || (upstream_port > 65535)) {
+		print_error_gateway(4);
+		exit(EXIT_FAILURE);
+	}
+	options->upstream_addr.sin_family = AF_INET;
+	options->upstream_addr.sin_port = htons((uint16_t) upstream_port);
+}
+
+
+
+
+
+/**
+ * gateway_socket_init
+ * returns socket descriptor bound to local clients' port
+ */
+int gateway_socket_init(int local_port) {
+
+	int local_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (local_socket < 0) {
+		print_error_gateway(1);
+		exit(EXIT_FAILURE);
+	}
+
+	struct sockaddr_in local_addr;
+	memset(&local_addr, 0, sizeof(local_addr));
+	local_addr.sin_family = AF_INET;
+	local_addr.sin_port = htons((uint16_t) local_port);
+	local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(local_socket, (const struct sockaddr *) &local_addr, sizeof(local_addr)) < 0) {
+		print_error_gateway(2);
+		exit(EXIT_FAILURE);
+	}
+	printf("IOT_GATEWAY: Initialized local UDP socket (descriptor %d)\n", local_socket);
+
+	return local_socket;
+}
+
+
+
+
+
+/**
+ * gateway_upstream_init
+ * returns socket descriptor connected to central server (handshake replies time out)
+ */
+int gateway_upstream_init(struct sockaddr_in* upstream_addr) {
+
+	int upstream_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (upstream_socket < 0) {
+		print_error_gateway(1);
+		exit(EXIT_FAILURE);
+	}
+
+	struct timeval intervals;
+	intervals.tv_sec = GATEWAY_UPSTREAM_TIMEOUT_SECS;
+	intervals.tv_usec = 0;
+	if ((setsockopt(upstream_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals)) < 0)
+			|| (connect(upstream_socket, (const struct sockaddr *) upstream_addr, sizeof(*upstream_addr)) < 0)) {
+		print_error_gateway(5);
+		exit(EXIT_FAILURE);
+	}
+	printf("IOT_GATEWAY: Initialized upstream UDP socket (descriptor %d)\n", upstream_socket);
+
+	return upstream_socket;
+}
+
+
+
+
+
+/**
+ * gateway_upstream_handshake
+ * requests communication (retried until answered) as a relaying client, and takes the central server's rates;
+ * replies to frames still in flight (refused, or acknowledged) are skipped
+ */
+void gateway_upstream_handshake(gateway_state* state) {
+
+	uint8_t buffer_send[DATAGRAM_HEADER_SIZE + 2];
+	codec_datagram_begin(buffer_send, DATAGRAM_REQ_COMM, 1);
+	codec_datagram_payload(buffer_send)[0] = GATEWAY_UPSTREAM_CAPABILITIES;
+	uint8_t buffer_recv[DATAGRAM_SIZE];
+	ssize_t recv_len;
+	while (true) {
+		send(state->upstream_socket, buffer_send, sizeof(buffer_send), 0);
+		do {
+			recv_len = recv(state->upstream_socket, buffer_recv, DATAGRAM_SIZE, 0);
+		} while ((recv_len >= 0) && (codec_header_get_type(buffer_recv) != DATAGRAM_REP_COMM_OK));
+		if (recv_len >= (DATAGRAM_HEADER_SIZE + DATAGRAM_COMM_REPLY_SIZE))
+			break;
+		printf("IOT_GATEWAY: No handshake reply from central server, retrying\n");
+	}
+
+	uint8_t* reply = codec_datagram_payload(buffer_recv);
+	state->upstream_capabilities = codec_comm_reply_get_capabilities(reply);
+	state->timings.sampling = (int) codec_comm_reply_get_sampling(reply);
+	state->timings.server_stream = (int) codec_comm_reply_get_server_stream(reply);
+	if (!(state->upstream_capabilities & COMM_CAP_RATES_MS) || !(state->upstream_capabilities & COMM_CAP_RELAY)) {
+		print_error_gateway(6);
+		exit(EXIT_FAILURE);
+	}
+	if ((state->timings.sampling < MIN_RATE_SAMPLING) || (state->timings.server_stream < state->timings.sampling)
+			|| ((state->timings.server_stream / state->timings.sampling) > MAX_SAMPLING_RATIO)) {
+		state->timings.sampling = DEFAULT_RATE_SAMPLING;
+		state->timings.server_stream = DEFAULT_RATE_SERVER_STREAM;
+	}
+	printf("IOT_GATEWAY: Central server accepted relay: sampling rate: %d ms - server streaming rate: %d ms%s\n",
+			state->timings.sampling, state->timings.server_stream, (state->upstream_capabilities & COMM_CAP_CRC32C) ? " - CRC32C frames" : "");
+}
+
+
+
+
+
+/**
+ * gateway_local_datagram
+ * checks a local client's datagram as the server would (CRC32C negotiated in handshake), relays its samples and
+ * acknowledges it; datagrams failing the check, or carrying samples while the upstream queue is full (frames are
+ * never dropped unacknowledged), are left unacknowledged, so the client keeps them and retries
+ */
+void gateway_local_datagram(gateway_state* state, uint8_t* buffer_recv, int recv_len, struct sockaddr_in* client_addr, int64_t now_us, bool quiet) {
+
+	state->local_datagrams++;
+
+	int data_length = codec_datagram_length(buffer_recv);
+	int status = datagram_check_crc32c(buffer_recv, recv_len);
+	int device_id;
+	gateway_device* device = gateway_device_find(state, client_addr, now_us, &device_id);
+	if ((recv_len < (DATAGRAM_HEADER_SIZE + data_length + 1)) || (status < 0) || (device == NULL)
+			|| ((status == 0) && (device->capabilities & COMM_CAP_CRC32C) && (buffer_recv[0] != DATAGRAM_REQ_COMM))) {
+		state->local_dropped++;
+		return;
+	}
+
+	bool samples = (buffer_recv[0] == DATAGRAM_REQ_SEND_DATA) || (buffer_recv[0] == DATAGRAM_REQ_SEND_TAGGED_DATA);
+	if (samples && relay_queue_full(&state->queue)) {
+		state->local_deferred++;
+		return;
+	}
+
+	device->datagrams++;
+	int n_samples = 0;
+	if (samples) {
+		n_samples = gateway_relay_samples(state, device_id, buffer_recv, recv_len, now_us);
+		device->samples += n_samples;
+	}
+
+	uint8_t buffer_reply[DATAGRAM_SIZE] = {'\0'};
+	int reply_len = gateway_build_reply(state, device, buffer_recv, buffer_reply);
+	if (buffer_recv[DATAGRAM_HEADER_SIZE + data_length] & DATAGRAM_EOP_CRC32C)
+		reply_len = datagram_seal_crc32c(buffer_reply, reply_len);
+	sendto(state->local_socket, buffer_reply, reply_len, 0, (const struct sockaddr *) client_addr, sizeof(*client_addr));
+
+	if (!quiet)
+		printf("IOT_GATEWAY: %s:%d (device %d): %d-byte datagram - %d samples relayed\n",
+				inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port), device_id, recv_len, n_samples);
+}
+
+
+
+
+
+/**
+ * gateway_build_reply
+ * builds reply to local client according to request type received, as the server would (rates: central server's)
+ * returns reply length
+ */
+int gateway_build_reply(gateway_state* state, gateway_device* device, uint8_t* buffer_recv, uint8_t* buffer_reply) {
+
+	uint8_t capabilities = (codec_datagram_length(buffer_recv) >= 1) ? codec_datagram_payload(buffer_recv)[0] : 0;
+	uint8_t* reply = codec_datagram_payload(buffer_reply);
+
+	switch(codec_header_get_type(buffer_recv)) {
+		case DATAGRAM_REQ_COMM:
+			device->capabilities = capabilities & GATEWAY_CAPABILITIES;
+			if (!(state->upstream_capabilities & COMM_CAP_TIMESTAMP_MS))
+				device->capabilities &= ~COMM_CAP_TIMESTAMP_MS;
+			if (capabilities & COMM_CAP_RATES_MS) {
+				// Capabilities echo + sampling and streaming rates, milliseconds
+				codec_datagram_begin(buffer_reply, DATAGRAM_REP_COMM_OK, DATAGRAM_COMM_REPLY_SIZE);
+				codec_comm_reply_set_capabilities(reply, device->capabilities);
+				codec_comm_reply_set_sampling(reply, (uint32_t) state->timings.sampling);
+				codec_comm_reply_set_server_stream(reply, (uint32_t) state->timings.server_stream);
+			} else {
+				// Legacy client: whole seconds (at least 1)
+				codec_datagram_begin(buffer_reply, DATAGRAM_REP_COMM_OK, DATAGRAM_COMM_REPLY_LEGACY_SIZE);
+				codec_comm_reply_legacy_set_sampling(reply, (uint8_t) ((state->timings.sampling < 1000) ? 1 : state->timings.sampling / 1000));
+				codec_comm_reply_legacy_set_server_stream(reply, (uint8_t) ((state->timings.server_stream < 1000) ? 1 : state->timings.server_stream / 1000));
+			}
+			break;
+
+		case DATAGRAM_REQ_SEND_DATA:
+		case DATAGRAM_REQ_SEND_TAGGED_DATA:
+			codec_datagram_begin(buffer_reply, DATAGRAM_REP_SEND_DATA_OK, 0);
+			break;
+
+		// Summaries (COMM_CAP_AGGREGATE) are not relayed: never accepted in handshake
+		default:
+			codec_datagram_begin(buffer_reply, DATAGRAM_REP_ERROR, 0);
+			break;
+	}
+
+	return codec_datagram_size(buffer_reply);
+}
+
+
+
+
+
+/**
+ * gateway_relay_samples
+ * appends datagram's samples to the open upstream frame as one device block, tagged with sensor id (0 for
+ * untagged single-sensor clients)
+ * returns number of samples relayed
+ */
+int gateway_relay_samples(gateway_state* state, int device_id, uint8_t* buffer_recv, int recv_len, int64_t now_us) {
+
+	bool tagged = (buffer_recv[0] == DATAGRAM_REQ_SEND_TAGGED_DATA);
+	int record_size = tagged ? DATAGRAM_TAGGED_SAMPLE_SIZE : DATAGRAM_SAMPLE_SIZE;
+	int n_samples = codec_datagram_records(buffer_recv, recv_len, record_size);
+	if (n_samples > MAX_SAMPLING_RATIO)
+		n_samples = MAX_SAMPLING_RATIO;
+
+	// Frames carry timestamps in the unit accepted upstream: local clients counting whole seconds are converted
+	bool to_ms = (state->upstream_capabilities & COMM_CAP_TIMESTAMP_MS) && !(state->devices[device_id - 1].capabilities & COMM_CAP_TIMESTAMP_MS);
+
+	uint8_t records[MAX_SAMPLING_RATIO * DATAGRAM_TAGGED_SAMPLE_SIZE];
+	int sample;
+	for (sample = 0; sample < n_samples; sample++) {
+		uint8_t* record = codec_at(records, sample, DATAGRAM_TAGGED_SAMPLE_SIZE);
+		uint8_t* record_raw = codec_at(codec_datagram_payload(buffer_recv), sample, record_size);
+		if (tagged) {
+			memcpy(record, record_raw, DATAGRAM_TAGGED_SAMPLE_SIZE);
+		} else {
+			codec_tagged_sample_set_sensor(record, 0);
+			memcpy(codec_tagged_sample_sample(record), record_raw, DATAGRAM_SAMPLE_SIZE);
+		}
+		if (to_ms)
+			codec_sample_set_timestamp(codec_tagged_sample_sample(record), (uint16_t) (codec_sample_get_timestamp(codec_tagged_sample_sample(record)) * 1000));
+	}
+
+	// First block since the device id was given to this client: the server drops the session a previous client left
+	gateway_device* device = &state->devices[device_id - 1];
+	uint16_t device_field = (uint16_t) device_id | (device->announced ? 0 : DATAGRAM_RELAY_NEW_DEVICE);
+	device->announced = true;
+	relay_queue_append(&state->queue, device_field, records, n_samples, now_us);
+	return n_samples;
+}
+
+
+
+
+
+/**
+ * gateway_device_find
+ * returns local client's device (registered on first datagram, in the slot of a long-silent client if the table
+ * is full: its first block then has the server drop that client's session), NULL if no slot is free; a linear scan
+ * is enough for the dozens of clients of a site
+ */
+gateway_device* gateway_device_find(gateway_state* state, struct sockaddr_in* client_addr, int64_t now_us, int* device_id) {
+
+	gateway_device* idle = NULL;
+	int index;
+	for (index = 0; index < state->n_devices; index++) {
+		gateway_device* device = &state->devices[index];
+		if ((device->addr == client_addr->sin_addr.s_addr) && (device->port == client_addr->sin_port)) {
+			device->last_seen_us = now_us;
+			*device_id = index + 1;
+			return device;
+		}
+		if ((idle == NULL) && ((now_us - device->last_seen_us) > (GATEWAY_DEVICE_IDLE_SECS * 1000000LL)))
+			idle = device;
+	}
+
+	if (idle == NULL) {
+		if (state->n_devices >= GATEWAY_MAX_DEVICES)
+			return NULL;
+		idle = &state->devices[state->n_devices++];
+	}
+	memset(idle, 0, sizeof(*idle));
+	idle->addr = client_addr->sin_addr.s_addr;
+	idle->port = client_addr->sin_port;
+	idle->in_use = true;
+	idle->last_seen_us = now_us;
+	*device_id = (int) (idle - state->devices) + 1;
+	printf("IOT_GATEWAY: New local client %s:%d relayed as device %d\n", inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port), *device_id);
+	return idle;
+}
+
+
+
+
+
+/**
+ * gateway_print_stats
+ * prints local traffic and upstream frame counters
+ */
+void gateway_print_stats(gateway_state* state) {
+
+	printf("IOT_GATEWAY: Local: %d devices - %lu datagrams (%lu dropped, %lu deferred while upstream queue full) - %.1f local datagrams per upstream frame - %lu upstream replies - %lu handshakes again\n",
+			state->n_devices, state->local_datagrams, state->local_dropped, state->local_deferred,
+			(state->queue.sent > 0) ? (double) state->local_datagrams / (state->queue.sent + state->queue.retransmits) : 0, state->upstream_replies,
+			state->upstream_handshakes);
+	relay_queue_print_stats(&state->queue);
+	fflush(stdout);
+}
+
+
+
+
+
+/**
+ * gateway_now_us
+ * returns monotonic time in microseconds
+ */
+int64_t gateway_now_us(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+
+
+
+
+void print_error_gateway(int error_code) {
+
+	printf("ERROR IOT_GATEWAY: Code %d\n", error_code);
+	switch(error_code) {
+		case 1:
+			printf(">> Could not open file descriptor for socket.\n");
+			break;
+		case 2:
+			printf(">> Could not bind address to local socket (port in use?).\n");
+			break;
+		case 4:
+			printf(">> Incorrect arguments provided: iot_gateway [options] <central server ip>[:<port>] (default port %d)\n"
+					" Options:\n -l <port> Port local clients send to (default %d)\n -f <ms> Flush frames once their first samples are this old (%d-60000, default %d)\n"
+					" -q Quiet: do not print every local datagram\n\n", SERVER_PORT, SERVER_PORT, GATEWAY_TICK_MS, GATEWAY_DEFAULT_FLUSH_MS);
+			break;
+		case 5:
+			printf(">> Could not set timeout for or connect upstream socket.\n");
+			break;
+		case 6:
+			printf(">> Central server does not accept relayed frames (COMM_CAP_RELAY) or millisecond rates.\n");
+			break;
+		case 7:
+			printf(">> Could not allocate upstream frame queue.\n");
+			break;
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ * iot_gateway.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef IOT_GATEWAY_H_
+#define IOT_GATEWAY_H_
+
+
+#include <netinet/in.h>		// For sockaddr_in struct
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+
+#include "iot_lib.h"
+#include "crc32c.h"
+#include "iot_codec.h"
+#include "relay/relay_queue.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define GATEWAY_CAPABILITIES			(COMM_CAP_RATES_MS | COMM_CAP_SENSOR_ID | COMM_CAP_CRC32C | COMM_CAP_TIMESTAMP_MS)		// Accepted from local clients
+#define GATEWAY_UPSTREAM_CAPABILITIES	(COMM_CAP_RATES_MS | COMM_CAP_SENSOR_ID | COMM_CAP_CRC32C | COMM_CAP_RELAY | COMM_CAP_TIMESTAMP_MS)	// Requested from server
+#define GATEWAY_MAX_DEVICES				1024	// Local clients, device ids 1 to GATEWAY_MAX_DEVICES (0 never used)
+#define GATEWAY_DEVICE_IDLE_SECS		300		// Device ids of clients silent for this long are given to new clients
+#define GATEWAY_DEFAULT_FLUSH_MS		100		// Frame sent once its first block is this old, even if not full
+#define GATEWAY_TICK_MS					10		// Poll timeout: resolution of flush and retransmission timers
+#define GATEWAY_REPORT_SECS				10		// Statistics period
+#define GATEWAY_UPSTREAM_TIMEOUT_SECS	2		// Handshake reply timeout (retried until answered)
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	struct sockaddr_in	upstream_addr;	// Central server
+	int					local_port;		// Port local clients send to
+	int					flush_ms;
+	bool				quiet;			// Do not print every local datagram
+} gateway_options;
+
+
+// Local client, known by its address and port; its device id is its index + 1
+typedef struct {
+	uint32_t		addr;				// Network order
+	uint16_t		port;				// Network order
+	bool			in_use;
+	uint8_t			capabilities;		// Accepted in its last handshake (COMM_CAP_* flags)
+	bool			announced;			// Block flagged DATAGRAM_RELAY_NEW_DEVICE sent since the id was given to this client
+	int64_t			last_seen_us;
+	unsigned long	datagrams;
+	unsigned long	samples;
+} gateway_device;
+
+
+typedef struct {
+	int				local_socket;
+	int				upstream_socket;		// Connected to central server
+	timing_rates	timings;				// Given by central server, handed on to local clients
+	uint8_t			upstream_capabilities;	// Accepted by central server
+	gateway_device	devices		[GATEWAY_MAX_DEVICES];
+	int				n_devices;
+	relay_queue		queue;
+
+	unsigned long	local_datagrams;
+	unsigned long	local_dropped;			// Failing CRC32C check, or from clients beyond GATEWAY_MAX_DEVICES
+	unsigned long	local_deferred;			// Datagrams with samples left unacknowledged while the upstream queue was full (clients retry them)
+	unsigned long	upstream_replies;
+	unsigned long	upstream_handshakes;	// Handshakes after the first (frames refused: server lost the relay session)
+} gateway_state;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void			parse_param_options			(gateway_options* options, int argc, char* argv[]);
+int				gateway_socket_init			(int local_port);
+int				gateway_upstream_init		(struct sockaddr_in* upstream_addr);
+void			gateway_upstream_handshake	(gateway_state* state);
+void			gateway_local_datagram		(gateway_state* state, uint8_t* buffer_recv, int recv_len, struct sockaddr_in* client_addr, int64_t now_us, bool quiet);
+int				gateway_build_reply			(gateway_state* state, gateway_device* device, uint8_t* buffer_recv, uint8_t* buffer_reply);
+int				gateway_relay_samples		(gateway_state* state, int device_id, uint8_t* buffer_recv, int recv_len, int64_t now_us);
+gateway_device*	gateway_device_find			(gateway_state* state, struct sockaddr_in* client_addr, int64_t now_us, int* device_id);
+void			gateway_print_stats			(gateway_state* state);
+int64_t			gateway_now_us				(void);
+void			print_error_gateway			(int error_code);
+
+
+
+#endif /* IOT_GATEWAY_H_ */
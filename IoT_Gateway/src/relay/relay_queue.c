@@ -0,0 +1,246 @@
+/*
+ * relay_queue.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For calloc() and free()
+#include <string.h>			// For memcpy()
+#include <sys/socket.h>		// For send()
+
+#include "crc32c.h"
+#include "iot_codec.h"
+#include "relay_queue.h"
+
+
+
+static void		relay_open_frame	(relay_queue* queue);
+static int		relay_capacity		(relay_queue* queue);
+
+
+
+int relay_queue_init(relay_queue* queue, bool checksummed) {
+
+	memset(queue, 0, sizeof(*queue));
+	queue->frames = calloc(RELAY_QUEUE_FRAMES, sizeof(relay_frame));
+	if (queue->frames == NULL)
+		return -1;
+	queue->checksummed = checksummed;
+	queue->next_sequence = 1;
+	queue->rto_us = RELAY_RTO_INITIAL_US;
+	relay_open_frame(queue);
+	return 0;
+}
+
+
+
+void relay_queue_free(relay_queue* queue) {
+
+	free(queue->frames);
+	queue->frames = NULL;
+}
+
+
+
+/*
+ * Appends a device block to the open frame, sealing it and carrying on in the next one whenever it fills up
+ * (a DATAGRAM_RELAY_NEW_DEVICE flag in device is only kept on the first block)
+ */
+void relay_queue_append(relay_queue* queue, uint16_t device, uint8_t* samples, int n_samples, int64_t now_us) {
+
+	while (n_samples > 0) {
+		int room = (relay_capacity(queue) - queue->open_length - DATAGRAM_RELAY_BLOCK_SIZE) / DATAGRAM_TAGGED_SAMPLE_SIZE;
+		if ((room <= 0) || (queue->open_blocks == UINT8_MAX)) {
+			if (!relay_queue_seal(queue)) {
+				queue->overflow += n_samples;
+				return;
+			}
+			continue;
+		}
+		int n_block = (n_samples < room) ? n_samples : room;
+		if (n_block > RELAY_MAX_BLOCK_SAMPLES)
+			n_block = RELAY_MAX_BLOCK_SAMPLES;
+
+		if (queue->open_blocks == 0)
+			queue->opened_us = now_us;
+		uint8_t* block = codec_datagram_payload(queue->frames[queue->head & (RELAY_QUEUE_FRAMES - 1)].datagram) + queue->open_length;
+		codec_relay_block_set_device(block, device);
+		codec_relay_block_set_n_samples(block, (uint8_t) n_block);
+		device &= ~DATAGRAM_RELAY_NEW_DEVICE;			// Only on the first of its blocks
+		memcpy(&block[DATAGRAM_RELAY_BLOCK_SIZE], samples, n_block * DATAGRAM_TAGGED_SAMPLE_SIZE);
+		queue->open_length += DATAGRAM_RELAY_BLOCK_SIZE + (n_block * DATAGRAM_TAGGED_SAMPLE_SIZE);
+		queue->open_blocks++;
+		queue->samples += n_block;
+
+		samples += n_block * DATAGRAM_TAGGED_SAMPLE_SIZE;
+		n_samples -= n_block;
+	}
+}
+
+
+
+/*
+ * Closes open frame (if it holds any block) with the next sequence. Unacknowledged frames are never overwritten:
+ * with every other slot pending, the open frame stays open.
+ * returns false if the frame could not be sealed
+ */
+bool relay_queue_seal(relay_queue* queue) {
+
+	if (queue->open_blocks == 0)
+		return true;
+	if ((queue->head + 1 - queue->tail) >= RELAY_QUEUE_FRAMES)
+		return false;
+
+	relay_frame* frame = &queue->frames[queue->head & (RELAY_QUEUE_FRAMES - 1)];
+	uint8_t* header = codec_datagram_payload(frame->datagram);
+	frame->sequence = queue->next_sequence++;
+	codec_relay_header_set_sequence(header, frame->sequence);
+	codec_relay_header_set_n_blocks(header, (uint8_t) queue->open_blocks);
+	codec_datagram_begin(frame->datagram, DATAGRAM_REQ_SEND_RELAY, queue->open_length);
+	frame->length = codec_datagram_size(frame->datagram);
+	if (queue->checksummed)
+		frame->length = datagram_seal_crc32c(frame->datagram, frame->length);
+	queue->sealed++;
+
+	queue->head++;
+	relay_open_frame(queue);
+	return true;
+}
+
+
+
+bool relay_queue_due(relay_queue* queue, int64_t now_us, int64_t flush_us) {
+
+	return (queue->open_blocks > 0) && ((now_us - queue->opened_us) >= flush_us);
+}
+
+
+
+/*
+ * Sends frames of the window not sent yet, and resends those unacknowledged for longer than the retransmission
+ * timeout (doubled on every expiry, Karn's rule: resent frames are not timed)
+ */
+int relay_queue_send(relay_queue* queue, int upstream_socket, int64_t now_us) {
+
+	int n_sent = 0;
+	bool expired = false;
+	uint64_t index;
+	for (index = queue->tail; (index < queue->head) && (index < (queue->tail + RELAY_WINDOW)); index++) {
+		relay_frame* frame = &queue->frames[index & (RELAY_QUEUE_FRAMES - 1)];
+		if (frame->acked || ((frame->sent_us != 0) && ((now_us - frame->sent_us) < queue->rto_us)))
+			continue;
+
+		if (send(upstream_socket, frame->datagram, frame->length, 0) < 0)
+			break;
+		if (frame->sent_us != 0) {
+			queue->retransmits++;
+			expired = true;
+		} else {
+			queue->sent++;
+		}
+		frame->sent_us = now_us;
+		frame->attempts++;
+		n_sent++;
+	}
+
+	if (expired) {
+		queue->rto_us *= 2;
+		if (queue->rto_us > RELAY_RTO_MAX_US)
+			queue->rto_us = RELAY_RTO_MAX_US;
+	}
+	return n_sent;
+}
+
+
+
+/*
+ * Marks acknowledged frame (replies for frames already dropped or acknowledged are ignored) and slides the window;
+ * first-attempt round-trips update the timeout (Jacobson/Karels)
+ */
+void relay_queue_ack(relay_queue* queue, uint8_t* buffer_recv, int recv_len, int64_t now_us) {
+
+	if ((recv_len < (DATAGRAM_HEADER_SIZE + DATAGRAM_RELAY_REPLY_SIZE)) || (buffer_recv[0] != DATAGRAM_REP_RELAY_OK) || (queue->tail == queue->head))
+		return;
+	if (queue->checksummed && (datagram_check_crc32c(buffer_recv, recv_len) != 1))
+		return;
+
+	uint32_t sequence = codec_relay_reply_get_sequence(codec_datagram_payload(buffer_recv));
+	uint32_t offset = sequence - queue->frames[queue->tail & (RELAY_QUEUE_FRAMES - 1)].sequence;
+	if (offset >= (queue->head - queue->tail))
+		return;
+
+	relay_frame* frame = &queue->frames[(queue->tail + offset) & (RELAY_QUEUE_FRAMES - 1)];
+	if (frame->acked || (frame->sent_us == 0))
+		return;
+	frame->acked = true;
+	queue->acked++;
+
+	if (frame->attempts == 1) {
+		int64_t rtt_us = now_us - frame->sent_us;
+		if (queue->srtt_us == 0) {
+			queue->srtt_us = rtt_us;
+			queue->rttvar_us = rtt_us / 2;
+		} else {
+			int64_t error = (rtt_us > queue->srtt_us) ? (rtt_us - queue->srtt_us) : (queue->srtt_us - rtt_us);
+			queue->rttvar_us += (error - queue->rttvar_us) / 4;
+			queue->srtt_us += (rtt_us - queue->srtt_us) / 8;
+		}
+	}
+	queue->rto_us = (queue->srtt_us > 0) ? (queue->srtt_us + (4 * queue->rttvar_us)) : RELAY_RTO_INITIAL_US;
+	if (queue->rto_us < RELAY_RTO_MIN_US)
+		queue->rto_us = RELAY_RTO_MIN_US;
+	if (queue->rto_us > RELAY_RTO_MAX_US)
+		queue->rto_us = RELAY_RTO_MAX_US;
+
+	while ((queue->tail < queue->head) && queue->frames[queue->tail & (RELAY_QUEUE_FRAMES - 1)].acked)
+		queue->tail++;
+}
+
+
+
+int relay_queue_depth(relay_queue* queue) {
+
+	return (int) (queue->head - queue->tail);
+}
+
+
+
+bool relay_queue_full(relay_queue* queue) {
+
+	return relay_queue_depth(queue) >= RELAY_QUEUE_LIMIT;
+}
+
+
+
+void relay_queue_print_stats(relay_queue* queue) {
+
+	printf("IOT_GATEWAY: Upstream: %lu samples in %lu frames (%.1f per frame) - %lu sent - %lu retransmitted - %lu acknowledged - %lu samples overflowed - queue %d frames - RTT %.1f ms (timeout %.1f ms)\n",
+			queue->samples, queue->sealed, (queue->sealed > 0) ? (double) queue->samples / queue->sealed : 0, queue->sent, queue->retransmits,
+			queue->acked, queue->overflow, relay_queue_depth(queue), queue->srtt_us / 1000.0, queue->rto_us / 1000.0);
+}
+
+
+
+/*
+ * Resets frame at head for new blocks
+ */
+static void relay_open_frame(relay_queue* queue) {
+
+	relay_frame* frame = &queue->frames[queue->head & (RELAY_QUEUE_FRAMES - 1)];
+	memset(frame, 0, sizeof(*frame));
+	queue->open_length = DATAGRAM_RELAY_HEADER_SIZE;
+	queue->open_blocks = 0;
+}
+
+
+
+/*
+ * Payload bytes a frame may hold: one datagram, End-Of-Package byte and checksum included
+ */
+static int relay_capacity(relay_queue* queue) {
+
+	return DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 1 - (queue->checksummed ? DATAGRAM_CRC_SIZE : 0);
+}
@@ -0,0 +1,89 @@
+/*
+ * relay_queue.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef RELAY_QUEUE_H_
+#define RELAY_QUEUE_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define RELAY_QUEUE_FRAMES		4096		// Frames held while upstream is slow or down (power of 2), never overwritten unacknowledged
+#define RELAY_QUEUE_LIMIT		(RELAY_QUEUE_FRAMES - 3)	// Sealed frames past which local samples are refused: a local datagram
+													// seals at most two more, and the open frame keeps its slot
+#define RELAY_WINDOW			32			// Frames in flight awaiting acknowledgement (below server's dedup window)
+#define RELAY_RTO_INITIAL_US	500000		// Retransmission timeout until the first round-trip is measured
+#define RELAY_RTO_MIN_US		20000
+#define RELAY_RTO_MAX_US		8000000		// Backed-off timeout cap while upstream is down
+#define RELAY_MAX_BLOCK_SAMPLES	255			// Block sample count is one byte
+
+#if RELAY_WINDOW >= 64
+#error "Frames in flight must stay within server's RELAY_DEDUP_WINDOW"
+#endif
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	uint8_t		datagram	[DATAGRAM_SIZE];
+	int			length;				// Sealed datagram length
+	uint32_t	sequence;
+	int64_t		sent_us;			// Last transmission (0: not sent yet)
+	int			attempts;
+	bool		acked;
+} relay_frame;
+
+
+// Frames from tail to head are sealed and pending acknowledgement, the first RELAY_WINDOW of them may be in flight;
+// the frame at head is open, filling with device blocks until full or flushed
+typedef struct {
+	relay_frame*	frames;
+	uint64_t		head;
+	uint64_t		tail;
+	uint32_t		next_sequence;
+	bool			checksummed;		// Frames end in CRC32C (upstream accepted COMM_CAP_CRC32C)
+	int				open_length;		// Open frame payload bytes (DATAGRAM_RELAY_HEADER_SIZE: empty)
+	int				open_blocks;
+	int64_t			opened_us;			// First block appended to open frame
+
+	int64_t			srtt_us;			// Smoothed round-trip time (0: not measured yet)
+	int64_t			rttvar_us;
+	int64_t			rto_us;
+
+	unsigned long	samples;
+	unsigned long	sealed;
+	unsigned long	sent;
+	unsigned long	retransmits;
+	unsigned long	acked;
+	unsigned long	overflow;			// Samples not queued: every slot held an unacknowledged frame (RELAY_QUEUE_LIMIT not checked)
+} relay_queue;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		relay_queue_init		(relay_queue* queue, bool checksummed);		// returns -1 if allocation fails
+void	relay_queue_free		(relay_queue* queue);
+void	relay_queue_append		(relay_queue* queue, uint16_t device, uint8_t* samples, int n_samples, int64_t now_us);	// tagged samples
+bool	relay_queue_seal		(relay_queue* queue);		// false if no slot is free (open frame kept open)
+bool	relay_queue_due			(relay_queue* queue, int64_t now_us, int64_t flush_us);		// open frame older than flush_us
+int		relay_queue_send		(relay_queue* queue, int upstream_socket, int64_t now_us);	// returns frames sent
+void	relay_queue_ack			(relay_queue* queue, uint8_t* buffer_recv, int recv_len, int64_t now_us);
+int		relay_queue_depth		(relay_queue* queue);
+bool	relay_queue_full		(relay_queue* queue);		// depth reached RELAY_QUEUE_LIMIT
+void	relay_queue_print_stats	(relay_queue* queue);
+
+
+
+#endif /* RELAY_QUEUE_H_ */
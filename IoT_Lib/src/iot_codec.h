@@ -0,0 +1,429 @@
+/*
+ * iot_codec.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef IOT_CODEC_H_
+#define IOT_CODEC_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <string.h>			// For memcpy()
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+// Record layouts, declared once as field lists: FIELD(record, name, width) for a little-endian unsigned of width
+// bytes (1, 2, 4 or 8), BLOCK(record, name, size) for a nested record or array. Offsets follow from the order.
+// CODEC_LAYOUT() turns a list into accessors over a view (pointer to the record inside a datagram buffer, no copy):
+//   codec_<record>_get_<name>(view), codec_<record>_set_<name>(view, value)	- fields
+//   codec_<record>_<name>(view)												- blocks, view of the nested record
+// and checks at compile time that the fields add up to the record's wire size.
+
+#define CODEC_HEADER_FIELDS(FIELD, BLOCK)			\
+	FIELD(header, type, 1)							\
+	FIELD(header, length, 2)						/* Message size, without header and End-Of-Package byte */
+
+#define CODEC_SAMPLE_FIELDS(FIELD, BLOCK)			\
+	FIELD(sample, timestamp, 2)						\
+	FIELD(sample, clarity, 2)						\
+	FIELD(sample, red, 2)							\
+	FIELD(sample, green, 2)							\
+	FIELD(sample, blue, 2)
+
+#define CODEC_TAGGED_SAMPLE_FIELDS(FIELD, BLOCK)	\
+	FIELD(tagged_sample, sensor, 1)					\
+	BLOCK(tagged_sample, sample, DATAGRAM_SAMPLE_SIZE)
+
+#define CODEC_SUMMARY_FIELDS(FIELD, BLOCK)			\
+	FIELD(summary, sensor, 1)						\
+	FIELD(summary, window_start, 2)					\
+	FIELD(summary, count, 2)						\
+	BLOCK(summary, channels, DATAGRAM_CHANNELS * DATAGRAM_SUMMARY_CHANNEL_SIZE)
+
+#define CODEC_SUMMARY_CHANNEL_FIELDS(FIELD, BLOCK)	\
+	FIELD(summary_channel, minimum, 2)				\
+	FIELD(summary_channel, maximum, 2)				\
+	FIELD(summary_channel, sum, 4)
+
+#define CODEC_COMM_REPLY_FIELDS(FIELD, BLOCK)		\
+	FIELD(comm_reply, capabilities, 1)				\
+	FIELD(comm_reply, sampling, 4)					\
+	FIELD(comm_reply, server_stream, 4)
+
+#define CODEC_COMM_REPLY_LEGACY_FIELDS(FIELD, BLOCK)	\
+	FIELD(comm_reply_legacy, sampling, 1)			/* Whole seconds */	\
+	FIELD(comm_reply_legacy, server_stream, 1)
+
+#define CODEC_RATE_UPDATE_FIELDS(FIELD, BLOCK)		\
+	FIELD(rate_update, sampling, 4)					\
+	FIELD(rate_update, server_stream, 4)
+
+#define CODEC_RELAY_REPLY_FIELDS(FIELD, BLOCK)		\
+	FIELD(relay_reply, sequence, 4)
+
+// Client addresses and ports travel in network order, as held in sockaddr_in: blocks, read with codec_load_addr/port
+#define CODEC_SUBSCRIBE_FIELDS(FIELD, BLOCK)		\
+	BLOCK(subscribe, addr, 4)						/* 0: any */	\
+	BLOCK(subscribe, port, 2)						/* 0: any */	\
+	FIELD(subscribe, sensor, 1)						/* DATAGRAM_SUBSCRIBE_ANY_SENSOR: any */
+
+#define CODEC_PUBLISH_FIELDS(FIELD, BLOCK)			\
+	BLOCK(publish, addr, 4)							\
+	BLOCK(publish, port, 2)							\
+	FIELD(publish, arrival_ns, 8)					/* Tagged samples of one sensor follow */
+
+#define CODEC_SUBSCRIBE_REPLY_FIELDS(FIELD, BLOCK)	\
+	FIELD(subscribe_reply, status, 1)				\
+	FIELD(subscribe_reply, lease, 2)				/* Seconds */
+
+#define CODEC_QUERY_FIELDS(FIELD, BLOCK)			\
+	BLOCK(query, addr, 4)							\
+	BLOCK(query, port, 2)							\
+	FIELD(query, sensor, 1)							\
+	FIELD(query, from, 4)							/* Unix seconds */	\
+	FIELD(query, to, 4)
+
+#define CODEC_QUERY_REPLY_FIELDS(FIELD, BLOCK)		\
+	FIELD(query_reply, status, 1)					\
+	FIELD(query_reply, from, 4)						\
+	FIELD(query_reply, to, 4)						\
+	FIELD(query_reply, count, 4)					\
+	BLOCK(query_reply, channels, DATAGRAM_CHANNELS * DATAGRAM_QUERY_CHANNEL_SIZE)
+
+#define CODEC_QUERY_CHANNEL_FIELDS(FIELD, BLOCK)	\
+	FIELD(query_channel, minimum, 2)				\
+	FIELD(query_channel, mean, 2)					\
+	FIELD(query_channel, maximum, 2)
+
+// Trailer after the End-Of-Package byte (COMM_CAP_TRACE), microseconds
+#define CODEC_TRACE_FIELDS(FIELD, BLOCK)			\
+	FIELD(trace, marker, 1)							/* DATAGRAM_TRACE_MARKER */	\
+	FIELD(trace, captured_us, 8)					\
+	FIELD(trace, read_us, 4)						\
+	FIELD(trace, sent_us, 8)						\
+	FIELD(trace, offset_us, 8)						/* Signed */	\
+	FIELD(trace, rtt_us, 4)
+
+#define CODEC_COMM_TRACE_FIELDS(FIELD, BLOCK)		\
+	FIELD(comm_trace, received_us, 8)				\
+	FIELD(comm_trace, sent_us, 8)
+
+#define CODEC_RELAY_HEADER_FIELDS(FIELD, BLOCK)		\
+	FIELD(relay_header, sequence, 4)				\
+	FIELD(relay_header, n_blocks, 1)
+
+#define CODEC_RELAY_BLOCK_FIELDS(FIELD, BLOCK)		\
+	FIELD(relay_block, device, 2)					\
+	FIELD(relay_block, n_samples, 1)				/* Tagged samples follow */
+
+// Cluster traffic: client datagram (or its reply) wrapped behind its client's address
+#define CODEC_FORWARD_FIELDS(FIELD, BLOCK)			\
+	BLOCK(forward, addr, 4)							\
+	BLOCK(forward, port, 2)
+
+#define CODEC_HANDOFF_FIELDS(FIELD, BLOCK)			\
+	BLOCK(handoff, addr, 4)							\
+	BLOCK(handoff, port, 2)							\
+	BLOCK(handoff, relay_port, 2)					\
+	FIELD(handoff, capabilities, 1)					\
+	FIELD(handoff, sampling, 4)						\
+	FIELD(handoff, server_stream, 4)				\
+	FIELD(handoff, relay_sequence, 4)				\
+	FIELD(handoff, relay_window, 8)					\
+	FIELD(handoff, datagrams, 4)					\
+	FIELD(handoff, samples, 4)
+
+#define CODEC_REPORT_HEADER_FIELDS(FIELD, BLOCK)	\
+	FIELD(report_header, n_clients, 4)				\
+	FIELD(report_header, n_samples, 4)				\
+	FIELD(report_header, n_sensors, 1)
+
+#define CODEC_REPORT_SENSOR_FIELDS(FIELD, BLOCK)	\
+	FIELD(report_sensor, sensor, 1)					\
+	FIELD(report_sensor, count, 4)					\
+	BLOCK(report_sensor, channels, DATAGRAM_CHANNELS * DATAGRAM_REPORT_CHANNEL_SIZE)
+
+// IEEE 754 single bits, moved with codec_float_bits/codec_bits_float
+#define CODEC_REPORT_CHANNEL_FIELDS(FIELD, BLOCK)	\
+	FIELD(report_channel, minimum, 4)				\
+	FIELD(report_channel, mean, 4)					\
+	FIELD(report_channel, maximum, 4)
+
+// Field types by width
+#define CODEC_TYPE_1		uint8_t
+#define CODEC_TYPE_2		uint16_t
+#define CODEC_TYPE_4		uint32_t
+#define CODEC_TYPE_8		uint64_t
+
+// Native loads and stores on little-endian hosts (Pi and x86: one unaligned move), byte swapped elsewhere
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define CODEC_SWAP_2(value)	__builtin_bswap16(value)
+#define CODEC_SWAP_4(value)	__builtin_bswap32(value)
+#define CODEC_SWAP_8(value)	__builtin_bswap64(value)
+#else
+#define CODEC_SWAP_2(value)	(value)
+#define CODEC_SWAP_4(value)	(value)
+#define CODEC_SWAP_8(value)	(value)
+#endif
+
+// Layout generators: offsets as enumerators (each field's last byte steps the next offset), then accessors
+#define CODEC_OFFSET_FIELD(record, name, width)		codec_##record##_##name##_offset, codec_##record##_##name##_last = codec_##record##_##name##_offset + (width) - 1,
+#define CODEC_OFFSET_BLOCK(record, name, size)		CODEC_OFFSET_FIELD(record, name, size)
+#define CODEC_ACCESS_FIELD(record, name, width)																		\
+	static inline CODEC_TYPE_##width codec_##record##_get_##name(const uint8_t* view) {								\
+		return codec_load_##width(view + codec_##record##_##name##_offset);											\
+	}																												\
+	static inline void codec_##record##_set_##name(uint8_t* view, CODEC_TYPE_##width value) {						\
+		codec_store_##width(view + codec_##record##_##name##_offset, value);										\
+	}
+#define CODEC_ACCESS_BLOCK(record, name, size)																		\
+	static inline uint8_t* codec_##record##_##name(uint8_t* view) {													\
+		return view + codec_##record##_##name##_offset;																\
+	}
+
+#define CODEC_LAYOUT(record, FIELDS, size)																			\
+	enum { FIELDS(CODEC_OFFSET_FIELD, CODEC_OFFSET_BLOCK) codec_##record##_size };								\
+	FIELDS(CODEC_ACCESS_FIELD, CODEC_ACCESS_BLOCK)																	\
+	_Static_assert(codec_##record##_size == (size), "codec: " #record " layout does not match its wire size");
+
+
+
+/* FUNCTION DEFINITIONS */
+
+static inline uint8_t codec_load_1(const uint8_t* bytes) {
+
+	return bytes[0];
+}
+
+
+static inline uint16_t codec_load_2(const uint8_t* bytes) {
+
+	uint16_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return CODEC_SWAP_2(value);
+}
+
+
+static inline uint32_t codec_load_4(const uint8_t* bytes) {
+
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return CODEC_SWAP_4(value);
+}
+
+
+static inline uint64_t codec_load_8(const uint8_t* bytes) {
+
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return CODEC_SWAP_8(value);
+}
+
+
+static inline void codec_store_1(uint8_t* bytes, uint8_t value) {
+
+	bytes[0] = value;
+}
+
+
+static inline void codec_store_2(uint8_t* bytes, uint16_t value) {
+
+	value = CODEC_SWAP_2(value);
+	memcpy(bytes, &value, sizeof(value));
+}
+
+
+static inline void codec_store_4(uint8_t* bytes, uint32_t value) {
+
+	value = CODEC_SWAP_4(value);
+	memcpy(bytes, &value, sizeof(value));
+}
+
+
+static inline void codec_store_8(uint8_t* bytes, uint64_t value) {
+
+	value = CODEC_SWAP_8(value);
+	memcpy(bytes, &value, sizeof(value));
+}
+
+
+// Addresses and ports: network order on the wire and in memory, copied as is
+static inline uint32_t codec_load_addr(const uint8_t* bytes) {
+
+	uint32_t addr;
+	memcpy(&addr, bytes, sizeof(addr));
+	return addr;
+}
+
+
+static inline uint16_t codec_load_port(const uint8_t* bytes) {
+
+	uint16_t port;
+	memcpy(&port, bytes, sizeof(port));
+	return port;
+}
+
+
+static inline void codec_store_addr(uint8_t* bytes, uint32_t addr) {
+
+	memcpy(bytes, &addr, sizeof(addr));
+}
+
+
+static inline void codec_store_port(uint8_t* bytes, uint16_t port) {
+
+	memcpy(bytes, &port, sizeof(port));
+}
+
+
+static inline uint32_t codec_float_bits(float value) {
+
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+
+static inline float codec_bits_float(uint32_t bits) {
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+
+/* RECORD LAYOUTS */
+
+CODEC_LAYOUT(header, CODEC_HEADER_FIELDS, DATAGRAM_HEADER_SIZE)
+CODEC_LAYOUT(sample, CODEC_SAMPLE_FIELDS, DATAGRAM_SAMPLE_SIZE)
+CODEC_LAYOUT(tagged_sample, CODEC_TAGGED_SAMPLE_FIELDS, DATAGRAM_TAGGED_SAMPLE_SIZE)
+CODEC_LAYOUT(summary, CODEC_SUMMARY_FIELDS, DATAGRAM_SUMMARY_SIZE)
+CODEC_LAYOUT(summary_channel, CODEC_SUMMARY_CHANNEL_FIELDS, DATAGRAM_SUMMARY_CHANNEL_SIZE)
+CODEC_LAYOUT(comm_reply, CODEC_COMM_REPLY_FIELDS, DATAGRAM_COMM_REPLY_SIZE)
+CODEC_LAYOUT(comm_reply_legacy, CODEC_COMM_REPLY_LEGACY_FIELDS, DATAGRAM_COMM_REPLY_LEGACY_SIZE)
+CODEC_LAYOUT(rate_update, CODEC_RATE_UPDATE_FIELDS, DATAGRAM_RATE_UPDATE_SIZE)
+CODEC_LAYOUT(relay_reply, CODEC_RELAY_REPLY_FIELDS, DATAGRAM_RELAY_REPLY_SIZE)
+CODEC_LAYOUT(subscribe, CODEC_SUBSCRIBE_FIELDS, DATAGRAM_SUBSCRIBE_SIZE)
+CODEC_LAYOUT(publish, CODEC_PUBLISH_FIELDS, DATAGRAM_PUBLISH_HEADER_SIZE)
+CODEC_LAYOUT(subscribe_reply, CODEC_SUBSCRIBE_REPLY_FIELDS, DATAGRAM_SUBSCRIBE_REPLY_SIZE)
+CODEC_LAYOUT(query, CODEC_QUERY_FIELDS, DATAGRAM_QUERY_SIZE)
+CODEC_LAYOUT(query_reply, CODEC_QUERY_REPLY_FIELDS, DATAGRAM_QUERY_REPLY_SIZE)
+CODEC_LAYOUT(query_channel, CODEC_QUERY_CHANNEL_FIELDS, DATAGRAM_QUERY_CHANNEL_SIZE)
+CODEC_LAYOUT(trace, CODEC_TRACE_FIELDS, DATAGRAM_TRACE_SIZE)
+CODEC_LAYOUT(comm_trace, CODEC_COMM_TRACE_FIELDS, DATAGRAM_COMM_TRACE_SIZE)
+CODEC_LAYOUT(relay_header, CODEC_RELAY_HEADER_FIELDS, DATAGRAM_RELAY_HEADER_SIZE)
+CODEC_LAYOUT(relay_block, CODEC_RELAY_BLOCK_FIELDS, DATAGRAM_RELAY_BLOCK_SIZE)
+CODEC_LAYOUT(forward, CODEC_FORWARD_FIELDS, DATAGRAM_FORWARD_SIZE)
+CODEC_LAYOUT(handoff, CODEC_HANDOFF_FIELDS, DATAGRAM_HANDOFF_RECORD_SIZE)
+CODEC_LAYOUT(report_header, CODEC_REPORT_HEADER_FIELDS, DATAGRAM_REPORT_HEADER_SIZE)
+CODEC_LAYOUT(report_sensor, CODEC_REPORT_SENSOR_FIELDS, DATAGRAM_REPORT_SENSOR_SIZE)
+CODEC_LAYOUT(report_channel, CODEC_REPORT_CHANNEL_FIELDS, DATAGRAM_REPORT_CHANNEL_SIZE)
+
+// Color channels are indexed (clarity, red, green, blue): contiguous after the timestamp
+_Static_assert(codec_sample_blue_offset == (codec_sample_clarity_offset + ((DATAGRAM_CHANNELS - 1) * 2)), "codec: sample channels not contiguous");
+
+
+
+/*
+ * View of record index in an array of fixed-size records
+ */
+static inline uint8_t* codec_at(uint8_t* records, int index, int record_size) {
+
+	return records + (index * record_size);
+}
+
+
+static inline uint16_t codec_sample_get_channel(const uint8_t* view, int channel) {
+
+	return codec_load_2(view + codec_sample_clarity_offset + (channel * 2));
+}
+
+
+static inline void codec_sample_set_channel(uint8_t* view, int channel, uint16_t value) {
+
+	codec_store_2(view + codec_sample_clarity_offset + (channel * 2), value);
+}
+
+
+static inline uint8_t* codec_summary_channel(uint8_t* summary, int channel) {
+
+	return codec_at(codec_summary_channels(summary), channel, DATAGRAM_SUMMARY_CHANNEL_SIZE);
+}
+
+
+static inline uint8_t* codec_query_reply_channel(uint8_t* reply, int channel) {
+
+	return codec_at(codec_query_reply_channels(reply), channel, DATAGRAM_QUERY_CHANNEL_SIZE);
+}
+
+
+static inline uint8_t* codec_report_sensor_channel(uint8_t* sensor, int channel) {
+
+	return codec_at(codec_report_sensor_channels(sensor), channel, DATAGRAM_REPORT_CHANNEL_SIZE);
+}
+
+
+/*
+ * Writes header (End-Of-Package byte cleared: flags are set when sealing): payload follows at codec_datagram_payload()
+ */
+static inline void codec_datagram_begin(uint8_t* datagram, uint8_t type, int length) {
+
+	codec_header_set_type(datagram, type);
+	codec_header_set_length(datagram, (uint16_t) length);
+	datagram[DATAGRAM_HEADER_SIZE + length] = 0x00;
+}
+
+
+static inline uint8_t* codec_datagram_payload(uint8_t* datagram) {
+
+	return datagram + DATAGRAM_HEADER_SIZE;
+}
+
+
+static inline int codec_datagram_length(const uint8_t* datagram) {
+
+	return (int) codec_header_get_length(datagram);
+}
+
+
+/*
+ * returns offset of the End-Of-Package byte (declared, to be checked against the received length before reading it)
+ */
+static inline int codec_datagram_eop(const uint8_t* datagram) {
+
+	return DATAGRAM_HEADER_SIZE + codec_datagram_length(datagram);
+}
+
+
+/*
+ * returns wire size up to and including the End-Of-Package byte (trailers, if any, follow it)
+ */
+static inline int codec_datagram_size(const uint8_t* datagram) {
+
+	return DATAGRAM_HEADER_SIZE + codec_datagram_length(datagram) + 1;
+}
+
+
+/*
+ * returns whole records of record_size in the declared message, never past the received bytes (received: datagram
+ * size as received) nor the datagram buffer
+ */
+static inline int codec_datagram_records(const uint8_t* datagram, int received, int record_size) {
+
+	int length = codec_datagram_length(datagram);
+	int capacity = ((received < DATAGRAM_SIZE) ? received : DATAGRAM_SIZE) - DATAGRAM_HEADER_SIZE;
+	if (capacity < 0)
+		return 0;
+	return ((length < capacity) ? length : capacity) / record_size;
+}
+
+
+
+#endif /* IOT_CODEC_H_ */
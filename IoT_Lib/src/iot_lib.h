@@ -22,27 +22,93 @@
 #define DATAGRAM_SIZE					1024
 #define DATAGRAM_HEADER_SIZE			3	// Request Type (1B) + Message Size (2B)
 #define DATAGRAM_SAMPLE_SIZE			10	// 2 timestamp bytes + 8 data bytes
-#define MAX_SAMPLING_RATIO				DATAGRAM_SIZE / DATAGRAM_SAMPLE_SIZE
-#define DEFAULT_RATE_SAMPLING			1
-#define DEFAULT_RATE_SERVER_STREAM		10
-#define DEFAULT_RATE_SERVER_STATS_CALC	60
-#define MAX_RATE_SERVER_STATS_CALC		600
+#define DATAGRAM_TAGGED_SAMPLE_SIZE		11	// 1 sensor id byte + DATAGRAM_SAMPLE_SIZE
+#define DATAGRAM_CHANNELS				4	// Clarity, red, green and blue (16 bits each)
+#define DATAGRAM_SUMMARY_SIZE			37	// 1 sensor id byte + 2 window timestamp bytes + 2 count bytes + per channel: min (2B), max (2B), sum (4B)
+#define DATAGRAM_SUMMARY_CHANNEL_SIZE	8	// Per channel part of a summary: min (2B) + max (2B) + sum (4B)
+#define DATAGRAM_MAX_SENSORS			16	// Sensor ids per client (0 for single-sensor clients)
+#define DATAGRAM_QUERY_SIZE				15	// Client address (4B) + client port (2B), network order + sensor id (1B) + from (4B) + to (4B) unix seconds
+#define DATAGRAM_QUERY_REPLY_SIZE		37	// Status (1B) + from (4B) + to (4B) + sample count (4B) + per channel: min, mean, max (2B each, sensor counts)
+#define DATAGRAM_QUERY_CHANNEL_SIZE		6	// Per channel part of a query reply: min (2B) + mean (2B) + max (2B)
+#define DATAGRAM_TRACE_SIZE				33	// Trace trailer (COMM_CAP_TRACE), after the End-Of-Package byte: marker (1B) + oldest sample capture (8B)
+											// + longest sensor read (4B) + send time (8B) + clock offset (8B, signed) + handshake RTT (4B), microseconds
+#define DATAGRAM_TRACE_MARKER			0x54
+#define DATAGRAM_COMM_REPLY_SIZE		9	// DATAGRAM_REP_COMM_OK (COMM_CAP_RATES_MS): capabilities echo (1B) + sampling and streaming rates (4B each, milliseconds)
+#define DATAGRAM_COMM_REPLY_LEGACY_SIZE	2	// DATAGRAM_REP_COMM_OK to legacy clients: sampling and streaming rates (1B each, whole seconds)
+#define DATAGRAM_COMM_TRACE_SIZE		16	// Appended to DATAGRAM_REP_COMM_OK when COMM_CAP_TRACE is accepted: server receive + send times (8B each, microseconds)
+#define DATAGRAM_CRC_SIZE				4	// CRC32C of all preceding bytes, last in datagram (COMM_CAP_CRC32C, flagged in End-Of-Package byte)
+#define DATAGRAM_RATE_UPDATE_SIZE		8	// Appended to DATAGRAM_REP_SEND_DATA_OK (COMM_CAP_RATE_CONTROL): sampling + streaming rate (4B each, milliseconds)
+#define DATAGRAM_SUBSCRIBE_SIZE			7	// Filter: client address (4B) + client port (2B), network order (0: any) + sensor id (1B)
+#define DATAGRAM_SUBSCRIBE_REPLY_SIZE	3	// Status (1B) + lease seconds (2B)
+#define DATAGRAM_SUBSCRIBE_ANY_SENSOR	0xFF
+#define DATAGRAM_PUBLISH_HEADER_SIZE	14	// Client address (4B) + client port (2B), network order + arrival (8B, unix nanoseconds), followed by
+											// samples of one sensor: sensor id (1B) + timestamp (2B, milliseconds) + clarity, red, green, blue (2B each, sensor counts)
+#define DATAGRAM_RELAY_HEADER_SIZE		5	// Frame sequence (4B) + device blocks (1B), followed per block by device id (2B) + sample count (1B)
+											// + tagged samples (DATAGRAM_TAGGED_SAMPLE_SIZE each)
+#define DATAGRAM_RELAY_BLOCK_SIZE		3	// Device id (2B) + sample count (1B)
+#define DATAGRAM_RELAY_NEW_DEVICE		0x8000	// Device id flag: first block since the id was given to a new local client (its old session is dropped)
+#define DATAGRAM_RELAY_REPLY_SIZE		4	// Frame sequence acknowledged (4B)
+#define DATAGRAM_FORWARD_SIZE			6	// Cluster forward (and its reply): client address (4B) + client port (2B), network order, followed by client's whole datagram
+#define DATAGRAM_CLUSTER_SIZE			(DATAGRAM_SIZE + DATAGRAM_HEADER_SIZE + DATAGRAM_FORWARD_SIZE + 1)	// Largest datagram between cluster nodes
+#define DATAGRAM_HEARTBEAT_SIZE			1	// Node status (1B): CLUSTER_NODE_ALIVE or CLUSTER_NODE_LEAVING
+#define DATAGRAM_HANDOFF_RECORD_SIZE	37	// Client address (4B) + port (2B) + gateway port (2B), network order + capabilities (1B) + sampling and
+											// streaming rates (4B each) + relay sequence (4B) and window (8B) + datagrams and samples (4B each);
+											// records follow a count (1B)
+#define DATAGRAM_REPORT_HEADER_SIZE		9	// Node stats report: clients (4B) + samples (4B) + sensors (1B), followed per sensor by
+#define DATAGRAM_REPORT_SENSOR_SIZE		53	// sensor id (1B) + count (4B) + per channel: min, mean, max (IEEE 754 single, 4B each)
+#define DATAGRAM_REPORT_CHANNEL_SIZE	12	// Per channel part of a report sensor: min (4B) + mean (4B) + max (4B)
+#define MAX_SAMPLING_RATIO				(DATAGRAM_SIZE / DATAGRAM_SAMPLE_SIZE)
+
+// Timing rates (milliseconds)
+#define DEFAULT_RATE_SAMPLING			1000
+#define DEFAULT_RATE_SERVER_STREAM		10000
+#define DEFAULT_RATE_SERVER_STATS_CALC	60000
+#define MAX_RATE_SERVER_STATS_CALC		600000
+#define MIN_RATE_SAMPLING				1
 
 // Protocol data codes
 #define DATAGRAM_REQ_COMM				0x01
 #define DATAGRAM_REP_COMM_OK			0x02
 #define DATAGRAM_REQ_SEND_DATA			0x03
 #define DATAGRAM_REP_SEND_DATA_OK		0x04
+#define DATAGRAM_REQ_SEND_SUMMARY		0x05	// Window summaries (COMM_CAP_AGGREGATE), acknowledged with DATAGRAM_REP_SEND_DATA_OK
+#define DATAGRAM_REQ_SEND_TAGGED_DATA	0x06	// Samples tagged with sensor id (COMM_CAP_SENSOR_ID), acknowledged with DATAGRAM_REP_SEND_DATA_OK
+#define DATAGRAM_REQ_QUERY_RANGE		0x07	// Operator query: statistics of one client sensor over a time range
+#define DATAGRAM_REP_QUERY_RANGE		0x08
+#define DATAGRAM_REQ_SUBSCRIBE			0x09	// Live sample subscription (UDP or server's Unix socket), renewed within its lease
+#define DATAGRAM_REP_SUBSCRIBE			0x0A
+#define DATAGRAM_PUBLISH_SAMPLES		0x0B	// Samples fanned out to subscribers, one datagram per client sensor batch
+#define DATAGRAM_REQ_SEND_RELAY			0x0C	// Gateway frame (COMM_CAP_RELAY): samples of many local clients, in blocks tagged with device id
+												// (answered with DATAGRAM_REP_ERROR without a relay session: the gateway handshakes again)
+#define DATAGRAM_REP_RELAY_OK			0x0D	// Acknowledges one frame by sequence (frames may be in flight together)
 #define DATAGRAM_REP_ERROR				0x0F
+#define DATAGRAM_CLUSTER_FORWARD		0x10	// Cluster node to client's owner node: client datagram, answered by the owner once processed
+#define DATAGRAM_CLUSTER_HEARTBEAT		0x11	// Cluster node liveness, sent to every other node (also when leaving the ring)
+#define DATAGRAM_CLUSTER_HANDOFF		0x12	// Client sessions handed to their new owner when the ring changes
+#define DATAGRAM_CLUSTER_REPORT			0x13	// Node statistics for one period, sent to the coordinator node
+#define DATAGRAM_CLUSTER_REPLY			0x14	// Owner node to the entry node of a forwarded datagram: its reply, sent on to the client from there
+
+// Handshake capabilities (DATAGRAM_REQ_COMM payload byte 0, echoed back in DATAGRAM_REP_COMM_OK when accepted)
+#define COMM_CAP_RATES_MS				0x01	// Rates in DATAGRAM_REP_COMM_OK as 32-bit milliseconds (otherwise 8-bit seconds)
+#define COMM_CAP_AGGREGATE				0x02	// Client sends window summaries, plus raw samples only around anomalies
+#define COMM_CAP_SENSOR_ID				0x04	// Client multiplexes several sensors, samples sent as DATAGRAM_REQ_SEND_TAGGED_DATA
+#define COMM_CAP_TRACE					0x08	// Client appends latency trace trailer to sample datagrams (clock offset from handshake stamps)
+#define COMM_CAP_CRC32C					0x10	// Datagrams after the handshake (both directions) end in a CRC32C checksum
+#define COMM_CAP_RATE_CONTROL			0x20	// Client applies rates piggybacked on DATAGRAM_REP_SEND_DATA_OK at runtime
+#define COMM_CAP_RELAY					0x40	// Client is a gateway relaying local clients' samples in DATAGRAM_REQ_SEND_RELAY frames
+#define COMM_CAP_TIMESTAMP_MS			0x80	// Sample timestamps and summary window starts in milliseconds, wrapping every 65.536 s (otherwise whole seconds)
+
+// End-Of-Package byte flags (protocol v2: byte after the declared message, 0 in v1)
+#define DATAGRAM_EOP_CRC32C				0x01	// Datagram ends in DATAGRAM_CRC_SIZE checksum bytes
 
 
 
 /* TYPE DEFINITIONS */
 
 typedef struct {
-    int sampling;
-    int server_stream;
-    int server_stats_calc;
+    int sampling;				// milliseconds
+    int server_stream;			// milliseconds
+    int server_stats_calc;		// milliseconds
 } timing_rates;
 
 
@@ -0,0 +1,153 @@
+/*
+ * admission.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset()
+
+#include "iot_codec.h"
+#include "admission.h"
+
+
+
+static admission_bucket*	admission_source	(admission_control* admission, uint32_t addr, uint16_t port, int64_t now_ns);
+static bool					bucket_take			(float* tokens, int64_t* refilled_ns, float rate, float burst, int64_t now_ns);
+
+
+
+void admission_init(admission_control* admission, float source_rate, float global_rate) {
+
+	memset(admission, 0, sizeof(*admission));
+	admission->source_rate = source_rate;
+	admission->source_burst = ADMISSION_SOURCE_BURST;
+	admission->global_rate = global_rate;
+	admission->global_burst = ADMISSION_GLOBAL_BURST;
+	admission->global_tokens = ADMISSION_GLOBAL_BURST;
+}
+
+
+
+/*
+ * Decides whether a received datagram is decoded and answered. Only the header is read: nothing is copied or parsed
+ * for rejected datagrams. Header checks always run (parsers rely on the declared length being received); rate limits
+ * only with a global rate set. Global tokens are only spent by datagrams their source's bucket allowed, so one
+ * flooding source cannot drain the budget of the others.
+ * returns true if datagram is admitted
+ */
+bool admission_admit(admission_control* admission, uint8_t* datagram, int length, struct sockaddr_in* client_addr, int64_t now_ns) {
+
+	if (length < DATAGRAM_HEADER_SIZE) {
+		admission->shed_malformed++;
+		return false;
+	}
+
+	int data_length = codec_datagram_length(datagram);
+	if (data_length > (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 1)) {
+		admission->shed_oversize++;
+		return false;
+	}
+	if ((DATAGRAM_HEADER_SIZE + data_length + 1) > length) {		// EOP flag included
+		admission->shed_malformed++;
+		return false;
+	}
+
+	switch(datagram[0]) {
+		case DATAGRAM_REQ_COMM:
+		case DATAGRAM_REQ_SEND_DATA:
+		case DATAGRAM_REQ_SEND_SUMMARY:
+		case DATAGRAM_REQ_SEND_TAGGED_DATA:
+		case DATAGRAM_REQ_QUERY_RANGE:
+		case DATAGRAM_REQ_SUBSCRIBE:
+		case DATAGRAM_REQ_SEND_RELAY:
+			break;
+		default:
+			admission->shed_unknown++;
+			return false;
+	}
+
+	if (admission->global_rate <= 0) {
+		admission->admitted++;
+		return true;
+	}
+
+	admission_bucket* bucket = admission_source(admission, client_addr->sin_addr.s_addr, client_addr->sin_port, now_ns);
+	if (!bucket_take(&bucket->tokens, &bucket->refilled_ns, admission->source_rate, admission->source_burst, now_ns)) {
+		admission->shed_source++;
+		return false;
+	}
+	if (!bucket_take(&admission->global_tokens, &admission->global_refilled_ns, admission->global_rate, admission->global_burst, now_ns)) {
+		admission->shed_global++;
+		return false;
+	}
+
+	admission->admitted++;
+	return true;
+}
+
+
+
+void admission_print_stats(admission_control* admission) {
+
+	unsigned long shed = admission->shed_malformed + admission->shed_oversize + admission->shed_unknown + admission->shed_source + admission->shed_global;
+	printf("IOT_SERVER: Admission: %lu admitted - %lu shed (malformed %lu, oversize %lu, unknown type %lu, source rate %lu, global rate %lu) - %lu source buckets reused\n",
+			admission->admitted, shed, admission->shed_malformed, admission->shed_oversize, admission->shed_unknown,
+			admission->shed_source, admission->shed_global, admission->replaced);
+}
+
+
+
+/*
+ * Set-associative lookup: a source missing from its set takes the bucket idle the longest, starting with a full burst
+ */
+static admission_bucket* admission_source(admission_control* admission, uint32_t addr, uint16_t port, int64_t now_ns) {
+
+	// 64-bit mix (splitmix64 finalizer) of address and port
+	uint64_t key = ((uint64_t) addr << 16) | port;
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	admission_bucket* set = &admission->buckets[((uint32_t) key & (ADMISSION_SETS - 1)) * ADMISSION_WAYS];
+
+	admission_bucket* oldest = &set[0];
+	int way;
+	for (way = 0; way < ADMISSION_WAYS; way++) {
+		if ((set[way].addr == addr) && (set[way].port == port) && (set[way].refilled_ns != 0))
+			return &set[way];
+		if (set[way].refilled_ns < oldest->refilled_ns)
+			oldest = &set[way];
+	}
+
+	if (oldest->refilled_ns != 0)
+		admission->replaced++;
+	oldest->addr = addr;
+	oldest->port = port;
+	oldest->tokens = admission->source_burst;
+	oldest->refilled_ns = now_ns;
+	return oldest;
+}
+
+
+
+/*
+ * Token bucket: refills at rate tokens per second up to burst, then takes one token if available
+ */
+static bool bucket_take(float* tokens, int64_t* refilled_ns, float rate, float burst, int64_t now_ns) {
+
+	if (now_ns > *refilled_ns) {
+		*tokens += (float) ((now_ns - *refilled_ns) / 1e9) * rate;
+		if (*tokens > burst)
+			*tokens = burst;
+		*refilled_ns = now_ns;
+	}
+
+	if (*tokens < 1)
+		return false;
+	*tokens -= 1;
+	return true;
+}
@@ -0,0 +1,72 @@
+/*
+ * admission.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef ADMISSION_H_
+#define ADMISSION_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <netinet/in.h>		// For sockaddr_in struct
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define ADMISSION_SETS				16384	// Source bucket sets (power of 2)
+#define ADMISSION_WAYS				4		// Buckets per set: a new source replaces the longest idle one
+#define ADMISSION_SOURCE_MIN_RATE	50		// Datagrams per second per source (at least client's maximum catch-up rate)
+#define ADMISSION_SOURCE_RATIO		4		// ...or this many times the streaming rate, if higher
+#define ADMISSION_SOURCE_BURST		64		// Datagrams a source may send back-to-back
+#define ADMISSION_GLOBAL_RATE		50000	// Datagrams per second admitted from all sources together
+#define ADMISSION_GLOBAL_BURST		1024
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	uint32_t	addr;				// Source IPv4 address (network order)
+	uint16_t	port;				// Source UDP port (network order)
+	float		tokens;
+	int64_t		refilled_ns;		// Monotonic time of last refill, idle age for replacement (0: unused)
+} admission_bucket;
+
+
+// Checks run in front of decoding, cheapest first: header sanity (no table access), source bucket, global bucket.
+// Rejected datagrams are dropped without reply, so a flood is never amplified.
+typedef struct {
+	admission_bucket	buckets		[ADMISSION_SETS * ADMISSION_WAYS];
+	float				source_rate;		// Tokens per second
+	float				source_burst;
+	float				global_rate;		// 0: no rate limits, header checks only
+	float				global_burst;
+	float				global_tokens;
+	int64_t				global_refilled_ns;
+
+	unsigned long		admitted;
+	unsigned long		shed_malformed;		// Shorter than header, or declared length past received bytes
+	unsigned long		shed_oversize;		// Declared length beyond a datagram
+	unsigned long		shed_unknown;		// Request type the server does not serve
+	unsigned long		shed_source;		// Source bucket empty
+	unsigned long		shed_global;		// Global budget exhausted
+	unsigned long		replaced;			// Idle source buckets reused for new sources
+} admission_control;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	admission_init			(admission_control* admission, float source_rate, float global_rate);
+bool	admission_admit			(admission_control* admission, uint8_t* datagram, int length, struct sockaddr_in* client_addr, int64_t now_ns);
+void	admission_print_stats	(admission_control* admission);
+
+
+
+#endif /* ADMISSION_H_ */
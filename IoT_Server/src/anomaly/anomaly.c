@@ -0,0 +1,253 @@
+/*
+ * anomaly.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf() and fprintf()
+#include <stdlib.h>			// For calloc() and free()
+#include <string.h>			// For strcmp()
+#include <math.h>			// For sqrtf() and sinf()
+#include <time.h>			// For clock_gettime()
+#include <arpa/inet.h>		// For inet_ntoa() and htonl()
+
+#include "anomaly.h"
+
+
+
+static const char* channel_names[DATAGRAM_CHANNELS] = { "clarity", "red", "green", "blue" };
+
+static anomaly_series*	anomaly_find		(anomaly_detector* detector, uint32_t addr, uint16_t port, uint8_t sensor, uint32_t now_secs);
+static void				anomaly_alert		(anomaly_detector* detector, anomaly_series* series, int channel, const char* kind, float value, float stddev, float z, int64_t arrival_ns);
+static double			anomaly_now_secs	(void);
+
+
+
+/*
+ * Table allocated up front; alert records go out line-buffered, so each one reaches the channel as it is raised
+ */
+int anomaly_init(anomaly_detector* detector, const char* alert_path) {
+
+	memset(detector, 0, sizeof(*detector));
+	detector->table = calloc(ANOMALY_TABLE_SLOTS, sizeof(anomaly_series));
+	if (detector->table == NULL)
+		return -1;
+	detector->table_mask = ANOMALY_TABLE_SLOTS - 1;
+
+	if (alert_path != NULL) {
+		detector->alerts = (strcmp(alert_path, "-") == 0) ? stdout : fopen(alert_path, "a");
+		if (detector->alerts == NULL) {
+			free(detector->table);
+			return -1;
+		}
+		setvbuf(detector->alerts, NULL, _IOLBF, 0);
+	}
+	return 0;
+}
+
+
+
+void anomaly_free(anomaly_detector* detector) {
+
+	if ((detector->alerts != NULL) && (detector->alerts != stdout))
+		fclose(detector->alerts);
+	free(detector->table);
+	detector->table = NULL;
+}
+
+
+
+/*
+ * Per channel: z-score against the EWMA estimates before this sample (spike), then two-sided CUSUM of z beyond
+ * the slack (drift, reset once raised). Both the CUSUM and the estimates take z capped at the spike threshold, so
+ * a lone outlier is one spike, not a drift, and does not drag the baseline.
+ */
+int anomaly_add_sample(anomaly_detector* detector, uint32_t addr, uint16_t port, uint8_t sensor, float values[DATAGRAM_CHANNELS], int64_t arrival_ns) {
+
+	anomaly_series* series = anomaly_find(detector, addr, port, sensor, (uint32_t) (arrival_ns / 1000000000LL));
+	if (series == NULL) {
+		detector->rejected++;
+		return 0;
+	}
+	detector->samples++;
+	series->samples++;
+
+	int n_alerts = 0;
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		anomaly_channel* state = &series->channels[channel];
+		float value = values[channel];
+
+		if (series->samples == 1) {
+			state->mean = value;
+			continue;
+		}
+
+		float stddev = sqrtf(state->variance);
+		if (stddev < ANOMALY_MIN_STDDEV)
+			stddev = ANOMALY_MIN_STDDEV;
+		float deviation = value - state->mean;
+		float z = deviation / stddev;
+		float capped = (z > ANOMALY_Z_SPIKE) ? ANOMALY_Z_SPIKE : ((z < -ANOMALY_Z_SPIKE) ? -ANOMALY_Z_SPIKE : z);
+
+		if (series->samples > ANOMALY_WARMUP) {
+			if ((z > ANOMALY_Z_SPIKE) || (z < -ANOMALY_Z_SPIKE)) {
+				anomaly_alert(detector, series, channel, "spike", value, stddev, z, arrival_ns);
+				detector->spikes++;
+				n_alerts++;
+			}
+
+			state->cusum_up += capped - ANOMALY_CUSUM_SLACK;
+			state->cusum_down += -capped - ANOMALY_CUSUM_SLACK;
+			if (state->cusum_up < 0)
+				state->cusum_up = 0;
+			if (state->cusum_down < 0)
+				state->cusum_down = 0;
+			if ((state->cusum_up > ANOMALY_CUSUM_LIMIT) || (state->cusum_down > ANOMALY_CUSUM_LIMIT)) {
+				anomaly_alert(detector, series, channel, (state->cusum_up > ANOMALY_CUSUM_LIMIT) ? "drift-up" : "drift-down", value, stddev, z, arrival_ns);
+				detector->drifts++;
+				n_alerts++;
+				state->cusum_up = 0;
+				state->cusum_down = 0;
+			}
+		}
+
+		deviation = capped * stddev;
+		float alpha = (series->samples <= ANOMALY_WARMUP) ? 1.0f / series->samples : ANOMALY_ALPHA;
+		state->mean += alpha * deviation;
+		state->variance = (1 - alpha) * (state->variance + (alpha * deviation * deviation));
+	}
+
+	return n_alerts;
+}
+
+
+
+void anomaly_print_stats(anomaly_detector* detector) {
+
+	printf("IOT_SERVER: Anomaly detection: %u series - %lu samples - %lu spikes - %lu drifts - %lu samples rejected (table full)\n",
+			detector->n_series, detector->samples, detector->spikes, detector->drifts, detector->rejected);
+}
+
+
+
+/*
+ * Pushes ANOMALY_BENCH_SAMPLES samples spread over n_clients sensors (noisy sine, occasional spikes), in an
+ * interleaved order as ingest sees them, and reports the cost per sample against a fleet streaming at ANOMALY_BENCH_RATE
+ */
+void anomaly_benchmark(int n_clients) {
+
+	anomaly_detector detector;
+	if ((n_clients <= 0) || (n_clients > (ANOMALY_TABLE_SLOTS * 3 / 4)) || (anomaly_init(&detector, NULL) < 0)) {
+		printf("IOT_SERVER: Could not set up anomaly detection for %d clients (up to %d)\n", n_clients, ANOMALY_TABLE_SLOTS * 3 / 4);
+		return;
+	}
+
+	int64_t arrival_ns = (int64_t) time(NULL) * 1000000000LL;
+	uint32_t random = 2463534242U;
+	float values[DATAGRAM_CHANNELS];
+	unsigned long alerts = 0, injected = 0;
+	long int sample;
+	double start = anomaly_now_secs();
+	for (sample = 0; sample < ANOMALY_BENCH_SAMPLES; sample++) {
+		uint32_t client = (uint32_t) (sample % n_clients);
+		long int step = sample / n_clients;
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		float noise = (float) (random & 0xFFFF) / 65535.0f - 0.5f;
+		float base = 50 + (20 * sinf((float) step * 0.01f)) + noise;
+		if ((random >> 16) == 0) {
+			base += 30;
+			injected++;
+		}
+		values[0] = base;
+		values[1] = base * 0.5f;
+		values[2] = base * 0.3f;
+		values[3] = base * 0.2f;
+		alerts += anomaly_add_sample(&detector, htonl(0x0A000000 | client), htons((uint16_t) (1024 + (client % 60000))), 0, values, arrival_ns);
+		arrival_ns += 1000000000LL / ANOMALY_BENCH_RATE / n_clients;
+	}
+	double secs = anomaly_now_secs() - start;
+
+	double per_sample_ns = secs * 1e9 / ANOMALY_BENCH_SAMPLES;
+	printf("IOT_SERVER: == Anomaly Detection Benchmark (%d clients, %d samples) ==\n", n_clients, ANOMALY_BENCH_SAMPLES);
+	printf("IOT_SERVER: >> %.1f ns per sample (4 channels) - %.0f samples/s - %lu alerts (%lu spikes, %lu drifts) for %lu injected spikes (on all 4 channels)\n",
+			per_sample_ns, ANOMALY_BENCH_SAMPLES / secs, alerts, detector.spikes, detector.drifts, injected);
+	printf("IOT_SERVER: >> %d clients at %d samples/s take %.2f %% of one core (%.0f such clients per core) - state %zu B per sensor\n",
+			n_clients, ANOMALY_BENCH_RATE, (double) n_clients * ANOMALY_BENCH_RATE * per_sample_ns / 1e7,
+			1e9 / (per_sample_ns * ANOMALY_BENCH_RATE), sizeof(anomaly_series));
+
+	anomaly_free(&detector);
+}
+
+
+
+/*
+ * Linear probing: returns the key's series, or claims the first idle series on its probe path (or the empty slot
+ * ending it) for a new one; NULL if the table is full
+ */
+static anomaly_series* anomaly_find(anomaly_detector* detector, uint32_t addr, uint16_t port, uint8_t sensor, uint32_t now_secs) {
+
+	// 64-bit mix (splitmix64 finalizer) of address, port and sensor
+	uint64_t key = ((uint64_t) addr << 24) | ((uint64_t) port << 8) | sensor;
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+
+	anomaly_series* idle = NULL;
+	uint32_t index = (uint32_t) key & detector->table_mask;
+	while (detector->table[index].in_use) {
+		anomaly_series* series = &detector->table[index];
+		if ((series->addr == addr) && (series->port == port) && (series->sensor == sensor)) {
+			series->last_secs = now_secs;
+			return series;
+		}
+		if ((idle == NULL) && ((now_secs - series->last_secs) > ANOMALY_IDLE_SECS))
+			idle = series;
+		index = (index + 1) & detector->table_mask;
+	}
+
+	if (idle == NULL) {
+		if (detector->n_series >= (ANOMALY_TABLE_SLOTS * 3 / 4))
+			return NULL;
+		idle = &detector->table[index];
+		detector->n_series++;
+	}
+	memset(idle, 0, sizeof(*idle));
+	idle->addr = addr;
+	idle->port = port;
+	idle->sensor = sensor;
+	idle->in_use = true;
+	idle->last_secs = now_secs;
+	return idle;
+}
+
+
+
+/*
+ * One line per alert: arrival time, client sensor, channel, kind, and the sample against its estimates
+ */
+static void anomaly_alert(anomaly_detector* detector, anomaly_series* series, int channel, const char* kind, float value, float stddev, float z, int64_t arrival_ns) {
+
+	if (detector->alerts == NULL)
+		return;
+
+	struct in_addr client_addr = { .s_addr = series->addr };
+	fprintf(detector->alerts, "%lld.%03d %s:%d sensor %d %s %s: value %.2f %% - mean %.2f %% - stddev %.2f %% - z %.1f\n",
+			(long long) (arrival_ns / 1000000000LL), (int) ((arrival_ns / 1000000LL) % 1000), inet_ntoa(client_addr), ntohs(series->port),
+			series->sensor, channel_names[channel], kind, value, series->channels[channel].mean, stddev, z);
+}
+
+
+
+static double anomaly_now_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
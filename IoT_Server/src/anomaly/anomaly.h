@@ -0,0 +1,83 @@
+/*
+ * anomaly.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef ANOMALY_H_
+#define ANOMALY_H_
+
+
+#include <stdio.h>			// For FILE
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+
+#include "iot_lib.h"
+#include "registry/client_registry.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define ANOMALY_TABLE_SLOTS		65536		// Client sensors tracked (power of 2); filled up to 3/4
+#define ANOMALY_IDLE_SECS		REGISTRY_IDLE_TIMEOUT_SECS	// Series without samples for this long give their slot to new ones
+#define ANOMALY_ALPHA			0.05		// EWMA weight of each new sample (memory of about 20 samples)
+#define ANOMALY_WARMUP			20			// Samples learnt before alerting (weight 1/n meanwhile)
+#define ANOMALY_Z_SPIKE			4.0			// |z| beyond this is a spike; also caps how far one sample moves the estimates
+#define ANOMALY_CUSUM_SLACK		1.5			// CUSUM allowance k, in standard deviations (tracking a steady ramp settles at z ~1.03)
+#define ANOMALY_CUSUM_LIMIT		8.0			// CUSUM decision threshold h, in standard deviations
+#define ANOMALY_MIN_STDDEV		0.05		// Standard deviation floor (percent): flat signals do not alert on quantization
+#define ANOMALY_BENCH_SAMPLES	10000000	// Samples pushed by anomaly_benchmark()
+#define ANOMALY_BENCH_RATE		100			// Samples per second per client assumed to size the benchmark's verdict
+
+
+
+/* TYPE DEFINITIONS */
+
+// EWMA mean and variance of one color channel, and its two-sided CUSUM of standardized deviations
+typedef struct {
+	float		mean;
+	float		variance;
+	float		cusum_up;
+	float		cusum_down;
+} anomaly_channel;
+
+
+// One client sensor: open-addressing table slot keyed by client address, port and sensor id
+typedef struct {
+	uint32_t		addr;				// Network order
+	uint16_t		port;				// Network order
+	uint8_t			sensor;
+	bool			in_use;
+	uint32_t		samples;
+	uint32_t		last_secs;			// Arrival of last sample (unix seconds)
+	anomaly_channel	channels	[DATAGRAM_CHANNELS];
+} anomaly_series;
+
+
+typedef struct {
+	anomaly_series*	table;
+	uint32_t		table_mask;
+	FILE*			alerts;				// Alert records, line-buffered (NULL: counted only)
+	uint32_t		n_series;
+
+	unsigned long	samples;
+	unsigned long	spikes;
+	unsigned long	drifts;
+	unsigned long	rejected;			// Samples of new series refused because the table was full
+} anomaly_detector;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		anomaly_init			(anomaly_detector* detector, const char* alert_path);	// "-": stdout, NULL: no records; returns -1 on failure
+void	anomaly_free			(anomaly_detector* detector);
+int		anomaly_add_sample		(anomaly_detector* detector, uint32_t addr, uint16_t port, uint8_t sensor, float values[DATAGRAM_CHANNELS], int64_t arrival_ns);	// returns alerts raised
+void	anomaly_print_stats		(anomaly_detector* detector);
+void	anomaly_benchmark		(int n_clients);
+
+
+
+#endif /* ANOMALY_H_ */
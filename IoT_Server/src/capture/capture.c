@@ -0,0 +1,109 @@
+/*
+ * capture.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For fopen() and fwrite()
+#include <string.h>			// For memcmp()
+
+#include "iot_lib.h"
+#include "capture.h"
+
+
+
+/**
+ * capture_open_write
+ * opens capture file for appending, writing the file header if the file is new
+ * returns NULL if the file cannot be opened
+ */
+FILE* capture_open_write(const char* path) {
+
+	FILE* capture_file = fopen(path, "ab");
+	if (capture_file == NULL)
+		return NULL;
+
+	/* New (empty) file: write header before first record */
+	fseek(capture_file, 0, SEEK_END);
+	if (ftell(capture_file) == 0) {
+		capture_file_header header;
+		memcpy(header.magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+		header.version = CAPTURE_VERSION;
+		if (fwrite(&header, sizeof(header), 1, capture_file) != 1) {
+			fclose(capture_file);
+			return NULL;
+		}
+	}
+
+	printf("IOT_SERVER: Capturing datagrams into %s\n", path);
+	return capture_file;
+}
+
+
+
+/**
+ * capture_open_read
+ * opens capture file for replay and validates its header
+ * returns NULL if the file cannot be opened or is not a capture file
+ */
+FILE* capture_open_read(const char* path) {
+
+	FILE* capture_file = fopen(path, "rb");
+	if (capture_file == NULL)
+		return NULL;
+
+	capture_file_header header;
+	if ((fread(&header, sizeof(header), 1, capture_file) != 1)
+			|| (memcmp(header.magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0)
+			|| (header.version != CAPTURE_VERSION)) {
+		fclose(capture_file);
+		return NULL;
+	}
+
+	return capture_file;
+}
+
+
+
+/**
+ * capture_append
+ * appends one raw datagram with its arrival time and client address
+ * returns 0 on success, -1 on write failure
+ */
+int capture_append(FILE* capture_file, struct timespec* arrival, struct sockaddr_in* client_addr, uint8_t* datagram, int length) {
+
+	capture_record_header record;
+	record.timestamp_ns = ((int64_t) arrival->tv_sec * 1000000000LL) + arrival->tv_nsec;
+	record.addr = client_addr->sin_addr.s_addr;
+	record.port = client_addr->sin_port;
+	record.length = (uint16_t) length;
+
+	if ((fwrite(&record, sizeof(record), 1, capture_file) != 1)
+			|| (fwrite(datagram, 1, length, capture_file) != (size_t) length))
+		return -1;
+
+	return 0;
+}
+
+
+
+/**
+ * capture_next
+ * reads next record from capture file into record header and datagram buffer (DATAGRAM_SIZE bytes)
+ * returns datagram length, 0 at end of file, -1 for a truncated or corrupt record
+ */
+int capture_next(FILE* capture_file, capture_record_header* record, uint8_t* datagram) {
+
+	if (fread(record, sizeof(*record), 1, capture_file) != 1)
+		return feof(capture_file) ? 0 : -1;
+
+	if (record->length > DATAGRAM_SIZE)
+		return -1;
+
+	if (fread(datagram, 1, record->length, capture_file) != record->length)
+		return -1;
+
+	return (int) record->length;
+}
@@ -0,0 +1,55 @@
+/*
+ * capture.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+
+#include <stdio.h>			// For FILE
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <time.h>			// For timespec struct
+#include <netinet/in.h>		// For sockaddr_in struct
+
+
+
+/* MACROS AND CONSTANTS */
+
+// Capture file layout: file header, then (record header + raw datagram) per received datagram.
+// All record header fields are stored in host byte order except address and port (network order, as received).
+#define CAPTURE_MAGIC				"IOTCAP"
+#define CAPTURE_MAGIC_SIZE			6
+#define CAPTURE_VERSION				1
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	char		magic[CAPTURE_MAGIC_SIZE];
+	uint16_t	version;
+} capture_file_header;
+
+
+typedef struct {
+	int64_t		timestamp_ns;	// Arrival time (CLOCK_REALTIME)
+	uint32_t	addr;			// Client IPv4 address (network order)
+	uint16_t	port;			// Client UDP port (network order)
+	uint16_t	length;			// Raw datagram length in bytes
+} capture_record_header;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+FILE*	capture_open_write		(const char* path);
+FILE*	capture_open_read		(const char* path);
+int		capture_append			(FILE* capture_file, struct timespec* arrival, struct sockaddr_in* client_addr, uint8_t* datagram, int length);
+int		capture_next			(FILE* capture_file, capture_record_header* record, uint8_t* datagram);
+
+
+
+#endif /* CAPTURE_H_ */
@@ -0,0 +1,217 @@
+/*
+ * replay.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For exit code
+#include <string.h>			// For memset()
+#include <time.h>			// For clock_gettime() and clock_nanosleep()
+#include <unistd.h>			// For close()
+#include <sys/socket.h>		// For socket()
+#include <arpa/inet.h>		// For inet_aton()
+
+#include "iot_lib.h"
+#include "iot_server.h"
+#include "capture.h"
+#include "replay.h"
+
+
+
+static int64_t	replay_now_ns		(void);
+static int		replay_socket_init	(struct sockaddr_in* server_addr);
+static int		replay_samples		(uint8_t* buffer_recv, int recv_len);
+
+
+
+/**
+ * replay_run
+ * pushes every datagram of the capture file through the server processing path, either
+ * in-process (decode, reply build, save and stats) or over UDP to a running server (-u).
+ * Pacing follows capture timestamps divided by replay speed; speed 0 replays as fast as possible.
+ */
+void replay_run(server_options* options, timing_rates* timings, server_state* state) {
+
+	/* STEP 1 - Open capture file and, for socket replay, the UDP socket */
+
+	FILE* capture_file = capture_open_read(options->replay_path);
+	if (capture_file == NULL) {
+		print_error_server(7);
+		exit(EXIT_FAILURE);
+	}
+
+	struct sockaddr_in server_addr;
+	int replay_socket = -1;
+	if (options->replay_socket)
+		replay_socket = replay_socket_init(&server_addr);
+
+	printf("IOT_SERVER: Replaying %s at %s speed %.2f (%s)\n", options->replay_path,
+			(options->replay_speed > 0) ? "x" : "maximum", options->replay_speed,
+			options->replay_socket ? "UDP socket" : "in-process");
+
+
+	/* STEP 2 - Push records through processing path */
+
+	capture_record_header record;
+	uint8_t buffer_recv[DATAGRAM_SIZE] = {'\0'};
+	uint8_t buffer_reply[DATAGRAM_SIZE];
+
+	long int n_datagrams = 0, n_samples = 0, n_bytes = 0, n_lost = 0;
+	int64_t first_capture_ns = 0, stats_capture_ns = 0, last_capture_ns = 0;
+	int64_t start_ns = replay_now_ns();
+
+	int recv_len;
+	while ((recv_len = capture_next(capture_file, &record, buffer_recv)) > 0) {
+
+		if (n_datagrams == 0) {
+			first_capture_ns = record.timestamp_ns;
+			stats_capture_ns = record.timestamp_ns;
+		}
+		last_capture_ns = record.timestamp_ns;
+
+		// Pace against capture timeline (absolute deadlines, so processing time does not drift)
+		if (options->replay_speed > 0) {
+			int64_t deadline_ns = start_ns + (int64_t) ((record.timestamp_ns - first_capture_ns) / options->replay_speed);
+			struct timespec deadline = { deadline_ns / 1000000000LL, deadline_ns % 1000000000LL };
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+		}
+
+		if (replay_socket >= 0) {
+			sendto(replay_socket, buffer_recv, recv_len, 0, (struct sockaddr *) &server_addr, sizeof(server_addr));
+			if (recvfrom(replay_socket, buffer_reply, DATAGRAM_SIZE, 0, NULL, NULL) < 0)
+				n_lost++;
+			n_samples += replay_samples(buffer_recv, recv_len);
+		} else {
+			// Statistics follow capture time, as the live timer would have
+			if ((record.timestamp_ns - stats_capture_ns) >= ((int64_t) timings->server_stats_calc * 1000000LL)) {
+				server_stats_flush(state, record.timestamp_ns);
+				stats_capture_ns = record.timestamp_ns;
+			}
+
+			memset(buffer_reply, 0, DATAGRAM_SIZE);
+			server_build_reply(buffer_recv, buffer_reply, timings);
+
+			// Client registry and range index on capture time, with the source recorded for each datagram
+			struct sockaddr_in client_addr;
+			memset(&client_addr, 0, sizeof(client_addr));
+			client_addr.sin_addr.s_addr = record.addr;
+			client_addr.sin_port = record.port;
+			int record_samples = server_process_datagram(state, buffer_recv, recv_len, &client_addr, record.timestamp_ns);
+			n_samples += record_samples;
+			server_track_client(state, &client_addr, buffer_recv, record_samples, (uint32_t) (record.timestamp_ns / 1000000000LL), timings);
+		}
+
+		n_datagrams++;
+		n_bytes += recv_len;
+
+		// A shorter record next must not leave this one's bytes past its end, as a fresh receive would not
+		memset(buffer_recv, 0, recv_len);
+	}
+
+	if (recv_len < 0)
+		print_error_server(7);
+
+	if (replay_socket < 0)
+		server_stats_flush(state, last_capture_ns);
+
+
+	/* STEP 3 - Report replay throughput */
+
+	double elapsed_secs = (double) (replay_now_ns() - start_ns) / 1e9;
+	if (elapsed_secs <= 0)
+		elapsed_secs = 1e-9;
+
+	printf("IOT_SERVER: == Replay Summary ==\n");
+	printf("IOT_SERVER: >> %ld datagrams (%ld bytes, %ld samples) in %.3f s\n", n_datagrams, n_bytes, n_samples, elapsed_secs);
+	printf("IOT_SERVER: >> %.0f datagrams/s - %.0f samples/s - %.2f MB/s\n",
+			n_datagrams / elapsed_secs, n_samples / elapsed_secs, n_bytes / elapsed_secs / 1e6);
+	if (replay_socket >= 0) {
+		printf("IOT_SERVER: >> %ld datagrams without reply\n", n_lost);
+		close(replay_socket);
+	}
+
+	fclose(capture_file);
+}
+
+
+
+/**
+ * replay_now_ns
+ * returns monotonic clock in nanoseconds
+ */
+static int64_t replay_now_ns(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+
+
+/**
+ * replay_samples
+ * counts samples of a datagram sent to a running server as in-process replay counts them (server_process_datagram):
+ * raw and tagged samples of known sensors, and samples represented by window summaries; relay frames count none
+ * (their samples are counted on the relayed devices)
+ */
+static int replay_samples(uint8_t* buffer_recv, int recv_len) {
+
+	int n_samples = 0;
+	int record, n_records;
+	switch(codec_header_get_type(buffer_recv)) {
+		case DATAGRAM_REQ_SEND_DATA:
+			n_samples = codec_datagram_records(buffer_recv, recv_len, DATAGRAM_SAMPLE_SIZE);
+			break;
+
+		case DATAGRAM_REQ_SEND_TAGGED_DATA:
+			n_records = codec_datagram_records(buffer_recv, recv_len, DATAGRAM_TAGGED_SAMPLE_SIZE);
+			for (record = 0; record < n_records; record++) {
+				if (codec_tagged_sample_get_sensor(codec_at(codec_datagram_payload(buffer_recv), record, DATAGRAM_TAGGED_SAMPLE_SIZE)) < DATAGRAM_MAX_SENSORS)
+					n_samples++;
+			}
+			break;
+
+		case DATAGRAM_REQ_SEND_SUMMARY:
+			n_records = codec_datagram_records(buffer_recv, recv_len, DATAGRAM_SUMMARY_SIZE);
+			for (record = 0; record < n_records; record++) {
+				uint8_t* summary = codec_at(codec_datagram_payload(buffer_recv), record, DATAGRAM_SUMMARY_SIZE);
+				if (codec_summary_get_sensor(summary) < DATAGRAM_MAX_SENSORS)
+					n_samples += (int) codec_summary_get_count(summary);
+			}
+			break;
+	}
+
+	return n_samples;
+}
+
+
+
+/**
+ * replay_socket_init
+ * returns UDP socket descriptor to push replayed datagrams to a running server
+ */
+static int replay_socket_init(struct sockaddr_in* server_addr) {
+
+	int replay_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (replay_socket < 0) {
+		print_error_server(1);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Do not wait for a lost reply longer than 1 second */
+	struct timeval intervals = { 1, 0 };
+	if (setsockopt(replay_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals)) < 0) {
+		print_error_server(5);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(server_addr, 0, sizeof(*server_addr));
+	server_addr->sin_family = AF_INET;
+	server_addr->sin_port = htons(SERVER_PORT);
+	inet_aton(REPLAY_SOCKET_ADDR, &server_addr->sin_addr);
+
+	return replay_socket;
+}
@@ -0,0 +1,29 @@
+/*
+ * replay.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+
+#include "iot_lib.h"
+#include "iot_server.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define REPLAY_SOCKET_ADDR		"127.0.0.1"		// Running server targeted by socket replay (-u)
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	replay_run		(server_options* options, timing_rates* timings, server_state* state);
+
+
+
+#endif /* REPLAY_H_ */
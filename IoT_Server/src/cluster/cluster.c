@@ -0,0 +1,722 @@
+/*
+ * cluster.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For qsort()
+#include <string.h>			// For memset()
+#include <time.h>			// For clock_gettime()
+#include <sys/socket.h>		// For sendto()
+#include <arpa/inet.h>		// For inet_aton()
+
+#include "iot_codec.h"
+#include "cluster.h"
+
+
+
+static int		cluster_send			(cluster_node* cluster, int member, uint8_t* datagram, int data_length);
+static void		cluster_heartbeat		(cluster_node* cluster, uint8_t status);
+static void		cluster_rebuild			(cluster_node* cluster);
+static void		cluster_handoff			(cluster_node* cluster);
+static void		cluster_take_over		(cluster_node* cluster, uint8_t* datagram, int64_t now_ms);
+static void		cluster_wrap			(uint8_t* wrapped, uint8_t type, struct sockaddr_in* client_addr, uint8_t* datagram, int length);
+static void		cluster_store_report	(cluster_node* cluster, int member, uint8_t* datagram);
+static void		cluster_merge_reports	(cluster_node* cluster);
+static int		cluster_member_of		(cluster_node* cluster, struct sockaddr_in* addr);
+static int		cluster_owner			(cluster_node* cluster, uint32_t addr, uint16_t port);
+static int		cluster_coordinator		(cluster_node* cluster);
+static double	cluster_share			(cluster_node* cluster);
+static uint32_t	cluster_hash			(uint32_t addr, uint16_t port, uint32_t salt);
+static int		cluster_point_compare	(const void* a, const void* b);
+
+
+
+/*
+ * Parses member list "<ip>:<port>,<ip>:<port>,...", this node first (its port is the one served)
+ */
+int cluster_init(cluster_node* cluster, char* members, client_registry* registry) {
+
+	memset(cluster, 0, sizeof(*cluster));
+	cluster->registry = registry;
+	cluster->self = 0;
+
+	char* cursor = members;
+	while ((cursor != NULL) && (*cursor != '\0')) {
+		char member_ip[32];
+		int member_port;
+		if ((cluster->n_members == CLUSTER_MAX_NODES) || (sscanf(cursor, "%31[^:,]:%d", member_ip, &member_port) != 2)
+				|| (member_port < 1) || (member_port > 65535))
+			return -1;
+
+		struct sockaddr_in* addr = &cluster->members[cluster->n_members].addr;
+		addr->sin_family = AF_INET;
+		addr->sin_port = htons((uint16_t) member_port);
+		if ((inet_aton(member_ip, &addr->sin_addr) == 0) || (cluster_member_of(cluster, addr) >= 0))
+			return -1;
+		cluster->n_members++;
+
+		cursor = strchr(cursor, ',');
+		if (cursor != NULL)
+			cursor++;
+	}
+
+	if (cluster->n_members < 1)
+		return -1;
+	cluster->members[cluster->self].live = true;
+	return 0;
+}
+
+
+
+/*
+ * Starts alone in the ring: other members join it as their heartbeats arrive (the first ones are sent right away)
+ */
+void cluster_start(cluster_node* cluster, int server_socket, int64_t now_ms) {
+
+	cluster->server_socket = server_socket;
+	cluster->heartbeat_ms = now_ms;
+	cluster_rebuild(cluster);
+}
+
+
+
+bool cluster_frame(uint8_t* datagram) {
+
+	return (datagram[0] >= DATAGRAM_CLUSTER_FORWARD) && (datagram[0] <= DATAGRAM_CLUSTER_REPLY);
+}
+
+
+
+bool cluster_is_member(cluster_node* cluster, struct sockaddr_in* addr) {
+
+	return cluster_member_of(cluster, addr) >= 0;
+}
+
+
+
+/*
+ * Handles a datagram from another member: heartbeats, handoffs and reports are consumed, replies to datagrams this
+ * node forwarded are sent on to their client, a forwarded client datagram is unwrapped in place (source_addr
+ * rewritten to its client's, its entry node kept for the reply)
+ * returns length of the client datagram unwrapped (0: consumed)
+ */
+int cluster_receive(cluster_node* cluster, uint8_t* datagram, int length, struct sockaddr_in* source_addr, int64_t now_ms) {
+
+	int member = cluster_member_of(cluster, source_addr);
+	int data_length = codec_datagram_length(datagram);
+	if ((member < 0) || (member == cluster->self) || (length < (DATAGRAM_HEADER_SIZE + data_length + 1))) {
+		cluster->rejected++;
+		return 0;
+	}
+
+	switch(datagram[0]) {
+		case DATAGRAM_CLUSTER_FORWARD: {
+			int inner_length = data_length - DATAGRAM_FORWARD_SIZE;
+			if ((inner_length < (DATAGRAM_HEADER_SIZE + 1)) || (inner_length > DATAGRAM_SIZE)) {
+				cluster->rejected++;
+				return 0;
+			}
+			uint8_t* forward = codec_datagram_payload(datagram);
+			memset(source_addr, 0, sizeof(*source_addr));
+			source_addr->sin_family = AF_INET;
+			source_addr->sin_addr.s_addr = codec_load_addr(codec_forward_addr(forward));
+			source_addr->sin_port = codec_load_port(codec_forward_port(forward));
+			memmove(datagram, &forward[DATAGRAM_FORWARD_SIZE], inner_length);
+			memset(&datagram[inner_length], 0, length - inner_length);
+
+			cluster->entry = member;
+			cluster->received++;
+			if ((datagram[0] != DATAGRAM_REQ_QUERY_RANGE) && !cluster_owns(cluster, source_addr->sin_addr.s_addr, source_addr->sin_port))
+				cluster->misrouted++;
+			return inner_length;
+		}
+
+		case DATAGRAM_CLUSTER_REPLY: {
+			int inner_length = data_length - DATAGRAM_FORWARD_SIZE;
+			if ((inner_length < (DATAGRAM_HEADER_SIZE + 1)) || (inner_length > DATAGRAM_SIZE)) {
+				cluster->rejected++;
+				break;
+			}
+			uint8_t* reply = codec_datagram_payload(datagram);
+			struct sockaddr_in client_addr;
+			memset(&client_addr, 0, sizeof(client_addr));
+			client_addr.sin_family = AF_INET;
+			client_addr.sin_addr.s_addr = codec_load_addr(codec_forward_addr(reply));
+			client_addr.sin_port = codec_load_port(codec_forward_port(reply));
+			if (sendto(cluster->server_socket, &reply[DATAGRAM_FORWARD_SIZE], inner_length, 0, (struct sockaddr *) &client_addr, sizeof(client_addr)) < 0)
+				cluster->unsent++;
+			else
+				cluster->relayed++;
+			break;
+		}
+
+		case DATAGRAM_CLUSTER_HEARTBEAT:
+			if (data_length < DATAGRAM_HEARTBEAT_SIZE)
+				break;
+			if (codec_datagram_payload(datagram)[0] == CLUSTER_NODE_LEAVING) {
+				if (cluster->members[member].live) {
+					cluster->members[member].live = false;
+					cluster->ring_changed = true;
+					printf("IOT_SERVER: Cluster node %s:%d left the ring\n", inet_ntoa(source_addr->sin_addr), ntohs(source_addr->sin_port));
+				}
+			} else {
+				cluster->members[member].heard_ms = now_ms;
+				if (!cluster->members[member].live) {
+					// Welcomed at once, so a joining node learns the ring within a round-trip
+					cluster->members[member].live = true;
+					cluster->ring_changed = true;
+					printf("IOT_SERVER: Cluster node %s:%d joined the ring\n", inet_ntoa(source_addr->sin_addr), ntohs(source_addr->sin_port));
+					uint8_t heartbeat[DATAGRAM_HEADER_SIZE + DATAGRAM_HEARTBEAT_SIZE + 1] = { DATAGRAM_CLUSTER_HEARTBEAT, DATAGRAM_HEARTBEAT_SIZE, 0x00, CLUSTER_NODE_ALIVE, 0x00 };
+					cluster_send(cluster, member, heartbeat, DATAGRAM_HEARTBEAT_SIZE);
+				}
+			}
+			break;
+
+		case DATAGRAM_CLUSTER_HANDOFF:
+			if ((data_length >= 1) && (data_length >= (1 + (codec_datagram_payload(datagram)[0] * DATAGRAM_HANDOFF_RECORD_SIZE))))
+				cluster_take_over(cluster, datagram, now_ms);
+			else
+				cluster->rejected++;
+			break;
+
+		case DATAGRAM_CLUSTER_REPORT:
+			if ((data_length >= DATAGRAM_REPORT_HEADER_SIZE)
+					&& (data_length >= (DATAGRAM_REPORT_HEADER_SIZE + (codec_report_header_get_n_sensors(codec_datagram_payload(datagram)) * DATAGRAM_REPORT_SENSOR_SIZE))))
+				cluster_store_report(cluster, member, datagram);
+			else
+				cluster->rejected++;
+			break;
+	}
+
+	return 0;
+}
+
+
+
+bool cluster_owns(cluster_node* cluster, uint32_t addr, uint16_t port) {
+
+	return cluster_owner(cluster, addr, port) == cluster->self;
+}
+
+
+
+/*
+ * Wraps client's datagram (trailers included: checksum verified again by the owner) and sends it to the owner of
+ * key (the client itself, or the client a range query is about). The client is only acknowledged by the owner, once
+ * the datagram is processed there (cluster_reply): a forward lost between nodes leaves it unacknowledged, and the
+ * client retries it from its spool as from a single server
+ */
+void cluster_forward(cluster_node* cluster, uint8_t* datagram, int length, struct sockaddr_in* client_addr, uint32_t key_addr, uint16_t key_port) {
+
+	int owner = cluster_owner(cluster, key_addr, key_port);
+	if ((owner == cluster->self) || (length > DATAGRAM_SIZE))
+		return;
+
+	uint8_t forward[DATAGRAM_CLUSTER_SIZE];
+	cluster_wrap(forward, DATAGRAM_CLUSTER_FORWARD, client_addr, datagram, length);
+	if (cluster_send(cluster, owner, forward, DATAGRAM_FORWARD_SIZE + length) < 0)
+		cluster->unsent++;
+	else
+		cluster->forwarded++;
+}
+
+
+
+/*
+ * Sends the reply to the last forwarded datagram back to the node it entered through, which sends it on to client
+ * returns number of bytes sent (-1: not sent)
+ */
+int cluster_reply(cluster_node* cluster, struct sockaddr_in* client_addr, uint8_t* reply, int length) {
+
+	if ((cluster->entry == cluster->self) || (length > DATAGRAM_SIZE))
+		return -1;
+
+	uint8_t wrapped[DATAGRAM_CLUSTER_SIZE];
+	cluster_wrap(wrapped, DATAGRAM_CLUSTER_REPLY, client_addr, reply, length);
+	int send_len = cluster_send(cluster, cluster->entry, wrapped, DATAGRAM_FORWARD_SIZE + length);
+	if (send_len < 0)
+		cluster->unsent++;
+	else
+		cluster->replied++;
+	return send_len;
+}
+
+
+
+/*
+ * Sends heartbeats, drops members not heard for CLUSTER_DEAD_MS and rebuilds the ring if membership changed
+ */
+void cluster_tick(cluster_node* cluster, int64_t now_ms) {
+
+	if (now_ms >= cluster->heartbeat_ms) {
+		cluster_heartbeat(cluster, CLUSTER_NODE_ALIVE);
+		cluster->heartbeat_ms = now_ms + CLUSTER_HEARTBEAT_MS;
+
+		int member;
+		for (member = 0; member < cluster->n_members; member++) {
+			if ((member != cluster->self) && cluster->members[member].live && ((now_ms - cluster->members[member].heard_ms) > CLUSTER_DEAD_MS)) {
+				cluster->members[member].live = false;
+				cluster->ring_changed = true;
+				printf("IOT_SERVER: Cluster node %s:%d not heard for %d ms: out of the ring\n",
+						inet_ntoa(cluster->members[member].addr.sin_addr), ntohs(cluster->members[member].addr.sin_port), CLUSTER_DEAD_MS);
+			}
+		}
+	}
+
+	if (cluster->ring_changed)
+		cluster_rebuild(cluster);
+}
+
+
+
+void cluster_report_sensor(cluster_node* cluster, int sensor, uint32_t count, float* minimum, float* mean, float* maximum) {
+
+	cluster_report* report = &cluster->members[cluster->self].report;
+	report->count[sensor] = count;
+	memcpy(report->minimum[sensor], minimum, sizeof(report->minimum[sensor]));
+	memcpy(report->mean[sensor], mean, sizeof(report->mean[sensor]));
+	memcpy(report->maximum[sensor], maximum, sizeof(report->maximum[sensor]));
+}
+
+
+
+/*
+ * Closes this node's report for the period: the coordinator merges it with the reports received since its previous
+ * period and prints fleet-wide statistics, other nodes send it to the coordinator
+ */
+void cluster_report_send(cluster_node* cluster, uint32_t n_clients) {
+
+	cluster_report* report = &cluster->members[cluster->self].report;
+	report->received = true;
+	report->n_clients = n_clients;
+	report->n_samples = 0;
+	int sensor;
+	for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++)
+		report->n_samples += report->count[sensor];
+
+	int coordinator = cluster_coordinator(cluster);
+	if (coordinator == cluster->self) {
+		cluster_merge_reports(cluster);
+		return;
+	}
+
+	uint8_t datagram[DATAGRAM_SIZE];
+	uint8_t* payload = codec_datagram_payload(datagram);
+	codec_header_set_type(datagram, DATAGRAM_CLUSTER_REPORT);
+	codec_report_header_set_n_clients(payload, report->n_clients);
+	codec_report_header_set_n_samples(payload, report->n_samples);
+	int n_sensors = 0;
+	for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+		if (report->count[sensor] == 0)
+			continue;
+		uint8_t* record = codec_at(payload + DATAGRAM_REPORT_HEADER_SIZE, n_sensors++, DATAGRAM_REPORT_SENSOR_SIZE);
+		codec_report_sensor_set_sensor(record, (uint8_t) sensor);
+		codec_report_sensor_set_count(record, report->count[sensor]);
+		int channel;
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+			uint8_t* values = codec_report_sensor_channel(record, channel);
+			codec_report_channel_set_minimum(values, codec_float_bits(report->minimum[sensor][channel]));
+			codec_report_channel_set_mean(values, codec_float_bits(report->mean[sensor][channel]));
+			codec_report_channel_set_maximum(values, codec_float_bits(report->maximum[sensor][channel]));
+		}
+	}
+	codec_report_header_set_n_sensors(payload, (uint8_t) n_sensors);
+	cluster_send(cluster, coordinator, datagram, DATAGRAM_REPORT_HEADER_SIZE + (n_sensors * DATAGRAM_REPORT_SENSOR_SIZE));
+	memset(report, 0, sizeof(*report));
+}
+
+
+
+/*
+ * Leaves the ring on shutdown: members are told at once (no CLUSTER_DEAD_MS wait) and sessions go to their next owners
+ */
+void cluster_leave(cluster_node* cluster) {
+
+	cluster_heartbeat(cluster, CLUSTER_NODE_LEAVING);
+	cluster->members[cluster->self].live = false;
+	cluster_rebuild(cluster);
+}
+
+
+
+/*
+ * returns monotonic clock in milliseconds (same base as client registry's seconds)
+ */
+int64_t cluster_now_ms(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+
+
+void cluster_print_stats(cluster_node* cluster) {
+
+	int n_live = 0;
+	int member;
+	for (member = 0; member < cluster->n_members; member++)
+		n_live += cluster->members[member].live;
+	struct sockaddr_in* coordinator = &cluster->members[cluster_coordinator(cluster)].addr;
+
+	printf("IOT_SERVER: Cluster: %d/%d nodes live - owning %.1f %% of clients - coordinator %s:%d - %lu forwarded - %lu received (%lu misrouted)"
+			" - %lu replied - %lu relayed - %lu unsent - %lu sessions handed off - %lu taken over - %lu ring changes - %lu rejected\n",
+			n_live, cluster->n_members, cluster_share(cluster) * 100, inet_ntoa(coordinator->sin_addr), ntohs(coordinator->sin_port),
+			cluster->forwarded, cluster->received, cluster->misrouted, cluster->replied, cluster->relayed, cluster->unsent,
+			cluster->handed_off, cluster->taken_over, cluster->ring_changes, cluster->rejected);
+}
+
+
+
+static int cluster_send(cluster_node* cluster, int member, uint8_t* datagram, int data_length) {
+
+	codec_datagram_begin(datagram, codec_header_get_type(datagram), data_length);
+	return (int) sendto(cluster->server_socket, datagram, DATAGRAM_HEADER_SIZE + data_length + 1, 0,
+			(struct sockaddr *) &cluster->members[member].addr, sizeof(cluster->members[member].addr));
+}
+
+
+
+/*
+ * Heartbeats go to every other member, live or not: that is how members out of the ring find out it is back
+ */
+static void cluster_heartbeat(cluster_node* cluster, uint8_t status) {
+
+	int member;
+	for (member = 0; member < cluster->n_members; member++) {
+		if (member == cluster->self)
+			continue;
+		uint8_t heartbeat[DATAGRAM_HEADER_SIZE + DATAGRAM_HEARTBEAT_SIZE + 1] = { DATAGRAM_CLUSTER_HEARTBEAT, DATAGRAM_HEARTBEAT_SIZE, 0x00, status, 0x00 };
+		cluster_send(cluster, member, heartbeat, DATAGRAM_HEARTBEAT_SIZE);
+	}
+}
+
+
+
+/*
+ * Places CLUSTER_VNODES points of every live member on the ring: a member joining or leaving only moves the clients
+ * between its points and their predecessors, about 1/n of them, taken from (or given to) every other member evenly
+ */
+static void cluster_rebuild(cluster_node* cluster) {
+
+	cluster->n_points = 0;
+	int member;
+	for (member = 0; member < cluster->n_members; member++) {
+		if (!cluster->members[member].live)
+			continue;
+		uint32_t vnode;
+		for (vnode = 0; vnode < CLUSTER_VNODES; vnode++) {
+			cluster_point* point = &cluster->ring[cluster->n_points++];
+			point->hash = cluster_hash(cluster->members[member].addr.sin_addr.s_addr, cluster->members[member].addr.sin_port, vnode + 1);
+			point->member = (uint8_t) member;
+		}
+	}
+	qsort(cluster->ring, cluster->n_points, sizeof(cluster_point), cluster_point_compare);
+	cluster->ring_changed = false;
+	cluster->ring_changes++;
+
+	printf("IOT_SERVER: Cluster ring rebuilt: %d nodes live - this node owns %.1f %% of clients\n",
+			cluster->n_points / CLUSTER_VNODES, cluster_share(cluster) * 100);
+	cluster_handoff(cluster);
+}
+
+
+
+/*
+ * Sends sessions this node no longer owns to their new owner (capabilities, rates and gateway dedup window carry on
+ * there) and releases them; relayed devices follow their gateway, whose frames carry them. A scan of the session
+ * slab, only run when the ring changes
+ */
+static void cluster_handoff(cluster_node* cluster) {
+
+	if (cluster->n_points == 0)
+		return;
+
+	static uint8_t batches[CLUSTER_MAX_NODES][DATAGRAM_SIZE];
+	int n_records[CLUSTER_MAX_NODES] = { 0 };
+	client_registry* registry = cluster->registry;
+	uint32_t slot;
+	for (slot = 0; slot < registry->capacity; slot++) {
+		client_session* session = &registry->slab[slot];
+		if (!session->in_use)
+			continue;
+		int owner = cluster_owner(cluster, session->addr, (session->relay_port != 0) ? session->relay_port : session->port);
+		if (owner == cluster->self)
+			continue;
+
+		uint8_t* record = codec_at(codec_datagram_payload(batches[owner]) + 1, n_records[owner], DATAGRAM_HANDOFF_RECORD_SIZE);
+		codec_store_addr(codec_handoff_addr(record), session->addr);
+		codec_store_port(codec_handoff_port(record), session->port);
+		codec_store_port(codec_handoff_relay_port(record), session->relay_port);
+		codec_handoff_set_capabilities(record, session->capabilities);
+		codec_handoff_set_sampling(record, (uint32_t) session->timings.sampling);
+		codec_handoff_set_server_stream(record, (uint32_t) session->timings.server_stream);
+		codec_handoff_set_relay_sequence(record, session->relay_sequence);
+		codec_handoff_set_relay_window(record, session->relay_window);
+		codec_handoff_set_datagrams(record, session->datagrams);
+		codec_handoff_set_samples(record, session->samples);
+		registry_release(registry, session);
+		cluster->handed_off++;
+
+		if (++n_records[owner] == CLUSTER_HANDOFF_RECORDS) {
+			codec_header_set_type(batches[owner], DATAGRAM_CLUSTER_HANDOFF);
+			codec_datagram_payload(batches[owner])[0] = (uint8_t) n_records[owner];
+			cluster_send(cluster, owner, batches[owner], 1 + (n_records[owner] * DATAGRAM_HANDOFF_RECORD_SIZE));
+			n_records[owner] = 0;
+		}
+	}
+
+	int member;
+	for (member = 0; member < cluster->n_members; member++) {
+		if (n_records[member] == 0)
+			continue;
+		codec_header_set_type(batches[member], DATAGRAM_CLUSTER_HANDOFF);
+		codec_datagram_payload(batches[member])[0] = (uint8_t) n_records[member];
+		cluster_send(cluster, member, batches[member], 1 + (n_records[member] * DATAGRAM_HANDOFF_RECORD_SIZE));
+	}
+}
+
+
+
+/*
+ * Registers sessions handed off by their previous owner; sessions already created here by datagrams that arrived
+ * first keep their counters added up and the two gateway dedup windows merged
+ */
+static void cluster_take_over(cluster_node* cluster, uint8_t* datagram, int64_t now_ms) {
+
+	uint8_t* records = codec_datagram_payload(datagram) + 1;
+	int n_records = codec_datagram_payload(datagram)[0];
+	int index;
+	for (index = 0; index < n_records; index++) {
+		uint8_t* record = codec_at(records, index, DATAGRAM_HANDOFF_RECORD_SIZE);
+		client_session* session = registry_touch(cluster->registry, codec_load_addr(codec_handoff_addr(record)), codec_load_port(codec_handoff_port(record)),
+				(uint32_t) (now_ms / 1000));
+		if (session == NULL)
+			continue;
+
+		session->relay_port = codec_load_port(codec_handoff_relay_port(record));
+		session->capabilities = codec_handoff_get_capabilities(record);
+		session->timings.sampling = (int) codec_handoff_get_sampling(record);
+		session->timings.server_stream = (int) codec_handoff_get_server_stream(record);
+		session->datagrams += codec_handoff_get_datagrams(record);
+		session->samples += codec_handoff_get_samples(record);
+
+		uint32_t sequence = codec_handoff_get_relay_sequence(record);
+		uint64_t window = codec_handoff_get_relay_window(record);
+		int32_t ahead = (int32_t) (sequence - session->relay_sequence);
+		if ((session->relay_window == 0) || (ahead >= 64)) {
+			session->relay_sequence = sequence;
+			session->relay_window = window;
+		} else if (ahead > 0) {
+			session->relay_sequence = sequence;
+			session->relay_window = (session->relay_window << ahead) | window;
+		} else if (ahead > -64) {
+			session->relay_window |= window << -ahead;
+		}
+		cluster->taken_over++;
+	}
+}
+
+
+
+/*
+ * Client datagram (or its reply) behind client's address and port, as forwarded between members
+ */
+static void cluster_wrap(uint8_t* wrapped, uint8_t type, struct sockaddr_in* client_addr, uint8_t* datagram, int length) {
+
+	uint8_t* forward = codec_datagram_payload(wrapped);
+	codec_header_set_type(wrapped, type);
+	codec_store_addr(codec_forward_addr(forward), client_addr->sin_addr.s_addr);
+	codec_store_port(codec_forward_port(forward), client_addr->sin_port);
+	memcpy(forward + DATAGRAM_FORWARD_SIZE, datagram, length);
+}
+
+
+
+static void cluster_store_report(cluster_node* cluster, int member, uint8_t* datagram) {
+
+	cluster_report* report = &cluster->members[member].report;
+	uint8_t* payload = codec_datagram_payload(datagram);
+	memset(report, 0, sizeof(*report));
+	report->received = true;
+	report->n_clients = codec_report_header_get_n_clients(payload);
+	report->n_samples = codec_report_header_get_n_samples(payload);
+
+	int n_sensors = codec_report_header_get_n_sensors(payload);
+	int index;
+	for (index = 0; index < n_sensors; index++) {
+		uint8_t* record = codec_at(payload + DATAGRAM_REPORT_HEADER_SIZE, index, DATAGRAM_REPORT_SENSOR_SIZE);
+		int sensor = codec_report_sensor_get_sensor(record);
+		if (sensor >= DATAGRAM_MAX_SENSORS)
+			continue;
+		report->count[sensor] = codec_report_sensor_get_count(record);
+		int channel;
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+			uint8_t* values = codec_report_sensor_channel(record, channel);
+			report->minimum[sensor][channel] = codec_bits_float(codec_report_channel_get_minimum(values));
+			report->mean[sensor][channel] = codec_bits_float(codec_report_channel_get_mean(values));
+			report->maximum[sensor][channel] = codec_bits_float(codec_report_channel_get_maximum(values));
+		}
+	}
+}
+
+
+
+/*
+ * Fleet-wide statistics: minimum of minimums, maximum of maximums and count-weighted mean of every sensor over the
+ * reports of live members; reports are cleared once merged
+ */
+static void cluster_merge_reports(cluster_node* cluster) {
+
+	int n_reports = 0;
+	uint32_t n_clients = 0;
+	uint32_t n_samples = 0;
+	uint32_t count[DATAGRAM_MAX_SENSORS] = { 0 };
+	float minimum[DATAGRAM_MAX_SENSORS][DATAGRAM_CHANNELS];
+	double sum[DATAGRAM_MAX_SENSORS][DATAGRAM_CHANNELS] = { { 0 } };
+	float maximum[DATAGRAM_MAX_SENSORS][DATAGRAM_CHANNELS];
+
+	int member;
+	for (member = 0; member < cluster->n_members; member++) {
+		cluster_report* report = &cluster->members[member].report;
+		if (!report->received || !cluster->members[member].live)
+			continue;
+		n_reports++;
+		n_clients += report->n_clients;
+		n_samples += report->n_samples;
+
+		int sensor;
+		for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+			if (report->count[sensor] == 0)
+				continue;
+			int channel;
+			for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+				if ((count[sensor] == 0) || (report->minimum[sensor][channel] < minimum[sensor][channel]))
+					minimum[sensor][channel] = report->minimum[sensor][channel];
+				if ((count[sensor] == 0) || (report->maximum[sensor][channel] > maximum[sensor][channel]))
+					maximum[sensor][channel] = report->maximum[sensor][channel];
+				sum[sensor][channel] += (double) report->mean[sensor][channel] * report->count[sensor];
+			}
+			count[sensor] += report->count[sensor];
+		}
+	}
+	for (member = 0; member < cluster->n_members; member++)
+		memset(&cluster->members[member].report, 0, sizeof(cluster_report));
+
+	printf("\nIOT_SERVER: == Fleet Statistics (%d nodes reporting) ==\n", n_reports);
+	printf("IOT_SERVER: >> Clients: %u - samples: %u\n", n_clients, n_samples);
+	int sensor;
+	for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+		if (count[sensor] == 0)
+			continue;
+		printf("IOT_SERVER: >> Sensor %d (%u samples)", sensor, count[sensor]);
+		const char* names[DATAGRAM_CHANNELS] = { "clarity", "red", "green", "blue" };
+		int channel;
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++)
+			printf(" - %s: %.2f/%.2f/%.2f", names[channel], minimum[sensor][channel], sum[sensor][channel] / count[sensor], maximum[sensor][channel]);
+		printf(" (minimum/mean/maximum)\n");
+	}
+	printf("\n");
+}
+
+
+
+static int cluster_member_of(cluster_node* cluster, struct sockaddr_in* addr) {
+
+	int member;
+	for (member = 0; member < cluster->n_members; member++) {
+		if ((cluster->members[member].addr.sin_addr.s_addr == addr->sin_addr.s_addr) && (cluster->members[member].addr.sin_port == addr->sin_port))
+			return member;
+	}
+	return -1;
+}
+
+
+
+/*
+ * Binary search for the first ring point at or after client's hash (wrapping around); this node if ring is empty
+ */
+static int cluster_owner(cluster_node* cluster, uint32_t addr, uint16_t port) {
+
+	if (cluster->n_points == 0)
+		return cluster->self;
+
+	uint32_t hash = cluster_hash(addr, port, 0);
+	int low = 0;
+	int high = cluster->n_points;
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (cluster->ring[middle].hash < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return cluster->ring[(low == cluster->n_points) ? 0 : low].member;
+}
+
+
+
+/*
+ * Live member with the lowest address and port: every node agrees on it once their rings agree
+ */
+static int cluster_coordinator(cluster_node* cluster) {
+
+	int coordinator = cluster->self;
+	int member;
+	for (member = 0; member < cluster->n_members; member++) {
+		struct sockaddr_in* candidate = &cluster->members[member].addr;
+		struct sockaddr_in* current = &cluster->members[coordinator].addr;
+		if (cluster->members[member].live && ((ntohl(candidate->sin_addr.s_addr) < ntohl(current->sin_addr.s_addr))
+				|| ((candidate->sin_addr.s_addr == current->sin_addr.s_addr) && (ntohs(candidate->sin_port) < ntohs(current->sin_port)))))
+			coordinator = member;
+	}
+	return coordinator;
+}
+
+
+
+/*
+ * returns fraction of hash space (thus of clients) owned by this node
+ */
+static double cluster_share(cluster_node* cluster) {
+
+	if (cluster->n_points == 0)
+		return 0;
+
+	uint64_t owned = 0;
+	int point;
+	for (point = 0; point < cluster->n_points; point++) {
+		if (cluster->ring[point].member != cluster->self)
+			continue;
+		uint32_t previous = cluster->ring[(point == 0) ? (cluster->n_points - 1) : (point - 1)].hash;
+		owned += (uint32_t) (cluster->ring[point].hash - previous);
+	}
+	return owned / 4294967296.0;
+}
+
+
+
+static uint32_t cluster_hash(uint32_t addr, uint16_t port, uint32_t salt) {
+
+	// 64-bit mix (splitmix64 finalizer) of address and port, salted with virtual node index (0: clients)
+	uint64_t key = (((uint64_t) addr << 16) | port) ^ ((uint64_t) salt << 48);
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return (uint32_t) key;
+}
+
+
+
+static int cluster_point_compare(const void* a, const void* b) {
+
+	uint32_t hash_a = ((const cluster_point*) a)->hash;
+	uint32_t hash_b = ((const cluster_point*) b)->hash;
+	return (hash_a > hash_b) - (hash_a < hash_b);
+}
@@ -0,0 +1,108 @@
+/*
+ * cluster.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef CLUSTER_H_
+#define CLUSTER_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <netinet/in.h>		// For sockaddr_in struct
+
+#include "iot_lib.h"
+#include "registry/client_registry.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define CLUSTER_MAX_NODES			16
+#define CLUSTER_VNODES				128			// Ring points per node: keeps shares even and spreads a leaving node's clients over all others
+#define CLUSTER_HEARTBEAT_MS		1000		// Heartbeat period (bounded below by the server socket's 1-second timeout)
+#define CLUSTER_DEAD_MS				3500		// Nodes not heard for this long leave the ring
+#define CLUSTER_NODE_ALIVE			0x00
+#define CLUSTER_NODE_LEAVING		0x01
+#define CLUSTER_HANDOFF_RECORDS		((DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 2) / DATAGRAM_HANDOFF_RECORD_SIZE)
+
+
+
+/* TYPE DEFINITIONS */
+
+// Statistics of one node for one period, merged by the coordinator (count-weighted means)
+typedef struct {
+	bool		received;
+	uint32_t	n_clients;
+	uint32_t	n_samples;
+	uint32_t	count		[DATAGRAM_MAX_SENSORS];		// 0: sensor not reported
+	float		minimum		[DATAGRAM_MAX_SENSORS][DATAGRAM_CHANNELS];
+	float		mean		[DATAGRAM_MAX_SENSORS][DATAGRAM_CHANNELS];
+	float		maximum		[DATAGRAM_MAX_SENSORS][DATAGRAM_CHANNELS];
+} cluster_report;
+
+
+typedef struct {
+	struct sockaddr_in	addr;
+	bool				live;			// In the ring (this node always is)
+	int64_t				heard_ms;		// Last heartbeat (monotonic)
+	cluster_report		report;			// Latest report, if this node is the coordinator
+} cluster_member;
+
+
+// Ring point: hash of (node, virtual node index); a client belongs to the first point at or after its hash
+typedef struct {
+	uint32_t			hash;
+	uint8_t				member;
+} cluster_point;
+
+
+// This node's view of the cluster: members (itself included) from the command line, ring built from the live ones
+typedef struct {
+	int					server_socket;
+	client_registry*	registry;
+	cluster_member		members		[CLUSTER_MAX_NODES];
+	int					n_members;
+	int					self;
+	cluster_point		ring		[CLUSTER_MAX_NODES * CLUSTER_VNODES];
+	int					n_points;
+	bool				ring_changed;	// Membership changed since ring was built
+	int64_t				heartbeat_ms;	// Next heartbeat due
+	int					entry;			// Member the last forwarded datagram came through (its reply goes back there)
+
+	unsigned long		forwarded;		// Client datagrams sent to their owner
+	unsigned long		received;		// ...and received from other nodes
+	unsigned long		replied;		// Replies to forwarded datagrams sent back to their entry node
+	unsigned long		relayed;		// ...and sent on to their client by this node
+	unsigned long		unsent;			// Forwards and replies the socket refused (client left unacknowledged: it retries)
+	unsigned long		misrouted;		// Received for clients this node does not own (processed anyway: rings converging)
+	unsigned long		handed_off;		// Sessions sent to their new owner
+	unsigned long		taken_over;		// ...and received from their previous owner
+	unsigned long		ring_changes;
+	unsigned long		rejected;		// Cluster datagrams from unknown sources or malformed
+} cluster_node;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		cluster_init			(cluster_node* cluster, char* members, client_registry* registry);	// returns -1 for bad member list
+void	cluster_start			(cluster_node* cluster, int server_socket, int64_t now_ms);
+bool	cluster_frame			(uint8_t* datagram);		// datagram is cluster traffic (from another node)
+bool	cluster_is_member		(cluster_node* cluster, struct sockaddr_in* addr);
+int		cluster_receive			(cluster_node* cluster, uint8_t* datagram, int length, struct sockaddr_in* source_addr, int64_t now_ms);
+bool	cluster_owns			(cluster_node* cluster, uint32_t addr, uint16_t port);
+void	cluster_forward			(cluster_node* cluster, uint8_t* datagram, int length, struct sockaddr_in* client_addr, uint32_t key_addr, uint16_t key_port);
+int		cluster_reply			(cluster_node* cluster, struct sockaddr_in* client_addr, uint8_t* reply, int length);
+void	cluster_tick			(cluster_node* cluster, int64_t now_ms);
+void	cluster_report_sensor	(cluster_node* cluster, int sensor, uint32_t count, float* minimum, float* mean, float* maximum);
+void	cluster_report_send		(cluster_node* cluster, uint32_t n_clients);
+void	cluster_leave			(cluster_node* cluster);
+int64_t	cluster_now_ms			(void);
+void	cluster_print_stats		(cluster_node* cluster);
+
+
+
+#endif /* CLUSTER_H_ */
@@ -0,0 +1,219 @@
+/*
+ * codec_benchmark.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For rand()
+#include <string.h>			// For memcmp()
+#include <time.h>			// For clock_gettime()
+
+#include "codec_benchmark.h"
+#include "iot_server.h"
+
+
+
+static void		codec_bench_encode_legacy	(uint8_t request_type, uint8_t* registers, int n_samples, uint8_t* datagram);
+static void		codec_bench_encode			(uint8_t request_type, uint8_t* registers, int n_samples, uint8_t* datagram);
+static int		codec_bench_decode_legacy	(uint8_t* buffer_recv, sample_data* data_out);
+static double	codec_now_ns				(void);
+
+
+
+/*
+ * Times the hand-written encode and decode loops the protocol had before IoT_Lib's codec (kept here as reference)
+ * against the codec, on full datagrams of plain and tagged samples; both must produce identical datagrams and samples
+ */
+void codec_benchmark(int n_datagrams) {
+
+	static uint8_t registers[CODEC_BENCH_DATAGRAMS][MAX_SAMPLING_RATIO][8];
+	static uint8_t datagrams[2][CODEC_BENCH_DATAGRAMS][DATAGRAM_SIZE];
+	static sample_data samples[2][MAX_SAMPLING_RATIO];
+	uint8_t request_types[2] = { DATAGRAM_REQ_SEND_DATA, DATAGRAM_REQ_SEND_TAGGED_DATA };
+
+	srand(1);
+	int index, sample, byte;
+	for (index = 0; index < CODEC_BENCH_DATAGRAMS; index++)
+		for (sample = 0; sample < MAX_SAMPLING_RATIO; sample++)
+			for (byte = 0; byte < 8; byte++)
+				registers[index][sample][byte] = (uint8_t) rand();
+
+	bool quiet = server_quiet;
+	server_quiet = true;
+	printf("IOT_SERVER: == Protocol Codec Benchmark (%d datagrams per record type, hand-written loops vs codec) ==\n", n_datagrams);
+
+	int type;
+	for (type = 0; type < 2; type++) {
+		int record_size = (type == 0) ? DATAGRAM_SAMPLE_SIZE : DATAGRAM_TAGGED_SAMPLE_SIZE;
+		int n_samples = (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 1) / record_size;
+
+		// Outputs first: the codec must reproduce the hand-written datagrams byte for byte, and their decoded samples
+		bool identical = true;
+		for (index = 0; (index < CODEC_BENCH_DATAGRAMS) && identical; index++) {
+			codec_bench_encode_legacy(request_types[type], registers[index][0], n_samples, datagrams[0][index]);
+			codec_bench_encode(request_types[type], registers[index][0], n_samples, datagrams[1][index]);
+			identical = (memcmp(datagrams[0][index], datagrams[1][index], DATAGRAM_HEADER_SIZE + (n_samples * record_size) + 1) == 0)
+					&& (codec_bench_decode_legacy(datagrams[0][index], samples[0]) == server_datagram_parsing(datagrams[1][index], DATAGRAM_SIZE, samples[1], 1));
+			for (sample = 0; (sample < n_samples) && identical; sample++) {
+				sample_data* legacy = &samples[0][sample];
+				sample_data* codec = &samples[1][sample];
+				identical = (legacy->timestamp == codec->timestamp) && (legacy->sensor == codec->sensor) && (legacy->clarity == codec->clarity)
+						&& (legacy->red == codec->red) && (legacy->green == codec->green) && (legacy->blue == codec->blue);
+			}
+		}
+
+		// Rotating over distinct datagrams (cache-resident) keeps iterations independent; sink keeps results live
+		volatile uint32_t sink = 0;
+		double per_datagram[4];
+		int method;
+		for (method = 0; method < 4; method++) {
+			double start = codec_now_ns();
+			int iteration;
+			for (iteration = 0; iteration < n_datagrams; iteration++) {
+				int slot = iteration & (CODEC_BENCH_DATAGRAMS - 1);
+				uint8_t* datagram = datagrams[method & 1][slot];
+				switch (method) {
+					case 0:
+						codec_bench_encode_legacy(request_types[type], registers[slot][0], n_samples, datagram);
+						sink += datagram[DATAGRAM_HEADER_SIZE + slot];
+						break;
+					case 1:
+						codec_bench_encode(request_types[type], registers[slot][0], n_samples, datagram);
+						sink += datagram[DATAGRAM_HEADER_SIZE + slot];
+						break;
+					case 2:
+						sink += (uint32_t) codec_bench_decode_legacy(datagram, samples[0]) + (uint32_t) samples[0][slot].red;
+						break;
+					default:
+						sink += (uint32_t) server_datagram_parsing(datagram, DATAGRAM_SIZE, samples[1], 1) + (uint32_t) samples[1][slot].red;
+						break;
+				}
+			}
+			per_datagram[method] = (codec_now_ns() - start) / n_datagrams;
+		}
+		(void) sink;
+
+		printf("IOT_SERVER: >> %s (%d per datagram): encode hand-written %.1f ns - codec %.1f ns (x%.2f) | decode hand-written %.1f ns - codec %.1f ns (x%.2f, %.1f M samples/s) - outputs %s\n",
+				(type == 0) ? "samples" : "tagged samples", n_samples, per_datagram[0], per_datagram[1], per_datagram[0] / per_datagram[1],
+				per_datagram[2], per_datagram[3], per_datagram[2] / per_datagram[3], (n_samples * 1e3) / per_datagram[3], identical ? "identical" : "DIFFER");
+	}
+
+	server_quiet = quiet;
+}
+
+
+
+/*
+ * Hand-written encoder (client_encode_sample and client_build_records before the codec): byte shifts per field
+ */
+static void codec_bench_encode_legacy(uint8_t request_type, uint8_t* registers, int n_samples, uint8_t* datagram) {
+
+	int tag_size = (request_type == DATAGRAM_REQ_SEND_TAGGED_DATA) ? 1 : 0;
+	int record_size = DATAGRAM_SAMPLE_SIZE + tag_size;
+
+	uint16_t message_size = (uint16_t) (n_samples * record_size);
+	datagram[0] = request_type;
+	datagram[1] = (uint8_t) message_size;			// LSB
+	datagram[2] = (uint8_t) (message_size >> 8);	// MSB
+
+	int sample;
+	for (sample = 0; sample < n_samples; sample++) {
+		uint8_t* record = &datagram[DATAGRAM_HEADER_SIZE + (sample * record_size)];
+		if (tag_size > 0)
+			record[0] = (uint8_t) (sample % DATAGRAM_MAX_SENSORS);
+
+		uint16_t seconds_16t = (uint16_t) sample;
+		record[tag_size] = (uint8_t) seconds_16t;
+		record[tag_size + 1] = (uint8_t) (seconds_16t >> 8);
+
+		int reg_index;
+		for (reg_index = 0; reg_index < 8; reg_index++) {
+			record[tag_size + reg_index + 2] = registers[(sample * 8) + reg_index];
+		}
+	}
+	datagram[DATAGRAM_HEADER_SIZE + message_size] = 0x00;
+}
+
+
+
+/*
+ * Same datagram through the codec (as the client encodes it now)
+ */
+static void codec_bench_encode(uint8_t request_type, uint8_t* registers, int n_samples, uint8_t* datagram) {
+
+	int tagged = (request_type == DATAGRAM_REQ_SEND_TAGGED_DATA);
+	int record_size = tagged ? DATAGRAM_TAGGED_SAMPLE_SIZE : DATAGRAM_SAMPLE_SIZE;
+
+	codec_datagram_begin(datagram, request_type, n_samples * record_size);
+	uint8_t* records = codec_datagram_payload(datagram);
+
+	int sample;
+	for (sample = 0; sample < n_samples; sample++) {
+		uint8_t* record = codec_at(records, sample, record_size);
+		if (tagged) {
+			codec_tagged_sample_set_sensor(record, (uint8_t) (sample % DATAGRAM_MAX_SENSORS));
+			record = codec_tagged_sample_sample(record);
+		}
+		codec_sample_set_timestamp(record, (uint16_t) sample);
+		memcpy(&record[codec_sample_clarity_offset], &registers[sample * 8], 8);
+	}
+}
+
+
+
+/*
+ * Hand-written decoder (server_datagram_parsing before the codec): samples copied out, then 16-bit values merged
+ */
+static int codec_bench_decode_legacy(uint8_t* buffer_recv, sample_data* data_out) {
+
+	int record_size = (buffer_recv[0] == DATAGRAM_REQ_SEND_TAGGED_DATA) ? DATAGRAM_TAGGED_SAMPLE_SIZE : DATAGRAM_SAMPLE_SIZE;
+	int tag_size = record_size - DATAGRAM_SAMPLE_SIZE;
+	int n_records = (int) ((buffer_recv[2] << 8) | (buffer_recv[1])) / record_size;
+	if (n_records > (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE) / record_size)
+		n_records = (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE) / record_size;
+
+	uint8_t	samples_raw	[MAX_SAMPLING_RATIO][DATAGRAM_SAMPLE_SIZE];
+
+	int n_samples = 0;
+	int record;
+	for (record = 0; record < n_records; record++) {
+		uint8_t* record_raw = &buffer_recv[DATAGRAM_HEADER_SIZE + (record * record_size)];
+		int sensor = (tag_size > 0) ? record_raw[0] : 0;
+		if (sensor >= DATAGRAM_MAX_SENSORS)
+			continue;
+
+		int sample = n_samples++;
+		int index;
+		for (index = 0; index < DATAGRAM_SAMPLE_SIZE; index++) {
+			samples_raw[sample][index] = record_raw[tag_size + index];
+		}
+
+		uint16_t conversions_16[5];
+		conversions_16[0] = (uint16_t) (samples_raw[sample][1] << 8 | samples_raw[sample][0]);
+		conversions_16[1] = (uint16_t) (samples_raw[sample][3] << 8 | samples_raw[sample][2]);
+		conversions_16[2] = (uint16_t) (samples_raw[sample][5] << 8 | samples_raw[sample][4]);
+		conversions_16[3] = (uint16_t) (samples_raw[sample][7] << 8 | samples_raw[sample][6]);
+		conversions_16[4] = (uint16_t) (samples_raw[sample][9] << 8 | samples_raw[sample][8]);
+
+		data_out[sample].timestamp = (long int) conversions_16[0];
+		data_out[sample].sensor = sensor;
+		data_out[sample].clarity = (float) conversions_16[1] / 655.35;
+		data_out[sample].red = (float) conversions_16[2] / 655.35;
+		data_out[sample].green = (float) conversions_16[3] / 655.35;
+		data_out[sample].blue = (float) conversions_16[4] / 655.35;
+	}
+
+	return n_samples;
+}
+
+
+
+static double codec_now_ns(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1e9) + now.tv_nsec;
+}
@@ -0,0 +1,29 @@
+/*
+ * codec_benchmark.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef CODEC_BENCHMARK_H_
+#define CODEC_BENCHMARK_H_
+
+
+#include "iot_lib.h"
+#include "iot_codec.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define CODEC_BENCH_DATAGRAMS		64		// Distinct datagrams cycled through by the benchmark (power of 2)
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	codec_benchmark		(int n_datagrams);
+
+
+
+#endif /* CODEC_BENCHMARK_H_ */
@@ -0,0 +1,494 @@
+/*
+ * exporter.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For fopen() and fwrite()
+#include <stdlib.h>			// For malloc() and free()
+#include <string.h>			// For memcpy()
+#include <time.h>			// For clock_gettime() and nanosleep()
+#include <arpa/inet.h>		// For htonl()
+
+#include "iot_lib.h"
+#include "iot_server.h"
+#include "exporter.h"
+
+
+
+static void*	exporter_thread			(void* arg);
+static void		exporter_add_row		(exporter* exp, export_row* row);
+static void		exporter_flush			(exporter* exp);
+static void		exporter_write_samples	(exporter* exp);
+static void		exporter_write_stats	(exporter* exp);
+static void		exporter_write_batch	(exporter* exp, uint8_t kind, int n_columns, int n_rows, uint8_t* end);
+static int		exporter_rotate			(exporter* exp);
+static uint8_t*	export_column_varint	(uint8_t* out, int column, int64_t* values, int n_rows);
+static uint8_t*	export_column_float		(uint8_t* out, int column, float* values, int n_rows);
+static time_t	export_now_secs			(void);
+static double	export_bench_secs		(void);
+static double	export_bench_cpu_secs	(void);
+
+
+
+/*
+ * Allocates batch buffers, opens first export file and starts exporter thread
+ */
+int exporter_start(exporter* exp, const char* prefix) {
+
+	atomic_init(&exp->head, 0);
+	atomic_init(&exp->tail, 0);
+	exp->tail_cached = 0;
+	atomic_init(&exp->dropped, 0);
+	atomic_init(&exp->running, true);
+	atomic_init(&exp->rows_written, 0);
+	atomic_init(&exp->bytes_written, 0);
+	atomic_init(&exp->batches, 0);
+	atomic_init(&exp->files, 0);
+	atomic_init(&exp->write_errors, 0);
+	exp->prefix = prefix;
+	exp->file = NULL;
+	exp->file_sequence = 0;
+	exp->n_sample_rows = 0;
+	exp->n_stats_rows = 0;
+	exp->pending_since = 0;
+
+	// Worst case of a batch: every value a 10-byte varint
+	exp->sample_columns = malloc(EXPORT_SAMPLE_COLUMNS * EXPORT_BATCH_ROWS * sizeof(int64_t));
+	exp->batch_buffer = malloc(10 + (EXPORT_SAMPLE_COLUMNS * (6 + (EXPORT_BATCH_ROWS * 10))));
+	if ((exp->sample_columns == NULL) || (exp->batch_buffer == NULL) || (exporter_rotate(exp) < 0)
+			|| (pthread_create(&exp->thread, NULL, exporter_thread, exp) != 0)) {
+		if (exp->file != NULL)
+			fclose(exp->file);
+		free(exp->sample_columns);
+		free(exp->batch_buffer);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+void exporter_stop(exporter* exp) {
+
+	atomic_store(&exp->running, false);
+	pthread_join(exp->thread, NULL);
+
+	if (exp->file != NULL)
+		fclose(exp->file);
+	exp->file = NULL;
+	free(exp->sample_columns);
+	free(exp->batch_buffer);
+}
+
+
+
+/*
+ * Producer side (ingest thread): never blocks, a full ring drops the row
+ */
+int exporter_push_sample(exporter* exp, int64_t time_ns, uint32_t addr, uint16_t port, int sensor, long int timestamp, float* values) {
+	unsigned long head = atomic_load_explicit(&exp->head, memory_order_relaxed);
+
+	if ((head - exp->tail_cached) >= EXPORT_RING_SIZE) {
+		exp->tail_cached = atomic_load_explicit(&exp->tail, memory_order_acquire);
+		if ((head - exp->tail_cached) >= EXPORT_RING_SIZE) {
+			atomic_fetch_add_explicit(&exp->dropped, 1, memory_order_relaxed);
+			return -1;
+		}
+	}
+
+	export_row* row = &exp->ring[head & (EXPORT_RING_SIZE - 1)];
+	row->kind = EXPORT_KIND_SAMPLES;
+	row->sensor = (uint8_t) sensor;
+	row->port = port;
+	row->addr = addr;
+	row->time_ns = time_ns;
+	row->sample.timestamp = (uint32_t) timestamp;
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++)
+		row->sample.values[channel] = (uint16_t) ((values[channel] * 655.35f) + 0.5f);
+	atomic_store_explicit(&exp->head, head + 1, memory_order_release);
+
+	return 0;
+}
+
+
+
+int exporter_push_stats(exporter* exp, int64_t time_ns, int sensor, long int count, float* minimum, float* mean, float* maximum) {
+	unsigned long head = atomic_load_explicit(&exp->head, memory_order_relaxed);
+
+	if ((head - exp->tail_cached) >= EXPORT_RING_SIZE) {
+		exp->tail_cached = atomic_load_explicit(&exp->tail, memory_order_acquire);
+		if ((head - exp->tail_cached) >= EXPORT_RING_SIZE) {
+			atomic_fetch_add_explicit(&exp->dropped, 1, memory_order_relaxed);
+			return -1;
+		}
+	}
+
+	export_row* row = &exp->ring[head & (EXPORT_RING_SIZE - 1)];
+	row->kind = EXPORT_KIND_STATS;
+	row->sensor = (uint8_t) sensor;
+	row->port = 0;
+	row->addr = 0;
+	row->time_ns = time_ns;
+	row->stats.count = (uint32_t) count;
+	memcpy(row->stats.minimum, minimum, sizeof(row->stats.minimum));
+	memcpy(row->stats.mean, mean, sizeof(row->stats.mean));
+	memcpy(row->stats.maximum, maximum, sizeof(row->stats.maximum));
+	atomic_store_explicit(&exp->head, head + 1, memory_order_release);
+
+	return 0;
+}
+
+
+
+void exporter_print_stats(exporter* exp) {
+
+	printf("IOT_SERVER: Export: %lu rows in %lu batches - %lu KB in %lu files - %lu dropped - %lu write errors\n",
+			atomic_load(&exp->rows_written), atomic_load(&exp->batches), atomic_load(&exp->bytes_written) / 1024,
+			atomic_load(&exp->files), atomic_load(&exp->dropped), atomic_load(&exp->write_errors));
+}
+
+
+
+/*
+ * Ingest throughput of the server processing path on synthetic datagrams, first without and then with export.
+ * Ingest thread CPU time per sample is reported too: on a single core the exporter thread shares the CPU, so
+ * wall-clock throughput drops even though ingest itself does no extra waiting. Ring drain time is reported separately.
+ */
+void exporter_benchmark(int n_datagrams, const char* prefix) {
+
+	static server_state state;		// Static: sample buffers too large for the stack
+	static exporter exp;
+	server_state_init(&state);
+	server_quiet = true;
+
+	struct sockaddr_in client_addr;
+	memset(&client_addr, 0, sizeof(client_addr));
+	client_addr.sin_addr.s_addr = htonl(0x0A000001);
+	client_addr.sin_port = htons(40000);
+	registry_touch(&state.registry, client_addr.sin_addr.s_addr, client_addr.sin_port, 0);		// As after its handshake: samples indexed
+
+	// Full tagged datagram, values drifting slowly as a real sensor's would
+	uint8_t datagram[DATAGRAM_SIZE] = {'\0'};
+	int n_records = (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE) / DATAGRAM_TAGGED_SAMPLE_SIZE;
+	int data_length = n_records * DATAGRAM_TAGGED_SAMPLE_SIZE;
+	codec_datagram_begin(datagram, DATAGRAM_REQ_SEND_TAGGED_DATA, data_length);
+
+	double ingest_secs[2];
+	double ingest_cpu_secs[2];
+	double drain_secs = 0;
+	int pass;
+	for (pass = 0; pass < 2; pass++) {
+		if ((pass == 1) && (exporter_start(&exp, prefix) < 0)) {
+			printf("IOT_SERVER: Could not start exporter with prefix %s\n", prefix);
+			return;
+		}
+		state.exporter = (pass == 1) ? &exp : NULL;
+
+		int64_t time_ns = (int64_t) time(NULL) * 1000000000LL;
+		double start = export_bench_secs();
+		double start_cpu = export_bench_cpu_secs();
+		int datagram_index;
+		for (datagram_index = 0; datagram_index < n_datagrams; datagram_index++) {
+			int sample;
+			for (sample = 0; sample < n_records; sample++) {
+				uint8_t* record = codec_at(codec_datagram_payload(datagram), sample, DATAGRAM_TAGGED_SAMPLE_SIZE);
+				uint16_t value = (uint16_t) (20000 + ((datagram_index + sample) & 1023));
+				codec_tagged_sample_set_sensor(record, (uint8_t) (sample & 3));
+				codec_sample_set_timestamp(codec_tagged_sample_sample(record), (uint16_t) datagram_index);
+				int channel;
+				for (channel = 0; channel < DATAGRAM_CHANNELS; channel++)
+					codec_sample_set_channel(codec_tagged_sample_sample(record), channel, (uint16_t) (value + channel + 1));
+			}
+			time_ns += 10000000;
+			server_process_datagram(&state, datagram, codec_datagram_size(datagram), &client_addr, time_ns);
+
+			// Stand-in for the statistics timer: keep saving samples without printing
+			if ((state.samples_all_index + n_records) > MAX_SAMPLES_STATS_CALC)
+				state.samples_all_index = 0;
+		}
+		ingest_secs[pass] = export_bench_secs() - start;
+		ingest_cpu_secs[pass] = export_bench_cpu_secs() - start_cpu;
+
+		if (pass == 1) {
+			start = export_bench_secs();
+			exporter_stop(&exp);
+			drain_secs = export_bench_secs() - start;
+		}
+	}
+
+	double n_samples = (double) n_datagrams * n_records;
+	unsigned long rows = atomic_load(&exp.rows_written);
+	printf("IOT_SERVER: == Export Benchmark (%d datagrams of %d samples) ==\n", n_datagrams, n_records);
+	printf("IOT_SERVER: >> Ingest without export: %.0f samples/s - ingest thread %.1f ns CPU per sample\n",
+			n_samples / ingest_secs[0], 1e9 * ingest_cpu_secs[0] / n_samples);
+	printf("IOT_SERVER: >> Ingest with export: %.0f samples/s (%.1f %% of baseline) - ingest thread %.1f ns CPU per sample - drain after ingest: %.3f s\n",
+			n_samples / ingest_secs[1], 100.0 * ingest_secs[0] / ingest_secs[1], 1e9 * ingest_cpu_secs[1] / n_samples, drain_secs);
+	printf("IOT_SERVER: >> Exported %lu rows (%lu dropped) - %.2f B per row in %lu files (%s-*%s)\n", rows, atomic_load(&exp.dropped),
+			(rows > 0) ? (double) atomic_load(&exp.bytes_written) / rows : 0.0, atomic_load(&exp.files), prefix, EXPORT_FILE_EXTENSION);
+
+	registry_free(&state.registry);
+	range_store_free(&state.ranges);
+}
+
+
+
+/*
+ * Consumer side: moves rows from the ring into column batches, releasing slots every EXPORT_RELEASE_ROWS rows
+ * (and before any batch write). Sleeps while the ring is empty; rows pushed before exporter_stop() are always written.
+ */
+static void* exporter_thread(void* arg) {
+
+	exporter* exp = (exporter*) arg;
+	struct timespec idle = { 0, 1000000 };
+
+	while (true) {
+		bool running = atomic_load(&exp->running);
+		unsigned long tail = atomic_load_explicit(&exp->tail, memory_order_relaxed);
+		unsigned long head = atomic_load_explicit(&exp->head, memory_order_acquire);
+
+		while (tail != head) {
+			unsigned long chunk_end = ((head - tail) > EXPORT_RELEASE_ROWS) ? tail + EXPORT_RELEASE_ROWS : head;
+			for (; tail != chunk_end; tail++)
+				exporter_add_row(exp, &exp->ring[tail & (EXPORT_RING_SIZE - 1)]);
+			atomic_store_explicit(&exp->tail, tail, memory_order_release);
+		}
+
+		if ((exp->pending_since != 0) && ((export_now_secs() - exp->pending_since) >= EXPORT_FLUSH_SECS))
+			exporter_flush(exp);
+
+		if (!running)
+			break;
+		if (atomic_load_explicit(&exp->head, memory_order_acquire) == tail)
+			nanosleep(&idle, NULL);
+	}
+
+	exporter_flush(exp);
+	return NULL;
+}
+
+
+
+static void exporter_add_row(exporter* exp, export_row* row) {
+
+	if (exp->pending_since == 0)
+		exp->pending_since = export_now_secs();
+
+	if (row->kind == EXPORT_KIND_STATS) {
+		exp->stats_rows[exp->n_stats_rows++] = *row;
+		if (exp->n_stats_rows == EXPORT_STATS_BATCH_ROWS)
+			exporter_write_stats(exp);
+		return;
+	}
+
+	int64_t* columns = exp->sample_columns;
+	int index = exp->n_sample_rows++;
+	columns[(EXPORT_COL_TIME_NS * EXPORT_BATCH_ROWS) + index] = row->time_ns;
+	columns[(EXPORT_COL_ADDR * EXPORT_BATCH_ROWS) + index] = row->addr;
+	columns[(EXPORT_COL_PORT * EXPORT_BATCH_ROWS) + index] = row->port;
+	columns[(EXPORT_COL_SENSOR * EXPORT_BATCH_ROWS) + index] = row->sensor;
+	columns[(EXPORT_COL_TIMESTAMP * EXPORT_BATCH_ROWS) + index] = row->sample.timestamp;
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++)
+		columns[((EXPORT_COL_VALUES + channel) * EXPORT_BATCH_ROWS) + index] = row->sample.values[channel];
+
+	if (exp->n_sample_rows == EXPORT_BATCH_ROWS)
+		exporter_write_samples(exp);
+}
+
+
+
+static void exporter_flush(exporter* exp) {
+
+	if (exp->n_sample_rows > 0)
+		exporter_write_samples(exp);
+	if (exp->n_stats_rows > 0)
+		exporter_write_stats(exp);
+	exp->pending_since = 0;
+}
+
+
+
+static void exporter_write_samples(exporter* exp) {
+
+	uint8_t* out = exp->batch_buffer + 10;
+	int column;
+	for (column = 0; column < EXPORT_SAMPLE_COLUMNS; column++)
+		out = export_column_varint(out, column, &exp->sample_columns[column * EXPORT_BATCH_ROWS], exp->n_sample_rows);
+
+	exporter_write_batch(exp, EXPORT_KIND_SAMPLES, EXPORT_SAMPLE_COLUMNS, exp->n_sample_rows, out);
+	exp->n_sample_rows = 0;
+}
+
+
+
+static void exporter_write_stats(exporter* exp) {
+
+	// Transpose rows into columns (stats batches are small: on the stack)
+	int64_t integers[3][EXPORT_STATS_BATCH_ROWS];
+	float floats[3 * DATAGRAM_CHANNELS][EXPORT_STATS_BATCH_ROWS];
+
+	int row, channel;
+	for (row = 0; row < exp->n_stats_rows; row++) {
+		export_row* stats = &exp->stats_rows[row];
+		integers[EXPORT_COL_TIME_NS][row] = stats->time_ns;
+		integers[EXPORT_COL_STATS_SENSOR][row] = stats->sensor;
+		integers[EXPORT_COL_STATS_COUNT][row] = stats->stats.count;
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+			floats[channel][row] = stats->stats.minimum[channel];
+			floats[DATAGRAM_CHANNELS + channel][row] = stats->stats.mean[channel];
+			floats[(2 * DATAGRAM_CHANNELS) + channel][row] = stats->stats.maximum[channel];
+		}
+	}
+
+	uint8_t* out = exp->batch_buffer + 10;
+	int column;
+	for (column = 0; column < EXPORT_COL_STATS_MINIMUM; column++)
+		out = export_column_varint(out, column, integers[column], exp->n_stats_rows);
+	for (column = EXPORT_COL_STATS_MINIMUM; column < EXPORT_STATS_COLUMNS; column++)
+		out = export_column_float(out, column, floats[column - EXPORT_COL_STATS_MINIMUM], exp->n_stats_rows);
+
+	exporter_write_batch(exp, EXPORT_KIND_STATS, EXPORT_STATS_COLUMNS, exp->n_stats_rows, out);
+	exp->n_stats_rows = 0;
+}
+
+
+
+/*
+ * Writes batch encoded after the 10-byte header space of batch_buffer in a single sequential write,
+ * rotating file first if it grew too large or too old
+ */
+static void exporter_write_batch(exporter* exp, uint8_t kind, int n_columns, int n_rows, uint8_t* end) {
+
+	uint8_t* header = exp->batch_buffer;
+	header[0] = kind;
+	header[1] = (uint8_t) n_columns;
+	codec_store_4(&header[2], (uint32_t) n_rows);
+	codec_store_4(&header[6], (uint32_t) (end - header - 10));
+	size_t length = (size_t) (end - header);
+
+	if ((exp->file == NULL) || (exp->file_bytes >= EXPORT_ROTATE_BYTES) || ((time(NULL) - exp->file_opened) >= EXPORT_ROTATE_SECS))
+		exporter_rotate(exp);
+
+	if ((exp->file == NULL) || (fwrite(header, 1, length, exp->file) != length) || (fflush(exp->file) != 0)) {
+		atomic_fetch_add(&exp->write_errors, 1);
+		return;
+	}
+
+	exp->file_bytes += (long int) length;
+	atomic_fetch_add(&exp->rows_written, (unsigned long) n_rows);
+	atomic_fetch_add(&exp->bytes_written, (unsigned long) length);
+	atomic_fetch_add(&exp->batches, 1);
+}
+
+
+
+/*
+ * Closes current export file and starts the next one
+ * returns -1 if the new file cannot be opened
+ */
+static int exporter_rotate(exporter* exp) {
+
+	if (exp->file != NULL)
+		fclose(exp->file);
+
+	char stamp[32];
+	char path[512];
+	time_t now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+	snprintf(path, sizeof(path), "%s-%s-%03d%s", exp->prefix, stamp, exp->file_sequence++, EXPORT_FILE_EXTENSION);
+
+	exp->file = fopen(path, "wb");
+	exp->file_opened = now;
+	exp->file_bytes = 0;
+	if (exp->file == NULL)
+		return -1;
+
+	uint8_t header[EXPORT_MAGIC_SIZE + 2];
+	memcpy(header, EXPORT_MAGIC, EXPORT_MAGIC_SIZE);
+	codec_store_2(&header[EXPORT_MAGIC_SIZE], EXPORT_VERSION);
+	if (fwrite(header, sizeof(header), 1, exp->file) != 1) {
+		fclose(exp->file);
+		exp->file = NULL;
+		return -1;
+	}
+	exp->file_bytes = sizeof(header);
+	atomic_fetch_add(&exp->files, 1);
+
+	return 0;
+}
+
+
+
+/*
+ * Delta + zigzag + LEB128: slowly changing columns (time, address, sensor values) shrink to 1-2 bytes per row
+ */
+static uint8_t* export_column_varint(uint8_t* out, int column, int64_t* values, int n_rows) {
+
+	uint8_t* data = out + 6;
+	int64_t previous = 0;
+
+	int row;
+	for (row = 0; row < n_rows; row++) {
+		int64_t delta = values[row] - previous;
+		uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+		previous = values[row];
+		while (zigzag >= 0x80) {
+			*data++ = (uint8_t) (zigzag | 0x80);
+			zigzag >>= 7;
+		}
+		*data++ = (uint8_t) zigzag;
+	}
+
+	out[0] = (uint8_t) column;
+	out[1] = EXPORT_ENC_DELTA_VARINT;
+	codec_store_4(&out[2], (uint32_t) (data - out - 6));
+	return data;
+}
+
+
+
+static uint8_t* export_column_float(uint8_t* out, int column, float* values, int n_rows) {
+
+	uint8_t* data = out + 6;
+
+	int row;
+	for (row = 0; row < n_rows; row++, data += 4)
+		codec_store_4(data, codec_float_bits(values[row]));
+
+	out[0] = (uint8_t) column;
+	out[1] = EXPORT_ENC_FLOAT32;
+	codec_store_4(&out[2], (uint32_t) (data - out - 6));
+	return data;
+}
+
+
+
+static time_t export_now_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+
+
+static double export_bench_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+
+
+static double export_bench_cpu_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
@@ -0,0 +1,138 @@
+/*
+ * exporter.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef EXPORTER_H_
+#define EXPORTER_H_
+
+
+#include <stdio.h>			// For FILE
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdatomic.h>		// For lock-free head/tail indexes
+#include <pthread.h>		// For pthread_t
+#include <time.h>			// For time_t
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+// Export file layout (all integers little-endian):
+//   file header:	magic "IOTCOL" (6 bytes), version (uint16)
+//   batch:			kind (uint8, EXPORT_KIND_*), number of columns (uint8), rows (uint32), bytes of column blocks (uint32)
+//   column block:	column id (uint8, EXPORT_COL_*), encoding (uint8, EXPORT_ENC_*), encoded bytes (uint32), data
+// EXPORT_ENC_DELTA_VARINT: per row, difference from previous row (first row: from 0), zigzag-mapped, LEB128 varint
+// EXPORT_ENC_FLOAT32: per row, IEEE 754 single-precision value
+#define EXPORT_MAGIC				"IOTCOL"
+#define EXPORT_MAGIC_SIZE			6
+#define EXPORT_VERSION				2		// 2: client sample timestamps in milliseconds (1: seconds)
+#define EXPORT_FILE_EXTENSION		".iotcol"
+
+#define EXPORT_KIND_SAMPLES			0x01
+#define EXPORT_KIND_STATS			0x02
+#define EXPORT_ENC_DELTA_VARINT		0x01
+#define EXPORT_ENC_FLOAT32			0x02
+
+// Sample columns (all EXPORT_ENC_DELTA_VARINT): channel values in raw sensor counts (percent * 655.35)
+#define EXPORT_COL_TIME_NS			0		// Arrival time, nanoseconds since epoch
+#define EXPORT_COL_ADDR				1		// Client IPv4 address (network order, read as uint32)
+#define EXPORT_COL_PORT				2		// Client UDP port (network order, read as uint16)
+#define EXPORT_COL_SENSOR			3
+#define EXPORT_COL_TIMESTAMP		4		// Client sample timestamp, milliseconds
+#define EXPORT_COL_VALUES			5		// Clarity, red, green, blue: columns 5 to 8
+#define EXPORT_SAMPLE_COLUMNS		(EXPORT_COL_VALUES + DATAGRAM_CHANNELS)
+
+// Stats columns: time, sensor and count (EXPORT_ENC_DELTA_VARINT), then minimum, mean and maximum of clarity,
+// red, green and blue (EXPORT_ENC_FLOAT32, percent)
+#define EXPORT_COL_STATS_SENSOR		1
+#define EXPORT_COL_STATS_COUNT		2
+#define EXPORT_COL_STATS_MINIMUM	3		// Columns 3 to 6
+#define EXPORT_COL_STATS_MEAN		(EXPORT_COL_STATS_MINIMUM + DATAGRAM_CHANNELS)
+#define EXPORT_COL_STATS_MAXIMUM	(EXPORT_COL_STATS_MEAN + DATAGRAM_CHANNELS)
+#define EXPORT_STATS_COLUMNS		(EXPORT_COL_STATS_MAXIMUM + DATAGRAM_CHANNELS)
+
+#define EXPORT_RING_SIZE			65536				// Rows buffered between ingest and exporter threads (power of 2)
+#define EXPORT_RELEASE_ROWS			1024				// Ring slots are handed back to the producer in chunks of this many rows
+#define EXPORT_BATCH_ROWS			16384				// Sample rows per batch (one sequential write)
+#define EXPORT_STATS_BATCH_ROWS		256					// Stats rows per batch
+#define EXPORT_FLUSH_SECS			5					// Partial batches are written after this long
+#define EXPORT_ROTATE_BYTES			(64L * 1024 * 1024)	// A new file is started past this size...
+#define EXPORT_ROTATE_SECS			3600				// ...or age
+#define EXPORT_BENCHMARK_PREFIX		"/tmp/iot_export_benchmark"
+
+
+
+/* TYPE DEFINITIONS */
+
+// Row handed from ingest thread to exporter thread
+typedef struct {
+	uint8_t		kind;				// EXPORT_KIND_*
+	uint8_t		sensor;
+	uint16_t	port;				// Network order
+	uint32_t	addr;				// Network order
+	int64_t		time_ns;
+	union {
+		struct {
+			uint32_t	timestamp;
+			uint16_t	values		[DATAGRAM_CHANNELS];
+		} sample;
+		struct {
+			uint32_t	count;
+			float		minimum		[DATAGRAM_CHANNELS];
+			float		mean		[DATAGRAM_CHANNELS];
+			float		maximum		[DATAGRAM_CHANNELS];
+		} stats;
+	};
+} export_row;
+
+
+typedef struct {
+	// Single-producer (ingest thread) / single-consumer (exporter thread) ring: ingest never waits for disk.
+	// Indexes on their own cache lines; producer rereads tail only when its cached copy says the ring is full.
+	export_row		ring		[EXPORT_RING_SIZE];
+	_Alignas(64) atomic_ulong	head;
+	unsigned long	tail_cached;		// Producer only
+	atomic_ulong	dropped;			// Rows discarded because ring was full
+	_Alignas(64) atomic_ulong	tail;
+	atomic_bool		running;
+	pthread_t		thread;
+	const char*		prefix;				// Files are named <prefix>-<YYYYmmdd-HHMMSS>-<sequence>.iotcol
+
+	// Exporter thread only
+	FILE*			file;
+	int				file_sequence;
+	long int		file_bytes;
+	time_t			file_opened;
+	int64_t*		sample_columns;		// EXPORT_SAMPLE_COLUMNS x EXPORT_BATCH_ROWS
+	int				n_sample_rows;
+	export_row		stats_rows	[EXPORT_STATS_BATCH_ROWS];
+	int				n_stats_rows;
+	time_t			pending_since;		// Monotonic seconds of oldest row not yet written
+	uint8_t*		batch_buffer;
+
+	// Written by exporter thread, read by ingest thread
+	atomic_ulong	rows_written;
+	atomic_ulong	bytes_written;
+	atomic_ulong	batches;
+	atomic_ulong	files;
+	atomic_ulong	write_errors;
+} exporter;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		exporter_start			(exporter* exp, const char* prefix);	// returns -1 if first file or thread cannot be created
+void	exporter_stop			(exporter* exp);						// writes pending rows, then joins thread
+int		exporter_push_sample	(exporter* exp, int64_t time_ns, uint32_t addr, uint16_t port, int sensor, long int timestamp, float* values);
+int		exporter_push_stats		(exporter* exp, int64_t time_ns, int sensor, long int count, float* minimum, float* mean, float* maximum);
+void	exporter_print_stats	(exporter* exp);
+void	exporter_benchmark		(int n_datagrams, const char* prefix);
+
+
+
+#endif /* EXPORTER_H_ */
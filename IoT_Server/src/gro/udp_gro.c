@@ -0,0 +1,366 @@
+/*
+ * udp_gro.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset() and memcpy()
+#include <unistd.h>			// For close()
+#include <time.h>			// For clock_gettime()
+#include <pthread.h>		// For benchmark sender thread
+#include <sys/socket.h>		// For recvmsg() and sendmsg()
+#include <netinet/udp.h>	// For UDP_GRO and UDP_SEGMENT
+#include <arpa/inet.h>		// For htonl()
+
+#include "iot_lib.h"
+#include "iot_server.h"
+#include "udp_gro.h"
+
+
+
+typedef struct {
+	uint16_t	port;
+	int			n_datagrams;
+	uint8_t*	datagram;
+	int			length;
+	long int	acked;
+	long int	lost;
+} gro_bench_sender;
+
+
+static bool		gro_same_client			(struct sockaddr_in* a, struct sockaddr_in* b);
+static int		gro_bench_socket		(uint16_t* port);
+static void*	gro_bench_send			(void* arg);
+static double	gro_now_secs			(clockid_t clock);
+
+
+
+int udp_gro_init(udp_gro* gro, int server_socket) {
+
+	memset(gro, 0, sizeof(*gro));
+	gro->socket = server_socket;
+
+	int enable = 1;
+	return (setsockopt(server_socket, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) < 0) ? -1 : 0;
+}
+
+
+
+/*
+ * Returns next datagram of the current coalesced receive (pointer into it, valid until the next call), receiving
+ * again once all its segments were handed out. Replies still gathered are sent before blocking.
+ * returns datagram length (-1 on timeout or signal)
+ */
+int udp_gro_recv(udp_gro* gro, struct sockaddr_in* client_addr, uint8_t** datagram) {
+
+	if (gro->offset >= gro->length) {
+		udp_gro_flush(gro);
+
+		struct iovec iov = { gro->buffer, UDP_GRO_BUFFER_SIZE };
+		char control[CMSG_SPACE(sizeof(int))];
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &gro->client_addr;
+		msg.msg_namelen = sizeof(gro->client_addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t recv_len = recvmsg(gro->socket, &msg, 0);
+		if (recv_len < 0)
+			return -1;
+
+		// gso_size cmsg only present when datagrams were coalesced
+		gro->length = (int) recv_len;
+		gro->offset = 0;
+		gro->segment_size = (int) recv_len;
+		struct cmsghdr* cmsg;
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO))
+				memcpy(&gro->segment_size, CMSG_DATA(cmsg), sizeof(int));
+		}
+		if ((gro->segment_size <= 0) || (gro->segment_size > gro->length))
+			gro->segment_size = gro->length;
+
+		gro->receives++;
+		if (gro->segment_size < gro->length)
+			gro->coalesced++;
+	}
+
+	int segment = gro->length - gro->offset;
+	if (segment > gro->segment_size)
+		segment = gro->segment_size;
+
+	*datagram = gro->buffer + gro->offset;
+	*client_addr = gro->client_addr;
+	gro->offset += segment;
+	gro->datagrams++;
+	return segment;
+}
+
+
+
+/*
+ * Gathers reply: replies to one client are sent together once the current receive is exhausted. A longer reply,
+ * another client or a full batch sends the previous ones first; a shorter reply can only end a batch.
+ * returns number of bytes gathered
+ */
+int udp_gro_send(udp_gro* gro, struct sockaddr_in* client_addr, uint8_t* buffer, int length) {
+
+	if (length > DATAGRAM_SIZE)
+		length = DATAGRAM_SIZE;
+
+	if ((gro->n_replies > 0) && (!gro_same_client(&gro->reply_addr, client_addr) || (length > gro->reply_size)
+			|| (gro->n_replies >= UDP_GRO_MAX_SEGMENTS) || ((gro->replies_length + length) > UDP_GRO_MAX_PAYLOAD)))
+		udp_gro_flush(gro);
+
+	memcpy(&gro->replies[gro->replies_length], buffer, length);
+	gro->replies_length += length;
+	if (gro->n_replies == 0)
+		gro->reply_size = length;
+	gro->reply_addr = *client_addr;
+	gro->n_replies++;
+
+	if ((gro->offset >= gro->length) || (length < gro->reply_size))
+		udp_gro_flush(gro);
+
+	return length;
+}
+
+
+
+/*
+ * Sends gathered replies in one sendmsg(), split by the kernel into reply_size datagrams (UDP_SEGMENT)
+ */
+void udp_gro_flush(udp_gro* gro) {
+
+	if (gro->n_replies == 0)
+		return;
+
+	struct iovec iov = { gro->replies, gro->replies_length };
+	char control[CMSG_SPACE(sizeof(uint16_t))];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_name = &gro->reply_addr;
+	msg.msg_namelen = sizeof(gro->reply_addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (gro->n_replies > 1) {
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		uint16_t segment_size = (uint16_t) gro->reply_size;
+		memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+	}
+
+	sendmsg(gro->socket, &msg, 0);
+	gro->sends++;
+	gro->replies_sent += gro->n_replies;
+	gro->n_replies = 0;
+	gro->replies_length = 0;
+}
+
+
+
+void udp_gro_print_stats(udp_gro* gro) {
+
+	printf("IOT_SERVER: UDP GRO: %lu datagrams in %lu receives (%lu coalesced) - %lu replies in %lu sends - %.3f syscalls per datagram\n",
+			gro->datagrams, gro->receives, gro->coalesced, gro->replies_sent, gro->sends,
+			(gro->datagrams > 0) ? (double) (gro->receives + gro->sends) / gro->datagrams : 0.0);
+}
+
+
+
+/*
+ * Loopback load of small one-sample datagrams, sent in UDP_SEGMENT bursts (as a NIC with GRO would deliver a busy
+ * flow): received per packet by a plain socket, then coalesced by a UDP_GRO socket replying with UDP_SEGMENT.
+ * Reports datagrams per second, receiver CPU time and syscalls per datagram.
+ */
+void udp_gro_benchmark(int n_datagrams) {
+
+	uint8_t datagram[DATAGRAM_SIZE] = {'\0'};
+	datagram[0] = DATAGRAM_REQ_SEND_DATA;
+	datagram[1] = DATAGRAM_SAMPLE_SIZE;
+	int length = DATAGRAM_HEADER_SIZE + DATAGRAM_SAMPLE_SIZE + 1;
+	timing_rates timings = { DEFAULT_RATE_SAMPLING, DEFAULT_RATE_SERVER_STREAM, DEFAULT_RATE_SERVER_STATS_CALC };
+
+	printf("IOT_SERVER: == UDP GRO/GSO Benchmark (%d datagrams of %d bytes, bursts of %d) ==\n", n_datagrams, length, UDP_GRO_MAX_SEGMENTS);
+
+	int pass;
+	for (pass = 0; pass < 2; pass++) {
+		gro_bench_sender sender = { 0, n_datagrams, datagram, length, 0, 0 };
+		int server_socket = gro_bench_socket(&sender.port);
+		static udp_gro gro;
+		if ((server_socket < 0) || ((pass == 1) && (udp_gro_init(&gro, server_socket) < 0))) {
+			printf("IOT_SERVER: >> %s: not available\n", (pass == 1) ? "GRO/GSO" : "per-packet");
+			if (server_socket >= 0)
+				close(server_socket);
+			continue;
+		}
+
+		pthread_t sender_thread;
+		pthread_create(&sender_thread, NULL, gro_bench_send, &sender);
+		double start = gro_now_secs(CLOCK_MONOTONIC);
+		double start_cpu = gro_now_secs(CLOCK_THREAD_CPUTIME_ID);
+
+		long int received = 0;
+		unsigned long syscalls = 0;
+		while (true) {
+			struct sockaddr_in client_addr;
+			uint8_t buffer_stack[DATAGRAM_SIZE];
+			uint8_t* buffer_recv = buffer_stack;
+			uint8_t buffer_reply[DATAGRAM_SIZE] = {'\0'};
+			int recv_len;
+
+			if (pass == 1) {
+				recv_len = udp_gro_recv(&gro, &client_addr, &buffer_recv);
+			} else {
+				memset(buffer_recv, 0, DATAGRAM_SIZE);
+				memset(&client_addr, 0, sizeof(client_addr));
+				socklen_t client_addr_len = sizeof(client_addr);
+				recv_len = (int) recvfrom(server_socket, buffer_recv, DATAGRAM_SIZE, 0, (struct sockaddr *) &client_addr, &client_addr_len);
+				syscalls++;
+			}
+			// Sender done: receive timed out
+			if (recv_len < 0)
+				break;
+
+			received++;
+			server_build_reply(buffer_recv, buffer_reply, &timings);
+			int reply_len = codec_datagram_size(buffer_reply);
+			if (pass == 1) {
+				udp_gro_send(&gro, &client_addr, buffer_reply, reply_len);
+			} else {
+				sendto(server_socket, buffer_reply, reply_len, 0, (struct sockaddr *) &client_addr, sizeof(client_addr));
+				syscalls++;
+			}
+		}
+
+		pthread_join(sender_thread, NULL);
+		// Final receive timeout is not part of the measurement
+		double elapsed_secs = gro_now_secs(CLOCK_MONOTONIC) - start - 0.2;
+		double cpu_secs = gro_now_secs(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+		if (pass == 1)
+			syscalls = gro.receives + gro.sends;
+		close(server_socket);
+
+		printf("IOT_SERVER: >> %-10s: %.0f datagrams/s - receiver %.2f us CPU per datagram - %.3f syscalls per datagram - %ld received (%ld replies lost)\n",
+				(pass == 1) ? "GRO/GSO" : "per-packet", received / elapsed_secs, 1e6 * cpu_secs / ((received > 0) ? received : 1),
+				(double) syscalls / ((received > 0) ? received : 1), received, sender.lost);
+	}
+}
+
+
+
+static bool gro_same_client(struct sockaddr_in* a, struct sockaddr_in* b) {
+
+	return (a->sin_addr.s_addr == b->sin_addr.s_addr) && (a->sin_port == b->sin_port);
+}
+
+
+
+static int gro_bench_socket(uint16_t* port) {
+
+	int bench_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (bench_socket < 0)
+		return -1;
+
+	struct timeval intervals = { 0, 200000 };
+	setsockopt(bench_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals));
+
+	struct sockaddr_in bench_addr;
+	memset(&bench_addr, 0, sizeof(bench_addr));
+	bench_addr.sin_family = AF_INET;
+	bench_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t bench_addr_len = sizeof(bench_addr);
+	if ((bind(bench_socket, (struct sockaddr *) &bench_addr, sizeof(bench_addr)) < 0)
+			|| (getsockname(bench_socket, (struct sockaddr *) &bench_addr, &bench_addr_len) < 0)) {
+		close(bench_socket);
+		return -1;
+	}
+
+	*port = bench_addr.sin_port;
+	return bench_socket;
+}
+
+
+
+/*
+ * Sends one UDP_SEGMENT burst of UDP_GRO_MAX_SEGMENTS datagrams, then waits for their replies (missing after 200 ms: lost)
+ */
+static void* gro_bench_send(void* arg) {
+
+	gro_bench_sender* sender = (gro_bench_sender*) arg;
+	int send_socket = gro_bench_socket(&(uint16_t) { 0 });
+	if (send_socket < 0) {
+		sender->lost = sender->n_datagrams;
+		return NULL;
+	}
+
+	struct sockaddr_in server_addr;
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server_addr.sin_port = sender->port;
+	connect(send_socket, (struct sockaddr *) &server_addr, sizeof(server_addr));
+
+	uint8_t burst[UDP_GRO_MAX_SEGMENTS * DATAGRAM_SIZE];
+	int segment;
+	for (segment = 0; segment < UDP_GRO_MAX_SEGMENTS; segment++)
+		memcpy(&burst[segment * sender->length], sender->datagram, sender->length);
+
+	uint8_t buffer_reply[DATAGRAM_SIZE];
+	long int sent = 0;
+	while (sent < sender->n_datagrams) {
+		int n_burst = ((sender->n_datagrams - sent) < UDP_GRO_MAX_SEGMENTS) ? (int) (sender->n_datagrams - sent) : UDP_GRO_MAX_SEGMENTS;
+
+		struct iovec iov = { burst, (size_t) (n_burst * sender->length) };
+		char control[CMSG_SPACE(sizeof(uint16_t))];
+		memset(control, 0, sizeof(control));
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		uint16_t segment_size = (uint16_t) sender->length;
+		memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+		sendmsg(send_socket, &msg, 0);
+		sent += n_burst;
+
+		int reply;
+		for (reply = 0; reply < n_burst; reply++) {
+			if (recv(send_socket, buffer_reply, DATAGRAM_SIZE, 0) > 0) {
+				sender->acked++;
+			} else {
+				sender->lost += n_burst - reply;
+				break;
+			}
+		}
+	}
+
+	close(send_socket);
+	return NULL;
+}
+
+
+
+static double gro_now_secs(clockid_t clock) {
+
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
@@ -0,0 +1,68 @@
+/*
+ * udp_gro.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef UDP_GRO_H_
+#define UDP_GRO_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <netinet/in.h>		// For sockaddr_in struct
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define UDP_GRO_BUFFER_SIZE		65536	// Largest coalesced receive (one GRO packet)
+#define UDP_GRO_MAX_SEGMENTS	64		// Replies sent per UDP_SEGMENT sendmsg()
+#define UDP_GRO_MAX_PAYLOAD		65507	// IPv4 UDP payload limit for a segmented send
+
+
+
+/* TYPE DEFINITIONS */
+
+// Classic socket with UDP_GRO: one recvmsg() returns several same-flow datagrams of gso_size bytes each (last may be
+// shorter), handed out one at a time. Replies to them are gathered and sent as one UDP_SEGMENT (GSO) datagram.
+typedef struct {
+	int					socket;
+
+	// Current coalesced receive (extra DATAGRAM_SIZE: parsers may read a full datagram past the last segment)
+	uint8_t				buffer		[UDP_GRO_BUFFER_SIZE + DATAGRAM_SIZE];
+	int					length;
+	int					offset;				// Start of next segment to hand out
+	int					segment_size;
+	struct sockaddr_in	client_addr;
+
+	// Replies gathered for one client, all of reply_size bytes except possibly the last
+	uint8_t				replies		[UDP_GRO_MAX_SEGMENTS * DATAGRAM_SIZE];
+	int					replies_length;
+	int					reply_size;
+	int					n_replies;
+	struct sockaddr_in	reply_addr;
+
+	unsigned long		receives;			// recvmsg() calls returning data
+	unsigned long		coalesced;			// ...of which held more than one datagram
+	unsigned long		datagrams;
+	unsigned long		sends;				// sendmsg() calls
+	unsigned long		replies_sent;
+} udp_gro;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		udp_gro_init			(udp_gro* gro, int server_socket);		// returns -1 if kernel lacks UDP_GRO
+int		udp_gro_recv			(udp_gro* gro, struct sockaddr_in* client_addr, uint8_t** datagram);
+int		udp_gro_send			(udp_gro* gro, struct sockaddr_in* client_addr, uint8_t* buffer, int length);
+void	udp_gro_flush			(udp_gro* gro);
+void	udp_gro_print_stats		(udp_gro* gro);
+void	udp_gro_benchmark		(int n_datagrams);
+
+
+
+#endif /* UDP_GRO_H_ */
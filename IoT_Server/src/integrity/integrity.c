@@ -0,0 +1,142 @@
+/*
+ * integrity.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset()
+#include <time.h>			// For clock_gettime()
+
+#include "iot_codec.h"
+#include "integrity.h"
+
+
+
+#define INTEGRITY_BENCH_DATAGRAMS	64		// Distinct datagrams cycled through by the benchmark (power of 2)
+
+
+
+static double	integrity_now_ns	(void);
+
+
+
+/*
+ * Verifies trailing checksum before anything is decoded. Datagrams without one pass, unless their source negotiated
+ * COMM_CAP_CRC32C (a corrupted End-Of-Package byte must not skip the check); its handshake is never checksummed.
+ * returns true if datagram may be decoded
+ */
+bool integrity_check(integrity_stats* stats, client_registry* registry, uint8_t* datagram, int length, struct sockaddr_in* client_addr) {
+
+	int status = datagram_check_crc32c(datagram, length);
+	if (status > 0) {
+		stats->verified++;
+		return true;
+	}
+	if (status < 0) {
+		stats->failed++;
+		return false;
+	}
+
+	if (datagram[0] != DATAGRAM_REQ_COMM) {
+		client_session* session = registry_lookup(registry, client_addr->sin_addr.s_addr, client_addr->sin_port);
+		if ((session != NULL) && (session->capabilities & COMM_CAP_CRC32C)) {
+			stats->missing++;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+/*
+ * Replies to checksummed requests are checksummed too (request's EOP flag only read if received)
+ */
+int integrity_seal_reply(uint8_t* buffer_recv, int recv_len, uint8_t* buffer_reply, int length) {
+
+	int eop = codec_datagram_eop(buffer_recv);
+	if ((eop >= recv_len) || !(buffer_recv[eop] & DATAGRAM_EOP_CRC32C))
+		return length;
+	return datagram_seal_crc32c(buffer_reply, length);
+}
+
+
+
+void integrity_print_stats(integrity_stats* stats) {
+
+	if ((stats->verified + stats->failed + stats->missing) == 0)
+		return;
+	printf("IOT_SERVER: CRC32C (%s): %lu verified - %lu dropped on mismatch - %lu dropped without checksum\n",
+			crc32c_hw_available() ? "hardware" : "table", stats->verified, stats->failed, stats->missing);
+}
+
+
+
+/*
+ * Checksum cost per datagram for a handshake-sized, a typical (10 samples) and a full datagram: table-driven,
+ * hardware (if available) and the full receive-path check (dispatch included)
+ */
+void integrity_benchmark(int n_datagrams) {
+
+	int sizes[3] = { DATAGRAM_HEADER_SIZE + 1 + DATAGRAM_CRC_SIZE, DATAGRAM_HEADER_SIZE + (10 * DATAGRAM_SAMPLE_SIZE) + 1 + DATAGRAM_CRC_SIZE, DATAGRAM_SIZE };
+	static uint8_t datagrams[INTEGRITY_BENCH_DATAGRAMS][DATAGRAM_SIZE];
+
+	printf("IOT_SERVER: == CRC32C Benchmark (%d datagrams per size, %s) ==\n", n_datagrams,
+			crc32c_hw_available() ? "hardware CRC instructions available" : "no hardware CRC instructions: table only");
+
+	int size_index;
+	for (size_index = 0; size_index < 3; size_index++) {
+		int length = sizes[size_index];
+		int data_length = length - DATAGRAM_HEADER_SIZE - 1 - DATAGRAM_CRC_SIZE;
+		int index;
+		for (index = 0; index < INTEGRITY_BENCH_DATAGRAMS; index++) {
+			memset(datagrams[index], index, DATAGRAM_SIZE);
+			codec_datagram_begin(datagrams[index], DATAGRAM_REQ_SEND_DATA, data_length);
+			datagram_seal_crc32c(datagrams[index], length - DATAGRAM_CRC_SIZE);
+		}
+
+		// Rotating over distinct datagrams (cache-resident) keeps iterations independent; sink keeps results live
+		volatile uint32_t sink = 0;
+		double per_datagram[3] = { -1, -1, -1 };
+		int method;
+		for (method = 0; method < 3; method++) {
+			if ((method == 1) && !crc32c_hw_available())
+				continue;
+
+			double start = integrity_now_ns();
+			int iteration;
+			for (iteration = 0; iteration < n_datagrams; iteration++) {
+				uint8_t* datagram = datagrams[iteration & (INTEGRITY_BENCH_DATAGRAMS - 1)];
+				if (method == 0)
+					sink += crc32c_sw(0, datagram, (size_t) (length - DATAGRAM_CRC_SIZE));
+#if defined(CRC32C_HW_X86) || defined(CRC32C_HW_ARM)
+				else if (method == 1)
+					sink += crc32c_hw(0, datagram, (size_t) (length - DATAGRAM_CRC_SIZE));
+#endif
+				else
+					sink += (uint32_t) datagram_check_crc32c(datagram, length);
+			}
+			per_datagram[method] = (integrity_now_ns() - start) / n_datagrams;
+		}
+		(void) sink;
+
+		printf("IOT_SERVER: >> %4d bytes: table %.1f ns - hardware ", length, per_datagram[0]);
+		if (per_datagram[1] >= 0)
+			printf("%.1f ns (%.2f GB/s)", per_datagram[1], (length - DATAGRAM_CRC_SIZE) / per_datagram[1]);
+		else
+			printf("n/a");
+		printf(" - receive-path check %.1f ns per datagram\n", per_datagram[2]);
+	}
+}
+
+
+
+static double integrity_now_ns(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1e9) + now.tv_nsec;
+}
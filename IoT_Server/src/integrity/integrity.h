@@ -0,0 +1,41 @@
+/*
+ * integrity.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef INTEGRITY_H_
+#define INTEGRITY_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <netinet/in.h>		// For sockaddr_in struct
+
+#include "iot_lib.h"
+#include "crc32c.h"
+#include "registry/client_registry.h"
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	unsigned long	verified;		// Checksum matched
+	unsigned long	failed;			// Checksum did not match (or datagram cut short)
+	unsigned long	missing;		// No checksum from a client that negotiated COMM_CAP_CRC32C
+} integrity_stats;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+bool	integrity_check			(integrity_stats* stats, client_registry* registry, uint8_t* datagram, int length, struct sockaddr_in* client_addr);
+int		integrity_seal_reply	(uint8_t* buffer_recv, int recv_len, uint8_t* buffer_reply, int length);	// returns reply length
+void	integrity_print_stats	(integrity_stats* stats);
+void	integrity_benchmark		(int n_datagrams);
+
+
+
+#endif /* INTEGRITY_H_ */
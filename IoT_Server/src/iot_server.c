@@ -19,67 +19,421 @@
 #include <unistd.h>			// For close()
 #include <arpa/inet.h>		// For inet_aton()
 #include <sys/time.h>		// For timeval struct
+#include <time.h>			// For clock_gettime()
+#include <signal.h>			// For sigaction()
 
 #include "iot_lib.h"
 #include "iot_server.h"
+#include "capture/capture.h"
+#include "capture/replay.h"
+#include "range/range_query.h"
+#include "pubsub/pubsub_tail.h"
 
 
 
+bool server_quiet = false;						// Set by -q option: skip per-sample console output
+volatile sig_atomic_t server_running = 1;		// Cleared by SIGINT/SIGTERM to close capture file cleanly
+
+static void	sig_handler			(int _);
+
+
 
 int main(int argc, char* argv[]) {
 
-	/* STEP 1 - Parse command line parameters: sampling rate and server streaming rate */
+	/* STEP 1 - Parse command line options and parameters: sampling rate and server streaming rate */
+	server_options options;
 	timing_rates timings;
-	parse_param_rates(&timings, argc, argv);
+	int first_param = parse_param_options(&options, argc, argv);
+	parse_param_rates(&timings, argc - first_param + 1, &argv[first_param - 1]);
+
+	if (options.benchmark_clients > 0) {
+		registry_benchmark((uint32_t) options.benchmark_clients);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.benchmark_datagrams > 0) {
+		exporter_benchmark(options.benchmark_datagrams, (options.export_prefix != NULL) ? options.export_prefix : EXPORT_BENCHMARK_PREFIX);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.benchmark_socket > 0) {
+		uring_socket_benchmark(options.benchmark_socket);
+		udp_gro_benchmark(options.benchmark_socket);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.benchmark_latency > 0) {
+		busy_poll_benchmark(options.benchmark_latency, options.busy_poll_cpu, options.busy_poll_us);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.benchmark_anomaly > 0) {
+		anomaly_benchmark(options.benchmark_anomaly);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.benchmark_crc > 0) {
+		integrity_benchmark(options.benchmark_crc);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.benchmark_codec > 0) {
+		codec_benchmark(options.benchmark_codec);
+		return EXIT_SUCCESS;
+	}
+
+	if (options.range_query != NULL) {
+		if (range_query_run(options.range_query) < 0) {
+			print_error_server(9);
+			exit(EXIT_FAILURE);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (options.pubsub_tail != NULL) {
+		if (pubsub_tail_run(options.pubsub_tail, options.pubsub_unix_path) < 0) {
+			print_error_server(16);
+			exit(EXIT_FAILURE);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (options.stats_shm_watch != NULL) {
+		if (stats_shm_watch(options.stats_shm_watch) < 0) {
+			print_error_server(14);
+			exit(EXIT_FAILURE);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	static server_state state;		// Static: sample buffers too large for the stack
+	server_state_init(&state);
+
+	static exporter export_state;
+	if (options.export_prefix != NULL) {
+		if (exporter_start(&export_state, options.export_prefix) < 0) {
+			print_error_server(10);
+			exit(EXIT_FAILURE);
+		}
+		state.exporter = &export_state;
+	}
+
+	static stats_shm shm_state;
+	if (options.stats_shm_name != NULL) {
+		if (stats_shm_create(&shm_state, options.stats_shm_name) < 0) {
+			print_error_server(13);
+			exit(EXIT_FAILURE);
+		}
+		state.shm = &shm_state;
+		printf("IOT_SERVER: Publishing live stats into shared memory %s (%d client records)\n", options.stats_shm_name, STATS_SHM_MAX_CLIENTS);
+	}
+
+	static anomaly_detector anomaly_state;
+	if (options.anomaly_alerts != NULL) {
+		if (anomaly_init(&anomaly_state, options.anomaly_alerts) < 0) {
+			print_error_server(17);
+			exit(EXIT_FAILURE);
+		}
+		state.anomaly = &anomaly_state;
+		printf("IOT_SERVER: Detecting anomalies on every sample (EWMA z-score > %.1f, CUSUM > %.1f), alerts to %s\n",
+				ANOMALY_Z_SPIKE, ANOMALY_CUSUM_LIMIT, (strcmp(options.anomaly_alerts, "-") == 0) ? "stdout" : options.anomaly_alerts);
+	}
+
+	// Replay mode: push capture file through processing path instead of serving clients
+	if (options.replay_path != NULL) {
+		replay_run(&options, &timings, &state);
+		if (state.exporter != NULL)
+			exporter_stop(state.exporter);
+		if (state.shm != NULL)
+			stats_shm_destroy(state.shm);
+		if (state.anomaly != NULL)
+			anomaly_free(state.anomaly);
+		registry_free(&state.registry);
+		range_store_free(&state.ranges);
+		return EXIT_SUCCESS;
+	}
+
+	FILE* capture_file = NULL;
+	if (options.capture_path != NULL) {
+		capture_file = capture_open_write(options.capture_path);
+		if (capture_file == NULL) {
+			print_error_server(6);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+
+	// Cluster node serves its own port from the member list, sharing clients with the other members
+	static cluster_node cluster_state;
+	int server_port = SERVER_PORT;
+	if (options.cluster_members != NULL) {
+		if (cluster_init(&cluster_state, options.cluster_members, &state.registry) < 0) {
+			print_error_server(4);
+			exit(EXIT_FAILURE);
+		}
+		state.cluster = &cluster_state;
+		server_port = ntohs(cluster_state.members[cluster_state.self].addr.sin_port);
+	}
 
 
 	/* STEP 2 - Initialize UDP communication socket */
+	struct sigaction stop_action;
+	memset(&stop_action, 0, sizeof(stop_action));
+	stop_action.sa_handler = sig_handler;		// No SA_RESTART: interrupts blocking recvfrom()
+	sigaction(SIGINT, &stop_action, NULL);
+	sigaction(SIGTERM, &stop_action, NULL);
+
 	struct sockaddr_in server_addr;
+	// Receives time out every second, or sooner for shorter statistics periods
 	struct timeval intervals;
-	intervals.tv_sec = 1;
-	intervals.tv_usec = 0;
-	int server_socket = server_socket_init(&server_addr, &intervals);
+	intervals.tv_sec = (timings.server_stats_calc < 1000) ? 0 : 1;
+	intervals.tv_usec = (timings.server_stats_calc < 1000) ? timings.server_stats_calc * 1000 : 0;
+	int server_socket = server_socket_init(&server_addr, &intervals, server_port);
+
+	if (state.cluster != NULL) {
+		cluster_start(state.cluster, server_socket, cluster_now_ms());
+		printf("IOT_SERVER: Cluster node of %d members (%d ring points each): forwarding clients owned by other nodes\n",
+				state.cluster->n_members, CLUSTER_VNODES);
+	}
+
+	static uring_socket uring_state;
+	uring_socket* uring = NULL;
+	if (options.io_uring) {
+		if (uring_socket_init(&uring_state, server_socket) < 0) {
+			print_error_server(11);
+			exit(EXIT_FAILURE);
+		}
+		uring = &uring_state;
+		printf("IOT_SERVER: Serving socket through io_uring (multishot receive, %d provided buffers)\n", URING_BUFFERS);
+	}
+
+	static udp_gro gro_state;
+	udp_gro* gro = NULL;
+	if (options.udp_gro) {
+		if (udp_gro_init(&gro_state, server_socket) < 0) {
+			print_error_server(12);
+			exit(EXIT_FAILURE);
+		}
+		gro = &gro_state;
+		printf("IOT_SERVER: Serving socket with UDP GRO/GSO (up to %d replies per send)\n", UDP_GRO_MAX_SEGMENTS);
+	}
 
-	int samples_all_index = 0;
-	sample_data samples_all		[MAX_RATE_SERVER_STATS_CALC];
-	sample_data samples_stream	[MAX_SAMPLING_RATIO];
+	static pubsub pubsub_state;		// Static: ring too large for the stack
+	if (options.pubsub) {
+		if (pubsub_start(&pubsub_state, server_socket, options.pubsub_unix_path, options.pubsub_networks) < 0) {
+			print_error_server(15);
+			exit(EXIT_FAILURE);
+		}
+		state.pubsub = &pubsub_state;
+		printf("IOT_SERVER: Fanning out samples to subscribers over UDP%s%s (up to %d subscribers)\n",
+				(options.pubsub_unix_path != NULL) ? " and " : "", (options.pubsub_unix_path != NULL) ? options.pubsub_unix_path : "", PUBSUB_MAX_SUBSCRIBERS);
+	}
 
+	// Default source rate follows streaming rate, so clients given fast rates are not shed. Header checks are always run:
+	// -A 0 only disables the rate limits
+	static admission_control admission_state;
+	admission_control* admission = &admission_state;
+	if (options.admission_global_rate > 0) {
+		float source_rate = options.admission_source_rate;
+		if (source_rate < 0) {
+			source_rate = ADMISSION_SOURCE_RATIO * 1000.0 / timings.server_stream;
+			if (source_rate < ADMISSION_SOURCE_MIN_RATE)
+				source_rate = ADMISSION_SOURCE_MIN_RATE;
+		}
+		admission_init(admission, source_rate, options.admission_global_rate);
+		printf("IOT_SERVER: Admission control: %.0f datagrams/s per source (burst %d) - %.0f datagrams/s in total\n",
+				source_rate, ADMISSION_SOURCE_BURST, options.admission_global_rate);
+	} else {
+		admission_init(admission, 0, 0);
+		printf("IOT_SERVER: Admission control: no rate limits (malformed datagrams still dropped)\n");
+	}
+
+
+	// Rates given out (handshakes and acknowledgements) follow ingest load instead of staying as configured
+	static rate_control rate_state;
+	rate_control* rate = NULL;
+	if (options.rate_target > 0) {
+		rate_control_init(&rate_state, &timings, options.rate_target);
+		rate = &rate_state;
+		printf("IOT_SERVER: Rate control: keeping ingest utilization below %.0f %% (rates between x%.2f and x%.2f configured)\n",
+				options.rate_target * 100, rate->min_scale, rate->max_scale);
+	}
+	timing_rates* reply_timings = (rate != NULL) ? &rate->current : &timings;
+
+	// Per-stage latency of datagrams from clients tracing (COMM_CAP_TRACE), reported per statistics period, and ACK
+	// latency of every datagram received through the classic path (kernel receive stamps)
+	static latency_trace tracer;
+	if ((uring == NULL) && (gro == NULL) && (latency_trace_stamp_socket(server_socket) < 0))
+		printf("IOT_SERVER: Kernel receive timestamps not available: ACK latency not reported\n");
+
+	// Low-latency mode set up last: threads started above stay off the pinned CPU
+	static busy_poll busy_state;
+	busy_poll* busy = NULL;
+	if (options.busy_poll_cpu >= 0) {
+		if (busy_poll_init(&busy_state, server_socket, options.busy_poll_cpu, options.busy_poll_us) < 0) {
+			print_error_server(18);
+			exit(EXIT_FAILURE);
+		}
+		busy = &busy_state;
+		printf("IOT_SERVER: Low-latency mode: ingest pinned to CPU %d, spinning on non-blocking receives (SO_BUSY_POLL %s) - memory %s\n",
+				busy->cpu, (busy->busy_poll_us == 0) ? "off" : (busy->socket_busy_poll ? "on" : "refused"),
+				busy->locked ? "locked and prefaulted" : "NOT locked (needs CAP_IPC_LOCK or higher memlock limit)");
+	}
 
-	server_stats stats = { -1, -1, -1 };
 	int comm_established_flag = false;
-	int stats_secs = 0;
-	while(1) {
+	int64_t stats_flushed_ms = server_now_ms();
+	while(server_running) {
 		/* STEP 3 - Process incoming datagrams from client */
 
+		// Classic path receives into (and zeroes) the stack buffer, sized for cluster frames; io_uring and GRO point into their own buffers instead
 		struct sockaddr_in client_addr;
-		uint8_t buffer_recv[DATAGRAM_SIZE] = {'\0'};
-		int recv_len = server_socket_listen(server_socket, &client_addr, comm_established_flag, timings.server_stats_calc, &stats_secs, buffer_recv);
+		uint8_t buffer_stack[DATAGRAM_CLUSTER_SIZE];
+		uint8_t* buffer_recv = buffer_stack;
+		int64_t received_ns = 0;
+		int recv_len = ((uring != NULL) || (gro != NULL))
+				? server_io_listen(uring, gro, admission, &client_addr, comm_established_flag, stats_flushed_ms + timings.server_stats_calc, &buffer_recv)
+				: server_socket_listen(server_socket, busy, admission, state.cluster, &client_addr, comm_established_flag, stats_flushed_ms + timings.server_stats_calc, buffer_recv, &received_ns);
 		comm_established_flag = 1;
+		if (!server_running)
+			break;
 
 		/* STEP 4 - After datagram reception, reply to client, then parse and save data */
 
-		if (recv_len > 0) {
-			server_socket_reply(server_socket, &client_addr, buffer_recv, &timings);
+		// Datagrams from other cluster nodes: heartbeats, session handoffs, stats reports and replies are consumed, while
+		// client datagrams they forwarded go on below as received from their client (answered back through that node)
+		bool forwarded = false;
+		if ((recv_len > 0) && (state.cluster != NULL) && cluster_frame(buffer_recv)) {
+			recv_len = cluster_receive(state.cluster, buffer_recv, recv_len, &client_addr, cluster_now_ms());
+			forwarded = (recv_len > 0);
+		}
+
+		// Corrupted datagrams are dropped unacknowledged: client retries them from its spool
+		if ((recv_len > 0) && !integrity_check(&state.integrity, &state.registry, buffer_recv, recv_len, &client_addr)) {
+			printf("IOT_SERVER: Dropped datagram failing CRC32C check\n");
+		}
+
+		// Range queries from operators are answered from the index, not processed as client traffic (in a cluster,
+		// by the node owning the client queried)
+		else if ((recv_len >= (DATAGRAM_HEADER_SIZE + DATAGRAM_QUERY_SIZE)) && (buffer_recv[0] == DATAGRAM_REQ_QUERY_RANGE)) {
+			uint32_t query_addr = codec_load_addr(codec_query_addr(codec_datagram_payload(buffer_recv)));
+			uint16_t query_port = codec_load_port(codec_query_port(codec_datagram_payload(buffer_recv)));
+			if ((state.cluster != NULL) && !forwarded && !cluster_owns(state.cluster, query_addr, query_port)) {
+				cluster_forward(state.cluster, buffer_recv, recv_len, &client_addr, query_addr, query_port);
+			} else {
+				uint8_t buffer_reply[DATAGRAM_SIZE] = {'\0'};
+				range_query_answer(&state.registry, buffer_recv, buffer_reply);
+				if (forwarded)
+					cluster_reply(state.cluster, &client_addr, buffer_reply, DATAGRAM_HEADER_SIZE + DATAGRAM_QUERY_REPLY_SIZE + 1);
+				else
+					server_socket_send(server_socket, uring, gro, &client_addr, buffer_reply, DATAGRAM_HEADER_SIZE + DATAGRAM_QUERY_REPLY_SIZE + 1);
+			}
+		}
+
+		// Subscriptions are handed to the fan-out thread, which answers them
+		else if ((recv_len >= (DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_SIZE)) && (buffer_recv[0] == DATAGRAM_REQ_SUBSCRIBE)) {
+			if (state.pubsub != NULL) {
+				pubsub_subscribe(state.pubsub, buffer_recv, &client_addr);
+			} else {
+				uint8_t buffer_reply[DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_REPLY_SIZE + 1];
+				pubsub_build_reply(buffer_reply, PUBSUB_STATUS_DISABLED);
+				server_socket_send(server_socket, uring, gro, &client_addr, buffer_reply, sizeof(buffer_reply));
+			}
+		}
 
-			int n_samples = server_datagram_parsing(buffer_recv, samples_stream);
-			server_save_samples(samples_stream, n_samples, samples_all, &samples_all_index);
-			memset(samples_stream, 0, MAX_SAMPLING_RATIO);
+		// Datagrams of clients owned by another cluster node are forwarded, and only acknowledged once their owner has
+		// processed them (its reply comes back through this node)
+		else if ((recv_len > 0) && (state.cluster != NULL) && !forwarded && !cluster_owns(state.cluster, client_addr.sin_addr.s_addr, client_addr.sin_port)) {
+			cluster_forward(state.cluster, buffer_recv, recv_len, &client_addr, client_addr.sin_addr.s_addr, client_addr.sin_port);
+		}
+
+		// Frames of gateways without a relay session (server restarted, or session expired) are refused: the error makes
+		// the gateway handshake again, so its timestamp unit is known, and resend them unacknowledged
+		else if ((recv_len > 0) && (buffer_recv[0] == DATAGRAM_REQ_SEND_RELAY) && !relay_session(&state.registry, &client_addr)) {
+			uint8_t buffer_reply[DATAGRAM_HEADER_SIZE + 1 + DATAGRAM_CRC_SIZE];
+			codec_datagram_begin(buffer_reply, DATAGRAM_REP_ERROR, 0);
+			int reply_len = integrity_seal_reply(buffer_recv, recv_len, buffer_reply, codec_datagram_size(buffer_reply));
+			if (forwarded)
+				cluster_reply(state.cluster, &client_addr, buffer_reply, reply_len);
+			else
+				server_socket_send(server_socket, uring, gro, &client_addr, buffer_reply, reply_len);
+			state.relay.refused++;
+		}
+
+		else if (recv_len > 0) {
+			int64_t received_us = latency_trace_now_us();
+			struct timespec arrival;
+			clock_gettime(CLOCK_REALTIME, &arrival);
+			int64_t arrival_ns = ((int64_t) arrival.tv_sec * 1000000000LL) + arrival.tv_nsec;
+			if (capture_file != NULL) {
+				if (capture_append(capture_file, &arrival, &client_addr, buffer_recv, recv_len) < 0)
+					print_error_server(6);
+			}
+
+			// Rates only piggybacked to clients that negotiated applying them
+			client_session* session = (rate != NULL) ? registry_lookup(&state.registry, client_addr.sin_addr.s_addr, client_addr.sin_port) : NULL;
+			rate_control* rate_update = ((session != NULL) && (session->capabilities & COMM_CAP_RATE_CONTROL)) ? rate : NULL;
+			server_socket_reply(server_socket, busy, uring, gro, forwarded ? state.cluster : NULL, &client_addr, buffer_recv, recv_len, reply_timings, rate_update, received_us);
+			if (received_ns > 0)
+				latency_trace_record_ack(&tracer, received_ns);
+			int64_t acked_us = latency_trace_now_us();
+			int n_samples = server_process_datagram(&state, buffer_recv, recv_len, &client_addr, arrival_ns);
+
+			datagram_trace trace;
+			if (latency_trace_parse(buffer_recv, recv_len, &trace))
+				latency_trace_record(&tracer, &trace, received_us, acked_us, latency_trace_now_us());
+			server_track_client(&state, &client_addr, buffer_recv, n_samples, server_now_secs(), reply_timings);
+			if (rate != NULL)
+				rate_control_record(rate, received_us, latency_trace_now_us());
 		}
 
 		/* STEP 5 - For stats timeout, compute statistics for current data */
 
-		else if (samples_all_index > 0) {
-			stats_secs = 0;
-			server_compute_stats(samples_all, &samples_all_index, &stats);
-		} else {
-			stats_secs = 0;
-			printf("IOT_SERVER: No samples to compute statistics\n");
+		// Statistics period kept by the clock, also while datagrams keep arriving (cluster nodes: heartbeats)
+		if ((recv_len < 0) || ((server_now_ms() - stats_flushed_ms) >= timings.server_stats_calc)) {
+			stats_flushed_ms = server_now_ms();
+			if (capture_file != NULL)
+				fflush(capture_file);
+			registry_expire(&state.registry, server_now_secs());
+			struct timespec now;
+			clock_gettime(CLOCK_REALTIME, &now);
+			server_stats_flush(&state, ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec);
+			if (uring != NULL)
+				uring_socket_print_stats(uring);
+			if (gro != NULL)
+				udp_gro_print_stats(gro);
+			admission_print_stats(admission);
+			if (busy != NULL)
+				busy_poll_print_stats(busy);
+			latency_trace_print(&tracer);
+			latency_trace_print_ack(&tracer, (busy != NULL) ? "busy-poll" : "blocking");
+			latency_trace_reset(&tracer);
+			if (rate != NULL)
+				rate_control_print_stats(rate);
 		}
 
+		if (rate != NULL)
+			rate_control_tick(rate, server_socket, latency_trace_now_us());
+
 
 	}
 
 
+	if (capture_file != NULL)
+		fclose(capture_file);
+	if (state.exporter != NULL)
+		exporter_stop(state.exporter);
+	if (state.shm != NULL)
+		stats_shm_destroy(state.shm);
+	if (state.pubsub != NULL)
+		pubsub_stop(state.pubsub);
+	if (state.anomaly != NULL)
+		anomaly_free(state.anomaly);
+	if (state.cluster != NULL)
+		cluster_leave(state.cluster);
+	registry_free(&state.registry);
+	range_store_free(&state.ranges);
+	if (uring != NULL)
+		uring_socket_free(uring);
 	close(server_socket);
 	return EXIT_SUCCESS;
 }
@@ -88,8 +442,206 @@ int main(int argc, char* argv[]) {
 
 
 
+/**
+ * parse_param_options
+ * parses optional flags preceding the timing rates
+ * returns index in argv of the first timing rate parameter
+ */
+int parse_param_options(server_options* options, int argc, char* argv[]) {
+
+	options->capture_path = NULL;
+	options->replay_path = NULL;
+	options->replay_speed = 1;
+	options->replay_socket = false;
+	options->quiet = false;
+	options->benchmark_clients = 0;
+	options->range_query = NULL;
+	options->export_prefix = NULL;
+	options->benchmark_datagrams = 0;
+	options->io_uring = false;
+	options->benchmark_socket = 0;
+	options->udp_gro = false;
+	options->admission_source_rate = -1;
+	options->admission_global_rate = ADMISSION_GLOBAL_RATE;
+	options->benchmark_crc = 0;
+	options->stats_shm_name = NULL;
+	options->stats_shm_watch = NULL;
+	options->pubsub = false;
+	options->pubsub_unix_path = NULL;
+	options->pubsub_networks = NULL;
+	options->pubsub_tail = NULL;
+	options->rate_target = 0;
+	options->anomaly_alerts = NULL;
+	options->benchmark_anomaly = 0;
+	options->cluster_members = NULL;
+	options->busy_poll_cpu = -1;
+	options->busy_poll_us = 0;
+	options->benchmark_latency = 0;
+	options->benchmark_codec = 0;
+
+	int option;
+	while ((option = getopt(argc, argv, "+c:r:x:uqb:Q:e:B:i:n:gA:k:S:w:pU:N:T:R:a:D:C:L:P:E:")) != -1) {
+		switch(option) {
+			case 'A':
+				// <per-source rate>[,<global rate>], 0 disables admission control
+				if (sscanf(optarg, "%f,%f", &options->admission_source_rate, &options->admission_global_rate) < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				if (options->admission_source_rate <= 0)
+					options->admission_global_rate = 0;
+				else if (options->admission_global_rate < options->admission_source_rate)
+					options->admission_global_rate = options->admission_source_rate;
+				break;
+			case 'a':
+				options->anomaly_alerts = optarg;
+				break;
+			case 'b':
+				options->benchmark_clients = atoi(optarg);
+				if ((options->benchmark_clients < 1) || (options->benchmark_clients > 16777216)) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'D':
+				options->benchmark_anomaly = atoi(optarg);
+				if (options->benchmark_anomaly < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'E':
+				options->benchmark_codec = atoi(optarg);
+				if (options->benchmark_codec < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'B':
+				options->benchmark_datagrams = atoi(optarg);
+				if (options->benchmark_datagrams < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'c':
+				options->capture_path = optarg;
+				break;
+			case 'C':
+				options->cluster_members = optarg;
+				break;
+			case 'e':
+				options->export_prefix = optarg;
+				break;
+			case 'g':
+				options->udp_gro = true;
+				break;
+			case 'i':
+				if (strcmp(optarg, "uring") == 0) {
+					options->io_uring = true;
+				} else if (strcmp(optarg, "classic") != 0) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'L':
+				// <cpu>[,<SO_BUSY_POLL microseconds>]
+				if ((sscanf(optarg, "%d,%d", &options->busy_poll_cpu, &options->busy_poll_us) < 1) || (options->busy_poll_cpu < 0) || (options->busy_poll_us < 0)) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'k':
+				options->benchmark_crc = atoi(optarg);
+				if (options->benchmark_crc < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'n':
+				options->benchmark_socket = atoi(optarg);
+				if (options->benchmark_socket < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'r':
+				options->replay_path = optarg;
+				break;
+			case 'x':
+				options->replay_speed = atof(optarg);
+				if (options->replay_speed < 0) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'u':
+				options->replay_socket = true;
+				break;
+			case 'p':
+				options->pubsub = true;
+				break;
+			case 'N':
+				options->pubsub = true;
+				options->pubsub_networks = optarg;
+				break;
+			case 'P':
+				options->benchmark_latency = atoi(optarg);
+				if (options->benchmark_latency < 1) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'q':
+				options->quiet = true;
+				break;
+			case 'Q':
+				options->range_query = optarg;
+				break;
+			case 'R':
+				options->rate_target = atof(optarg);
+				if ((options->rate_target <= 0) || (options->rate_target > 1)) {
+					print_error_server(4);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'S':
+				options->stats_shm_name = optarg;
+				break;
+			case 'T':
+				options->pubsub_tail = optarg;
+				break;
+			case 'U':
+				options->pubsub = true;
+				options->pubsub_unix_path = optarg;
+				break;
+			case 'w':
+				options->stats_shm_watch = optarg;
+				break;
+			default:
+				print_error_server(4);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	// GRO/GSO applies to the recvmsg()/sendmsg() path only, cluster frames (larger than DATAGRAM_SIZE) and busy-poll
+	// receives to the classic path only
+	if ((options->udp_gro && options->io_uring) || (((options->cluster_members != NULL) || (options->busy_poll_cpu >= 0)) && (options->udp_gro || options->io_uring))) {
+		print_error_server(4);
+		exit(EXIT_FAILURE);
+	}
+
+	server_quiet = options->quiet;
+	return optind;
+}
+
+
+
+
+
 /* parse_param_rates
- * return 0 for successful parsing, 1 for incorrect format
+ * rates are given in seconds (decimals allowed, e.g. 0.01) and stored in milliseconds
+ * exits with error message for incorrect format
  */
 void parse_param_rates (timing_rates* timings, int argc, char* argv[]) {
 
@@ -104,9 +656,10 @@ void parse_param_rates (timing_rates* timings, int argc, char* argv[]) {
 
 		// Parameters provided: parse and save for subsequent datagram to client
 		case 3:
-			sampling = atoi(argv[1]);
-			server_data = atoi(argv[2]);
-			if (sampling && server_data && (sampling <= server_data) && ((server_data / sampling) <= MAX_SAMPLING_RATIO)) {
+			sampling = (int) (atof(argv[1]) * 1000 + 0.5);
+			server_data = (int) (atof(argv[2]) * 1000 + 0.5);
+			if ((sampling >= MIN_RATE_SAMPLING) && server_data && (sampling <= server_data) && ((server_data / sampling) <= MAX_SAMPLING_RATIO)
+					&& ((DEFAULT_RATE_SERVER_STATS_CALC / sampling) <= MAX_SAMPLES_STATS_CALC)) {
 				timings->sampling = sampling;
 				timings->server_stream = server_data;
 				timings->server_stats_calc = DEFAULT_RATE_SERVER_STATS_CALC;
@@ -117,10 +670,11 @@ void parse_param_rates (timing_rates* timings, int argc, char* argv[]) {
 			break;
 
 		case 4:
-			sampling = atoi(argv[1]);
-			server_data = atoi(argv[2]);
-			server_stats_calc = atoi(argv[3]);
-			if (sampling && server_data && (sampling <= server_data) && ((server_data / sampling) <= MAX_SAMPLING_RATIO) && ((server_data*2) <= server_stats_calc) && (server_stats_calc <= 600)) {
+			sampling = (int) (atof(argv[1]) * 1000 + 0.5);
+			server_data = (int) (atof(argv[2]) * 1000 + 0.5);
+			server_stats_calc = (int) (atof(argv[3]) * 1000 + 0.5);
+			if ((sampling >= MIN_RATE_SAMPLING) && server_data && (sampling <= server_data) && ((server_data / sampling) <= MAX_SAMPLING_RATIO) && ((server_data*2) <= server_stats_calc)
+					&& (server_stats_calc <= MAX_RATE_SERVER_STATS_CALC) && ((server_stats_calc / sampling) <= MAX_SAMPLES_STATS_CALC)) {
 				timings->sampling = sampling;
 				timings->server_stream = server_data;
 				timings->server_stats_calc = server_stats_calc;
@@ -145,7 +699,7 @@ void parse_param_rates (timing_rates* timings, int argc, char* argv[]) {
  * server_socket_init
  * returns socket descriptor bound to UDP server
  */
-int server_socket_init(struct sockaddr_in* server_addr, struct timeval *intervals) {
+int server_socket_init(struct sockaddr_in* server_addr, struct timeval *intervals, int server_port) {
 
 	/* Create UDP/IP socket */
 	int server_socket = socket(AF_INET, SOCK_DGRAM, 0);
@@ -165,7 +719,7 @@ int server_socket_init(struct sockaddr_in* server_addr, struct timeval *interval
 	/* Fill socket address structure */
 	memset(server_addr, 0, sizeof(*server_addr));
 	server_addr->sin_family = AF_INET;
-	server_addr->sin_port = htons(SERVER_PORT);
+	server_addr->sin_port = htons((uint16_t) server_port);
 	server_addr->sin_addr.s_addr = htonl(INADDR_ANY);		// int ia = inet_aton(SERVER_ADDR, &server_addr.sin_addr);
 
 
@@ -211,37 +765,62 @@ void server_socket_print_info(struct sockaddr_in* sockaddr) {
 
 /**
  * server_socket_listen
- * Halts execution until datagram arrives from client
- * return length of received data (-1 if no data is received: stats_flag triggered)
+ * Halts execution until datagram arrives from client (cluster heartbeats and ring kept up while waiting), or spins
+ * for it in low-latency mode (no console output per datagram there: it would delay the acknowledgement)
+ * return length of received data (-1 if no data is received: stats_flag triggered), and its kernel receive time
  */
-int server_socket_listen(int server_socket, struct sockaddr_in *client_addr, int comm_established_flag, int server_stats_timeout, int *stats_secs, uint8_t* buffer_recv) {
+int server_socket_listen(int server_socket, busy_poll* busy, admission_control* admission, cluster_node* cluster, struct sockaddr_in *client_addr, int comm_established_flag, int64_t stats_due_ms, uint8_t* buffer_recv, int64_t* received_ns) {
 
 	/* Clear reception buffer and client address structure */
-	memset(buffer_recv, 0, DATAGRAM_SIZE);
+	memset(buffer_recv, 0, DATAGRAM_CLUSTER_SIZE);
 	memset(client_addr, 0, sizeof(*client_addr));
-	socklen_t client_addr_len = sizeof(*client_addr);
+
+	/* Receive kernel timestamp alongside datagram */
+	struct iovec iov = { buffer_recv, DATAGRAM_CLUSTER_SIZE };
+	uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+	struct msghdr message;
 
 	/* Waits for datagram */
 	int stats_flag = 0;
 	ssize_t recv_len = -1;
 
-	printf("IOT_SERVER: Waiting to receive datagram...\n");
-	while ((recv_len < 0) && (stats_flag == 0)) {
-		recv_len = recvfrom(server_socket, buffer_recv, DATAGRAM_SIZE, 0, (struct sockaddr *) client_addr, &client_addr_len);
+	if (busy == NULL)
+		printf("IOT_SERVER: Waiting to receive datagram...\n");
+	while ((recv_len < 0) && (stats_flag == 0) && server_running) {
+		memset(&message, 0, sizeof(message));
+		message.msg_name = client_addr;
+		message.msg_namelen = sizeof(*client_addr);
+		message.msg_iov = &iov;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+		recv_len = (busy != NULL) ? busy_poll_recv(busy, server_socket, &message) : recvmsg(server_socket, &message, 0);
+		if (cluster != NULL)
+			cluster_tick(cluster, cluster_now_ms());
+
+		// Truncated datagrams (larger than a cluster frame) are dropped: their tail is missing
+		if ((recv_len >= 0) && (message.msg_flags & MSG_TRUNC)) {
+			recv_len = -1;
+			continue;
+		}
 
-		if (comm_established_flag == 1) {
-			*stats_secs += 1;
-			if (*stats_secs >= server_stats_timeout) {
-				stats_flag = 1;
-			}
+		// Shed datagrams are dropped here: not printed, answered, nor counted towards the statistics timeout
+		if ((recv_len >= 0) && !server_admit(admission, cluster, buffer_recv, (int) recv_len, client_addr)) {
+			recv_len = -1;
+			continue;
+		}
+
+		if ((recv_len < 0) && (comm_established_flag == 1) && (server_now_ms() >= stats_due_ms)) {
+			stats_flag = 1;
 		}
 	}
 
 	// Parse message and print buffer information
-	if (stats_flag == 0) {
+	*received_ns = (recv_len >= 0) ? latency_trace_rx_stamp(&message) : 0;
+	if ((recv_len >= 0) && (busy == NULL)) {
 		printf("IOT_SERVER: Received %d-byte datagram from %s:%d\n", (int) recv_len, inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
-	} else {
-		printf("IOT_SERVER: statistics calculation flag triggered after %d seconds\n", *stats_secs);
+	} else if (stats_flag == 1) {
+		printf("IOT_SERVER: statistics calculation flag triggered (period over without datagrams)\n");
 	}
 
 	return (int) recv_len;
@@ -252,18 +831,109 @@ int server_socket_listen(int server_socket, struct sockaddr_in *client_addr, int
 
 
 
+/**
+ * server_io_listen
+ * io_uring and GRO counterpart of server_socket_listen: buffer_recv is pointed at the datagram, left in place in
+ * the io_uring provided buffer or the coalesced GRO receive (valid until next call)
+ * return length of received data (-1 if no data is received: stats_flag triggered)
+ */
+int server_io_listen(uring_socket* uring, udp_gro* gro, admission_control* admission, struct sockaddr_in *client_addr, int comm_established_flag, int64_t stats_due_ms, uint8_t** buffer_recv) {
+
+	/* Waits for datagram */
+	int stats_flag = 0;
+	int recv_len = -1;
+
+	printf("IOT_SERVER: Waiting to receive datagram...\n");
+	while ((recv_len < 0) && (stats_flag == 0) && server_running) {
+		// GRO socket blocks up to its SO_RCVTIMEO, as the classic path; io_uring waits up to a second, or until period end
+		int64_t remaining_ms = stats_due_ms - server_now_ms();
+		int timeout_ms = (remaining_ms > 1000) ? 1000 : ((remaining_ms < 1) ? 1 : (int) remaining_ms);
+		recv_len = (uring != NULL) ? uring_socket_recv(uring, client_addr, buffer_recv, timeout_ms) : udp_gro_recv(gro, client_addr, buffer_recv);
+
+		if ((recv_len >= 0) && !server_admit(admission, NULL, *buffer_recv, recv_len, client_addr)) {
+			recv_len = -1;
+			continue;
+		}
+
+		if ((recv_len < 0) && (comm_established_flag == 1) && (server_now_ms() >= stats_due_ms)) {
+			stats_flag = 1;
+		}
+	}
+
+	// Parse message and print buffer information
+	if (recv_len >= 0) {
+		printf("IOT_SERVER: Received %d-byte datagram from %s:%d\n", recv_len, inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
+	} else if (stats_flag == 1) {
+		printf("IOT_SERVER: statistics calculation flag triggered (period over without datagrams)\n");
+	}
+
+	return recv_len;
+}
+
+
+
+
+
+/**
+ * server_admit
+ * runs admission control on a received datagram: header and declared length checked against the received bytes, then
+ * rate limits (unless disabled); datagrams of other cluster nodes skip it, as already admitted by the node they entered through
+ * returns true if datagram is to be decoded and answered
+ */
+bool server_admit(admission_control* admission, cluster_node* cluster, uint8_t* buffer_recv, int recv_len, struct sockaddr_in *client_addr) {
+
+	if ((cluster != NULL) && cluster_frame(buffer_recv) && cluster_is_member(cluster, client_addr))
+		return true;
+	if (recv_len > DATAGRAM_SIZE)
+		return false;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return admission_admit(admission, buffer_recv, recv_len, client_addr, ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec);
+}
+
+
+
+
+
+/**
+ * server_socket_send
+ * sends datagram to client through the selected socket backend (io_uring queues it, GRO gathers it into a segmented send)
+ * returns number of bytes sent or queued
+ */
+int server_socket_send(int server_socket, uring_socket* uring, udp_gro* gro, struct sockaddr_in *client_addr, uint8_t* buffer, int length) {
+
+	if (uring != NULL)
+		return uring_socket_send(uring, client_addr, buffer, length);
+	if (gro != NULL)
+		return udp_gro_send(gro, client_addr, buffer, length);
+	return (int) sendto(server_socket, buffer, length, 0, (struct sockaddr *) client_addr, sizeof(*client_addr));
+}
+
+
+
+
+
 /**
  * server_socket_reply
- * Parses received datagram, and builds and sends response
+ * Parses received datagram, and builds and sends response (handshakes of tracing clients stamped with received_us,
+ * data acknowledgements carrying current rates if rate is given); datagrams forwarded by another cluster node are
+ * answered back through that entry node; busy-polling keeps the console off the per-datagram path, as on receive
  */
-void server_socket_reply(int server_socket, struct sockaddr_in *client_addr, uint8_t* buffer_recv, timing_rates* timings) {
+void server_socket_reply(int server_socket, busy_poll* busy, uring_socket* uring, udp_gro* gro, cluster_node* entry, struct sockaddr_in *client_addr, uint8_t* buffer_recv, int recv_len, timing_rates* timings, rate_control* rate, int64_t received_us) {
 
 	/* Build and send UDP reply to client */
 	uint8_t buffer_reply[DATAGRAM_SIZE] = {"\0"};
-	server_build_reply(server_socket, buffer_recv, buffer_reply, timings);
+	server_build_reply(buffer_recv, buffer_reply, timings);
+	if ((rate != NULL) && (buffer_reply[0] == DATAGRAM_REP_SEND_DATA_OK))
+		rate_control_put_rates(rate, buffer_reply);
+	latency_trace_stamp_comm(buffer_reply, received_us);
 
-	ssize_t send_len = sendto(server_socket, buffer_reply, (((int) (buffer_reply[2] << 8) | (buffer_reply[1])) + DATAGRAM_HEADER_SIZE + 1), 0, (struct sockaddr *) client_addr, sizeof(*client_addr));
-	printf("Sent %d-byte response\n", (int) send_len);
+	int reply_len = integrity_seal_reply(buffer_recv, recv_len, buffer_reply, codec_datagram_size(buffer_reply));
+	int send_len = (entry != NULL) ? cluster_reply(entry, client_addr, buffer_reply, reply_len)
+			: server_socket_send(server_socket, uring, gro, client_addr, buffer_reply, reply_len);
+	if (busy == NULL)
+		printf("Sent %d-byte response\n", send_len);
 
 }
 
@@ -274,29 +944,41 @@ void server_socket_reply(int server_socket, struct sockaddr_in *client_addr, uin
  * server_build_reply
  * Build reply to client according to request type received
  */
-void server_build_reply(int server_socket, uint8_t* buffer_recv, uint8_t* buffer_reply, timing_rates* timings) {
+void server_build_reply(uint8_t* buffer_recv, uint8_t* buffer_reply, timing_rates* timings) {
 
-	uint8_t request_type = buffer_recv[0];
+	uint8_t request_type = codec_header_get_type(buffer_recv);
+	uint8_t* reply = codec_datagram_payload(buffer_reply);
 
 	switch(request_type) {
 		case DATAGRAM_REQ_COMM:
-			buffer_reply[0] = DATAGRAM_REP_COMM_OK;
-			buffer_reply[1] = 0x02;
-			buffer_reply[2] = 0x00;
-			buffer_reply[3] = timings->sampling;
-			buffer_reply[4] = timings->server_stream;
+			if (server_comm_capabilities(buffer_recv) & COMM_CAP_RATES_MS) {
+				// Accepted capabilities echo + sampling and streaming rates, milliseconds
+				codec_datagram_begin(buffer_reply, DATAGRAM_REP_COMM_OK, DATAGRAM_COMM_REPLY_SIZE);
+				codec_comm_reply_set_capabilities(reply, server_comm_capabilities(buffer_recv) & SERVER_CAPABILITIES);
+				codec_comm_reply_set_sampling(reply, (uint32_t) timings->sampling);
+				codec_comm_reply_set_server_stream(reply, (uint32_t) timings->server_stream);
+			} else {
+				// Legacy client: whole seconds (at least 1)
+				codec_datagram_begin(buffer_reply, DATAGRAM_REP_COMM_OK, DATAGRAM_COMM_REPLY_LEGACY_SIZE);
+				codec_comm_reply_legacy_set_sampling(reply, (uint8_t) ((timings->sampling < 1000) ? 1 : timings->sampling / 1000));
+				codec_comm_reply_legacy_set_server_stream(reply, (uint8_t) ((timings->server_stream < 1000) ? 1 : timings->server_stream / 1000));
+			}
 			break;
 
 		case DATAGRAM_REQ_SEND_DATA:
-			buffer_reply[0] = DATAGRAM_REP_SEND_DATA_OK;
-			buffer_reply[1] = 0x00;
-			buffer_reply[2] = 0x00;
+		case DATAGRAM_REQ_SEND_TAGGED_DATA:
+		case DATAGRAM_REQ_SEND_SUMMARY:
+			codec_datagram_begin(buffer_reply, DATAGRAM_REP_SEND_DATA_OK, 0);
+			break;
+
+		case DATAGRAM_REQ_SEND_RELAY:
+			// Frame sequence echo: duplicates are acknowledged again, their first copy was unpacked
+			codec_datagram_begin(buffer_reply, DATAGRAM_REP_RELAY_OK, DATAGRAM_RELAY_REPLY_SIZE);
+			codec_relay_reply_set_sequence(reply, relay_sequence(buffer_recv));
 			break;
 
 		default:
-			buffer_reply[0] = DATAGRAM_REP_ERROR;
-			buffer_reply[1] = 0x00;
-			buffer_reply[2] = 0x00;
+			codec_datagram_begin(buffer_reply, DATAGRAM_REP_ERROR, 0);
 			break;
 	}
 }
@@ -306,45 +988,56 @@ void server_build_reply(int server_socket, uint8_t* buffer_recv, uint8_t* buffer
 
 
 /**
- * server_datagram_parsing
- * parses datagram received from client
- * returns number of samples parsed
+ * server_comm_capabilities
+ * returns capability flags requested in a DATAGRAM_REQ_COMM datagram (0 for legacy clients without payload)
  */
-// float data_out[][4]
-int server_datagram_parsing(uint8_t* buffer_recv, sample_data* data_out) {
+uint8_t server_comm_capabilities(uint8_t* buffer_recv) {
 
-	int n_samples = (int) ((buffer_recv[2] << 8) | (buffer_recv[1])) / DATAGRAM_SAMPLE_SIZE;
+	return (codec_datagram_length(buffer_recv) >= 1) ? codec_datagram_payload(buffer_recv)[0] : 0;
+}
 
-	uint8_t	samples_raw	[n_samples][DATAGRAM_SAMPLE_SIZE];
 
-	int sample;
-	for (sample = 0; sample < n_samples; sample++) {
-		/* Parse samples into (row-per-sample)-matrix from raw buffer vector */
-		int index;
-		for (index = 0; index < DATAGRAM_SAMPLE_SIZE; index++) {
-			samples_raw[sample][index] = buffer_recv[DATAGRAM_HEADER_SIZE + (sample * DATAGRAM_SAMPLE_SIZE) + index];
-		}
 
 
-		// Merge 8-bit register sensor data into 16-bit structures
-		uint16_t conversions_16[5];
-		conversions_16[0] = (uint16_t) (samples_raw[sample][1] << 8 | samples_raw[sample][0]);
-		conversions_16[1] = (uint16_t) (samples_raw[sample][3] << 8 | samples_raw[sample][2]);
-		conversions_16[2] = (uint16_t) (samples_raw[sample][5] << 8 | samples_raw[sample][4]);
-		conversions_16[3] = (uint16_t) (samples_raw[sample][7] << 8 | samples_raw[sample][6]);
-		conversions_16[4] = (uint16_t) (samples_raw[sample][9] << 8 | samples_raw[sample][8]);
 
-		// Convert into percentage-based floating-point numbers.
-		data_out[sample].timestamp = (long int) conversions_16[0];
-		data_out[sample].clarity = (float) conversions_16[1] / 655.35;
-		data_out[sample].red = (float) conversions_16[2] / 655.35;
-		data_out[sample].green = (float) conversions_16[3] / 655.35;
-		data_out[sample].blue = (float) conversions_16[4] / 655.35;
+/**
+ * server_datagram_parsing
+ * parses datagram received from client (samples tagged with sensor id for DATAGRAM_REQ_SEND_TAGGED_DATA)
+ * returns number of samples parsed
+ */
+// float data_out[][4]
+int server_datagram_parsing(uint8_t* buffer_recv, int recv_len, sample_data* data_out, int timestamp_scale) {
+
+	int record_size = (codec_header_get_type(buffer_recv) == DATAGRAM_REQ_SEND_TAGGED_DATA) ? DATAGRAM_TAGGED_SAMPLE_SIZE : DATAGRAM_SAMPLE_SIZE;
+	int tag_size = record_size - DATAGRAM_SAMPLE_SIZE;
+	int n_records = codec_datagram_records(buffer_recv, recv_len, record_size);
+	uint8_t* records = codec_datagram_payload(buffer_recv);
+
+	int n_samples = 0;
+	int record;
+	for (record = 0; record < n_records; record++) {
+		// Samples read in place: tagged records are a sensor id followed by a sample
+		uint8_t* record_raw = codec_at(records, record, record_size);
+		int sensor = (tag_size > 0) ? codec_tagged_sample_get_sensor(record_raw) : 0;
+		if (sensor >= DATAGRAM_MAX_SENSORS)
+			continue;
+		uint8_t* sample_raw = record_raw + tag_size;
 
-		printf("IOT_SERVER: Sample %d from sensor at %ld seconds: Clarity %.2f %% - Red: %.2f %% - Green: %.2f %% - Blue: %.2f %% \n",
-				sample, data_out[sample].timestamp, data_out[sample].clarity, data_out[sample].red, data_out[sample].green, data_out[sample].blue);
+		// Convert into percentage-based floating-point numbers.
+		int sample = n_samples++;
+		data_out[sample].timestamp = (long int) codec_sample_get_timestamp(sample_raw) * timestamp_scale;
+		data_out[sample].sensor = sensor;
+		data_out[sample].clarity = (float) codec_sample_get_clarity(sample_raw) / 655.35;
+		data_out[sample].red = (float) codec_sample_get_red(sample_raw) / 655.35;
+		data_out[sample].green = (float) codec_sample_get_green(sample_raw) / 655.35;
+		data_out[sample].blue = (float) codec_sample_get_blue(sample_raw) / 655.35;
+
+		if (!server_quiet)
+			printf("IOT_SERVER: Sample %d from sensor %d at %ld ms: Clarity %.2f %% - Red: %.2f %% - Green: %.2f %% - Blue: %.2f %% \n",
+					sample, sensor, data_out[sample].timestamp, data_out[sample].clarity, data_out[sample].red, data_out[sample].green, data_out[sample].blue);
 	}
-	printf("\n");
+	if (!server_quiet)
+		printf("\n");
 
 	return n_samples;
 }
@@ -359,6 +1052,10 @@ int server_datagram_parsing(uint8_t* buffer_recv, sample_data* data_out) {
  */
 void server_save_samples(sample_data* samples_stream, int n_samples, sample_data* samples_all, int* samples_all_index) {
 
+	// Drop samples beyond stats window capacity instead of overrunning it
+	if ((*samples_all_index + n_samples) > MAX_SAMPLES_STATS_CALC)
+		n_samples = MAX_SAMPLES_STATS_CALC - *samples_all_index;
+
 	int sample;
 	for(sample = 0; sample < n_samples; sample++) {
 		samples_all[(*samples_all_index) + sample] = samples_stream[sample];
@@ -372,17 +1069,23 @@ void server_save_samples(sample_data* samples_stream, int n_samples, sample_data
 
 /**
  * server_compute_stats
- * computes and prints statistics for time frame selected (default 60 secs)
+ * computes and prints statistics of one sensor for time frame selected (default 60 secs), also stored per channel in stats
+ * returns number of samples of the sensor (0: nothing printed, stats untouched)
  */
-void server_compute_stats (sample_data* samples_all, int* samples_all_index, server_stats* stats) {
+int server_compute_stats (sample_data* samples_all, int samples_all_index, int sensor, summary_data* summaries, server_stats stats[DATAGRAM_CHANNELS]) {
 
 	server_stats acc_cla = { -1, -1, -1 };
 	server_stats acc_red = acc_cla;
 	server_stats acc_grn = acc_cla;
 	server_stats acc_blu = acc_cla;
 
+	long int n_raw = 0;
 	int sample;
-	for (sample = 0; sample < *samples_all_index; sample++) {
+	for (sample = 0; sample < samples_all_index; sample++) {
+		if (samples_all[sample].sensor != sensor)
+			continue;
+		n_raw++;
+
 		acc_cla.mean += samples_all[sample].clarity;
 		acc_red.mean += samples_all[sample].red;
 		acc_grn.mean += samples_all[sample].green;
@@ -409,22 +1112,446 @@ void server_compute_stats (sample_data* samples_all, int* samples_all_index, ser
 			acc_blu.minimum = samples_all[sample].blue;
 	}
 
-	acc_cla.mean = (acc_cla.mean + 1) / *samples_all_index;
-	acc_red.mean = (acc_red.mean + 1) / *samples_all_index;
-	acc_grn.mean = (acc_grn.mean + 1) / *samples_all_index;
-	acc_blu.mean = (acc_blu.mean + 1) / *samples_all_index;
+	// Merge window summaries received from aggregating clients (disjoint from raw samples)
+	server_merge_summary(&acc_cla, summaries, 0);
+	server_merge_summary(&acc_red, summaries, 1);
+	server_merge_summary(&acc_grn, summaries, 2);
+	server_merge_summary(&acc_blu, summaries, 3);
+
+	long int n_total = n_raw + summaries->count;
+	if (n_total == 0)
+		return 0;
+
+	acc_cla.mean = (acc_cla.mean + 1) / n_total;
+	acc_red.mean = (acc_red.mean + 1) / n_total;
+	acc_grn.mean = (acc_grn.mean + 1) / n_total;
+	acc_blu.mean = (acc_blu.mean + 1) / n_total;
+	stats[0] = acc_cla;
+	stats[1] = acc_red;
+	stats[2] = acc_grn;
+	stats[3] = acc_blu;
 
 	/* Print values*/
-	printf("\nIOT_SERVER: == Statistics Calculation ==\n");
+	printf("\nIOT_SERVER: == Statistics Calculation (sensor %d) ==\n", sensor);
 	printf("IOT_SERVER: >> Clarity values 	- minimum: %.2f - mean: %.2f - maximum: %.2f\n", acc_cla.minimum, acc_cla.mean, acc_cla.maximum);
 	printf("IOT_SERVER: >> Red values 	- minimum: %.2f - mean: %.2f - maximum: %.2f\n", acc_red.minimum, acc_red.mean, acc_red.maximum);
 	printf("IOT_SERVER: >> Green values 	- minimum: %.2f - mean: %.2f - maximum: %.2f\n", acc_grn.minimum, acc_grn.mean, acc_grn.maximum);
 	printf("IOT_SERVER: >> Blue values 	- minimum: %.2f - mean: %.2f - maximum: %.2f\n", acc_blu.minimum, acc_blu.mean, acc_blu.maximum);
 	printf("\n");
 
+	return (int) n_total;
+}
+
+
+
+
+
+/**
+ * server_merge_summary
+ * folds one channel of merged window summaries into statistics accumulator (sum kept in mean until division)
+ */
+void server_merge_summary(server_stats* acc, summary_data* summaries, int channel) {
+
+	if (summaries->count == 0)
+		return;
+
+	acc->mean += summaries->sum[channel];
+	if (summaries->maximum[channel] > acc->maximum)
+		acc->maximum = summaries->maximum[channel];
+	if ((summaries->minimum[channel] < acc->minimum) || (acc->minimum < 0))
+		acc->minimum = summaries->minimum[channel];
+}
+
+
+
+
+
+/**
+ * server_summary_parsing
+ * parses window summaries received from an aggregating client and merges them into their sensor's summaries accumulator
+ * and into the client's range index
+ * returns number of samples represented by the summaries
+ */
+int server_summary_parsing(uint8_t* buffer_recv, int recv_len, summary_data* summaries_all, range_store* ranges, client_session* session, int64_t arrival_secs, int timestamp_scale) {
+
+	int n_summaries = codec_datagram_records(buffer_recv, recv_len, DATAGRAM_SUMMARY_SIZE);
+	int n_samples = 0;
+
+	int summary;
+	for (summary = 0; summary < n_summaries; summary++) {
+		uint8_t* record = codec_at(codec_datagram_payload(buffer_recv), summary, DATAGRAM_SUMMARY_SIZE);
+		int sensor = codec_summary_get_sensor(record);
+		long int window_start = (long int) codec_summary_get_window_start(record) * timestamp_scale;
+		int count = (int) codec_summary_get_count(record);
+		if ((count == 0) || (sensor >= DATAGRAM_MAX_SENSORS))
+			continue;
+		summary_data* summaries = &summaries_all[sensor];
+
+		int channel;
+		float minimum[DATAGRAM_CHANNELS], mean[DATAGRAM_CHANNELS], maximum[DATAGRAM_CHANNELS];
+		double sums[DATAGRAM_CHANNELS];
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+			uint8_t* values = codec_summary_channel(record, channel);
+			uint32_t sum = codec_summary_channel_get_sum(values);
+
+			// Convert into percentage-based floating-point numbers.
+			minimum[channel] = (float) codec_summary_channel_get_minimum(values) / 655.35;
+			maximum[channel] = (float) codec_summary_channel_get_maximum(values) / 655.35;
+			mean[channel] = (float) ((double) sum / count / 655.35);
+
+			if ((summaries->count == 0) || (minimum[channel] < summaries->minimum[channel]))
+				summaries->minimum[channel] = minimum[channel];
+			if ((summaries->count == 0) || (maximum[channel] > summaries->maximum[channel]))
+				summaries->maximum[channel] = maximum[channel];
+			sums[channel] = (double) sum / 655.35;
+			summaries->sum[channel] += sums[channel];
+		}
+		summaries->count += count;
+		range_add(ranges, session, sensor, arrival_secs, count, sums, minimum, maximum);
+		n_samples += count;
+
+		if (!server_quiet)
+			printf("IOT_SERVER: Summary %d of %d samples from sensor %d at %ld ms: Clarity %.2f/%.2f/%.2f %% - Red: %.2f/%.2f/%.2f %% - Green: %.2f/%.2f/%.2f %% - Blue: %.2f/%.2f/%.2f %% (min/mean/max)\n",
+					summary, count, sensor, window_start, minimum[0], mean[0], maximum[0], minimum[1], mean[1], maximum[1],
+					minimum[2], mean[2], maximum[2], minimum[3], mean[3], maximum[3]);
+	}
+
+	return n_samples;
+}
+
+
+
+
+
+/**
+ * server_state_init
+ * clears sample buffers and statistics of server processing state, allocates client registry and clears range index
+ * (range series live as long as their client's session)
+ */
+void server_state_init(server_state* state) {
+
+	memset(state, 0, sizeof(*state));
+
+	if (registry_init(&state->registry, REGISTRY_MAX_CLIENTS) < 0) {
+		print_error_server(8);
+		exit(EXIT_FAILURE);
+	}
+	range_store_init(&state->ranges);
+	state->registry.on_evict = server_session_evicted;
+	state->registry.evict_context = state;
+}
+
+
+
+
+
+/**
+ * server_session_evicted
+ * frees the range series of a client session leaving the registry
+ */
+void server_session_evicted(void* context, client_session* session) {
+
+	server_state* state = (server_state*) context;
+	range_release(&state->ranges, session);
+}
+
+
+
+
+
+/**
+ * server_process_datagram
+ * parses samples (or window summaries) from a received datagram and saves them for the next statistics calculation,
+ * indexing them by arrival second for range queries and handing samples to the exporter and subscribers (arrival in unix nanoseconds)
+ * returns number of samples parsed (or represented by summaries)
+ */
+int server_process_datagram(server_state* state, uint8_t* buffer_recv, int recv_len, struct sockaddr_in* client_addr, int64_t arrival_ns) {
+
+	int64_t arrival_secs = arrival_ns / 1000000000LL;
+
+	// Timestamps normalized to milliseconds: clients without COMM_CAP_TIMESTAMP_MS count whole seconds
+	client_session* session = registry_lookup(&state->registry, client_addr->sin_addr.s_addr, client_addr->sin_port);
+	int timestamp_scale = ((session != NULL) && (session->capabilities & COMM_CAP_TIMESTAMP_MS)) ? 1 : 1000;
+
+	int n_samples = 0;
+	int sample;
+	switch(buffer_recv[0]) {
+		case DATAGRAM_REQ_SEND_DATA:
+		case DATAGRAM_REQ_SEND_TAGGED_DATA:
+			n_samples = server_datagram_parsing(buffer_recv, recv_len, state->samples_stream, timestamp_scale);
+			bool publish = (state->pubsub != NULL) && pubsub_begin(state->pubsub, client_addr->sin_addr.s_addr, client_addr->sin_port, arrival_ns);
+			for (sample = 0; sample < n_samples; sample++) {
+				sample_data* parsed = &state->samples_stream[sample];
+				float values[DATAGRAM_CHANNELS] = { parsed->clarity, parsed->red, parsed->green, parsed->blue };
+				double sums[DATAGRAM_CHANNELS] = { parsed->clarity, parsed->red, parsed->green, parsed->blue };
+				range_add(&state->ranges, session, parsed->sensor, arrival_secs, 1, sums, values, values);
+				if (state->exporter != NULL)
+					exporter_push_sample(state->exporter, arrival_ns, client_addr->sin_addr.s_addr, client_addr->sin_port, parsed->sensor, parsed->timestamp, values);
+				if (publish)
+					pubsub_add_sample(state->pubsub, parsed->sensor, parsed->timestamp, values);
+				if (state->anomaly != NULL)
+					anomaly_add_sample(state->anomaly, client_addr->sin_addr.s_addr, client_addr->sin_port, parsed->sensor, values, arrival_ns);
+			}
+			if (publish)
+				pubsub_commit(state->pubsub);
+			server_save_samples(state->samples_stream, n_samples, state->samples_all, &state->samples_all_index);
+			memset(state->samples_stream, 0, sizeof(state->samples_stream));
+			break;
+
+		case DATAGRAM_REQ_SEND_SUMMARY:
+			n_samples = server_summary_parsing(buffer_recv, recv_len, state->summaries, &state->ranges, session, arrival_secs, timestamp_scale);
+			break;
+
+		// Samples are counted on the relayed devices, not on the gateway
+		case DATAGRAM_REQ_SEND_RELAY:
+			server_relay_unpack(state, buffer_recv, recv_len, client_addr, arrival_ns);
+			break;
+	}
+
+	return n_samples;
+}
+
+
+
+
+
+/**
+ * server_relay_unpack
+ * unpacks a gateway frame not seen before: each device block takes the path of a tagged datagram from that device,
+ * identified by the gateway's address and its device id as port (e.g. for range queries and subscriptions)
+ * returns samples unpacked
+ */
+int server_relay_unpack(server_state* state, uint8_t* buffer_recv, int recv_len, struct sockaddr_in* gateway_addr, int64_t arrival_ns) {
+
+	// Malformed frames are dropped before their sequence is taken
+	relay_block blocks[256];
+	int n_blocks = relay_blocks(&state->relay, buffer_recv, recv_len, blocks, 256);
+	if ((n_blocks < 0) || !relay_accept(&state->relay, &state->registry, buffer_recv, gateway_addr))
+		return 0;
+	relay_count(&state->relay, blocks, n_blocks);
+
+	// Relayed devices are given the gateway's rates
+	timing_rates timings = { 0, 0, 0 };
+	client_session* gateway = registry_lookup(&state->registry, gateway_addr->sin_addr.s_addr, gateway_addr->sin_port);
+	if (gateway != NULL)
+		timings = gateway->timings;
+
+	int n_samples = 0;
+	int block;
+	for (block = 0; block < n_blocks; block++) {
+		struct sockaddr_in device_addr = *gateway_addr;
+		device_addr.sin_port = htons(blocks[block].device);
+
+		// A device id given to a new local client starts over: the previous client's session and range series are dropped
+		if (blocks[block].new_device) {
+			client_session* previous = registry_lookup(&state->registry, device_addr.sin_addr.s_addr, device_addr.sin_port);
+			if (previous != NULL)
+				registry_release(&state->registry, previous);
+			state->relay.new_devices++;
+		}
+
+		// Relayed timestamps are in the gateway's unit (it converts its local clients'); the device's session follows
+		// its gateway's owner node in a cluster
+		client_session* device = registry_touch(&state->registry, device_addr.sin_addr.s_addr, device_addr.sin_port, server_now_secs());
+		if (device != NULL) {
+			device->capabilities = (gateway != NULL) ? (gateway->capabilities & COMM_CAP_TIMESTAMP_MS) : 0;
+			device->relay_port = gateway_addr->sin_port;
+		}
+
+		uint8_t datagram[DATAGRAM_SIZE];
+		int data_length = blocks[block].n_samples * DATAGRAM_TAGGED_SAMPLE_SIZE;
+		codec_datagram_begin(datagram, DATAGRAM_REQ_SEND_TAGGED_DATA, data_length);
+		memcpy(codec_datagram_payload(datagram), blocks[block].samples, data_length);
+
+		int n_device = server_process_datagram(state, datagram, codec_datagram_size(datagram), &device_addr, arrival_ns);
+		server_track_client(state, &device_addr, datagram, n_device, server_now_secs(), &timings);
+		n_samples += n_device;
+	}
+
+	return n_samples;
+}
+
+
+
+
 
-	memset(samples_all, 0, MAX_RATE_SERVER_STATS_CALC);
-	*samples_all_index = 0;
+/**
+ * server_track_client
+ * registers datagram's source in client registry (idle sessions expire first), keeping per-client counters and
+ * the capabilities and rates given out in its last handshake (or acknowledgement, if rate-controlled); published to shared memory if enabled
+ */
+void server_track_client(server_state* state, struct sockaddr_in* client_addr, uint8_t* buffer_recv, int n_samples, uint32_t now_secs, timing_rates* timings) {
+
+	registry_expire(&state->registry, now_secs);
+
+	client_session* session = registry_touch(&state->registry, client_addr->sin_addr.s_addr, client_addr->sin_port, now_secs);
+	if (session == NULL)
+		return;
+
+	session->datagrams++;
+	session->samples += n_samples;
+	if (buffer_recv[0] == DATAGRAM_REQ_COMM) {
+		session->capabilities = server_comm_capabilities(buffer_recv) & SERVER_CAPABILITIES;
+		session->relay_sequence = 0;
+		session->relay_window = 0;
+	}
+	if ((buffer_recv[0] == DATAGRAM_REQ_COMM) || (session->capabilities & COMM_CAP_RATE_CONTROL))
+		session->timings = *timings;
+
+	if (state->shm != NULL) {
+		stats_shm_client client = { session->addr, session->port, session->capabilities, 1, session->first_seen, session->last_seen,
+				session->datagrams, session->samples, session->timings.sampling, session->timings.server_stream };
+		stats_shm_publish_client(state->shm, (uint32_t) (session - state->registry.slab), &client);
+		state->shm->counters.datagrams++;
+		state->shm->counters.samples += n_samples;
+		server_publish_counters(state, now_secs);
+	}
+}
+
+
+
+
+
+/**
+ * server_now_secs
+ * returns monotonic clock in seconds (client registry time base)
+ */
+uint32_t server_now_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) now.tv_sec;
+}
+
+
+
+
+
+/**
+ * server_now_ms
+ * returns monotonic clock in milliseconds (statistics period time base)
+ */
+int64_t server_now_ms(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+
+
+
+
+/**
+ * server_stats_flush
+ * computes statistics of every sensor for samples saved since last calculation, exporting them stamped with now_ns
+ */
+void server_stats_flush(server_state* state, int64_t now_ns) {
+
+	int n_samples = 0;
+	int sensor;
+	for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+		server_stats stats[DATAGRAM_CHANNELS];
+		int n_sensor = server_compute_stats(state->samples_all, state->samples_all_index, sensor, &state->summaries[sensor], stats);
+		n_samples += n_sensor;
+
+		if ((n_sensor > 0) && ((state->exporter != NULL) || (state->cluster != NULL))) {
+			float minimum[DATAGRAM_CHANNELS], mean[DATAGRAM_CHANNELS], maximum[DATAGRAM_CHANNELS];
+			int channel;
+			for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+				minimum[channel] = stats[channel].minimum;
+				mean[channel] = stats[channel].mean;
+				maximum[channel] = stats[channel].maximum;
+			}
+			if (state->exporter != NULL)
+				exporter_push_stats(state->exporter, now_ns, sensor, n_sensor, minimum, mean, maximum);
+			if (state->cluster != NULL)
+				cluster_report_sensor(state->cluster, sensor, (uint32_t) n_sensor, minimum, mean, maximum);
+		}
+
+		if ((n_sensor > 0) && (state->shm != NULL)) {
+			stats_shm_sensor sensor_stats;
+			sensor_stats.computed_ns = now_ns;
+			sensor_stats.count = (uint32_t) n_sensor;
+			int channel;
+			for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+				sensor_stats.minimum[channel] = stats[channel].minimum;
+				sensor_stats.mean[channel] = stats[channel].mean;
+				sensor_stats.maximum[channel] = stats[channel].maximum;
+			}
+			stats_shm_publish_sensor(state->shm, sensor, &sensor_stats);
+		}
+	}
+
+	// Records of sessions evicted (or reused by another client) since they were last published are cleared
+	if (state->shm != NULL) {
+		uint32_t n_slots = atomic_load_explicit(&state->shm->segment->n_clients, memory_order_relaxed);
+		uint32_t slot;
+		for (slot = 0; slot < n_slots; slot++) {
+			stats_shm_client* published = &state->shm->segment->clients[slot].data;
+			client_session* session = &state->registry.slab[slot];
+			if (published->in_use && (!session->in_use || (session->addr != published->addr) || (session->port != published->port)))
+				stats_shm_clear_client(state->shm, slot);
+		}
+		server_publish_counters(state, server_now_secs());
+	}
+
+	if (n_samples == 0)
+		printf("IOT_SERVER: No samples to compute statistics\n");
+	registry_print_stats(&state->registry);
+	range_print_stats(&state->ranges);
+	integrity_print_stats(&state->integrity);
+	relay_print_stats(&state->relay);
+	if (state->cluster != NULL) {
+		cluster_print_stats(state->cluster);
+		cluster_report_send(state->cluster, state->registry.n_clients);
+	}
+	if (state->exporter != NULL)
+		exporter_print_stats(state->exporter);
+	if (state->pubsub != NULL)
+		pubsub_print_stats(state->pubsub);
+	if (state->anomaly != NULL)
+		anomaly_print_stats(state->anomaly);
+
+	memset(state->samples_all, 0, state->samples_all_index * sizeof(sample_data));
+	state->samples_all_index = 0;
+	memset(state->summaries, 0, sizeof(state->summaries));
+}
+
+
+
+
+
+/**
+ * server_publish_counters
+ * publishes server-wide counters (registry and integrity, plus totals kept by server_track_client) to shared memory
+ */
+void server_publish_counters(server_state* state, uint32_t now_secs) {
+
+	stats_shm_counters* counters = &state->shm->counters;
+	counters->updated_secs = now_secs;
+	counters->n_clients = state->registry.n_clients;
+	counters->peak_clients = state->registry.peak_clients;
+	counters->evictions = state->registry.evictions;
+	counters->rejected = state->registry.rejected;
+	counters->crc_verified = state->integrity.verified;
+	counters->crc_failed = state->integrity.failed;
+	counters->crc_missing = state->integrity.missing;
+	stats_shm_publish_counters(state->shm);
+}
+
+
+
+
+
+/**
+ * sig_handler
+ * stops main loop on SIGINT/SIGTERM
+ */
+static void sig_handler(int signum) {
+
+	(void) signum;
+	server_running = 0;
 }
 
 
@@ -452,9 +1579,50 @@ void print_error_server(int error_code) {
 			printf(">> Could not...\n\n");
 			break;
 		case 4:
-			printf(">> Incorrect arguments provided (all in seconds):\n 1.- Sampling rate for sensor data\n 2.- Transmission streaming rate to server\n 3.- Statistics calculation rate (Optional)\n");
+			printf(">> Incorrect arguments provided (all in seconds, decimals allowed down to 0.001):\n 1.- Sampling rate for sensor data\n 2.- Transmission streaming rate to server\n 3.- Statistics calculation rate (Optional)\n");
 			printf(" Must satisfy (sampling rate <= streaming rate)\n (sampling/streaming) ratio must not exceed maximum sampling ratio: %d\n\n", MAX_SAMPLING_RATIO);
-			printf(" Statistics calculation rate must satisfy (>= 2*streaming rate) and not exceed %d\n\n", MAX_RATE_SERVER_STATS_CALC);
+			printf(" Statistics calculation rate must satisfy (>= 2*streaming rate) and not exceed %d\n", MAX_RATE_SERVER_STATS_CALC / 1000);
+			printf(" (statistics/sampling) ratio must not exceed %d samples\n\n", MAX_SAMPLES_STATS_CALC);
+			printf(" Options (before rates):\n -c <file> Capture received datagrams\n -r <file> Replay capture file\n -x <speed> Replay speed factor (0: as fast as possible)\n -u Replay through UDP to running server\n -q Quiet sample output\n -b <clients> Benchmark client registry (memory per client, lookups per second) and exit\n -Q <ip>:<port>[/<sensor>],<from>,<to> Query running server for client's statistics over a time range and exit\n    (times: now, -<n>[s|m|h], HH:MM[:SS] or unix seconds)\n -e <prefix> Export samples and statistics into rotated columnar files <prefix>-<time>-<n>.iotcol\n -B <datagrams> Benchmark ingest throughput without and with export (to -e prefix) and exit\n -i <classic|uring> Socket backend: recvfrom()/sendto() (default) or io_uring\n -A <rate>[,<total>] Admission control: datagrams/s admitted per source and in total (0: no rate limits, malformed\n    datagrams still dropped, default: %d or %d times streaming rate per source, %d in total)\n -g Coalesce receives with UDP GRO and send replies with UDP GSO (classic backend only)\n -n <datagrams> Benchmark socket backends and GRO/GSO on loopback and exit\n -k <datagrams> Benchmark CRC32C datagram checksums (table and hardware) and exit\n -S <name> Publish live stats into shared-memory segment <name> (e.g. %s) for local readers\n -w <name> Print stats of a running server from shared-memory segment <name> and exit\n -p Fan out decoded samples to live subscribers (UDP)\n -U <path> Fan out to subscribers through Unix datagram socket <path> too (implies -p; with -T: subscribe through it)\n -N <ip>[/<bits>],... Take UDP subscriptions from these networks too, besides loopback (implies -p)\n -T all|<ip>[:<port>][/<sensor>] Subscribe to a running server's live samples matching filter and print them\n -R <utilization> Adapt clients' rates to keep ingest thread busy below this fraction (0-1, e.g. 0.7)\n -a <file>|- Detect anomalies (spikes and drifts) on every color channel of every sample, one alert line each to file or stdout\n -D <clients> Benchmark anomaly detection over this many clients and exit\n -C <ip>:<port>,<ip>:<port>,... Run as cluster node (this node first, serving its port): clients are spread over\n    live nodes by consistent hashing, other nodes' clients answered and forwarded, fleet statistics merged by lowest node\n -L <cpu>[,<us>] Low-latency mode: pin ingest thread to CPU (isolate it, e.g. isolcpus=), spin on non-blocking receives\n    (SO_BUSY_POLL for <us> per receive if given), lock and prefault memory (classic backend only)\n -P <datagrams> Benchmark ACK latency (p50/p99/p99.9) blocking and busy-polling on loopback (-L CPU, default last) and exit\n -E <datagrams> Benchmark protocol codec against hand-written encode/decode loops and exit\n\n", ADMISSION_SOURCE_MIN_RATE, ADMISSION_SOURCE_RATIO, ADMISSION_GLOBAL_RATE, STATS_SHM_DEFAULT_NAME);
+			break;
+		case 6:
+			printf(">> Could not open or write capture file.\n\n");
+			break;
+		case 7:
+			printf(">> Could not read replay capture file (missing or corrupt).\n\n");
+			break;
+		case 8:
+			printf(">> Could not allocate client registry.\n\n");
+			break;
+		case 9:
+			printf(">> Range query failed (malformed query or no reply from server on port %d).\n\n", SERVER_PORT);
+			break;
+		case 10:
+			printf(">> Could not open export file or start exporter thread.\n\n");
+			break;
+		case 11:
+			printf(">> Could not set up io_uring socket backend (kernel 6.0 or later needed for multishot receive).\n\n");
+			break;
+		case 12:
+			printf(">> Could not enable UDP GRO on socket (kernel 5.0 or later needed).\n\n");
+			break;
+		case 13:
+			printf(">> Could not create shared-memory stats segment.\n\n");
+			break;
+		case 14:
+			printf(">> Could not attach shared-memory stats segment (server not publishing it, or different version).\n\n");
+			break;
+		case 15:
+			printf(">> Malformed subscriber networks, or could not bind fan-out Unix socket or start fan-out thread.\n\n");
+			break;
+		case 16:
+			printf(">> Subscription failed (malformed filter, fan-out disabled, or no reply from server on port %d).\n\n", SERVER_PORT);
+			break;
+		case 17:
+			printf(">> Could not open anomaly alert file or allocate detector.\n\n");
+			break;
+		case 18:
+			printf(">> Could not pin ingest thread for low-latency mode (CPU offline or outside allowed set).\n\n");
 			break;
 	}
 
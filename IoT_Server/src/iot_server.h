@@ -5,15 +5,41 @@
 
 #include <netinet/in.h>		// For socket and bind()'s sockaddr_in struct
 #include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
 
 #include "iot_lib.h"
+#include "iot_codec.h"
+#include "registry/client_registry.h"
+#include "range/range_index.h"
+#include "export/exporter.h"
+#include "uring/uring_socket.h"
+#include "gro/udp_gro.h"
+#include "admission/admission.h"
+#include "trace/latency_trace.h"
+#include "integrity/integrity.h"
+#include "shm/stats_shm.h"
+#include "pubsub/pubsub.h"
+#include "rate/rate_control.h"
+#include "anomaly/anomaly.h"
+#include "relay/relay_ingest.h"
+#include "cluster/cluster.h"
+#include "lowlat/busy_poll.h"
+#include "codec/codec_benchmark.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define MAX_SAMPLES_STATS_CALC		65536	// Capacity of samples saved between statistics calculations
+#define SERVER_CAPABILITIES			(COMM_CAP_RATES_MS | COMM_CAP_AGGREGATE | COMM_CAP_SENSOR_ID | COMM_CAP_TRACE | COMM_CAP_CRC32C | COMM_CAP_RATE_CONTROL | COMM_CAP_RELAY | COMM_CAP_TIMESTAMP_MS)	// Handshake capabilities accepted
 
 
 
 /* TYPE DEFINITIONS */
 
 typedef struct {
-	long int timestamp;
+	long int timestamp;		// Client clock, milliseconds (whole seconds * 1000 from clients without COMM_CAP_TIMESTAMP_MS)
+	int sensor;				// Sensor id (0 for single-sensor clients)
 	float clarity;
 	float red;
 	float green;
@@ -28,24 +54,104 @@ typedef struct {
 } server_stats;
 
 
+// Merge of window summaries received between statistics calculations (percent units)
+typedef struct {
+	long int	count;
+	double		sum			[DATAGRAM_CHANNELS];
+	float		minimum		[DATAGRAM_CHANNELS];
+	float		maximum		[DATAGRAM_CHANNELS];
+} summary_data;
+
+
+typedef struct {
+	char*	capture_path;		// Append every received datagram to this capture file (NULL: disabled)
+	char*	replay_path;		// Replay this capture file instead of listening (NULL: live mode)
+	float	replay_speed;		// Replay speed factor (1: original speed, 0: as fast as possible)
+	bool	replay_socket;		// Replay through UDP to a running server instead of in-process
+	bool	quiet;				// Do not print every parsed sample
+	int		benchmark_clients;	// Run client registry benchmark with this many clients and exit (0: disabled)
+	char*	range_query;		// Query a running server for this client/window and exit (NULL: disabled)
+	char*	export_prefix;		// Export samples and statistics into columnar files with this prefix (NULL: disabled)
+	int		benchmark_datagrams;	// Run ingest benchmark (without and with export) over this many datagrams and exit (0: disabled)
+	bool	io_uring;			// Serve socket through io_uring instead of recvfrom()/sendto()
+	int		benchmark_socket;	// Run socket backend benchmark (classic, io_uring and GRO/GSO) over this many datagrams and exit (0: disabled)
+	bool	udp_gro;			// Coalesce receives (UDP_GRO) and segment replies (UDP_SEGMENT) on classic socket
+	float	admission_source_rate;	// Datagrams per second admitted per source (-1: derived from streaming rate)
+	float	admission_global_rate;	// Datagrams per second admitted in total (0: no rate limits)
+	int		benchmark_crc;		// Run CRC32C benchmark over this many datagrams per size and exit (0: disabled)
+	char*	stats_shm_name;		// Publish live stats into this shared-memory segment (NULL: disabled)
+	char*	stats_shm_watch;	// Print a running server's shared-memory stats and exit (NULL: disabled)
+	bool	pubsub;				// Fan out decoded samples to live subscribers
+	char*	pubsub_unix_path;	// Also take subscriptions on this Unix datagram socket (NULL: UDP only)
+	char*	pubsub_networks;	// Also take UDP subscriptions from these networks, "<ip>[/<bits>],..." (NULL: loopback only)
+	char*	pubsub_tail;		// Subscribe to a running server with this filter and print its samples (NULL: disabled)
+	float	rate_target;		// Adapt clients' rates to keep ingest utilization below this fraction (0: fixed rates)
+	char*	anomaly_alerts;		// Detect anomalies on every sample and write alerts here ("-": stdout, NULL: disabled)
+	int		benchmark_anomaly;	// Run anomaly detection benchmark over this many clients and exit (0: disabled)
+	char*	cluster_members;	// Run as cluster node: "<ip>:<port>,..." this node first (NULL: standalone)
+	int		busy_poll_cpu;		// Low-latency mode: pin ingest thread to this CPU and spin on receives (-1: blocking receives)
+	int		busy_poll_us;		// ...with this SO_BUSY_POLL budget (0: none)
+	int		benchmark_latency;	// Run ACK latency benchmark (blocking and busy-poll) over this many datagrams and exit (0: disabled)
+	int		benchmark_codec;	// Run protocol codec benchmark (hand-written loops vs codec) over this many datagrams and exit (0: disabled)
+} server_options;
+
+
+typedef struct {
+	sample_data		samples_all		[MAX_SAMPLES_STATS_CALC];
+	sample_data		samples_stream	[MAX_SAMPLING_RATIO];
+	int				samples_all_index;
+	summary_data	summaries		[DATAGRAM_MAX_SENSORS];
+	client_registry	registry;
+	range_store		ranges;
+	exporter*		exporter;		// Background export (NULL: disabled)
+	integrity_stats	integrity;
+	relay_stats		relay;
+	stats_shm*		shm;			// Shared-memory stats publication (NULL: disabled)
+	pubsub*			pubsub;			// Live sample fan-out (NULL: disabled)
+	anomaly_detector*	anomaly;		// Per-sample anomaly detection (NULL: disabled)
+	cluster_node*	cluster;		// Cluster membership and client ring (NULL: standalone)
+} server_state;
+
+
+
+/* GLOBAL VARIABLES */
+
+extern bool server_quiet;
+
+
 
 /* FUNCTION DECLARATIONS */
 
 // IoT Server Module
+int			parse_param_options			(server_options* options, int argc, char* argv[]);
 void		parse_param_rates			(timing_rates* rates, int argc, char* argv[]);
-int			server_socket_init			(struct sockaddr_in* server_addr, struct timeval *intervals);
+int			server_socket_init			(struct sockaddr_in* server_addr, struct timeval *intervals, int server_port);
 void		server_socket_print_info	(struct sockaddr_in* sockaddr);
-int			server_socket_listen		(int server_socket, struct sockaddr_in *client_addr, int comm_established_flag, int server_stats_timeout, int *stats_secs, uint8_t* buffer_recv);
-void 		server_socket_reply			(int server_socket, struct sockaddr_in *client_addr, uint8_t* buffer_recv, timing_rates* timings);
-void 		server_build_reply			(int server_socket, uint8_t* buffer_recv, uint8_t* buffer_reply, timing_rates* timings);
-int 		server_datagram_parsing		(uint8_t* data_in, sample_data* data_out);
+int			server_socket_listen		(int server_socket, busy_poll* busy, admission_control* admission, cluster_node* cluster, struct sockaddr_in *client_addr, int comm_established_flag, int64_t stats_due_ms, uint8_t* buffer_recv, int64_t* received_ns);
+int			server_io_listen			(uring_socket* uring, udp_gro* gro, admission_control* admission, struct sockaddr_in *client_addr, int comm_established_flag, int64_t stats_due_ms, uint8_t** buffer_recv);
+bool		server_admit				(admission_control* admission, cluster_node* cluster, uint8_t* buffer_recv, int recv_len, struct sockaddr_in *client_addr);
+int			server_socket_send			(int server_socket, uring_socket* uring, udp_gro* gro, struct sockaddr_in *client_addr, uint8_t* buffer, int length);
+void 		server_socket_reply			(int server_socket, busy_poll* busy, uring_socket* uring, udp_gro* gro, cluster_node* entry, struct sockaddr_in *client_addr, uint8_t* buffer_recv, int recv_len, timing_rates* timings, rate_control* rate, int64_t received_us);
+void 		server_build_reply			(uint8_t* buffer_recv, uint8_t* buffer_reply, timing_rates* timings);
+uint8_t		server_comm_capabilities	(uint8_t* buffer_recv);
+int 		server_datagram_parsing		(uint8_t* data_in, int recv_len, sample_data* data_out, int timestamp_scale);
 void		server_save_samples			(sample_data* samples_stream, int n_samples, sample_data* samples_all, int* samples_all_index);
-void		server_compute_stats		(sample_data* samples_all, int* samples_all_index, server_stats* stats);
+int			server_compute_stats		(sample_data* samples_all, int samples_all_index, int sensor, summary_data* summaries, server_stats stats[DATAGRAM_CHANNELS]);
+void		server_merge_summary		(server_stats* acc, summary_data* summaries, int channel);
+int			server_summary_parsing		(uint8_t* buffer_recv, int recv_len, summary_data* summaries, range_store* ranges, client_session* session, int64_t arrival_secs, int timestamp_scale);
+void		server_state_init			(server_state* state);
+void		server_session_evicted		(void* context, client_session* session);
+int			server_process_datagram		(server_state* state, uint8_t* buffer_recv, int recv_len, struct sockaddr_in* client_addr, int64_t arrival_ns);
+int			server_relay_unpack			(server_state* state, uint8_t* buffer_recv, int recv_len, struct sockaddr_in* gateway_addr, int64_t arrival_ns);
+void		server_track_client			(server_state* state, struct sockaddr_in* client_addr, uint8_t* buffer_recv, int n_samples, uint32_t now_secs, timing_rates* timings);
+uint32_t	server_now_secs				(void);
+int64_t		server_now_ms				(void);
+void		server_stats_flush			(server_state* state, int64_t now_ns);
+void		server_publish_counters		(server_state* state, uint32_t now_secs);
 
 
 // Error Control
 void 		print_error_server	(int error_code);
-// static void	sig_handler			(int _);
 
 
 
@@ -0,0 +1,307 @@
+/*
+ * busy_poll.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#define _GNU_SOURCE			// For sched_setaffinity(), CPU_SET() and RUSAGE_THREAD
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset()
+#include <errno.h>			// For errno
+#include <unistd.h>			// For close() and sysconf()
+#include <time.h>			// For nanosleep()
+#include <sched.h>			// For sched_setaffinity()
+#include <malloc.h>			// For mallopt()
+#include <pthread.h>		// For benchmark sender thread
+#include <sys/mman.h>		// For mlockall()
+#include <sys/resource.h>	// For getrusage()
+#include <arpa/inet.h>		// For htonl()
+
+#include "iot_lib.h"
+#include "iot_server.h"
+#include "busy_poll.h"
+
+
+
+typedef struct {
+	uint16_t			port;
+	int					n_datagrams;
+	int					receiver_cpu;		// Sender kept off this CPU (-1: anywhere)
+	uint8_t*			datagram;
+	int					length;
+	latency_histogram	round_trip;
+	long int			lost;
+} busy_bench_sender;
+
+
+static void		busy_poll_prefault_stack	(void);
+static int		busy_bench_socket			(uint16_t* port);
+static void*	busy_bench_send				(void* arg);
+
+
+
+/*
+ * Pins the calling thread (threads started later inherit its CPU: start them first), locks all memory mapped now
+ * and later, and makes the stack resident, so the ingest path takes no page faults
+ */
+int busy_poll_init(busy_poll* busy, int server_socket, int cpu, int busy_poll_us) {
+
+	memset(busy, 0, sizeof(*busy));
+	busy->cpu = cpu;
+	busy->busy_poll_us = busy_poll_us;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+		return -1;
+	CPU_SET(cpu, &cpus);
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+		return -1;
+
+	// Freed heap kept mapped (no trimming, no per-allocation mmap), so later allocations land on locked pages
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	busy->locked = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0);
+	busy_poll_prefault_stack();
+
+	// Receives made non-blocking per call (MSG_DONTWAIT): replies still go out through the blocking socket
+	if (busy_poll_us > 0)
+		busy->socket_busy_poll = (setsockopt(server_socket, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) == 0);
+
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD, &usage);
+	busy->minor_faults = usage.ru_minflt;
+	busy->major_faults = usage.ru_majflt;
+	return 0;
+}
+
+
+
+/*
+ * Spins on recvmsg() until a datagram arrives or BUSY_POLL_TIMEOUT_US pass (returns -1, as a receive timeout)
+ */
+int busy_poll_recv(busy_poll* busy, int server_socket, struct msghdr* message) {
+
+	int64_t deadline_us = latency_trace_now_us() + BUSY_POLL_TIMEOUT_US;
+	while (true) {
+		ssize_t recv_len = recvmsg(server_socket, message, MSG_DONTWAIT);
+		busy->polls++;
+		if (recv_len >= 0) {
+			busy->datagrams++;
+			return (int) recv_len;
+		}
+		if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+			return -1;
+
+		busy->empty_polls++;
+		if (((busy->empty_polls % BUSY_POLL_CLOCK_POLLS) == 0) && (latency_trace_now_us() >= deadline_us))
+			return -1;
+	}
+}
+
+
+
+void busy_poll_print_stats(busy_poll* busy) {
+
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD, &usage);
+
+	printf("IOT_SERVER: Busy-poll on CPU %d: %lu datagrams - %lu polls (%.1f %% empty) - %ld page faults in period (%ld major) - memory %s - SO_BUSY_POLL %s\n",
+			busy->cpu, busy->datagrams, busy->polls, 100.0 * busy->empty_polls / ((busy->polls > 0) ? busy->polls : 1),
+			usage.ru_minflt - busy->minor_faults, usage.ru_majflt - busy->major_faults, busy->locked ? "locked" : "NOT locked",
+			(busy->busy_poll_us == 0) ? "off" : (busy->socket_busy_poll ? "on" : "refused"));
+
+	busy->polls = 0;
+	busy->empty_polls = 0;
+	busy->datagrams = 0;
+	busy->minor_faults = usage.ru_minflt;
+	busy->major_faults = usage.ru_majflt;
+}
+
+
+
+/*
+ * Loopback closed loop: a sender thread sends one datagram, waits for its reply, then pauses BUSY_POLL_BENCH_GAP_US
+ * (receiver goes idle, as between a sorting line's readings). Receiver runs blocking, then in busy-poll mode (which
+ * pins and locks this process for good: run last). Reports server ACK latency (kernel receive to reply sent) and
+ * sender round trip percentiles.
+ */
+void busy_poll_benchmark(int n_datagrams, int cpu, int busy_poll_us) {
+
+	uint8_t datagram[DATAGRAM_SIZE] = {'\0'};
+	int data_length = MAX_SAMPLING_RATIO * DATAGRAM_SAMPLE_SIZE;
+	codec_datagram_begin(datagram, DATAGRAM_REQ_SEND_DATA, data_length);
+	timing_rates timings = { DEFAULT_RATE_SAMPLING, DEFAULT_RATE_SERVER_STREAM, DEFAULT_RATE_SERVER_STATS_CALC };
+
+	int n_cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpu < 0)
+		cpu = n_cpus - 1;
+	printf("IOT_SERVER: == Low-Latency Benchmark (%d datagrams, one in flight, %d us apart - busy-poll on CPU %d of %d) ==\n",
+			n_datagrams, BUSY_POLL_BENCH_GAP_US, cpu, n_cpus);
+	if (n_cpus < 2)
+		printf("IOT_SERVER: >> Single CPU: sender shares the spinning receiver's core, busy-poll figures not representative\n");
+
+	int mode;
+	for (mode = 0; mode < 2; mode++) {
+		busy_bench_sender sender;
+		memset(&sender, 0, sizeof(sender));
+		sender.n_datagrams = n_datagrams;
+		sender.receiver_cpu = ((mode == 1) && (n_cpus > 1)) ? cpu : -1;
+		sender.datagram = datagram;
+		sender.length = DATAGRAM_HEADER_SIZE + data_length + 1;
+
+		static busy_poll busy;
+		int server_socket = busy_bench_socket(&sender.port);
+		if ((server_socket < 0) || (latency_trace_stamp_socket(server_socket) < 0)
+				|| ((mode == 1) && (busy_poll_init(&busy, server_socket, cpu, busy_poll_us) < 0))) {
+			printf("IOT_SERVER: >> %s: not available\n", (mode == 1) ? "busy-poll" : "blocking");
+			if (server_socket >= 0)
+				close(server_socket);
+			continue;
+		}
+
+		static latency_trace tracer;
+		latency_trace_reset(&tracer);
+		pthread_t sender_thread;
+		pthread_create(&sender_thread, NULL, busy_bench_send, &sender);
+
+		while (true) {
+			struct sockaddr_in client_addr;
+			uint8_t buffer_recv[DATAGRAM_SIZE] = {'\0'};
+			uint8_t buffer_reply[DATAGRAM_SIZE] = {'\0'};
+			uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+			struct iovec iov = { buffer_recv, DATAGRAM_SIZE };
+			struct msghdr message;
+			memset(&message, 0, sizeof(message));
+			message.msg_name = &client_addr;
+			message.msg_namelen = sizeof(client_addr);
+			message.msg_iov = &iov;
+			message.msg_iovlen = 1;
+			message.msg_control = control;
+			message.msg_controllen = sizeof(control);
+
+			int recv_len = (mode == 1) ? busy_poll_recv(&busy, server_socket, &message) : (int) recvmsg(server_socket, &message, 0);
+			// Sender done
+			if (recv_len < 0)
+				break;
+
+			server_build_reply(buffer_recv, buffer_reply, &timings);
+			int reply_len = codec_datagram_size(buffer_reply);
+			sendto(server_socket, buffer_reply, reply_len, 0, (struct sockaddr *) &client_addr, sizeof(client_addr));
+			int64_t received_ns = latency_trace_rx_stamp(&message);
+			if (received_ns > 0)
+				latency_trace_record_ack(&tracer, received_ns);
+		}
+
+		pthread_join(sender_thread, NULL);
+		close(server_socket);
+
+		latency_histogram* ack = &tracer.ack;
+		latency_histogram* round_trip = &sender.round_trip;
+		if ((ack->n == 0) || (round_trip->n == 0)) {
+			printf("IOT_SERVER: >> %-9s: no datagram acknowledged\n", (mode == 1) ? "busy-poll" : "blocking");
+			continue;
+		}
+		printf("IOT_SERVER: >> %-9s: ACK p50: %lu us - p99: %lu us - p99.9: %lu us - max: %lu us | round trip p50: %lu us - p99: %lu us - p99.9: %lu us - max: %lu us (%lu acknowledged, %ld lost)\n",
+				(mode == 1) ? "busy-poll" : "blocking",
+				(unsigned long) latency_histogram_percentile(ack, 0.50), (unsigned long) latency_histogram_percentile(ack, 0.99),
+				(unsigned long) latency_histogram_percentile(ack, 0.999), (unsigned long) ack->max_us,
+				(unsigned long) latency_histogram_percentile(round_trip, 0.50), (unsigned long) latency_histogram_percentile(round_trip, 0.99),
+				(unsigned long) latency_histogram_percentile(round_trip, 0.999), (unsigned long) round_trip->max_us, round_trip->n, sender.lost);
+		if (mode == 1)
+			busy_poll_print_stats(&busy);
+	}
+}
+
+
+
+/*
+ * Touches every page of a stack frame this deep: with memory locked, the pages stay resident once faulted in
+ */
+static void busy_poll_prefault_stack(void) {
+
+	volatile uint8_t stack[BUSY_POLL_STACK_PREFAULT];
+	size_t offset;
+	for (offset = 0; offset < sizeof(stack); offset += BUSY_POLL_PAGE_SIZE)
+		stack[offset] = 0;
+}
+
+
+
+static int busy_bench_socket(uint16_t* port) {
+
+	int bench_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (bench_socket < 0)
+		return -1;
+
+	struct timeval intervals = { 0, 200000 };
+	setsockopt(bench_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals));
+
+	struct sockaddr_in bench_addr;
+	memset(&bench_addr, 0, sizeof(bench_addr));
+	bench_addr.sin_family = AF_INET;
+	bench_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t bench_addr_len = sizeof(bench_addr);
+	if ((bind(bench_socket, (struct sockaddr *) &bench_addr, sizeof(bench_addr)) < 0)
+			|| (getsockname(bench_socket, (struct sockaddr *) &bench_addr, &bench_addr_len) < 0)) {
+		close(bench_socket);
+		return -1;
+	}
+
+	*port = bench_addr.sin_port;
+	return bench_socket;
+}
+
+
+
+/*
+ * Sender runs off the receiver's CPU (it inherits the pinning of the thread creating it); replies missing after
+ * 200 ms count as lost
+ */
+static void* busy_bench_send(void* arg) {
+
+	busy_bench_sender* sender = (busy_bench_sender*) arg;
+	if (sender->receiver_cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		int n_cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+		int cpu;
+		for (cpu = 0; (cpu < n_cpus) && (cpu < CPU_SETSIZE); cpu++) {
+			if (cpu != sender->receiver_cpu)
+				CPU_SET(cpu, &cpus);
+		}
+		sched_setaffinity(0, sizeof(cpus), &cpus);
+	}
+
+	int send_socket = busy_bench_socket(&(uint16_t) { 0 });
+	if (send_socket < 0) {
+		sender->lost = sender->n_datagrams;
+		return NULL;
+	}
+
+	struct sockaddr_in server_addr;
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server_addr.sin_port = sender->port;
+	connect(send_socket, (struct sockaddr *) &server_addr, sizeof(server_addr));
+
+	uint8_t buffer_reply[DATAGRAM_SIZE];
+	struct timespec gap = { 0, BUSY_POLL_BENCH_GAP_US * 1000L };
+	int sent;
+	for (sent = 0; sent < sender->n_datagrams; sent++) {
+		nanosleep(&gap, NULL);
+		int64_t sent_us = latency_trace_now_us();
+		send(send_socket, sender->datagram, sender->length, 0);
+		if (recv(send_socket, buffer_reply, DATAGRAM_SIZE, 0) > 0)
+			latency_histogram_add(&sender->round_trip, latency_trace_now_us() - sent_us);
+		else
+			sender->lost++;
+	}
+
+	close(send_socket);
+	return NULL;
+}
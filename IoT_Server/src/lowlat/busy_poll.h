@@ -0,0 +1,57 @@
+/*
+ * busy_poll.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef BUSY_POLL_H_
+#define BUSY_POLL_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <sys/socket.h>		// For msghdr struct
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define BUSY_POLL_TIMEOUT_US		1000000			// Spin without data this long, then return as the blocking receive's timeout would
+#define BUSY_POLL_CLOCK_POLLS		256				// Empty polls between clock reads
+#define BUSY_POLL_STACK_PREFAULT	(256 * 1024)	// Stack made resident at setup, well above the ingest path's deepest use
+#define BUSY_POLL_PAGE_SIZE			4096
+#define BUSY_POLL_BENCH_GAP_US		200				// Benchmark sender pause between datagrams (one in flight, receiver idle in between)
+
+
+
+/* TYPE DEFINITIONS */
+
+// Low-latency ingest: thread pinned to one core, spinning on non-blocking receives, its memory locked and prefaulted
+typedef struct {
+	int				cpu;
+	int				busy_poll_us;		// SO_BUSY_POLL budget requested (0: none)
+	bool			socket_busy_poll;	// ...and accepted by the kernel (CAP_NET_ADMIN above net.core.busy_read)
+	bool			locked;				// mlockall() succeeded (CAP_IPC_LOCK or memlock limit above footprint)
+
+	unsigned long	polls;				// recvmsg() calls in period
+	unsigned long	empty_polls;		// ...finding no datagram
+	unsigned long	datagrams;
+	long			minor_faults;		// This thread's page faults at last report
+	long			major_faults;
+} busy_poll;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		busy_poll_init			(busy_poll* busy, int server_socket, int cpu, int busy_poll_us);	// returns -1 if thread cannot be pinned to cpu
+int		busy_poll_recv			(busy_poll* busy, int server_socket, struct msghdr* message);
+void	busy_poll_print_stats	(busy_poll* busy);
+void	busy_poll_benchmark		(int n_datagrams, int cpu, int busy_poll_us);
+
+
+
+#endif /* BUSY_POLL_H_ */
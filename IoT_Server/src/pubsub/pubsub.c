@@ -0,0 +1,510 @@
+/*
+ * pubsub.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For strtol()
+#include <string.h>			// For memset() and memcpy()
+#include <errno.h>			// For errno
+#include <unistd.h>			// For close() and unlink()
+#include <time.h>			// For clock_gettime() and nanosleep()
+#include <poll.h>			// For poll()
+#include <sys/socket.h>		// For socket() and sendto()
+#include <arpa/inet.h>		// For inet_aton() and htonl()
+
+#include "pubsub.h"
+
+
+
+static int			pubsub_parse_networks	(pubsub* ps, const char* list);
+static bool			pubsub_allowed			(pubsub* ps, uint32_t addr);
+static void*		pubsub_thread			(void* arg);
+static pubsub_entry* pubsub_claim			(pubsub* ps);
+static void			pubsub_dispatch			(pubsub* ps, unsigned long head, uint32_t now_secs);
+static void			pubsub_recv_unix		(pubsub* ps, uint32_t now_secs);
+static int			pubsub_fan_out			(pubsub* ps, unsigned long head, uint32_t now_secs);
+static uint8_t		pubsub_add_subscriber	(pubsub* ps, pubsub_subscriber* candidate, uint8_t* filter, uint32_t now_secs);
+static void			pubsub_send_status		(pubsub* ps, pubsub_subscriber* subscriber, uint8_t status);
+static bool			pubsub_matches			(pubsub_subscriber* subscriber, pubsub_entry* entry);
+static ssize_t		pubsub_send				(pubsub* ps, pubsub_subscriber* subscriber, uint8_t* datagram, int length);
+static uint32_t		pubsub_now_secs			(void);
+
+
+
+/*
+ * Binds Unix socket (if a path is given, replacing a stale one) and starts fan-out thread. UDP subscriptions are taken
+ * from loopback and from the allowed networks ("<ip>[/<bits>],...", NULL: none) only: subscribers are sent samples
+ * of every client, and a forged source would have them sent to a third party.
+ */
+int pubsub_start(pubsub* ps, int udp_socket, const char* unix_path, const char* allowed) {
+
+	atomic_init(&ps->head, 0);
+	atomic_init(&ps->tail, 0);
+	ps->tail_cached = 0;
+	atomic_init(&ps->dropped, 0);
+	atomic_init(&ps->n_subscribers, 0);
+	atomic_init(&ps->running, true);
+	atomic_init(&ps->published, 0);
+	atomic_init(&ps->sent, 0);
+	atomic_init(&ps->subscribed, 0);
+	atomic_init(&ps->slow_dropped, 0);
+	atomic_init(&ps->expired, 0);
+	memset(ps->n_staged, 0, sizeof(ps->n_staged));
+	memset(ps->subscribers, 0, sizeof(ps->subscribers));
+	ps->dispatched = 0;
+	ps->udp_socket = udp_socket;
+	ps->unix_socket = -1;
+	ps->unix_path = unix_path;
+	ps->refused = 0;
+	if (pubsub_parse_networks(ps, allowed) < 0)
+		return -1;
+
+	if (unix_path != NULL) {
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(unix_path) >= sizeof(addr.sun_path))
+			return -1;
+		strcpy(addr.sun_path, unix_path);
+
+		ps->unix_socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if (ps->unix_socket < 0)
+			return -1;
+		unlink(unix_path);
+		if (bind(ps->unix_socket, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+			close(ps->unix_socket);
+			return -1;
+		}
+	}
+
+	if (pthread_create(&ps->thread, NULL, pubsub_thread, ps) != 0) {
+		if (ps->unix_socket >= 0) {
+			close(ps->unix_socket);
+			unlink(unix_path);
+		}
+		return -1;
+	}
+	return 0;
+}
+
+
+
+void pubsub_stop(pubsub* ps) {
+
+	atomic_store(&ps->running, false);
+	pthread_join(ps->thread, NULL);
+
+	if (ps->unix_socket >= 0) {
+		close(ps->unix_socket);
+		unlink(ps->unix_path);
+	}
+}
+
+
+
+/*
+ * Producer side (ingest thread): a datagram's samples are staged per sensor between pubsub_begin() and pubsub_commit(),
+ * so each client sensor batch is encoded once whatever the number of subscribers. Nothing is staged without subscribers.
+ */
+bool pubsub_begin(pubsub* ps, uint32_t addr, uint16_t port, int64_t arrival_ns) {
+
+	if (atomic_load_explicit(&ps->n_subscribers, memory_order_relaxed) == 0)
+		return false;
+
+	ps->batch_addr = addr;
+	ps->batch_port = port;
+	ps->batch_ns = arrival_ns;
+	return true;
+}
+
+
+
+void pubsub_add_sample(pubsub* ps, int sensor, long int timestamp, float* values) {
+
+	if ((sensor < 0) || (sensor >= DATAGRAM_MAX_SENSORS))
+		return;
+	if (ps->n_staged[sensor] == PUBSUB_MAX_SAMPLES)
+		pubsub_commit(ps);
+
+	uint8_t* record = codec_at(ps->staged[sensor], ps->n_staged[sensor]++, DATAGRAM_TAGGED_SAMPLE_SIZE);
+	codec_tagged_sample_set_sensor(record, (uint8_t) sensor);
+	uint8_t* sample = codec_tagged_sample_sample(record);
+	codec_sample_set_timestamp(sample, (uint16_t) timestamp);
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++)
+		codec_sample_set_channel(sample, channel, (uint16_t) ((values[channel] * 655.35f) + 0.5f));
+}
+
+
+
+/*
+ * Encodes staged samples into ring entries (one per sensor) and hands them to the fan-out thread; a full ring drops them
+ */
+void pubsub_commit(pubsub* ps) {
+
+	int sensor;
+	for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+		int n_samples = ps->n_staged[sensor];
+		if (n_samples == 0)
+			continue;
+		ps->n_staged[sensor] = 0;
+
+		pubsub_entry* entry = pubsub_claim(ps);
+		if (entry == NULL)
+			continue;
+
+		int data_length = DATAGRAM_PUBLISH_HEADER_SIZE + (n_samples * DATAGRAM_TAGGED_SAMPLE_SIZE);
+		entry->kind = PUBSUB_ENTRY_SAMPLES;
+		entry->sensor = (uint8_t) sensor;
+		entry->port = ps->batch_port;
+		entry->addr = ps->batch_addr;
+		entry->length = (uint16_t) (DATAGRAM_HEADER_SIZE + data_length + 1);
+
+		codec_datagram_begin(entry->datagram, DATAGRAM_PUBLISH_SAMPLES, data_length);
+		uint8_t* publish = codec_datagram_payload(entry->datagram);
+		codec_store_addr(codec_publish_addr(publish), ps->batch_addr);
+		codec_store_port(codec_publish_port(publish), ps->batch_port);
+		codec_publish_set_arrival_ns(publish, (uint64_t) ps->batch_ns);
+		memcpy(publish + codec_publish_size, ps->staged[sensor], n_samples * DATAGRAM_TAGGED_SAMPLE_SIZE);
+
+		atomic_store_explicit(&ps->head, atomic_load_explicit(&ps->head, memory_order_relaxed) + 1, memory_order_release);
+	}
+}
+
+
+
+/*
+ * DATAGRAM_REQ_SUBSCRIBE received on the UDP socket: queued for the fan-out thread, which owns the subscriber table
+ * and replies. Sources outside loopback and the allowed networks are dropped unanswered.
+ */
+void pubsub_subscribe(pubsub* ps, uint8_t* buffer_recv, struct sockaddr_in* subscriber_addr) {
+
+	if (!pubsub_allowed(ps, subscriber_addr->sin_addr.s_addr)) {
+		ps->refused++;
+		return;
+	}
+
+	pubsub_entry* entry = pubsub_claim(ps);
+	if (entry == NULL)
+		return;
+
+	entry->kind = PUBSUB_ENTRY_SUBSCRIBE;
+	entry->subscriber = *subscriber_addr;
+	entry->length = 0;
+	memcpy(entry->datagram, buffer_recv, DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_SIZE);
+	atomic_store_explicit(&ps->head, atomic_load_explicit(&ps->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+
+
+void pubsub_build_reply(uint8_t* buffer_reply, uint8_t status) {
+
+	codec_datagram_begin(buffer_reply, DATAGRAM_REP_SUBSCRIBE, DATAGRAM_SUBSCRIBE_REPLY_SIZE);
+	codec_subscribe_reply_set_status(codec_datagram_payload(buffer_reply), status);
+	codec_subscribe_reply_set_lease(codec_datagram_payload(buffer_reply), PUBSUB_LEASE_SECS);
+}
+
+
+
+void pubsub_print_stats(pubsub* ps) {
+
+	printf("IOT_SERVER: Fan-out: %u subscribers - %lu batches published - %lu datagrams sent - %lu subscriptions (%lu refused) - %lu slow subscribers dropped - %lu expired - %lu batches dropped\n",
+			atomic_load(&ps->n_subscribers), atomic_load(&ps->published), atomic_load(&ps->sent), atomic_load(&ps->subscribed), ps->refused,
+			atomic_load(&ps->slow_dropped), atomic_load(&ps->expired), atomic_load(&ps->dropped));
+}
+
+
+
+/*
+ * Parses allowed networks: "<ip>[/<bits>]" separated by commas (bits: 32 if omitted)
+ * returns -1 on a malformed network or more than PUBSUB_MAX_NETWORKS
+ */
+static int pubsub_parse_networks(pubsub* ps, const char* list) {
+
+	ps->n_allowed = 0;
+	while ((list != NULL) && (*list != '\0')) {
+		char network[32];
+		const char* comma = strchr(list, ',');
+		size_t length = (comma != NULL) ? (size_t) (comma - list) : strlen(list);
+		if ((length == 0) || (length >= sizeof(network)) || (ps->n_allowed == PUBSUB_MAX_NETWORKS))
+			return -1;
+		memcpy(network, list, length);
+		network[length] = '\0';
+
+		long int bits = 32;
+		char* slash = strchr(network, '/');
+		if (slash != NULL) {
+			char* end;
+			*slash = '\0';
+			bits = strtol(slash + 1, &end, 10);
+			if ((end == (slash + 1)) || (*end != '\0'))
+				return -1;
+		}
+		struct in_addr addr;
+		if ((inet_aton(network, &addr) == 0) || (bits < 0) || (bits > 32))
+			return -1;
+
+		uint32_t mask = (bits == 0) ? 0 : htonl(0xFFFFFFFFu << (32 - bits));
+		ps->allowed[ps->n_allowed].addr = addr.s_addr & mask;
+		ps->allowed[ps->n_allowed].mask = mask;
+		ps->n_allowed++;
+		list = (comma != NULL) ? (comma + 1) : NULL;
+	}
+	return 0;
+}
+
+
+
+static bool pubsub_allowed(pubsub* ps, uint32_t addr) {
+
+	if ((ntohl(addr) >> 24) == 127)
+		return true;
+	int index;
+	for (index = 0; index < ps->n_allowed; index++) {
+		if ((addr & ps->allowed[index].mask) == ps->allowed[index].addr)
+			return true;
+	}
+	return false;
+}
+
+
+
+/*
+ * Consumer side: applies subscriptions, sends each new entry to its matching subscribers (never blocking on one)
+ * and releases ring slots all subscribers are done with. Sleeps (polling the Unix socket) when idle.
+ */
+static void* pubsub_thread(void* arg) {
+
+	pubsub* ps = (pubsub*) arg;
+	struct timespec idle = { 0, PUBSUB_IDLE_NS };
+
+	while (atomic_load(&ps->running)) {
+		uint32_t now_secs = pubsub_now_secs();
+		unsigned long head = atomic_load_explicit(&ps->head, memory_order_acquire);
+		bool new_entries = (head != ps->dispatched);
+
+		pubsub_dispatch(ps, head, now_secs);
+		if (ps->unix_socket >= 0)
+			pubsub_recv_unix(ps, now_secs);
+		int waiting = pubsub_fan_out(ps, head, now_secs);
+
+		if (!new_entries && (waiting == 0)) {
+			if (ps->unix_socket >= 0) {
+				struct pollfd pending = { ps->unix_socket, POLLIN, 0 };
+				poll(&pending, 1, PUBSUB_IDLE_NS / 1000000);
+			} else {
+				nanosleep(&idle, NULL);
+			}
+		} else if (!new_entries) {
+			nanosleep(&idle, NULL);		// Subscriber sockets full: give them time to drain
+		}
+	}
+	return NULL;
+}
+
+
+
+/*
+ * returns free ring entry for the producer, or NULL (counted) if ring is full
+ */
+static pubsub_entry* pubsub_claim(pubsub* ps) {
+	unsigned long head = atomic_load_explicit(&ps->head, memory_order_relaxed);
+
+	if ((head - ps->tail_cached) >= PUBSUB_RING_SIZE) {
+		ps->tail_cached = atomic_load_explicit(&ps->tail, memory_order_acquire);
+		if ((head - ps->tail_cached) >= PUBSUB_RING_SIZE) {
+			atomic_fetch_add_explicit(&ps->dropped, 1, memory_order_relaxed);
+			return NULL;
+		}
+	}
+	return &ps->ring[head & (PUBSUB_RING_SIZE - 1)];
+}
+
+
+
+/*
+ * First pass over new entries: subscriptions take effect from the next entry on
+ */
+static void pubsub_dispatch(pubsub* ps, unsigned long head, uint32_t now_secs) {
+
+	for (; ps->dispatched != head; ps->dispatched++) {
+		pubsub_entry* entry = &ps->ring[ps->dispatched & (PUBSUB_RING_SIZE - 1)];
+		if (entry->kind != PUBSUB_ENTRY_SUBSCRIBE) {
+			atomic_fetch_add_explicit(&ps->published, 1, memory_order_relaxed);
+			continue;
+		}
+
+		pubsub_subscriber candidate;
+		memset(&candidate, 0, sizeof(candidate));
+		candidate.addr_in = entry->subscriber;
+		candidate.next = ps->dispatched + 1;
+		uint8_t status = pubsub_add_subscriber(ps, &candidate, codec_datagram_payload(entry->datagram), now_secs);
+		pubsub_send_status(ps, &candidate, status);
+	}
+}
+
+
+
+/*
+ * Subscriptions on the Unix socket: subscribers must bind their socket (e.g. autobind) to be answered
+ */
+static void pubsub_recv_unix(pubsub* ps, uint32_t now_secs) {
+
+	uint8_t buffer_recv[DATAGRAM_SIZE];
+	pubsub_subscriber candidate;
+	while (true) {
+		memset(&candidate, 0, sizeof(candidate));
+		candidate.unix_socket = true;
+		candidate.addr_un_length = sizeof(candidate.addr_un);
+		ssize_t recv_len = recvfrom(ps->unix_socket, buffer_recv, DATAGRAM_SIZE, MSG_DONTWAIT, (struct sockaddr *) &candidate.addr_un, &candidate.addr_un_length);
+		if (recv_len < 0)
+			return;
+		if ((recv_len < (DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_SIZE)) || (buffer_recv[0] != DATAGRAM_REQ_SUBSCRIBE)
+				|| (candidate.addr_un_length <= sizeof(sa_family_t)))
+			continue;
+
+		candidate.next = ps->dispatched;
+		uint8_t status = pubsub_add_subscriber(ps, &candidate, codec_datagram_payload(buffer_recv), now_secs);
+		pubsub_send_status(ps, &candidate, status);
+	}
+}
+
+
+
+/*
+ * Sends every subscriber its queued entries up to head, skipping those its filter does not match. A subscriber whose
+ * socket is full keeps its queue and is retried on the next pass; past PUBSUB_QUEUE_DEPTH entries it is dropped.
+ * returns subscribers left with queued entries
+ */
+static int pubsub_fan_out(pubsub* ps, unsigned long head, uint32_t now_secs) {
+
+	unsigned long tail = head;
+	int waiting = 0;
+	int n_subscribers = 0;
+	int index;
+	for (index = 0; index < PUBSUB_MAX_SUBSCRIBERS; index++) {
+		pubsub_subscriber* subscriber = &ps->subscribers[index];
+		if (!subscriber->in_use)
+			continue;
+
+		if ((int32_t) (now_secs - subscriber->expires) >= 0) {
+			subscriber->in_use = false;
+			atomic_fetch_add_explicit(&ps->expired, 1, memory_order_relaxed);
+			continue;
+		}
+
+		for (; subscriber->next != head; subscriber->next++) {
+			pubsub_entry* entry = &ps->ring[subscriber->next & (PUBSUB_RING_SIZE - 1)];
+			if ((entry->kind != PUBSUB_ENTRY_SAMPLES) || !pubsub_matches(subscriber, entry))
+				continue;
+			if (pubsub_send(ps, subscriber, entry->datagram, entry->length) < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS))
+					break;
+				continue;		// Unreachable subscriber: entry is skipped, lease expiry removes it
+			}
+			subscriber->sent++;
+			atomic_fetch_add_explicit(&ps->sent, 1, memory_order_relaxed);
+		}
+
+		if ((head - subscriber->next) > PUBSUB_QUEUE_DEPTH) {
+			subscriber->in_use = false;
+			atomic_fetch_add_explicit(&ps->slow_dropped, 1, memory_order_relaxed);
+			pubsub_send_status(ps, subscriber, PUBSUB_STATUS_DROPPED);
+			continue;
+		}
+
+		if (subscriber->next != head)
+			waiting++;
+		if ((long) (subscriber->next - tail) < 0)
+			tail = subscriber->next;
+		n_subscribers++;
+	}
+
+	atomic_store_explicit(&ps->n_subscribers, n_subscribers, memory_order_relaxed);
+	atomic_store_explicit(&ps->tail, tail, memory_order_release);
+	return waiting;
+}
+
+
+
+/*
+ * Renews an existing subscription of the same address (filter replaced, queue kept) or takes a free slot
+ * returns PUBSUB_STATUS_* for the reply
+ */
+static uint8_t pubsub_add_subscriber(pubsub* ps, pubsub_subscriber* candidate, uint8_t* filter, uint32_t now_secs) {
+
+	pubsub_subscriber* slot = NULL;
+	int index;
+	for (index = 0; index < PUBSUB_MAX_SUBSCRIBERS; index++) {
+		pubsub_subscriber* subscriber = &ps->subscribers[index];
+		if (!subscriber->in_use) {
+			if (slot == NULL)
+				slot = subscriber;
+			continue;
+		}
+		bool same = (subscriber->unix_socket == candidate->unix_socket) && (candidate->unix_socket
+				? ((subscriber->addr_un_length == candidate->addr_un_length) && (memcmp(&subscriber->addr_un, &candidate->addr_un, candidate->addr_un_length) == 0))
+				: ((subscriber->addr_in.sin_addr.s_addr == candidate->addr_in.sin_addr.s_addr) && (subscriber->addr_in.sin_port == candidate->addr_in.sin_port)));
+		if (same) {
+			candidate->next = subscriber->next;
+			candidate->sent = subscriber->sent;
+			slot = subscriber;
+			break;
+		}
+	}
+	if (slot == NULL)
+		return PUBSUB_STATUS_FULL;
+
+	bool renewed = slot->in_use;
+	*slot = *candidate;
+	slot->in_use = true;
+	slot->filter_addr = codec_load_addr(codec_subscribe_addr(filter));
+	slot->filter_port = codec_load_port(codec_subscribe_port(filter));
+	slot->filter_sensor = codec_subscribe_get_sensor(filter);
+	slot->expires = now_secs + PUBSUB_LEASE_SECS;
+	if (!renewed) {
+		atomic_fetch_add_explicit(&ps->subscribed, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&ps->n_subscribers, 1, memory_order_relaxed);
+	}
+	return PUBSUB_STATUS_OK;
+}
+
+
+
+static void pubsub_send_status(pubsub* ps, pubsub_subscriber* subscriber, uint8_t status) {
+
+	uint8_t buffer_reply[DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_REPLY_SIZE + 1];
+	pubsub_build_reply(buffer_reply, status);
+	pubsub_send(ps, subscriber, buffer_reply, sizeof(buffer_reply));
+}
+
+
+
+static bool pubsub_matches(pubsub_subscriber* subscriber, pubsub_entry* entry) {
+
+	return ((subscriber->filter_addr == 0) || (subscriber->filter_addr == entry->addr))
+			&& ((subscriber->filter_port == 0) || (subscriber->filter_port == entry->port))
+			&& ((subscriber->filter_sensor == DATAGRAM_SUBSCRIBE_ANY_SENSOR) || (subscriber->filter_sensor == entry->sensor));
+}
+
+
+
+static ssize_t pubsub_send(pubsub* ps, pubsub_subscriber* subscriber, uint8_t* datagram, int length) {
+
+	if (subscriber->unix_socket)
+		return sendto(ps->unix_socket, datagram, length, MSG_DONTWAIT, (struct sockaddr *) &subscriber->addr_un, subscriber->addr_un_length);
+	return sendto(ps->udp_socket, datagram, length, MSG_DONTWAIT, (struct sockaddr *) &subscriber->addr_in, sizeof(subscriber->addr_in));
+}
+
+
+
+static uint32_t pubsub_now_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) now.tv_sec;
+}
@@ -0,0 +1,136 @@
+/*
+ * pubsub.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef PUBSUB_H_
+#define PUBSUB_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <stdatomic.h>		// For lock-free head/tail indexes
+#include <pthread.h>		// For pthread_t
+#include <netinet/in.h>		// For sockaddr_in struct
+#include <sys/un.h>			// For sockaddr_un struct
+
+#include "iot_lib.h"
+#include "iot_codec.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define PUBSUB_RING_SIZE			4096	// Entries between ingest and fan-out threads (power of 2)
+#define PUBSUB_QUEUE_DEPTH			1024	// Entries a subscriber may lag behind before it is dropped (< ring size)
+#define PUBSUB_MAX_SUBSCRIBERS		64
+#define PUBSUB_LEASE_SECS			30		// Subscriptions not renewed for this long expire
+#define PUBSUB_IDLE_NS				1000000	// Fan-out thread sleep (or Unix socket poll) when there is nothing to do
+#define PUBSUB_MAX_SAMPLES			((DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - DATAGRAM_PUBLISH_HEADER_SIZE - 1) / DATAGRAM_TAGGED_SAMPLE_SIZE)
+#define PUBSUB_MAX_NETWORKS			16		// Networks allowed to subscribe over UDP, besides loopback (always allowed)
+
+#define PUBSUB_STATUS_OK			0x00	// DATAGRAM_REP_SUBSCRIBE status
+#define PUBSUB_STATUS_FULL			0x01	// No free subscriber slot
+#define PUBSUB_STATUS_DISABLED		0x02	// Server not started with fan-out
+#define PUBSUB_STATUS_DROPPED		0x03	// Unsolicited: subscriber lagged too far behind and was removed
+
+#define PUBSUB_ENTRY_SAMPLES		0x01	// Encoded DATAGRAM_PUBLISH_SAMPLES, sent to every matching subscriber
+#define PUBSUB_ENTRY_SUBSCRIBE		0x02	// DATAGRAM_REQ_SUBSCRIBE received by ingest thread on the UDP socket
+
+#if PUBSUB_QUEUE_DEPTH >= PUBSUB_RING_SIZE
+#error "Subscriber queues must be shorter than the ring, or a slow subscriber could stall ingest"
+#endif
+
+
+
+/* TYPE DEFINITIONS */
+
+// Source network allowed to subscribe over UDP (network order)
+typedef struct {
+	uint32_t			addr;
+	uint32_t			mask;
+} pubsub_network;
+
+
+// Ring entry: a batch of one client sensor's samples, encoded once and shared by all subscribers, or a subscription
+typedef struct {
+	uint8_t				kind;				// PUBSUB_ENTRY_*
+	uint8_t				sensor;				// Samples: sensor id / subscription: filter (DATAGRAM_SUBSCRIBE_ANY_SENSOR: any)
+	uint16_t			port;				// Samples: client port / subscription: filter (0: any), network order
+	uint32_t			addr;				// Samples: client address / subscription: filter (0: any), network order
+	uint16_t			length;				// Encoded datagram bytes
+	struct sockaddr_in	subscriber;			// Subscription only
+	uint8_t				datagram	[DATAGRAM_SIZE];
+} pubsub_entry;
+
+
+typedef struct {
+	bool				in_use;
+	bool				unix_socket;		// Reached through Unix socket (otherwise UDP)
+	struct sockaddr_in	addr_in;
+	struct sockaddr_un	addr_un;
+	socklen_t			addr_un_length;
+	uint32_t			filter_addr;
+	uint16_t			filter_port;
+	uint8_t				filter_sensor;
+	unsigned long		next;				// Next ring entry to send: its queue is [next, dispatched)
+	uint32_t			expires;			// Monotonic seconds
+	unsigned long		sent;
+} pubsub_subscriber;
+
+
+typedef struct {
+	// Single-producer (ingest thread) / single-consumer (fan-out thread) ring, as the exporter's: ingest never waits.
+	// Ring slots are released only when every subscriber has sent (or skipped) them.
+	pubsub_entry		ring		[PUBSUB_RING_SIZE];
+	_Alignas(64) atomic_ulong	head;
+	unsigned long		tail_cached;		// Producer only
+	atomic_ulong		dropped;			// Entries discarded because ring was full
+	atomic_uint			n_subscribers;		// Ingest skips encoding while zero
+	_Alignas(64) atomic_ulong	tail;
+	atomic_bool			running;
+	pthread_t			thread;
+
+	// Ingest thread only: UDP subscription sources, and samples of the datagram being published, grouped by sensor
+	pubsub_network		allowed		[PUBSUB_MAX_NETWORKS];
+	int					n_allowed;
+	unsigned long		refused;			// UDP subscriptions from sources not allowed, dropped unanswered
+	uint32_t			batch_addr;
+	uint16_t			batch_port;
+	int64_t				batch_ns;
+	uint8_t				staged		[DATAGRAM_MAX_SENSORS][PUBSUB_MAX_SAMPLES * DATAGRAM_TAGGED_SAMPLE_SIZE];
+	int					n_staged	[DATAGRAM_MAX_SENSORS];
+
+	// Fan-out thread only
+	int					udp_socket;			// Server socket, shared for sending only
+	int					unix_socket;		// Subscriptions and fan-out through Unix datagram socket (-1: disabled)
+	const char*			unix_path;
+	unsigned long		dispatched;			// Ring entries already seen by fan-out thread
+	pubsub_subscriber	subscribers	[PUBSUB_MAX_SUBSCRIBERS];
+
+	// Written by fan-out thread, read by ingest thread
+	atomic_ulong		published;			// Sample entries dispatched
+	atomic_ulong		sent;				// Datagrams sent to subscribers
+	atomic_ulong		subscribed;
+	atomic_ulong		slow_dropped;		// Subscribers dropped for lagging PUBSUB_QUEUE_DEPTH entries behind
+	atomic_ulong		expired;
+} pubsub;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		pubsub_start			(pubsub* ps, int udp_socket, const char* unix_path, const char* allowed);	// returns -1 if networks are malformed, or Unix socket or thread cannot be created
+void	pubsub_stop				(pubsub* ps);
+bool	pubsub_begin			(pubsub* ps, uint32_t addr, uint16_t port, int64_t arrival_ns);	// returns false if nobody subscribed
+void	pubsub_add_sample		(pubsub* ps, int sensor, long int timestamp, float* values);
+void	pubsub_commit			(pubsub* ps);
+void	pubsub_subscribe		(pubsub* ps, uint8_t* buffer_recv, struct sockaddr_in* subscriber_addr);
+void	pubsub_build_reply		(uint8_t* buffer_reply, uint8_t status);
+void	pubsub_print_stats		(pubsub* ps);
+
+
+
+#endif /* PUBSUB_H_ */
@@ -0,0 +1,181 @@
+/*
+ * pubsub_tail.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf() and sscanf()
+#include <string.h>			// For memset() and memcpy()
+#include <unistd.h>			// For close()
+#include <time.h>			// For time()
+#include <sys/socket.h>		// For socket()
+#include <sys/time.h>		// For timeval struct
+#include <arpa/inet.h>		// For inet_aton() and inet_ntoa()
+
+#include "pubsub_tail.h"
+
+
+
+static int		tail_parse_filter	(const char* spec, uint8_t* filter);
+static int		tail_subscribe		(int tail_socket, uint8_t* filter);
+static void		tail_print			(uint8_t* buffer_recv, int recv_len);
+
+
+
+/*
+ * Subscribes to a running server's live samples and prints them until interrupted. Filter: "all" or
+ * "<client ip>[:<port>][/<sensor>]" (e.g. "192.168.1.50", "192.168.1.50:40000/2"). Subscribes over UDP, or over the
+ * server's Unix socket if a path is given; subscription is renewed every third of its lease.
+ */
+int pubsub_tail_run(const char* spec, const char* unix_path) {
+
+	uint8_t filter[DATAGRAM_SUBSCRIBE_SIZE];
+	if (tail_parse_filter(spec, filter) < 0)
+		return -1;
+
+	int tail_socket;
+	if (unix_path != NULL) {
+		struct sockaddr_un server_addr;
+		memset(&server_addr, 0, sizeof(server_addr));
+		server_addr.sun_family = AF_UNIX;
+		if (strlen(unix_path) >= sizeof(server_addr.sun_path))
+			return -1;
+		strcpy(server_addr.sun_path, unix_path);
+
+		// Autobind (abstract address) so the server can send back
+		sa_family_t family = AF_UNIX;
+		tail_socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if ((tail_socket < 0) || (bind(tail_socket, (struct sockaddr *) &family, sizeof(family)) < 0)
+				|| (connect(tail_socket, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0))
+			return -1;
+	} else {
+		struct sockaddr_in server_addr;
+		memset(&server_addr, 0, sizeof(server_addr));
+		server_addr.sin_family = AF_INET;
+		server_addr.sin_port = htons(SERVER_PORT);
+		inet_aton(PUBSUB_TAIL_ADDR, &server_addr.sin_addr);
+
+		tail_socket = socket(AF_INET, SOCK_DGRAM, 0);
+		if ((tail_socket < 0) || (connect(tail_socket, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0))
+			return -1;
+	}
+
+	struct timeval intervals = { 1, 0 };
+	setsockopt(tail_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals));
+
+	int lease = tail_subscribe(tail_socket, filter);
+	if (lease < 0) {
+		close(tail_socket);
+		return -1;
+	}
+	printf("IOT_SERVER: == Tailing %s samples through %s (lease %d seconds) ==\n", spec, (unix_path != NULL) ? unix_path : "UDP", lease);
+
+	time_t renewed = time(NULL);
+	unsigned long received = 0;
+	while (true) {
+		uint8_t buffer_recv[DATAGRAM_SIZE];
+		ssize_t recv_len = recv(tail_socket, buffer_recv, DATAGRAM_SIZE, 0);
+
+		if ((recv_len >= (DATAGRAM_HEADER_SIZE + DATAGRAM_PUBLISH_HEADER_SIZE)) && (buffer_recv[0] == DATAGRAM_PUBLISH_SAMPLES)) {
+			tail_print(buffer_recv, (int) recv_len);
+			received++;
+		} else if ((recv_len >= (DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_REPLY_SIZE)) && (buffer_recv[0] == DATAGRAM_REP_SUBSCRIBE)
+				&& (codec_subscribe_reply_get_status(codec_datagram_payload(buffer_recv)) == PUBSUB_STATUS_DROPPED)) {
+			printf("IOT_SERVER: >> Dropped by server for falling behind after %lu batches: subscribing again\n", received);
+			renewed = 0;
+		}
+
+		// Renewal replies are read (and ignored) by the loop itself
+		if ((time(NULL) - renewed) >= (lease / 3)) {
+			uint8_t buffer_send[DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_SIZE + 1];
+			codec_datagram_begin(buffer_send, DATAGRAM_REQ_SUBSCRIBE, DATAGRAM_SUBSCRIBE_SIZE);
+			memcpy(codec_datagram_payload(buffer_send), filter, DATAGRAM_SUBSCRIBE_SIZE);
+			send(tail_socket, buffer_send, sizeof(buffer_send), 0);
+			renewed = time(NULL);
+		}
+	}
+
+	close(tail_socket);
+	return 0;
+}
+
+
+
+static int tail_parse_filter(const char* spec, uint8_t* filter) {
+	char client_ip[32];
+	int port = 0, sensor = DATAGRAM_SUBSCRIBE_ANY_SENSOR;
+	struct in_addr client_addr = { .s_addr = 0 };
+
+	if (strcmp(spec, "all") != 0) {
+		if ((sscanf(spec, "%31[^:/]:%d/%d", client_ip, &port, &sensor) < 1) || (inet_aton(client_ip, &client_addr) == 0))
+			return -1;
+		if ((strchr(spec, ':') == NULL) && (strchr(spec, '/') != NULL) && (sscanf(strchr(spec, '/'), "/%d", &sensor) != 1))
+			return -1;
+	}
+	if ((port < 0) || (port > 65535) || (((sensor < 0) || (sensor >= DATAGRAM_MAX_SENSORS)) && (sensor != DATAGRAM_SUBSCRIBE_ANY_SENSOR)))
+		return -1;
+
+	codec_store_addr(codec_subscribe_addr(filter), client_addr.s_addr);
+	codec_store_port(codec_subscribe_port(filter), htons((uint16_t) port));
+	codec_subscribe_set_sensor(filter, (uint8_t) sensor);
+	return 0;
+}
+
+
+
+/*
+ * returns lease in seconds, or -1 if server did not answer or refused
+ */
+static int tail_subscribe(int tail_socket, uint8_t* filter) {
+
+	uint8_t buffer_send[DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_SIZE + 1];
+	codec_datagram_begin(buffer_send, DATAGRAM_REQ_SUBSCRIBE, DATAGRAM_SUBSCRIBE_SIZE);
+	memcpy(codec_datagram_payload(buffer_send), filter, DATAGRAM_SUBSCRIBE_SIZE);
+	if (send(tail_socket, buffer_send, sizeof(buffer_send), 0) < 0)
+		return -1;
+
+	uint8_t buffer_recv[DATAGRAM_SIZE];
+	ssize_t recv_len = recv(tail_socket, buffer_recv, DATAGRAM_SIZE, 0);
+	if ((recv_len < (DATAGRAM_HEADER_SIZE + DATAGRAM_SUBSCRIBE_REPLY_SIZE)) || (buffer_recv[0] != DATAGRAM_REP_SUBSCRIBE))
+		return -1;
+
+	uint8_t* reply = codec_datagram_payload(buffer_recv);
+	uint8_t status = codec_subscribe_reply_get_status(reply);
+	if (status != PUBSUB_STATUS_OK) {
+		printf("IOT_SERVER: >> Subscription refused: %s\n", (status == PUBSUB_STATUS_FULL) ? "no free subscriber slot" : "server fan-out disabled (-p)");
+		return -1;
+	}
+	int lease = codec_subscribe_reply_get_lease(reply);
+	return (lease >= 3) ? lease : 3;
+}
+
+
+
+static void tail_print(uint8_t* buffer_recv, int recv_len) {
+
+	int data_length = codec_datagram_length(buffer_recv);
+	if ((DATAGRAM_HEADER_SIZE + data_length) > recv_len)
+		return;
+
+	uint8_t* publish = codec_datagram_payload(buffer_recv);
+	struct in_addr client_addr = { .s_addr = codec_load_addr(codec_publish_addr(publish)) };
+	uint16_t port = codec_load_port(codec_publish_port(publish));
+	uint64_t arrival_ns = codec_publish_get_arrival_ns(publish);
+	time_t arrival_secs = (time_t) (arrival_ns / 1000000000ULL);
+	char clock[16];
+	strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&arrival_secs));
+
+	int n_samples = (data_length - DATAGRAM_PUBLISH_HEADER_SIZE) / DATAGRAM_TAGGED_SAMPLE_SIZE;
+	int sample;
+	for (sample = 0; sample < n_samples; sample++) {
+		uint8_t* record = codec_at(publish + DATAGRAM_PUBLISH_HEADER_SIZE, sample, DATAGRAM_TAGGED_SAMPLE_SIZE);
+		uint8_t* values = codec_tagged_sample_sample(record);
+		printf("IOT_SERVER: %s.%03d %s:%d sensor %d sample at %d ms: Clarity %.2f %% - Red %.2f %% - Green %.2f %% - Blue %.2f %%\n",
+				clock, (int) ((arrival_ns / 1000000ULL) % 1000), inet_ntoa(client_addr), ntohs(port), codec_tagged_sample_get_sensor(record),
+				codec_sample_get_timestamp(values), codec_sample_get_clarity(values) / 655.35, codec_sample_get_red(values) / 655.35,
+				codec_sample_get_green(values) / 655.35, codec_sample_get_blue(values) / 655.35);
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,28 @@
+/*
+ * pubsub_tail.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef PUBSUB_TAIL_H_
+#define PUBSUB_TAIL_H_
+
+
+#include "pubsub.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define PUBSUB_TAIL_ADDR		"127.0.0.1"		// Running server subscribed to over UDP (-T without -U)
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		pubsub_tail_run		(const char* spec, const char* unix_path);	// returns -1 on malformed filter or refused subscription
+
+
+
+#endif /* PUBSUB_TAIL_H_ */
@@ -0,0 +1,394 @@
+/*
+ * range_index.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For malloc() and free()
+#include <string.h>			// For memset()
+#include <float.h>			// For FLT_MAX
+
+#include "range_index.h"
+
+
+
+static range_series*	range_series_get		(range_store* store, client_session* session, int sensor, bool create);
+static int				range_series_alloc		(range_series* series, int capacity);
+static void				range_series_grow		(range_store* store, range_series* series, int capacity);
+static void				range_series_advance	(range_store* store, range_series* series, int64_t second);
+static size_t			range_series_bytes		(int capacity);
+static void				range_tree_set			(range_series* series, int position, float* minimum, float* maximum);
+static void				range_tree_query		(range_series* series, int from, int to, range_extrema* acc);
+static void				range_extrema_empty		(range_extrema* extrema);
+static void				range_extrema_merge		(range_extrema* acc, range_extrema* other);
+
+
+
+void range_store_init(range_store* store) {
+
+	memset(store, 0, sizeof(*store));
+}
+
+
+
+void range_store_free(range_store* store) {
+
+	range_series* series = store->all;
+	while (series != NULL) {
+		range_series* next = series->store_next;
+		free(series->buckets);
+		free(series->tree);
+		free(series);
+		series = next;
+	}
+	memset(store, 0, sizeof(*store));
+}
+
+
+
+/*
+ * Adds samples (a single one, or a window summary) of client session arriving at second: O(log capacity), plus an
+ * occasional doubling of the series. Samples arriving late (clock stepped back) count into the newest bucket.
+ */
+void range_add(range_store* store, client_session* session, int sensor, int64_t second,
+		long int count, double* sum, float* minimum, float* maximum) {
+
+	if ((session == NULL) || (count <= 0))
+		return;
+	range_series* series = range_series_get(store, session, sensor, true);
+	if (series == NULL) {
+		store->dropped++;
+		return;
+	}
+
+	range_series_advance(store, series, second);
+	int position = (int) (series->last_second & (series->capacity - 1));
+	range_bucket* bucket = &series->buckets[position];
+
+	bucket->count += count;
+	bucket->cumulative_count += count;
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		bucket->sum[channel] += sum[channel];
+		bucket->cumulative[channel] += sum[channel];
+	}
+
+	range_tree_set(series, position, minimum, maximum);
+}
+
+
+
+/*
+ * Statistics over [from, to] (unix seconds, inclusive), clamped to the indexed window: means from the difference
+ * of two prefix sums (O(1)), extrema from the segment tree (O(log capacity)). No sample is rescanned.
+ */
+int range_query(client_session* session, int sensor, int64_t from, int64_t to, range_result* result) {
+
+	memset(result, 0, sizeof(*result));
+	range_series* series = (session != NULL) ? range_series_get(NULL, session, sensor, false) : NULL;
+	if ((series == NULL) || (series->last_second < 0))
+		return -1;
+
+	if (from < series->first_second)
+		from = series->first_second;
+	if (to > series->last_second)
+		to = series->last_second;
+	result->from = from;
+	result->to = to;
+	if (from > to)
+		return -1;
+
+	int mask = series->capacity - 1;
+	range_bucket* first = &series->buckets[from & mask];
+	range_bucket* last = &series->buckets[to & mask];
+	result->count = (long int) (last->cumulative_count - (first->cumulative_count - first->count));
+	if (result->count == 0)
+		return -1;
+
+	range_extrema extrema;
+	range_extrema_empty(&extrema);
+	range_tree_query(series, (int) (from & mask), (int) (to & mask), &extrema);
+
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		double sum = last->cumulative[channel] - (first->cumulative[channel] - first->sum[channel]);
+		result->mean[channel] = (float) (sum / result->count);
+		result->minimum[channel] = extrema.minimum[channel];
+		result->maximum[channel] = extrema.maximum[channel];
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * Frees series of a session leaving the registry (idle timeout, or handed to another cluster node)
+ */
+void range_release(range_store* store, client_session* session) {
+
+	range_series* series = session->ranges;
+	while (series != NULL) {
+		range_series* next = series->next;
+		if (series->store_prev != NULL)
+			series->store_prev->store_next = series->store_next;
+		else
+			store->all = series->store_next;
+		if (series->store_next != NULL)
+			series->store_next->store_prev = series->store_prev;
+
+		store->bytes -= range_series_bytes(series->capacity);
+		store->n_series--;
+		free(series->buckets);
+		free(series->tree);
+		free(series);
+		series = next;
+	}
+	session->ranges = NULL;
+}
+
+
+
+void range_print_stats(range_store* store) {
+
+	printf("IOT_SERVER: Range index: %lu series - %zu KB - %lu additions not indexed - %lu series kept short (budget %ld MB)\n",
+			store->n_series, store->bytes / 1024, store->dropped, store->capped, RANGE_MAX_BYTES / (1024 * 1024));
+}
+
+
+
+/*
+ * Series of session's sensor, among the few of that session; created on the sensor's first addition
+ */
+static range_series* range_series_get(range_store* store, client_session* session, int sensor, bool create) {
+
+	range_series* series;
+	for (series = session->ranges; series != NULL; series = series->next) {
+		if (series->sensor == sensor)
+			return series;
+	}
+	if (!create)
+		return NULL;
+
+	if ((store->bytes + range_series_bytes(RANGE_MIN_SECS)) > RANGE_MAX_BYTES)
+		return NULL;
+	series = calloc(1, sizeof(*series));
+	if ((series == NULL) || (range_series_alloc(series, RANGE_MIN_SECS) < 0)) {
+		free(series);
+		return NULL;
+	}
+
+	series->sensor = (uint8_t) sensor;
+	series->first_second = -1;
+	series->last_second = -1;
+	series->next = session->ranges;
+	session->ranges = series;
+	series->store_next = store->all;
+	if (store->all != NULL)
+		store->all->store_prev = series;
+	store->all = series;
+
+	store->bytes += range_series_bytes(RANGE_MIN_SECS);
+	store->n_series++;
+	return series;
+}
+
+
+
+/*
+ * Allocates empty buckets and tree of capacity
+ * returns -1 if allocation fails (series unchanged)
+ */
+static int range_series_alloc(range_series* series, int capacity) {
+
+	range_bucket* buckets = calloc((size_t) capacity, sizeof(range_bucket));
+	range_extrema* tree = malloc(2 * (size_t) capacity * sizeof(range_extrema));
+	if ((buckets == NULL) || (tree == NULL)) {
+		free(buckets);
+		free(tree);
+		return -1;
+	}
+
+	int node;
+	for (node = 0; node < (2 * capacity); node++)
+		range_extrema_empty(&tree[node]);
+
+	series->buckets = buckets;
+	series->tree = tree;
+	series->capacity = capacity;
+	return 0;
+}
+
+
+
+/*
+ * Widens series to capacity: the window's buckets move to their position in the wider array (same seconds), the tree
+ * is rebuilt above their leaves. Without memory (or budget) the series keeps its shorter window.
+ */
+static void range_series_grow(range_store* store, range_series* series, int capacity) {
+
+	size_t added = range_series_bytes(capacity) - range_series_bytes(series->capacity);
+	range_series wider = *series;
+	if (((store->bytes + added) > RANGE_MAX_BYTES) || (range_series_alloc(&wider, capacity) < 0)) {
+		store->capped++;
+		return;
+	}
+
+	int64_t second;
+	for (second = series->first_second; second <= series->last_second; second++) {
+		int from = (int) (second & (series->capacity - 1));
+		int to = (int) (second & (capacity - 1));
+		wider.buckets[to] = series->buckets[from];
+		wider.tree[capacity + to] = series->tree[series->capacity + from];
+	}
+	int node;
+	for (node = capacity - 1; node >= 1; node--) {
+		wider.tree[node] = wider.tree[2 * node];
+		range_extrema_merge(&wider.tree[node], &wider.tree[(2 * node) + 1]);
+	}
+
+	free(series->buckets);
+	free(series->tree);
+	series->buckets = wider.buckets;
+	series->tree = wider.tree;
+	series->capacity = capacity;
+	store->bytes += added;
+}
+
+
+
+/*
+ * Opens buckets up to second: each new bucket starts empty, carrying the prefix sums forward. The series is widened
+ * first if the seconds it covers outgrow it. A gap longer than the window only needs the last capacity buckets opened.
+ */
+static void range_series_advance(range_store* store, range_series* series, int64_t second) {
+
+	if (series->last_second < 0) {
+		series->first_second = second;
+		series->last_second = second;
+		series->buckets[second & (series->capacity - 1)].second = second;
+		return;
+	}
+	if (second <= series->last_second)
+		return;
+
+	int64_t span = second - series->first_second + 1;
+	if ((span > series->capacity) && (series->capacity < RANGE_INDEX_SECS)) {
+		int capacity = series->capacity;
+		while ((capacity < span) && (capacity < RANGE_INDEX_SECS))
+			capacity <<= 1;
+		range_series_grow(store, series, capacity);
+	}
+
+	int mask = series->capacity - 1;
+	range_bucket previous = series->buckets[series->last_second & mask];
+	int64_t next = series->last_second + 1;
+	if ((second - next) >= series->capacity)
+		next = second - series->capacity + 1;
+
+	range_extrema empty;
+	range_extrema_empty(&empty);
+	for (; next <= second; next++) {
+		int position = (int) (next & mask);
+		range_bucket* bucket = &series->buckets[position];
+		bucket->second = next;
+		bucket->count = 0;
+		memset(bucket->sum, 0, sizeof(bucket->sum));
+		memcpy(bucket->cumulative, previous.cumulative, sizeof(bucket->cumulative));
+		bucket->cumulative_count = previous.cumulative_count;
+
+		// Reused leaf: clear it before the path above is recomputed
+		series->tree[series->capacity + position] = empty;
+		range_tree_set(series, position, NULL, NULL);
+	}
+
+	series->last_second = second;
+	if (series->first_second < (second - series->capacity + 1))
+		series->first_second = second - series->capacity + 1;
+}
+
+
+
+static size_t range_series_bytes(int capacity) {
+
+	return (size_t) capacity * (sizeof(range_bucket) + (2 * sizeof(range_extrema)));
+}
+
+
+
+/*
+ * Merges extrema into bucket's leaf (if given) and recomputes its path up to the root
+ */
+static void range_tree_set(range_series* series, int position, float* minimum, float* maximum) {
+
+	int node = series->capacity + position;
+	range_extrema* leaf = &series->tree[node];
+
+	int channel;
+	if (minimum != NULL) {
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+			if (minimum[channel] < leaf->minimum[channel])
+				leaf->minimum[channel] = minimum[channel];
+			if (maximum[channel] > leaf->maximum[channel])
+				leaf->maximum[channel] = maximum[channel];
+		}
+	}
+
+	for (node >>= 1; node >= 1; node >>= 1) {
+		series->tree[node] = series->tree[2 * node];
+		range_extrema_merge(&series->tree[node], &series->tree[(2 * node) + 1]);
+	}
+}
+
+
+
+/*
+ * Extrema of bucket positions from..to (inclusive), wrapping around the circular window if from > to
+ */
+static void range_tree_query(range_series* series, int from, int to, range_extrema* acc) {
+
+	if (from > to) {
+		range_tree_query(series, from, series->capacity - 1, acc);
+		range_tree_query(series, 0, to, acc);
+		return;
+	}
+
+	// Bottom-up over half-open [left, right) leaves
+	int left = series->capacity + from;
+	int right = series->capacity + to + 1;
+	while (left < right) {
+		if (left & 1)
+			range_extrema_merge(acc, &series->tree[left++]);
+		if (right & 1)
+			range_extrema_merge(acc, &series->tree[--right]);
+		left >>= 1;
+		right >>= 1;
+	}
+}
+
+
+
+static void range_extrema_empty(range_extrema* extrema) {
+
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		extrema->minimum[channel] = FLT_MAX;
+		extrema->maximum[channel] = -FLT_MAX;
+	}
+}
+
+
+
+static void range_extrema_merge(range_extrema* acc, range_extrema* other) {
+
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		if (other->minimum[channel] < acc->minimum[channel])
+			acc->minimum[channel] = other->minimum[channel];
+		if (other->maximum[channel] > acc->maximum[channel])
+			acc->maximum[channel] = other->maximum[channel];
+	}
+}
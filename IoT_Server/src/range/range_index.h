@@ -0,0 +1,94 @@
+/*
+ * range_index.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef RANGE_INDEX_H_
+#define RANGE_INDEX_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+
+#include "iot_lib.h"
+#include "registry/client_registry.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define RANGE_INDEX_SECS		8192	// One-second buckets kept at most per series (2 h 16 min, power of 2)
+#define RANGE_MIN_SECS			64		// Buckets of a new series, doubled as its history grows (power of 2)
+#define RANGE_MAX_BYTES			(512L * 1024 * 1024)	// Memory budget of all series: past it, series are neither created nor grown
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	int64_t		second;							// Arrival time of bucket's samples (unix seconds)
+	uint32_t	count;
+	double		sum			[DATAGRAM_CHANNELS];	// Bucket's own sums (percent units)
+	double		cumulative	[DATAGRAM_CHANNELS];	// Prefix sums of the series up to and including this bucket
+	uint64_t	cumulative_count;
+} range_bucket;
+
+
+// Segment tree node: extrema of the buckets below it
+typedef struct {
+	float		minimum		[DATAGRAM_CHANNELS];
+	float		maximum		[DATAGRAM_CHANNELS];
+} range_extrema;
+
+
+// Samples of one sensor of one client, bucketed by arrival second in a circular window. Owned by the client's registry
+// session (list of its sensors' series), freed when the session is evicted.
+typedef struct range_series {
+	struct range_series*	next;		// Session's next series
+	struct range_series*	store_prev;	// All series of the store
+	struct range_series*	store_next;
+	uint8_t			sensor;
+	int				capacity;			// Buckets (power of 2, RANGE_MIN_SECS to RANGE_INDEX_SECS)
+	int64_t			first_second;		// Oldest second still in the window
+	int64_t			last_second;		// Newest bucket
+	range_bucket*	buckets;			// capacity buckets, position: second % capacity
+	range_extrema*	tree;				// 2 * capacity nodes, root at 1, bucket leaves from capacity
+} range_series;
+
+
+typedef struct {
+	range_series*	all;				// List of every series (freed with the store)
+	unsigned long	n_series;
+	size_t			bytes;				// Bucket and tree memory of all series
+	unsigned long	dropped;			// Additions not indexed: their series could not be created (RANGE_MAX_BYTES)
+	unsigned long	capped;				// Growths refused: series kept a shorter window
+} range_store;
+
+
+typedef struct {
+	int64_t		from;				// Range actually covered (clamped to indexed window)
+	int64_t		to;
+	long int	count;
+	float		minimum		[DATAGRAM_CHANNELS];
+	float		mean		[DATAGRAM_CHANNELS];
+	float		maximum		[DATAGRAM_CHANNELS];
+} range_result;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	range_store_init		(range_store* store);
+void	range_store_free		(range_store* store);
+void	range_add				(range_store* store, client_session* session, int sensor, int64_t second,
+								 long int count, double* sum, float* minimum, float* maximum);
+int		range_query				(client_session* session, int sensor, int64_t from, int64_t to,
+								 range_result* result);		// returns -1 if series is unknown or has no samples in range
+void	range_release			(range_store* store, client_session* session);		// frees session's series
+void	range_print_stats		(range_store* store);
+
+
+
+#endif /* RANGE_INDEX_H_ */
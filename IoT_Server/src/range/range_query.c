@@ -0,0 +1,195 @@
+/*
+ * range_query.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf() and sscanf()
+#include <stdlib.h>			// For strtoll()
+#include <string.h>			// For memset() and strchr()
+#include <unistd.h>			// For close()
+#include <sys/socket.h>		// For socket()
+#include <arpa/inet.h>		// For inet_aton()
+#include <sys/time.h>		// For timeval struct
+
+#include "iot_lib.h"
+#include "iot_server.h"
+#include "range_query.h"
+
+
+
+static uint16_t		range_percent_counts	(float percent);
+
+
+
+/*
+ * Answers DATAGRAM_REQ_QUERY_RANGE from the range index of the client's session (no rescan of stored samples)
+ */
+void range_query_answer(client_registry* registry, uint8_t* buffer_recv, uint8_t* buffer_reply) {
+
+	codec_datagram_begin(buffer_reply, DATAGRAM_REP_QUERY_RANGE, DATAGRAM_QUERY_REPLY_SIZE);
+	uint8_t* reply = codec_datagram_payload(buffer_reply);
+	memset(reply, 0, DATAGRAM_QUERY_REPLY_SIZE);
+	codec_query_reply_set_status(reply, RANGE_QUERY_NO_DATA);
+
+	if (codec_datagram_length(buffer_recv) < DATAGRAM_QUERY_SIZE)
+		return;
+
+	uint8_t* query = codec_datagram_payload(buffer_recv);
+	uint32_t addr = codec_load_addr(codec_query_addr(query));
+	uint16_t port = codec_load_port(codec_query_port(query));
+
+	range_result result;
+	int status = range_query(registry_lookup(registry, addr, port), codec_query_get_sensor(query), (int64_t) codec_query_get_from(query),
+			(int64_t) codec_query_get_to(query), &result);
+
+	codec_query_reply_set_status(reply, (status == 0) ? RANGE_QUERY_OK : RANGE_QUERY_NO_DATA);
+	codec_query_reply_set_from(reply, (uint32_t) result.from);
+	codec_query_reply_set_to(reply, (uint32_t) result.to);
+	codec_query_reply_set_count(reply, (uint32_t) result.count);
+
+	int channel;
+	for (channel = 0; (status == 0) && (channel < DATAGRAM_CHANNELS); channel++) {
+		uint8_t* values = codec_query_reply_channel(reply, channel);
+		codec_query_channel_set_minimum(values, range_percent_counts(result.minimum[channel]));
+		codec_query_channel_set_mean(values, range_percent_counts(result.mean[channel]));
+		codec_query_channel_set_maximum(values, range_percent_counts(result.maximum[channel]));
+	}
+}
+
+
+
+/*
+ * Operator query to a running server: "<client ip>:<port>[/<sensor>],<from>,<to>", times as accepted by
+ * range_parse_time (e.g. "192.168.1.50:40000,-7m,now" or "192.168.1.50:40000/2,10:03,10:17")
+ */
+int range_query_run(const char* spec) {
+	char client_ip[32];
+	char from_text[32];
+	char to_text[32];
+	int port, sensor = 0;
+
+	if ((sscanf(spec, "%31[^:]:%d/%d,%31[^,],%31s", client_ip, &port, &sensor, from_text, to_text) != 5)
+			&& (sscanf(spec, "%31[^:]:%d,%31[^,],%31s", client_ip, &port, from_text, to_text) != 4))
+		return -1;
+
+	struct in_addr client_addr;
+	time_t now = time(NULL);
+	int64_t from, to;
+	if ((inet_aton(client_ip, &client_addr) == 0) || (port < 1) || (port > 65535) || (sensor < 0) || (sensor >= DATAGRAM_MAX_SENSORS)
+			|| (range_parse_time(from_text, now, &from) < 0) || (range_parse_time(to_text, now, &to) < 0))
+		return -1;
+
+
+	/* Build query and send it to server, waiting at most 1 second for the reply */
+
+	uint8_t buffer_send[DATAGRAM_SIZE] = {'\0'};
+	uint8_t buffer_recv[DATAGRAM_SIZE] = {'\0'};
+	codec_datagram_begin(buffer_send, DATAGRAM_REQ_QUERY_RANGE, DATAGRAM_QUERY_SIZE);
+	uint8_t* query = codec_datagram_payload(buffer_send);
+	codec_store_addr(codec_query_addr(query), client_addr.s_addr);
+	codec_store_port(codec_query_port(query), htons((uint16_t) port));
+	codec_query_set_sensor(query, (uint8_t) sensor);
+	codec_query_set_from(query, (uint32_t) from);
+	codec_query_set_to(query, (uint32_t) to);
+
+	int query_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (query_socket < 0)
+		return -1;
+	struct timeval intervals = { 1, 0 };
+	setsockopt(query_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals));
+
+	struct sockaddr_in server_addr;
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(SERVER_PORT);
+	inet_aton(RANGE_QUERY_ADDR, &server_addr.sin_addr);
+
+	sendto(query_socket, buffer_send, DATAGRAM_HEADER_SIZE + DATAGRAM_QUERY_SIZE + 1, 0, (struct sockaddr *) &server_addr, sizeof(server_addr));
+	ssize_t recv_len = recvfrom(query_socket, buffer_recv, DATAGRAM_SIZE, 0, NULL, NULL);
+	close(query_socket);
+	if ((recv_len < (DATAGRAM_HEADER_SIZE + DATAGRAM_QUERY_REPLY_SIZE)) || (codec_header_get_type(buffer_recv) != DATAGRAM_REP_QUERY_RANGE))
+		return -1;
+
+
+	/* Print reply */
+
+	uint8_t* reply = codec_datagram_payload(buffer_recv);
+	time_t covered_from = (time_t) codec_query_reply_get_from(reply);
+	time_t covered_to = (time_t) codec_query_reply_get_to(reply);
+	char from_clock[16], to_clock[16];
+	strftime(from_clock, sizeof(from_clock), "%H:%M:%S", localtime(&covered_from));
+	strftime(to_clock, sizeof(to_clock), "%H:%M:%S", localtime(&covered_to));
+
+	printf("IOT_SERVER: == Range Query %s:%d sensor %d ==\n", client_ip, port, sensor);
+	if (codec_query_reply_get_status(reply) != RANGE_QUERY_OK) {
+		printf("IOT_SERVER: >> No samples in range\n");
+		return 0;
+	}
+	printf("IOT_SERVER: >> %u samples from %s to %s\n", codec_query_reply_get_count(reply), from_clock, to_clock);
+
+	const char* names[DATAGRAM_CHANNELS] = { "Clarity", "Red", "Green", "Blue" };
+	int channel;
+	for (channel = 0; channel < DATAGRAM_CHANNELS; channel++) {
+		uint8_t* values = codec_query_reply_channel(reply, channel);
+		printf("IOT_SERVER: >> %s values 	- minimum: %.2f - mean: %.2f - maximum: %.2f\n", names[channel],
+				codec_query_channel_get_minimum(values) / 655.35, codec_query_channel_get_mean(values) / 655.35, codec_query_channel_get_maximum(values) / 655.35);
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * Parses a query time: "now", "-<n>[s|m|h]" (before now), "HH:MM[:SS]" (today, local time) or unix seconds
+ */
+int range_parse_time(const char* text, time_t now, int64_t* second) {
+	char unit = 's';
+	long int amount;
+	int hours, minutes, seconds = 0;
+
+	if (strcmp(text, "now") == 0) {
+		*second = now;
+	} else if (text[0] == '-') {
+		if (sscanf(text, "-%ld%c", &amount, &unit) < 1)
+			return -1;
+		if (unit == 'm')
+			amount *= 60;
+		else if (unit == 'h')
+			amount *= 3600;
+		else if (unit != 's')
+			return -1;
+		*second = now - amount;
+	} else if (strchr(text, ':') != NULL) {
+		if (sscanf(text, "%d:%d:%d", &hours, &minutes, &seconds) < 2)
+			return -1;
+		struct tm clock;
+		localtime_r(&now, &clock);
+		clock.tm_hour = hours;
+		clock.tm_min = minutes;
+		clock.tm_sec = seconds;
+		*second = mktime(&clock);
+	} else {
+		char* end;
+		*second = strtoll(text, &end, 10);
+		if (*end != '\0')
+			return -1;
+	}
+
+	return 0;
+}
+
+
+
+static uint16_t range_percent_counts(float percent) {
+
+	float counts = (percent * 655.35f) + 0.5f;
+	if (counts < 0)
+		return 0;
+	if (counts > 65535)
+		return 65535;
+	return (uint16_t) counts;
+}
@@ -0,0 +1,36 @@
+/*
+ * range_query.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef RANGE_QUERY_H_
+#define RANGE_QUERY_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <time.h>			// For time_t
+
+#include "range_index.h"
+#include "registry/client_registry.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define RANGE_QUERY_ADDR		"127.0.0.1"		// Running server targeted by operator queries (-Q)
+#define RANGE_QUERY_OK			0x00
+#define RANGE_QUERY_NO_DATA		0x01
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	range_query_answer		(client_registry* registry, uint8_t* buffer_recv, uint8_t* buffer_reply);
+int		range_query_run			(const char* spec);			// returns -1 on malformed specification or no reply
+int		range_parse_time		(const char* text, time_t now, int64_t* second);
+
+
+
+#endif /* RANGE_QUERY_H_ */
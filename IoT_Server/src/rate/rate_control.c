@@ -0,0 +1,174 @@
+/*
+ * rate_control.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset()
+#include <sys/socket.h>		// For getsockopt()
+#include <linux/sock_diag.h>	// For SK_MEMINFO_* indexes
+
+#include "iot_server.h"
+#include "rate_control.h"
+
+
+
+static void			rate_apply_scale		(rate_control* rate);
+static uint32_t		rate_queue_bytes		(int server_socket);
+
+
+
+/*
+ * Scale bounds follow parse_param_rates constraints: sampling no faster than MIN_RATE_SAMPLING and the statistics
+ * window capacity allow, streaming no slower than half the statistics period
+ */
+void rate_control_init(rate_control* rate, timing_rates* base, float target) {
+
+	memset(rate, 0, sizeof(*rate));
+	rate->base = *base;
+	rate->current = *base;
+	rate->target = target;
+	rate->scale = 1;
+
+	rate->min_scale = RATE_CONTROL_MIN_SCALE;
+	if (((double) MIN_RATE_SAMPLING / base->sampling) > rate->min_scale)
+		rate->min_scale = (double) MIN_RATE_SAMPLING / base->sampling;
+	if (((double) base->server_stats_calc / MAX_SAMPLES_STATS_CALC / base->sampling) > rate->min_scale)
+		rate->min_scale = (double) base->server_stats_calc / MAX_SAMPLES_STATS_CALC / base->sampling;
+
+	rate->max_scale = RATE_CONTROL_MAX_SCALE;
+	if (((double) base->server_stats_calc / (2.0 * base->server_stream)) < rate->max_scale)
+		rate->max_scale = (double) base->server_stats_calc / (2.0 * base->server_stream);
+	if (rate->max_scale < 1)
+		rate->max_scale = 1;
+	if (rate->min_scale > 1)
+		rate->min_scale = 1;
+}
+
+
+
+/*
+ * Ingest thread busy time: from datagram received to datagram replied and processed
+ */
+void rate_control_record(rate_control* rate, int64_t received_us, int64_t processed_us) {
+
+	rate->busy_us += processed_us - received_us;
+	rate->datagrams++;
+}
+
+
+
+/*
+ * Revises scale once per period: over target (or with datagrams queueing up) rates slow down in proportion to the
+ * excess, mostly idle they speed up a step; in between they hold, so the fleet settles inside the band
+ */
+bool rate_control_tick(rate_control* rate, int server_socket, int64_t now_us) {
+
+	if (rate->period_start_us == 0)
+		rate->period_start_us = now_us;
+	int64_t period_us = now_us - rate->period_start_us;
+	if (period_us < RATE_CONTROL_PERIOD_US)
+		return false;
+
+	rate->utilization = (float) rate->busy_us / period_us;
+	rate->latency_us = (rate->datagrams > 0) ? (float) rate->busy_us / rate->datagrams : 0;
+	rate->queue_bytes = rate_queue_bytes(server_socket);
+	bool active = (rate->datagrams > 0);
+	rate->period_start_us = now_us;
+	rate->busy_us = 0;
+	rate->datagrams = 0;
+
+	double load = rate->utilization / rate->target;
+	if (rate->queue_bytes > RATE_CONTROL_QUEUE_BYTES)
+		load = RATE_CONTROL_MAX_STEP;
+
+	double previous = rate->scale;
+	if (load > 1) {
+		double step = (load > RATE_CONTROL_MAX_STEP) ? RATE_CONTROL_MAX_STEP : load;
+		rate->scale *= (step < RATE_CONTROL_MIN_STEP) ? RATE_CONTROL_MIN_STEP : step;
+	} else if (active && (load < RATE_CONTROL_IDLE_RATIO)) {
+		rate->scale *= RATE_CONTROL_SPEEDUP;		// Only while clients stream: an empty server learns nothing
+	}
+	if (rate->scale > rate->max_scale)
+		rate->scale = rate->max_scale;
+	if (rate->scale < rate->min_scale)
+		rate->scale = rate->min_scale;
+	if (rate->scale == previous)
+		return false;
+
+	timing_rates previous_rates = rate->current;
+	rate_apply_scale(rate);
+	if ((previous_rates.sampling == rate->current.sampling) && (previous_rates.server_stream == rate->current.server_stream))
+		return false;
+
+	if (rate->scale > previous)
+		rate->slowdowns++;
+	else
+		rate->speedups++;
+	printf("IOT_SERVER: Rate control: utilization %.1f %% (target %.0f %%) - queue %u KB: clients asked for sampling %d ms - streaming %d ms\n",
+			rate->utilization * 100, rate->target * 100, rate->queue_bytes / 1024, rate->current.sampling, rate->current.server_stream);
+	return true;
+}
+
+
+
+/*
+ * Piggybacks current rates on a DATAGRAM_REP_SEND_DATA_OK: sampling (4B) + streaming (4B), milliseconds LSB first
+ */
+void rate_control_put_rates(rate_control* rate, uint8_t* buffer_reply) {
+
+	codec_datagram_begin(buffer_reply, DATAGRAM_REP_SEND_DATA_OK, DATAGRAM_RATE_UPDATE_SIZE);
+	uint8_t* update = codec_datagram_payload(buffer_reply);
+	codec_rate_update_set_sampling(update, (uint32_t) rate->current.sampling);
+	codec_rate_update_set_server_stream(update, (uint32_t) rate->current.server_stream);
+	rate->announced++;
+}
+
+
+
+void rate_control_print_stats(rate_control* rate) {
+
+	printf("IOT_SERVER: Rate control: sampling %d ms - streaming %d ms (x%.2f configured) - utilization %.1f %% (target %.0f %%) - latency %.1f us - queue %u KB - %lu slow-downs - %lu speed-ups - %lu announced\n",
+			rate->current.sampling, rate->current.server_stream, rate->scale, rate->utilization * 100, rate->target * 100,
+			rate->latency_us, rate->queue_bytes / 1024, rate->slowdowns, rate->speedups, rate->announced);
+}
+
+
+
+/*
+ * Both rates scale together, so the samples per datagram (and the stream/sampling ratio limit) are kept
+ */
+static void rate_apply_scale(rate_control* rate) {
+
+	int sampling = (int) ((rate->base.sampling * rate->scale) + 0.5);
+	if (sampling < MIN_RATE_SAMPLING)
+		sampling = MIN_RATE_SAMPLING;
+	int server_stream = sampling * (rate->base.server_stream / rate->base.sampling);
+	if ((rate->base.server_stream % rate->base.sampling) != 0)
+		server_stream = (int) ((rate->base.server_stream * rate->scale) + 0.5);
+	if (server_stream < sampling)
+		server_stream = sampling;
+	if ((server_stream / sampling) > MAX_SAMPLING_RATIO)
+		server_stream = sampling * MAX_SAMPLING_RATIO;
+
+	rate->current.sampling = sampling;
+	rate->current.server_stream = server_stream;
+}
+
+
+
+/*
+ * returns bytes queued in socket receive buffer (0 if the kernel does not report it)
+ */
+static uint32_t rate_queue_bytes(int server_socket) {
+
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	socklen_t length = sizeof(meminfo);
+	if ((server_socket < 0) || (getsockopt(server_socket, SOL_SOCKET, SO_MEMINFO, meminfo, &length) < 0)
+			|| (length <= (SK_MEMINFO_RMEM_ALLOC * sizeof(uint32_t))))
+		return 0;
+	return meminfo[SK_MEMINFO_RMEM_ALLOC];
+}
@@ -0,0 +1,68 @@
+/*
+ * rate_control.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef RATE_CONTROL_H_
+#define RATE_CONTROL_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define RATE_CONTROL_PERIOD_US		1000000		// Load measured and rates revised once per period
+#define RATE_CONTROL_IDLE_RATIO		0.5			// Below this fraction of the target, clients are asked for finer data
+#define RATE_CONTROL_MAX_STEP		2.0			// Largest slow-down in one period
+#define RATE_CONTROL_MIN_STEP		1.1			// Smallest slow-down when over target
+#define RATE_CONTROL_SPEEDUP		0.9			// Rate scale per idle period (rates 11% faster)
+#define RATE_CONTROL_MIN_SCALE		0.25		// Fastest rates: 4 times the configured ones
+#define RATE_CONTROL_MAX_SCALE		64.0		// Slowest rates (also bounded by statistics period)
+#define RATE_CONTROL_QUEUE_BYTES	(256 * 1024)	// Socket receive queue beyond this is overload whatever the utilization
+
+
+
+/* TYPE DEFINITIONS */
+
+// Fleet-wide control loop: rates given out are the configured ones times a scale, raised (slower) when the ingest
+// thread's busy fraction exceeds the target or datagrams queue up in the socket, lowered (faster) when mostly idle
+typedef struct {
+	timing_rates	base;				// Configured rates (scale 1)
+	timing_rates	current;			// Given out in handshakes and piggybacked on acknowledgements
+	float			target;				// Utilization (busy fraction of ingest thread) to stay below
+	double			scale;
+	double			min_scale;			// Scale bounds keeping rates within parse_param_rates limits
+	double			max_scale;
+
+	int64_t			period_start_us;
+	int64_t			busy_us;			// Receive-to-processed time of datagrams in period
+	unsigned long	datagrams;			// ...and their number
+	float			utilization;		// Of last period
+	float			latency_us;			// Mean processing latency of last period
+	uint32_t		queue_bytes;		// Socket receive queue at end of last period
+
+	unsigned long	slowdowns;
+	unsigned long	speedups;
+	unsigned long	announced;			// Acknowledgements carrying rates
+} rate_control;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+void	rate_control_init			(rate_control* rate, timing_rates* base, float target);
+void	rate_control_record			(rate_control* rate, int64_t received_us, int64_t processed_us);
+bool	rate_control_tick			(rate_control* rate, int server_socket, int64_t now_us);	// returns true if rates changed
+void	rate_control_put_rates		(rate_control* rate, uint8_t* buffer_reply);
+void	rate_control_print_stats	(rate_control* rate);
+
+
+
+#endif /* RATE_CONTROL_H_ */
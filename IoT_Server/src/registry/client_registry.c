@@ -0,0 +1,348 @@
+/*
+ * client_registry.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For malloc() and free()
+#include <string.h>			// For memset()
+#include <time.h>			// For clock_gettime()
+#include <arpa/inet.h>		// For htonl()
+
+#include "client_registry.h"
+
+
+
+static uint32_t		registry_home		(client_registry* registry, uint32_t addr, uint16_t port);
+static uint32_t		registry_find		(client_registry* registry, uint32_t addr, uint16_t port);
+static void			registry_remove		(client_registry* registry, uint32_t index);
+static void			wheel_link			(client_registry* registry, uint32_t session);
+static void			wheel_unlink		(client_registry* registry, uint32_t session);
+static void			registry_evict		(client_registry* registry, uint32_t session);
+static double		bench_now_secs		(void);
+
+
+
+/*
+ * Allocates hash table (twice the capacity, so load stays under 1/2) and session slab up front:
+ * no allocation happens while serving clients.
+ */
+int registry_init(client_registry* registry, uint32_t capacity) {
+
+	memset(registry, 0, sizeof(*registry));
+
+	uint32_t table_size = 1;
+	while (table_size < (capacity * 2))
+		table_size <<= 1;
+
+	registry->table = malloc(table_size * sizeof(registry_entry));
+	registry->slab = malloc(capacity * sizeof(client_session));
+	if ((registry->table == NULL) || (registry->slab == NULL)) {
+		registry_free(registry);
+		return -1;
+	}
+	registry->table_mask = table_size - 1;
+	registry->capacity = capacity;
+
+	uint32_t index;
+	for (index = 0; index < table_size; index++)
+		registry->table[index].session = REGISTRY_NIL;
+
+	// Free list threaded through unused sessions
+	memset(registry->slab, 0, capacity * sizeof(client_session));
+	for (index = 0; index < capacity; index++)
+		registry->slab[index].wheel_next = (index + 1 < capacity) ? index + 1 : REGISTRY_NIL;
+	registry->free_head = 0;
+
+	for (index = 0; index < REGISTRY_WHEEL_SLOTS; index++)
+		registry->wheel[index] = REGISTRY_NIL;
+
+	return 0;
+}
+
+
+
+void registry_free(client_registry* registry) {
+
+	free(registry->table);
+	free(registry->slab);
+	registry->table = NULL;
+	registry->slab = NULL;
+}
+
+
+
+client_session* registry_lookup(client_registry* registry, uint32_t addr, uint16_t port) {
+
+	uint32_t index = registry_find(registry, addr, port);
+	if (registry->table[index].session == REGISTRY_NIL)
+		return NULL;
+	return &registry->slab[registry->table[index].session];
+}
+
+
+
+/*
+ * Finds client's session, creating it on first datagram, and pushes its eviction deadline forward
+ */
+client_session* registry_touch(client_registry* registry, uint32_t addr, uint16_t port, uint32_t now_secs) {
+
+	uint32_t index = registry_find(registry, addr, port);
+	uint32_t session = registry->table[index].session;
+
+	if (session == REGISTRY_NIL) {
+		if (registry->free_head == REGISTRY_NIL) {
+			registry->rejected++;
+			return NULL;
+		}
+		session = registry->free_head;
+		registry->free_head = registry->slab[session].wheel_next;
+
+		client_session* created = &registry->slab[session];
+		memset(created, 0, sizeof(*created));
+		created->addr = addr;
+		created->port = port;
+		created->in_use = true;
+		created->first_seen = now_secs;
+
+		registry->table[index].addr = addr;
+		registry->table[index].port = port;
+		registry->table[index].session = session;
+
+		registry->inserts++;
+		registry->n_clients++;
+		if (registry->n_clients > registry->peak_clients)
+			registry->peak_clients = registry->n_clients;
+	} else {
+		wheel_unlink(registry, session);
+	}
+
+	client_session* touched = &registry->slab[session];
+	touched->last_seen = now_secs;
+	touched->deadline = now_secs + REGISTRY_IDLE_TIMEOUT_SECS;
+	wheel_link(registry, session);
+
+	return touched;
+}
+
+
+
+/*
+ * Advances timing wheel to now, evicting sessions of every slot passed. Sessions are relinked on each touch,
+ * so a slot only holds sessions whose deadline is that second: no scan of live sessions.
+ */
+int registry_expire(client_registry* registry, uint32_t now_secs) {
+
+	if (!registry->wheel_started) {
+		registry->wheel_now = now_secs;
+		registry->wheel_started = true;
+		return 0;
+	}
+
+	// After a gap of a whole wheel turn every slot is due: visit each once
+	if ((now_secs - registry->wheel_now) > REGISTRY_WHEEL_SLOTS)
+		registry->wheel_now = now_secs - REGISTRY_WHEEL_SLOTS;
+
+	int n_evicted = 0;
+	while (registry->wheel_now != now_secs) {
+		registry->wheel_now++;
+
+		uint32_t session = registry->wheel[registry->wheel_now % REGISTRY_WHEEL_SLOTS];
+		while (session != REGISTRY_NIL) {
+			uint32_t next = registry->slab[session].wheel_next;
+			if ((int32_t) (registry->slab[session].deadline - now_secs) <= 0) {
+				registry_evict(registry, session);
+				n_evicted++;
+			}
+			session = next;
+		}
+	}
+
+	return n_evicted;
+}
+
+
+
+/*
+ * Drops a session before its deadline (e.g. handed to another cluster node)
+ */
+void registry_release(client_registry* registry, client_session* session) {
+
+	registry_evict(registry, (uint32_t) (session - registry->slab));
+}
+
+
+
+size_t registry_memory(client_registry* registry) {
+
+	return sizeof(*registry) + ((size_t) (registry->table_mask + 1) * sizeof(registry_entry)) + ((size_t) registry->capacity * sizeof(client_session));
+}
+
+
+
+void registry_print_stats(client_registry* registry) {
+
+	size_t memory = registry_memory(registry);
+	printf("IOT_SERVER: Clients: %u active (peak %u) - %lu registered - %lu evicted - %lu rejected - memory %zu KB (%zu B per slot)\n",
+			registry->n_clients, registry->peak_clients, registry->inserts, registry->evictions, registry->rejected,
+			memory / 1024, memory / registry->capacity);
+}
+
+
+
+/*
+ * Synthetic load: registers n_clients distinct addresses, looks them up in random order, then lets all of them
+ * idle out through the timing wheel. Prints memory per client and operation rates.
+ */
+void registry_benchmark(uint32_t n_clients) {
+
+	client_registry registry;
+	if ((n_clients == 0) || (registry_init(&registry, n_clients) < 0)) {
+		printf("IOT_SERVER: Could not allocate registry for %u clients\n", n_clients);
+		return;
+	}
+
+	// Clients spread over a /8, port from address (distinct keys)
+	uint32_t client;
+	double start = bench_now_secs();
+	for (client = 0; client < n_clients; client++)
+		registry_touch(&registry, htonl(0x0A000000 | client), htons((uint16_t) (1024 + (client % 60000))), client % REGISTRY_IDLE_TIMEOUT_SECS);
+	double insert_secs = bench_now_secs() - start;
+
+	uint32_t n_lookups = 10000000;
+	uint32_t random = 2463534242U;
+	unsigned long found = 0;
+	uint32_t lookup;
+	start = bench_now_secs();
+	for (lookup = 0; lookup < n_lookups; lookup++) {
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		client = random % n_clients;
+		found += (registry_lookup(&registry, htonl(0x0A000000 | client), htons((uint16_t) (1024 + (client % 60000)))) != NULL);
+	}
+	double lookup_secs = bench_now_secs() - start;
+
+	start = bench_now_secs();
+	uint32_t now;
+	int n_evicted = 0;
+	for (now = 1; now <= 2 * REGISTRY_IDLE_TIMEOUT_SECS; now++)
+		n_evicted += registry_expire(&registry, now);
+	double expire_secs = bench_now_secs() - start;
+
+	size_t memory = registry_memory(&registry);
+	printf("IOT_SERVER: == Registry Benchmark (%u clients) ==\n", n_clients);
+	printf("IOT_SERVER: >> Memory: %zu KB - %.1f B per client (hash table %.1f B + session %zu B)\n", memory / 1024, (double) memory / n_clients,
+			(double) ((registry.table_mask + 1) * sizeof(registry_entry)) / n_clients, sizeof(client_session));
+	printf("IOT_SERVER: >> Inserts: %.0f /s - lookups: %.0f /s (%lu of %u found) - evictions: %.0f /s (%d evicted)\n",
+			n_clients / insert_secs, n_lookups / lookup_secs, found, n_lookups, n_evicted / expire_secs, n_evicted);
+
+	registry_free(&registry);
+}
+
+
+
+static uint32_t registry_home(client_registry* registry, uint32_t addr, uint16_t port) {
+
+	// 64-bit mix (splitmix64 finalizer) of address and port
+	uint64_t key = ((uint64_t) addr << 16) | port;
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return (uint32_t) key & registry->table_mask;
+}
+
+
+
+/*
+ * Linear probing: returns slot holding the key, or the empty slot where it would be inserted
+ */
+static uint32_t registry_find(client_registry* registry, uint32_t addr, uint16_t port) {
+
+	uint32_t index = registry_home(registry, addr, port);
+	while (registry->table[index].session != REGISTRY_NIL) {
+		if ((registry->table[index].addr == addr) && (registry->table[index].port == port))
+			break;
+		index = (index + 1) & registry->table_mask;
+	}
+	return index;
+}
+
+
+
+/*
+ * Backward-shift deletion: entries after the hole move back if that keeps them reachable from their home slot,
+ * so no tombstones accumulate
+ */
+static void registry_remove(client_registry* registry, uint32_t index) {
+
+	uint32_t hole = index;
+	uint32_t next = (hole + 1) & registry->table_mask;
+	while (registry->table[next].session != REGISTRY_NIL) {
+		uint32_t home = registry_home(registry, registry->table[next].addr, registry->table[next].port);
+		// Distance from home to next (cyclic) not shorter than distance to hole: entry can fill the hole
+		if (((next - home) & registry->table_mask) >= ((next - hole) & registry->table_mask)) {
+			registry->table[hole] = registry->table[next];
+			hole = next;
+		}
+		next = (next + 1) & registry->table_mask;
+	}
+	registry->table[hole].session = REGISTRY_NIL;
+}
+
+
+
+static void wheel_link(client_registry* registry, uint32_t session) {
+
+	uint32_t slot = registry->slab[session].deadline % REGISTRY_WHEEL_SLOTS;
+	registry->slab[session].wheel_prev = REGISTRY_NIL;
+	registry->slab[session].wheel_next = registry->wheel[slot];
+	if (registry->wheel[slot] != REGISTRY_NIL)
+		registry->slab[registry->wheel[slot]].wheel_prev = session;
+	registry->wheel[slot] = session;
+}
+
+
+
+static void wheel_unlink(client_registry* registry, uint32_t session) {
+
+	client_session* unlinked = &registry->slab[session];
+	if (unlinked->wheel_prev != REGISTRY_NIL)
+		registry->slab[unlinked->wheel_prev].wheel_next = unlinked->wheel_next;
+	else
+		registry->wheel[unlinked->deadline % REGISTRY_WHEEL_SLOTS] = unlinked->wheel_next;
+	if (unlinked->wheel_next != REGISTRY_NIL)
+		registry->slab[unlinked->wheel_next].wheel_prev = unlinked->wheel_prev;
+}
+
+
+
+static void registry_evict(client_registry* registry, uint32_t session) {
+
+	client_session* evicted = &registry->slab[session];
+	if (registry->on_evict != NULL)
+		registry->on_evict(registry->evict_context, evicted);
+	wheel_unlink(registry, session);
+	registry_remove(registry, registry_find(registry, evicted->addr, evicted->port));
+
+	evicted->in_use = false;
+	evicted->wheel_next = registry->free_head;
+	registry->free_head = session;
+
+	registry->n_clients--;
+	registry->evictions++;
+}
+
+
+
+static double bench_now_secs(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
@@ -0,0 +1,102 @@
+/*
+ * client_registry.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef CLIENT_REGISTRY_H_
+#define CLIENT_REGISTRY_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <stddef.h>			// For size_t
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define REGISTRY_MAX_CLIENTS		131072		// Sessions (slab capacity); hash table has twice as many slots
+#define REGISTRY_IDLE_TIMEOUT_SECS	300			// Sessions without datagrams for this long are evicted
+#define REGISTRY_WHEEL_SLOTS		512			// Timing wheel slots of 1 second (must exceed idle timeout)
+#define REGISTRY_NIL				UINT32_MAX	// Empty table slot / end of list
+
+#if REGISTRY_WHEEL_SLOTS <= REGISTRY_IDLE_TIMEOUT_SECS
+#error "Timing wheel must span the idle timeout"
+#endif
+
+
+
+/* TYPE DEFINITIONS */
+
+struct range_series;
+
+// Hash table slot: client key and its session's slab index (REGISTRY_NIL: empty)
+typedef struct {
+	uint32_t		addr;				// Client IPv4 address (network order)
+	uint16_t		port;				// Client UDP port (network order)
+	uint32_t		session;
+} registry_entry;
+
+
+// Fixed-size per-client state, allocated from the registry slab
+typedef struct {
+	uint32_t		addr;
+	uint16_t		port;
+	uint8_t			capabilities;		// Accepted in last handshake (COMM_CAP_* flags)
+	bool			in_use;
+	timing_rates	timings;			// Rates given out in last DATAGRAM_REP_COMM_OK
+	uint32_t		first_seen;			// Seconds (registry clock)
+	uint32_t		last_seen;
+	uint32_t		deadline;			// Eviction time: last_seen + REGISTRY_IDLE_TIMEOUT_SECS
+	uint32_t		wheel_prev;			// Timing wheel slot list (free list: wheel_next only)
+	uint32_t		wheel_next;
+	uint32_t		datagrams;
+	uint32_t		samples;
+	uint32_t		relay_sequence;		// Gateways (COMM_CAP_RELAY): newest frame sequence accepted (0: none since handshake)
+	uint16_t		relay_port;			// Relayed devices: their gateway's port (network order, 0: direct client)
+	uint64_t		relay_window;		// ...and frames seen among the 64 up to it (bit n: sequence - n)
+	struct range_series*	ranges;		// Range index series of client's sensors (NULL until its first sample)
+} client_session;
+
+
+typedef struct {
+	registry_entry*	table;
+	uint32_t		table_mask;			// Table size - 1 (power of 2)
+	client_session*	slab;
+	uint32_t		capacity;
+	uint32_t		free_head;
+	uint32_t		wheel		[REGISTRY_WHEEL_SLOTS];
+	uint32_t		wheel_now;			// Last second processed by expiry
+	bool			wheel_started;
+
+	uint32_t		n_clients;
+	uint32_t		peak_clients;
+	unsigned long	inserts;
+	unsigned long	evictions;
+	unsigned long	rejected;			// New clients refused because slab was full
+
+	void			(*on_evict)	(void* context, client_session* session);	// Frees state hung on a session (optional)
+	void*			evict_context;
+} client_registry;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int				registry_init			(client_registry* registry, uint32_t capacity);		// returns -1 if allocation fails
+void			registry_free			(client_registry* registry);
+client_session*	registry_lookup			(client_registry* registry, uint32_t addr, uint16_t port);
+client_session*	registry_touch			(client_registry* registry, uint32_t addr, uint16_t port, uint32_t now_secs);	// NULL if full
+int				registry_expire			(client_registry* registry, uint32_t now_secs);		// returns sessions evicted
+void			registry_release		(client_registry* registry, client_session* session);	// counted as evicted
+size_t			registry_memory			(client_registry* registry);
+void			registry_print_stats	(client_registry* registry);
+void			registry_benchmark		(uint32_t n_clients);
+
+
+
+#endif /* CLIENT_REGISTRY_H_ */
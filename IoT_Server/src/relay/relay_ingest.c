@@ -0,0 +1,124 @@
+/*
+ * relay_ingest.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+
+#include "iot_codec.h"
+#include "relay_ingest.h"
+
+
+
+/*
+ * Frames are only unpacked for gateways holding a session with COMM_CAP_RELAY: their timestamp unit was agreed in
+ * that handshake (after a server restart the gateway must handshake again before its frames can be read)
+ */
+bool relay_session(client_registry* registry, struct sockaddr_in* gateway_addr) {
+
+	client_session* session = registry_lookup(registry, gateway_addr->sin_addr.s_addr, gateway_addr->sin_port);
+	return (session != NULL) && (session->capabilities & COMM_CAP_RELAY);
+}
+
+
+
+/*
+ * Gateways keep several frames in flight and retransmit unacknowledged ones, so a frame may arrive twice or out of
+ * order: its sequence is checked against the newest accepted and a bitmap of the RELAY_DEDUP_WINDOW before it
+ * (kept in the gateway's session, reset on handshake). Frames from gateways without a session are accepted.
+ * returns true if frame is new and must be unpacked
+ */
+bool relay_accept(relay_stats* stats, client_registry* registry, uint8_t* frame, struct sockaddr_in* gateway_addr) {
+
+	client_session* session = registry_lookup(registry, gateway_addr->sin_addr.s_addr, gateway_addr->sin_port);
+	if (session == NULL)
+		return true;
+
+	uint32_t sequence = relay_sequence(frame);
+	int32_t ahead = (int32_t) (sequence - session->relay_sequence);
+	if ((session->relay_window == 0) || (ahead > 0)) {
+		session->relay_window = ((session->relay_window == 0) || (ahead >= RELAY_DEDUP_WINDOW)) ? 1 : ((session->relay_window << ahead) | 1);
+		session->relay_sequence = sequence;
+		return true;
+	}
+
+	int behind = -ahead;
+	if ((behind >= RELAY_DEDUP_WINDOW) || (session->relay_window & (1ULL << behind))) {
+		stats->duplicates++;
+		return false;
+	}
+	session->relay_window |= (1ULL << behind);
+	return true;
+}
+
+
+
+/*
+ * Splits frame payload into its device blocks: the declared message must have been received whole, and each block
+ * must fit in it and in a device datagram (blocks are unpacked as one)
+ */
+int relay_blocks(relay_stats* stats, uint8_t* frame, int recv_len, relay_block* blocks, int max_blocks) {
+
+	int data_length = codec_datagram_length(frame);
+	if ((recv_len < DATAGRAM_HEADER_SIZE) || (data_length < DATAGRAM_RELAY_HEADER_SIZE) || ((DATAGRAM_HEADER_SIZE + data_length + 1) > recv_len)) {
+		stats->malformed++;
+		return -1;
+	}
+
+	uint8_t* payload = codec_datagram_payload(frame);
+	int n_blocks = codec_relay_header_get_n_blocks(payload);
+	int offset = DATAGRAM_RELAY_HEADER_SIZE;
+	int block;
+	for (block = 0; (block < n_blocks) && (block < max_blocks); block++) {
+		uint8_t* header = &payload[offset];
+		int n_samples = codec_relay_block_get_n_samples(header);
+		if (((offset + DATAGRAM_RELAY_BLOCK_SIZE + (n_samples * DATAGRAM_TAGGED_SAMPLE_SIZE)) > data_length)
+				|| ((n_samples * DATAGRAM_TAGGED_SAMPLE_SIZE) > (DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 1))) {
+			stats->malformed++;
+			return -1;
+		}
+		uint16_t device = codec_relay_block_get_device(header);
+		blocks[block].device = device & ~DATAGRAM_RELAY_NEW_DEVICE;
+		blocks[block].new_device = (device & DATAGRAM_RELAY_NEW_DEVICE);
+		blocks[block].n_samples = n_samples;
+		blocks[block].samples = &header[DATAGRAM_RELAY_BLOCK_SIZE];
+		offset += DATAGRAM_RELAY_BLOCK_SIZE + (n_samples * DATAGRAM_TAGGED_SAMPLE_SIZE);
+	}
+
+	return block;
+}
+
+
+
+/*
+ * Counts a frame accepted for unpacking
+ */
+void relay_count(relay_stats* stats, relay_block* blocks, int n_blocks) {
+
+	int block;
+	for (block = 0; block < n_blocks; block++)
+		stats->samples += blocks[block].n_samples;
+	stats->frames++;
+	stats->blocks += n_blocks;
+}
+
+
+
+uint32_t relay_sequence(uint8_t* frame) {
+
+	return codec_relay_header_get_sequence(codec_datagram_payload(frame));
+}
+
+
+
+void relay_print_stats(relay_stats* stats) {
+
+	if ((stats->frames + stats->duplicates + stats->malformed + stats->refused) == 0)
+		return;
+	printf("IOT_SERVER: Gateway relay: %lu frames - %lu device blocks - %lu samples (%.1f per frame) - %lu duplicates - %lu malformed - %lu refused without relay session - %lu new devices\n",
+			stats->frames, stats->blocks, stats->samples, (stats->frames > 0) ? (double) stats->samples / stats->frames : 0,
+			stats->duplicates, stats->malformed, stats->refused, stats->new_devices);
+}
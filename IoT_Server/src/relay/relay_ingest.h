@@ -0,0 +1,61 @@
+/*
+ * relay_ingest.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef RELAY_INGEST_H_
+#define RELAY_INGEST_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <netinet/in.h>		// For sockaddr_in struct
+
+#include "iot_lib.h"
+#include "registry/client_registry.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define RELAY_DEDUP_WINDOW		64		// Frames behind a gateway's newest still told apart (bits of relay_window)
+
+
+
+/* TYPE DEFINITIONS */
+
+typedef struct {
+	unsigned long	frames;			// Accepted and unpacked
+	unsigned long	duplicates;		// Retransmissions of frames already unpacked (acknowledged again, not unpacked)
+	unsigned long	blocks;
+	unsigned long	samples;
+	unsigned long	malformed;		// Frames cut short, with block counts overrunning them or blocks larger than a datagram
+	unsigned long	refused;		// Frames of gateways without a relay session (answered with an error: gateway handshakes again)
+	unsigned long	new_devices;	// Device ids given to new local clients (their old sessions dropped)
+} relay_stats;
+
+
+// One device block of a frame: relayed samples, as a DATAGRAM_REQ_SEND_TAGGED_DATA payload
+typedef struct {
+	uint16_t		device;
+	bool			new_device;		// DATAGRAM_RELAY_NEW_DEVICE set: device id's previous session is stale
+	int				n_samples;
+	uint8_t*		samples;
+} relay_block;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+bool		relay_session		(client_registry* registry, struct sockaddr_in* gateway_addr);
+bool		relay_accept		(relay_stats* stats, client_registry* registry, uint8_t* frame, struct sockaddr_in* gateway_addr);	// false: duplicate
+int			relay_blocks		(relay_stats* stats, uint8_t* frame, int recv_len, relay_block* blocks, int max_blocks);	// returns blocks (-1: malformed)
+void		relay_count			(relay_stats* stats, relay_block* blocks, int n_blocks);
+uint32_t	relay_sequence		(uint8_t* frame);
+void		relay_print_stats	(relay_stats* stats);
+
+
+
+#endif /* RELAY_INGEST_H_ */
@@ -0,0 +1,150 @@
+/*
+ * stats_shm.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <string.h>			// For memset() and memcpy()
+#include <fcntl.h>			// For O_* constants
+#include <unistd.h>			// For ftruncate(), close() and getpid()
+#include <sys/mman.h>		// For shm_open() and mmap()
+
+#include "stats_shm.h"
+
+
+
+static void		seq_write_begin		(_Atomic uint32_t* seq);
+static void		seq_write_end		(_Atomic uint32_t* seq);
+
+
+
+/*
+ * Creates (replacing a stale one) and maps the segment: all records empty, then magic makes it visible to readers
+ */
+int stats_shm_create(stats_shm* shm, const char* name) {
+
+	memset(shm, 0, sizeof(*shm));
+	shm_unlink(name);
+
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, sizeof(stats_shm_segment)) < 0) {
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+
+	stats_shm_segment* segment = mmap(NULL, sizeof(stats_shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED) {
+		shm_unlink(name);
+		return -1;
+	}
+
+	// Fresh segment is zero-filled: only the header needs writing
+	segment->version = STATS_SHM_VERSION;
+	segment->max_sensors = DATAGRAM_MAX_SENSORS;
+	segment->max_clients = STATS_SHM_MAX_CLIENTS;
+	segment->segment_size = sizeof(stats_shm_segment);
+	segment->server_pid = (int32_t) getpid();
+	atomic_store_explicit(&segment->online, 1, memory_order_relaxed);
+	atomic_store_explicit(&segment->magic, STATS_SHM_MAGIC, memory_order_release);
+
+	shm->segment = segment;
+	shm->name = name;
+	return 0;
+}
+
+
+
+void stats_shm_destroy(stats_shm* shm) {
+
+	if (shm->segment == NULL)
+		return;
+	atomic_store_explicit(&shm->segment->online, 0, memory_order_release);
+	munmap(shm->segment, sizeof(stats_shm_segment));
+	shm_unlink(shm->name);
+	shm->segment = NULL;
+}
+
+
+
+/*
+ * Client records are indexed like registry sessions, so a client keeps its record while its session lives
+ */
+void stats_shm_publish_client(stats_shm* shm, uint32_t slot, const stats_shm_client* client) {
+
+	if (slot >= STATS_SHM_MAX_CLIENTS) {
+		shm->counters.unpublished++;
+		return;
+	}
+
+	stats_shm_client_record* record = &shm->segment->clients[slot];
+	seq_write_begin(&record->seq);
+	record->data = *client;
+	record->data.in_use = 1;
+	seq_write_end(&record->seq);
+
+	if (slot >= atomic_load_explicit(&shm->segment->n_clients, memory_order_relaxed))
+		atomic_store_explicit(&shm->segment->n_clients, slot + 1, memory_order_release);
+}
+
+
+
+void stats_shm_clear_client(stats_shm* shm, uint32_t slot) {
+
+	if (slot >= STATS_SHM_MAX_CLIENTS)
+		return;
+
+	stats_shm_client_record* record = &shm->segment->clients[slot];
+	seq_write_begin(&record->seq);
+	memset(&record->data, 0, sizeof(record->data));
+	seq_write_end(&record->seq);
+}
+
+
+
+void stats_shm_publish_counters(stats_shm* shm) {
+
+	stats_shm_counters_record* record = &shm->segment->counters;
+	seq_write_begin(&record->seq);
+	record->data = shm->counters;
+	seq_write_end(&record->seq);
+}
+
+
+
+void stats_shm_publish_sensor(stats_shm* shm, int sensor, const stats_shm_sensor* sensor_stats) {
+
+	if ((sensor < 0) || (sensor >= DATAGRAM_MAX_SENSORS))
+		return;
+
+	stats_shm_sensor_record* record = &shm->segment->sensors[sensor];
+	seq_write_begin(&record->seq);
+	record->data = *sensor_stats;
+	seq_write_end(&record->seq);
+}
+
+
+
+/*
+ * Odd sequence marks record as being written. Release fence keeps the record stores from moving above it.
+ */
+static void seq_write_begin(_Atomic uint32_t* seq) {
+
+	atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+
+
+/*
+ * Even sequence (release store) publishes the record stores made since seq_write_begin()
+ */
+static void seq_write_end(_Atomic uint32_t* seq) {
+
+	atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_release);
+}
@@ -0,0 +1,139 @@
+/*
+ * stats_shm.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef STATS_SHM_H_
+#define STATS_SHM_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <stdatomic.h>		// For sequence counters
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+// Segment is created by the server (shm_open(), /dev/shm/<name>) and mapped read-only by any number of local readers.
+// Every record has its own sequence counter (seqlock): the server makes it odd, writes the record, makes it even.
+// Readers copy a record between two loads of its counter and retry if it was odd or changed. The server never
+// waits for readers, and readers never issue a syscall after stats_shm_attach().
+#define STATS_SHM_DEFAULT_NAME		"/iot_server_stats"
+#define STATS_SHM_MAGIC				0x53544f49		// "IOTS" (little-endian)
+#define STATS_SHM_VERSION			1
+#define STATS_SHM_MAX_CLIENTS		4096			// Client records: registry sessions beyond this are not published
+#define STATS_SHM_READ_ATTEMPTS		1024			// Reader retries of a record being rewritten before giving up
+
+
+
+/* TYPE DEFINITIONS */
+
+// Counters of the whole server (times in CLOCK_MONOTONIC seconds, shared by every process on the host)
+typedef struct {
+	uint32_t	updated_secs;
+	uint32_t	n_clients;
+	uint32_t	peak_clients;
+	uint32_t	unpublished;		// Client updates dropped: session index beyond STATS_SHM_MAX_CLIENTS
+	uint64_t	datagrams;			// Datagrams decoded
+	uint64_t	samples;
+	uint64_t	evictions;
+	uint64_t	rejected;			// New clients refused (registry full)
+	uint64_t	crc_verified;
+	uint64_t	crc_failed;
+	uint64_t	crc_missing;
+} stats_shm_counters;
+
+
+// Statistics of one sensor at the last calculation (percent units)
+typedef struct {
+	int64_t		computed_ns;		// CLOCK_REALTIME nanoseconds (0: never computed)
+	uint32_t	count;
+	float		minimum		[DATAGRAM_CHANNELS];
+	float		mean		[DATAGRAM_CHANNELS];
+	float		maximum		[DATAGRAM_CHANNELS];
+} stats_shm_sensor;
+
+
+// Registry session of one client
+typedef struct {
+	uint32_t	addr;				// Client IPv4 address (network order)
+	uint16_t	port;				// Client UDP port (network order)
+	uint8_t		capabilities;		// COMM_CAP_* flags accepted in last handshake
+	uint8_t		in_use;				// 0: empty record
+	uint32_t	first_seen;			// CLOCK_MONOTONIC seconds
+	uint32_t	last_seen;
+	uint32_t	datagrams;
+	uint32_t	samples;
+	int32_t		sampling;			// Rates given out in last handshake (milliseconds)
+	int32_t		server_stream;
+} stats_shm_client;
+
+
+// Each record on its own cache line(s): a write to one never makes readers of another retry
+typedef struct {
+	_Alignas(64) _Atomic uint32_t	seq;
+	stats_shm_counters				data;
+} stats_shm_counters_record;
+
+typedef struct {
+	_Alignas(64) _Atomic uint32_t	seq;
+	stats_shm_sensor				data;
+} stats_shm_sensor_record;
+
+typedef struct {
+	_Alignas(64) _Atomic uint32_t	seq;
+	stats_shm_client				data;
+} stats_shm_client_record;
+
+
+typedef struct {
+	_Atomic uint32_t			magic;			// Stored last on creation: readers ignore a segment still being set up
+	uint16_t					version;
+	uint16_t					max_sensors;
+	uint32_t					max_clients;
+	uint32_t					segment_size;
+	int32_t						server_pid;
+	_Atomic uint32_t			online;			// Cleared when server exits
+	_Atomic uint32_t			n_clients;		// Client records ever used: readers scan [0, n_clients)
+	stats_shm_counters_record	counters;
+	stats_shm_sensor_record		sensors		[DATAGRAM_MAX_SENSORS];
+	stats_shm_client_record		clients		[STATS_SHM_MAX_CLIENTS];
+} stats_shm_segment;
+
+
+// Server side
+typedef struct {
+	stats_shm_segment*	segment;
+	const char*			name;
+	stats_shm_counters	counters;		// Private copy, published after every datagram
+} stats_shm;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+// Publisher (server ingest thread only)
+int							stats_shm_create			(stats_shm* shm, const char* name);		// returns -1 if segment cannot be created
+void						stats_shm_destroy			(stats_shm* shm);
+void						stats_shm_publish_client	(stats_shm* shm, uint32_t slot, const stats_shm_client* client);
+void						stats_shm_clear_client		(stats_shm* shm, uint32_t slot);
+void						stats_shm_publish_counters	(stats_shm* shm);
+void						stats_shm_publish_sensor	(stats_shm* shm, int sensor, const stats_shm_sensor* sensor_stats);
+
+// Reader library (any local process: only stats_shm.h and stats_shm_reader.c are needed)
+const stats_shm_segment*	stats_shm_attach			(const char* name);		// NULL if missing or incompatible
+void						stats_shm_detach			(const stats_shm_segment* segment);
+bool						stats_shm_read_counters		(const stats_shm_segment* segment, stats_shm_counters* counters);
+bool						stats_shm_read_sensor		(const stats_shm_segment* segment, int sensor, stats_shm_sensor* sensor_stats);
+bool						stats_shm_read_client		(const stats_shm_segment* segment, uint32_t slot, stats_shm_client* client);
+uint32_t					stats_shm_client_slots		(const stats_shm_segment* segment);
+int							stats_shm_watch				(const char* name);		// prints a snapshot, returns -1 if not attached
+
+
+
+#endif /* STATS_SHM_H_ */
@@ -0,0 +1,203 @@
+/*
+ * stats_shm_reader.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memcpy()
+#include <fcntl.h>			// For O_* constants
+#include <unistd.h>			// For close()
+#include <time.h>			// For clock_gettime()
+#include <sys/mman.h>		// For shm_open() and mmap()
+#include <sys/stat.h>		// For fstat()
+#include <arpa/inet.h>		// For inet_ntoa()
+
+#include "stats_shm.h"
+
+
+
+#define STATS_SHM_WATCH_READS		100000		// Snapshots timed by stats_shm_watch()
+
+
+
+static bool		seq_read			(const _Atomic uint32_t* seq, const void* data, void* copy, size_t size);
+static double	reader_now_ns		(void);
+
+
+
+/*
+ * Maps a server's segment read-only (readers cannot disturb the server or each other)
+ */
+const stats_shm_segment* stats_shm_attach(const char* name) {
+
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	struct stat info;
+	if ((fstat(fd, &info) < 0) || (info.st_size < (off_t) sizeof(stats_shm_segment))) {
+		close(fd);
+		return NULL;
+	}
+
+	const stats_shm_segment* segment = mmap(NULL, sizeof(stats_shm_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED)
+		return NULL;
+
+	if ((atomic_load_explicit(&segment->magic, memory_order_acquire) != STATS_SHM_MAGIC) || (segment->version != STATS_SHM_VERSION)
+			|| (segment->segment_size != sizeof(stats_shm_segment)) || (segment->max_sensors != DATAGRAM_MAX_SENSORS)) {
+		munmap((void*) segment, sizeof(stats_shm_segment));
+		return NULL;
+	}
+	return segment;
+}
+
+
+
+void stats_shm_detach(const stats_shm_segment* segment) {
+
+	munmap((void*) segment, sizeof(stats_shm_segment));
+}
+
+
+
+bool stats_shm_read_counters(const stats_shm_segment* segment, stats_shm_counters* counters) {
+
+	return seq_read(&segment->counters.seq, &segment->counters.data, counters, sizeof(*counters));
+}
+
+
+
+bool stats_shm_read_sensor(const stats_shm_segment* segment, int sensor, stats_shm_sensor* sensor_stats) {
+
+	if ((sensor < 0) || (sensor >= DATAGRAM_MAX_SENSORS))
+		return false;
+	return seq_read(&segment->sensors[sensor].seq, &segment->sensors[sensor].data, sensor_stats, sizeof(*sensor_stats));
+}
+
+
+
+/*
+ * returns false if slot is out of range or kept being rewritten; an empty record reads with in_use 0
+ */
+bool stats_shm_read_client(const stats_shm_segment* segment, uint32_t slot, stats_shm_client* client) {
+
+	if (slot >= STATS_SHM_MAX_CLIENTS)
+		return false;
+	return seq_read(&segment->clients[slot].seq, &segment->clients[slot].data, client, sizeof(*client));
+}
+
+
+
+uint32_t stats_shm_client_slots(const stats_shm_segment* segment) {
+
+	return atomic_load_explicit(&segment->n_clients, memory_order_acquire);
+}
+
+
+
+/*
+ * Reference consumer: prints every record of a running server's segment, then times full snapshots
+ */
+int stats_shm_watch(const char* name) {
+
+	const stats_shm_segment* segment = stats_shm_attach(name);
+	if (segment == NULL)
+		return -1;
+
+	printf("IOT_SERVER: == Shared-memory stats %s (server pid %d, %s) ==\n", name, segment->server_pid,
+			atomic_load_explicit(&segment->online, memory_order_acquire) ? "online" : "exited");
+
+	stats_shm_counters counters;
+	if (stats_shm_read_counters(segment, &counters)) {
+		printf("IOT_SERVER: >> %lu datagrams - %lu samples - %u clients (peak %u, %u updates unpublished) - %lu evicted - %lu rejected\n",
+				(unsigned long) counters.datagrams, (unsigned long) counters.samples, counters.n_clients, counters.peak_clients,
+				counters.unpublished, (unsigned long) counters.evictions, (unsigned long) counters.rejected);
+		printf("IOT_SERVER: >> CRC32C: %lu verified - %lu failed - %lu missing\n",
+				(unsigned long) counters.crc_verified, (unsigned long) counters.crc_failed, (unsigned long) counters.crc_missing);
+	}
+
+	const char* channels[DATAGRAM_CHANNELS] = { "clarity", "red", "green", "blue" };
+	int sensor;
+	for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+		stats_shm_sensor sensor_stats;
+		if (!stats_shm_read_sensor(segment, sensor, &sensor_stats) || (sensor_stats.computed_ns == 0))
+			continue;
+		printf("IOT_SERVER: >> Sensor %d (%u samples):", sensor, sensor_stats.count);
+		int channel;
+		for (channel = 0; channel < DATAGRAM_CHANNELS; channel++)
+			printf(" %s %.2f/%.2f/%.2f", channels[channel], sensor_stats.minimum[channel], sensor_stats.mean[channel], sensor_stats.maximum[channel]);
+		printf("\n");
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint32_t n_slots = stats_shm_client_slots(segment);
+	uint32_t slot;
+	for (slot = 0; slot < n_slots; slot++) {
+		stats_shm_client client;
+		if (!stats_shm_read_client(segment, slot, &client) || !client.in_use)
+			continue;
+		struct in_addr addr = { .s_addr = client.addr };
+		printf("IOT_SERVER: >> Client %s:%d: %u datagrams - %u samples - rates %d/%d ms - caps 0x%02x - seen %us ago\n",
+				inet_ntoa(addr), ntohs(client.port), client.datagrams, client.samples, client.sampling, client.server_stream,
+				client.capabilities, (uint32_t) now.tv_sec - client.last_seen);
+	}
+
+	// Cost of a consistent snapshot (counters, sensors, clients) as a polling dashboard would take it
+	double start = reader_now_ns();
+	unsigned long torn = 0;
+	int read;
+	for (read = 0; read < STATS_SHM_WATCH_READS; read++) {
+		stats_shm_counters snapshot_counters;
+		torn += !stats_shm_read_counters(segment, &snapshot_counters);
+		for (sensor = 0; sensor < DATAGRAM_MAX_SENSORS; sensor++) {
+			stats_shm_sensor sensor_stats;
+			torn += !stats_shm_read_sensor(segment, sensor, &sensor_stats);
+		}
+		for (slot = 0; slot < n_slots; slot++) {
+			stats_shm_client client;
+			torn += !stats_shm_read_client(segment, slot, &client);
+		}
+	}
+	printf("IOT_SERVER: >> Snapshot of %u records read in %.0f ns (%lu reads gave up)\n",
+			1 + DATAGRAM_MAX_SENSORS + n_slots, (reader_now_ns() - start) / STATS_SHM_WATCH_READS, torn);
+
+	stats_shm_detach(segment);
+	return 0;
+}
+
+
+
+/*
+ * Copies a record between two loads of its sequence counter: an odd or changed counter means the server wrote the
+ * record meanwhile, so the copy is retried
+ * returns false if every attempt was torn
+ */
+static bool seq_read(const _Atomic uint32_t* seq, const void* data, void* copy, size_t size) {
+
+	int attempt;
+	for (attempt = 0; attempt < STATS_SHM_READ_ATTEMPTS; attempt++) {
+		uint32_t before = atomic_load_explicit(seq, memory_order_acquire);
+		if (before & 1)
+			continue;
+		memcpy(copy, data, size);
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(seq, memory_order_relaxed) == before)
+			return true;
+	}
+	return false;
+}
+
+
+
+static double reader_now_ns(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1e9) + now.tv_nsec;
+}
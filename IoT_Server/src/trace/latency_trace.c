@@ -0,0 +1,223 @@
+/*
+ * latency_trace.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <string.h>			// For memset()
+#include <time.h>			// For clock_gettime()
+#include <sys/socket.h>		// For setsockopt() and control messages
+
+#include "iot_codec.h"
+#include "latency_trace.h"
+
+
+
+static const char*	stage_names	[TRACE_STAGES] = { "read", "queue", "network", "ack", "decode", "total" };
+
+
+
+int64_t latency_trace_now_us(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+
+
+/*
+ * Trailer sits after the End-Of-Package byte, outside the declared length: servers without tracing never see it
+ */
+bool latency_trace_parse(uint8_t* datagram, int length, datagram_trace* trace) {
+
+	int offset = codec_datagram_size(datagram);
+	if (((offset + DATAGRAM_TRACE_SIZE) > length) || (codec_trace_get_marker(&datagram[offset]) != DATAGRAM_TRACE_MARKER))
+		return false;
+
+	uint8_t* trailer = &datagram[offset];
+	trace->captured_us = (int64_t) codec_trace_get_captured_us(trailer);
+	trace->read_us = codec_trace_get_read_us(trailer);
+	trace->sent_us = (int64_t) codec_trace_get_sent_us(trailer);
+	trace->offset_us = (int64_t) codec_trace_get_offset_us(trailer);
+	trace->rtt_us = codec_trace_get_rtt_us(trailer);
+	return true;
+}
+
+
+
+void latency_trace_record(latency_trace* tracer, datagram_trace* trace, int64_t received_us, int64_t acked_us, int64_t decoded_us) {
+
+	tracer->traced++;
+	latency_histogram_add(&tracer->stages[TRACE_STAGE_READ], trace->read_us);
+
+	int64_t network_us = received_us - (trace->sent_us + trace->offset_us);
+	if (network_us < 0)
+		tracer->skewed++;
+	latency_histogram_add(&tracer->stages[TRACE_STAGE_NETWORK], network_us);
+	latency_histogram_add(&tracer->stages[TRACE_STAGE_ACK], acked_us - received_us);
+	latency_histogram_add(&tracer->stages[TRACE_STAGE_DECODE], decoded_us - received_us);
+
+	// Capture time unknown for backlog older than the client keeps traces of
+	if (trace->captured_us != 0) {
+		latency_histogram_add(&tracer->stages[TRACE_STAGE_QUEUE], trace->sent_us - trace->captured_us);
+		latency_histogram_add(&tracer->stages[TRACE_STAGE_TOTAL], decoded_us - (trace->captured_us + trace->offset_us));
+	}
+}
+
+
+
+/*
+ * Handshake stamps for the client's clock offset estimate: receive time, then send time taken as late as possible
+ */
+void latency_trace_stamp_comm(uint8_t* buffer_reply, int64_t received_us) {
+
+	uint8_t* reply = codec_datagram_payload(buffer_reply);
+	if ((codec_header_get_type(buffer_reply) != DATAGRAM_REP_COMM_OK) || (codec_datagram_length(buffer_reply) != DATAGRAM_COMM_REPLY_SIZE)
+			|| !(codec_comm_reply_get_capabilities(reply) & COMM_CAP_TRACE))
+		return;
+
+	codec_datagram_begin(buffer_reply, DATAGRAM_REP_COMM_OK, DATAGRAM_COMM_REPLY_SIZE + DATAGRAM_COMM_TRACE_SIZE);
+	uint8_t* stamps = reply + DATAGRAM_COMM_REPLY_SIZE;
+	codec_comm_trace_set_received_us(stamps, (uint64_t) received_us);
+	codec_comm_trace_set_sent_us(stamps, (uint64_t) latency_trace_now_us());
+}
+
+
+
+/*
+ * Kernel stamps every datagram on arrival (SO_TIMESTAMPNS, realtime clock): ACK latency then covers the wait for the
+ * ingest thread to wake up (or its spin to see the datagram), not only the work after recvmsg() returns
+ */
+int latency_trace_stamp_socket(int server_socket) {
+
+	int enable = 1;
+	return setsockopt(server_socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+}
+
+
+
+/*
+ * returns kernel receive time of the datagram just received into message (nanoseconds, realtime), 0 if not stamped
+ */
+int64_t latency_trace_rx_stamp(struct msghdr* message) {
+
+	struct cmsghdr* cmsg;
+	for (cmsg = CMSG_FIRSTHDR(message); cmsg != NULL; cmsg = CMSG_NXTHDR(message, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+			struct timespec stamp;
+			memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+			return ((int64_t) stamp.tv_sec * 1000000000LL) + stamp.tv_nsec;
+		}
+	}
+	return 0;
+}
+
+
+
+void latency_trace_record_ack(latency_trace* tracer, int64_t received_ns) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t now_ns = ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+	latency_histogram_add(&tracer->ack, (now_ns - received_ns) / 1000);
+}
+
+
+
+void latency_trace_print(latency_trace* tracer) {
+
+	if (tracer->traced == 0)
+		return;
+
+	printf("IOT_SERVER: == Latency Trace (%lu datagrams, %lu with clock skew) ==\n", tracer->traced, tracer->skewed);
+	int stage;
+	for (stage = 0; stage < TRACE_STAGES; stage++) {
+		latency_histogram* histogram = &tracer->stages[stage];
+		if (histogram->n == 0)
+			continue;
+		printf("IOT_SERVER: >> %-8s - p50: %.3f ms - p90: %.3f ms - p99: %.3f ms - max: %.3f ms (%lu)\n", stage_names[stage],
+				latency_histogram_percentile(histogram, 0.50) / 1000.0, latency_histogram_percentile(histogram, 0.90) / 1000.0,
+				latency_histogram_percentile(histogram, 0.99) / 1000.0, histogram->max_us / 1000.0, histogram->n);
+	}
+}
+
+
+
+/*
+ * Tail of the acknowledgement latency seen by every client (not only tracing ones), labelled with the receive mode
+ */
+void latency_trace_print_ack(latency_trace* tracer, const char* mode) {
+
+	latency_histogram* histogram = &tracer->ack;
+	if (histogram->n == 0)
+		return;
+
+	printf("IOT_SERVER: ACK latency (%s, kernel receive to reply sent) - p50: %lu us - p99: %lu us - p99.9: %lu us - max: %lu us (%lu)\n", mode,
+			(unsigned long) latency_histogram_percentile(histogram, 0.50), (unsigned long) latency_histogram_percentile(histogram, 0.99),
+			(unsigned long) latency_histogram_percentile(histogram, 0.999), (unsigned long) histogram->max_us, histogram->n);
+}
+
+
+
+void latency_trace_reset(latency_trace* tracer) {
+
+	memset(tracer, 0, sizeof(*tracer));
+}
+
+
+
+/*
+ * Log-linear bucket: exact below TRACE_LINEAR_US, then the power of 2 split into TRACE_SUB_BUCKETS (negative: 0)
+ */
+void latency_histogram_add(latency_histogram* histogram, int64_t value_us) {
+
+	uint64_t value = (value_us > 0) ? (uint64_t) value_us : 0;
+	int bucket;
+	if (value < TRACE_LINEAR_US) {
+		bucket = (int) value;
+	} else {
+		int octave = 63 - __builtin_clzll(value);
+		int sub = (int) (value >> (octave - 3)) & (TRACE_SUB_BUCKETS - 1);
+		bucket = TRACE_LINEAR_US + ((octave - 4) * TRACE_SUB_BUCKETS) + sub;
+		if (bucket >= TRACE_BUCKETS)
+			bucket = TRACE_BUCKETS - 1;
+	}
+
+	histogram->counts[bucket]++;
+	histogram->n++;
+	if (value > histogram->max_us)
+		histogram->max_us = value;
+}
+
+
+
+/*
+ * returns lower bound of the bucket holding the given fraction of values (capped by the maximum seen)
+ */
+uint64_t latency_histogram_percentile(latency_histogram* histogram, double fraction) {
+
+	unsigned long rank = (unsigned long) (fraction * histogram->n);
+	if (rank >= histogram->n)
+		rank = histogram->n - 1;
+
+	unsigned long seen = 0;
+	int bucket;
+	for (bucket = 0; bucket < TRACE_BUCKETS; bucket++) {
+		seen += histogram->counts[bucket];
+		if (seen > rank)
+			break;
+	}
+
+	uint64_t value;
+	if (bucket < TRACE_LINEAR_US) {
+		value = (uint64_t) bucket;
+	} else {
+		int octave = 4 + ((bucket - TRACE_LINEAR_US) / TRACE_SUB_BUCKETS);
+		value = (uint64_t) (TRACE_SUB_BUCKETS + ((bucket - TRACE_LINEAR_US) % TRACE_SUB_BUCKETS)) << (octave - 3);
+	}
+	return (value < histogram->max_us) ? value : histogram->max_us;
+}
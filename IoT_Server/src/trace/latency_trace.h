@@ -0,0 +1,86 @@
+/*
+ * latency_trace.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef LATENCY_TRACE_H_
+#define LATENCY_TRACE_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <sys/socket.h>		// For msghdr struct
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+// Histograms: values under TRACE_LINEAR_US exact, then TRACE_SUB_BUCKETS buckets per power of 2 (12.5% resolution)
+#define TRACE_LINEAR_US			16
+#define TRACE_SUB_BUCKETS		8
+#define TRACE_OCTAVES			36			// Up to 2^40 us (~12 days)
+#define TRACE_BUCKETS			(TRACE_LINEAR_US + (TRACE_OCTAVES * TRACE_SUB_BUCKETS))
+
+// Stages, in pipeline order. Client stamps are placed on the server clock with the handshake offset.
+#define TRACE_STAGE_READ		0			// Sensor register read (longest in datagram)
+#define TRACE_STAGE_QUEUE		1			// Capture of oldest sample to send (ring, spool and batching wait, client clock)
+#define TRACE_STAGE_NETWORK		2			// Send to server receive (includes offset error, up to half the handshake RTT)
+#define TRACE_STAGE_ACK			3			// Receive to acknowledgement sent (or queued)
+#define TRACE_STAGE_DECODE		4			// Receive to samples decoded and saved
+#define TRACE_STAGE_TOTAL		5			// Capture of oldest sample to decoded
+#define TRACE_STAGES			6
+
+
+
+/* TYPE DEFINITIONS */
+
+// Client stamps of one traced datagram (client monotonic clock, microseconds)
+typedef struct {
+	int64_t		captured_us;		// Oldest sample captured (0: unknown)
+	uint32_t	read_us;
+	int64_t		sent_us;
+	int64_t		offset_us;			// Server clock minus client clock
+	uint32_t	rtt_us;
+} datagram_trace;
+
+
+typedef struct {
+	unsigned long	counts		[TRACE_BUCKETS];
+	unsigned long	n;
+	uint64_t		max_us;
+} latency_histogram;
+
+
+typedef struct {
+	latency_histogram	stages		[TRACE_STAGES];
+	unsigned long		traced;				// Datagrams with trace trailer
+	unsigned long		skewed;				// ...whose network stage came out negative (offset error above network latency)
+	latency_histogram	ack;				// Kernel receive to acknowledgement sent, every datagram (classic socket path)
+} latency_trace;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int64_t	latency_trace_now_us		(void);
+bool	latency_trace_parse			(uint8_t* datagram, int length, datagram_trace* trace);		// false if datagram carries no trailer
+void	latency_trace_record		(latency_trace* tracer, datagram_trace* trace, int64_t received_us, int64_t acked_us, int64_t decoded_us);
+void	latency_trace_stamp_comm	(uint8_t* buffer_reply, int64_t received_us);
+int		latency_trace_stamp_socket	(int server_socket);		// returns -1 if kernel does not stamp receives
+int64_t	latency_trace_rx_stamp		(struct msghdr* message);
+void	latency_trace_record_ack	(latency_trace* tracer, int64_t received_ns);
+void	latency_trace_print			(latency_trace* tracer);
+void	latency_trace_print_ack		(latency_trace* tracer, const char* mode);
+void	latency_trace_reset			(latency_trace* tracer);
+
+// Log-linear histograms, also used for other latency measurements
+void		latency_histogram_add			(latency_histogram* histogram, int64_t value_us);
+uint64_t	latency_histogram_percentile	(latency_histogram* histogram, double fraction);	// returns microseconds
+
+
+
+#endif /* LATENCY_TRACE_H_ */
@@ -0,0 +1,533 @@
+/*
+ * uring_socket.c
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+
+#include <stdio.h>			// For printf()
+#include <stdlib.h>			// For malloc() and free()
+#include <string.h>			// For memset() and memcpy()
+#include <errno.h>			// For errno
+#include <unistd.h>			// For syscall() and close()
+#include <time.h>			// For clock_gettime()
+#include <pthread.h>		// For benchmark sender thread
+#include <sys/mman.h>		// For mmap()
+#include <sys/syscall.h>	// For io_uring syscall numbers
+#include <arpa/inet.h>		// For htonl()
+
+#include "iot_lib.h"
+#include "iot_server.h"
+#include "uring_socket.h"
+
+
+
+typedef struct {
+	uint16_t	port;
+	int			n_datagrams;
+	uint8_t*	datagram;
+	int			length;
+	long int	acked;
+	long int	lost;
+} uring_bench_sender;
+
+
+static int		uring_setup				(unsigned entries, struct io_uring_params* params);
+static int		uring_enter				(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size);
+static int		uring_submit			(uring_socket* ring, bool wait, int timeout_ms);
+static struct io_uring_sqe*	uring_get_sqe	(uring_socket* ring);
+static void		uring_arm_recv			(uring_socket* ring);
+static int		uring_complete			(uring_socket* ring, struct io_uring_cqe* cqe, struct sockaddr_in* client_addr, uint8_t** datagram);
+static void		uring_buffer_recycle	(uring_socket* ring, int buffer_id);
+static int		uring_bench_socket		(uint16_t* port);
+static void*	uring_bench_send		(void* arg);
+static double	uring_now_secs			(clockid_t clock);
+
+
+
+/*
+ * Sets up ring (queues mapped once, single mmap), provided buffer ring and reply slots
+ */
+int uring_socket_init(uring_socket* ring, int server_socket) {
+
+	memset(ring, 0, sizeof(*ring));
+	ring->ring_fd = -1;
+	ring->socket = server_socket;
+	ring->held_buffer = -1;
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_CQ_ENTRIES;
+	ring->ring_fd = uring_setup(URING_ENTRIES, &params);
+	if ((ring->ring_fd < 0) || !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+		uring_socket_free(ring);
+		return -1;
+	}
+
+	ring->sq_ring_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+	ring->cq_ring_size = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+	if (ring->cq_ring_size > ring->sq_ring_size)
+		ring->sq_ring_size = ring->cq_ring_size;
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	void* rings = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+	void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+	ring->sq_ring = (rings != MAP_FAILED) ? rings : NULL;
+	ring->sqes = (sqes != MAP_FAILED) ? sqes : NULL;
+	if ((ring->sq_ring == NULL) || (ring->sqes == NULL)) {
+		uring_socket_free(ring);
+		return -1;
+	}
+
+	uint8_t* base = (uint8_t*) ring->sq_ring;
+	ring->sq_head = (unsigned*) (base + params.sq_off.head);
+	ring->sq_tail = (unsigned*) (base + params.sq_off.tail);
+	ring->sq_mask = (unsigned*) (base + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned*) (base + params.sq_off.array);
+	ring->cq_head = (unsigned*) (base + params.cq_off.head);
+	ring->cq_tail = (unsigned*) (base + params.cq_off.tail);
+	ring->cq_mask = (unsigned*) (base + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*) (base + params.cq_off.cqes);
+	ring->sq_local_tail = *ring->sq_tail;
+
+
+	/* Provided buffer ring: registered once, buffers handed back after each datagram is processed */
+
+	ring->buf_ring_size = URING_BUFFERS * sizeof(struct io_uring_buf);
+	void* buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ring->buf_ring = (buf_ring != MAP_FAILED) ? buf_ring : NULL;
+	ring->buffers = malloc(URING_BUFFERS * URING_BUFFER_SIZE);
+	ring->slots = malloc(URING_SEND_SLOTS * sizeof(uring_send_slot));
+	if ((ring->buf_ring == NULL) || (ring->buffers == NULL) || (ring->slots == NULL)) {
+		uring_socket_free(ring);
+		return -1;
+	}
+
+	struct io_uring_buf_reg registration;
+	memset(&registration, 0, sizeof(registration));
+	registration.ring_addr = (uint64_t) (uintptr_t) ring->buf_ring;
+	registration.ring_entries = URING_BUFFERS;
+	registration.bgid = URING_BUFFER_GROUP;
+	if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+		uring_socket_free(ring);
+		return -1;
+	}
+
+	int index;
+	for (index = 0; index < URING_BUFFERS; index++)
+		uring_buffer_recycle(ring, index);
+
+	// Multishot recvmsg only takes name and control lengths from this header
+	ring->recv_msg.msg_namelen = sizeof(struct sockaddr_in);
+
+	for (index = 0; index < URING_SEND_SLOTS; index++)
+		ring->slots[index].next_free = (index + 1 < URING_SEND_SLOTS) ? index + 1 : -1;
+	ring->free_slot = 0;
+
+	return 0;
+}
+
+
+
+void uring_socket_free(uring_socket* ring) {
+
+	if (ring->ring_fd >= 0)
+		close(ring->ring_fd);
+	if (ring->sq_ring != NULL)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->buf_ring != NULL)
+		munmap(ring->buf_ring, ring->buf_ring_size);
+	free(ring->buffers);
+	free(ring->slots);
+	memset(ring, 0, sizeof(*ring));
+	ring->ring_fd = -1;
+}
+
+
+
+/*
+ * Returns next datagram in place (pointer into its provided buffer, valid until the next call) and its length.
+ * Completions already posted are consumed without a syscall; io_uring_enter() is only called to wait, which also
+ * submits queued replies. returns -1 on timeout or signal
+ */
+int uring_socket_recv(uring_socket* ring, struct sockaddr_in* client_addr, uint8_t** datagram, int timeout_ms) {
+
+	if (ring->held_buffer >= 0) {
+		uring_buffer_recycle(ring, ring->held_buffer);
+		ring->held_buffer = -1;
+	}
+
+	double deadline = uring_now_secs(CLOCK_MONOTONIC) + (timeout_ms / 1000.0);
+	while (true) {
+		if (!ring->recv_armed)
+			uring_arm_recv(ring);
+
+		unsigned head = *ring->cq_head;
+		unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+			head++;
+			int length = uring_complete(ring, cqe, client_addr, datagram);
+			if (length >= 0) {
+				__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+				return length;
+			}
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+		int remaining_ms = (int) ((deadline - uring_now_secs(CLOCK_MONOTONIC)) * 1000);
+		if ((remaining_ms <= 0) || (uring_submit(ring, true, remaining_ms) == -EINTR))
+			return -1;
+	}
+}
+
+
+
+/*
+ * Queues reply (copied into a slot owned by the ring until sent). Submitted with the next wait, or at once
+ * when URING_SUBMIT_BATCH replies are pending. Falls back to sendto() if every slot is in flight.
+ * returns number of bytes queued or sent
+ */
+int uring_socket_send(uring_socket* ring, struct sockaddr_in* client_addr, uint8_t* buffer, int length) {
+
+	if (length > DATAGRAM_SIZE)
+		length = DATAGRAM_SIZE;
+
+	int index = ring->free_slot;
+	struct io_uring_sqe* sqe = (index >= 0) ? uring_get_sqe(ring) : NULL;
+	if (sqe == NULL) {
+		ring->syscalls++;
+		return (int) sendto(ring->socket, buffer, length, 0, (struct sockaddr *) client_addr, sizeof(*client_addr));
+	}
+
+	uring_send_slot* slot = &ring->slots[index];
+	ring->free_slot = slot->next_free;
+	memcpy(slot->data, buffer, length);
+	slot->addr = *client_addr;
+	slot->iov.iov_base = slot->data;
+	slot->iov.iov_len = length;
+	memset(&slot->msg, 0, sizeof(slot->msg));
+	slot->msg.msg_name = &slot->addr;
+	slot->msg.msg_namelen = sizeof(slot->addr);
+	slot->msg.msg_iov = &slot->iov;
+	slot->msg.msg_iovlen = 1;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = ring->socket;
+	sqe->addr = (uint64_t) (uintptr_t) &slot->msg;
+	sqe->len = 1;
+	sqe->user_data = (uint64_t) index;
+
+	if (ring->sq_pending >= URING_SUBMIT_BATCH)
+		uring_submit(ring, false, 0);
+
+	return length;
+}
+
+
+
+void uring_socket_print_stats(uring_socket* ring) {
+
+	printf("IOT_SERVER: io_uring: %lu datagrams - %lu replies - %lu syscalls (%.3f per datagram) - %lu receive rearms - %lu truncated\n",
+			ring->datagrams, ring->replies, ring->syscalls, (ring->datagrams > 0) ? (double) ring->syscalls / ring->datagrams : 0.0, ring->rearms, ring->truncated);
+}
+
+
+
+/*
+ * Loopback load: a sender thread keeps a window of full datagrams in flight while this thread receives and replies
+ * through the classic (recvfrom/sendto) path, then through io_uring. Reports datagrams per second, receiver CPU
+ * time and syscalls per datagram.
+ */
+void uring_socket_benchmark(int n_datagrams) {
+
+	uint8_t datagram[DATAGRAM_SIZE] = {'\0'};
+	int data_length = MAX_SAMPLING_RATIO * DATAGRAM_SAMPLE_SIZE;
+	codec_datagram_begin(datagram, DATAGRAM_REQ_SEND_DATA, data_length);
+	timing_rates timings = { DEFAULT_RATE_SAMPLING, DEFAULT_RATE_SERVER_STREAM, DEFAULT_RATE_SERVER_STATS_CALC };
+
+	printf("IOT_SERVER: == Socket Backend Benchmark (%d datagrams of %d bytes) ==\n", n_datagrams, DATAGRAM_HEADER_SIZE + data_length + 1);
+
+	int backend;
+	for (backend = 0; backend < 2; backend++) {
+		uring_bench_sender sender = { 0, n_datagrams, datagram, DATAGRAM_HEADER_SIZE + data_length + 1, 0, 0 };
+		int server_socket = uring_bench_socket(&sender.port);
+		static uring_socket ring;
+		if ((server_socket < 0) || ((backend == 1) && (uring_socket_init(&ring, server_socket) < 0))) {
+			printf("IOT_SERVER: >> %s: not available\n", (backend == 1) ? "io_uring" : "classic");
+			if (server_socket >= 0)
+				close(server_socket);
+			continue;
+		}
+
+		pthread_t sender_thread;
+		pthread_create(&sender_thread, NULL, uring_bench_send, &sender);
+		double start = uring_now_secs(CLOCK_MONOTONIC);
+		double start_cpu = uring_now_secs(CLOCK_THREAD_CPUTIME_ID);
+
+		long int received = 0;
+		unsigned long syscalls = 0;
+		while (true) {
+			struct sockaddr_in client_addr;
+			uint8_t buffer_stack[DATAGRAM_SIZE];
+			uint8_t* buffer_recv = buffer_stack;
+			uint8_t buffer_reply[DATAGRAM_SIZE] = {'\0'};
+			int recv_len;
+
+			if (backend == 1) {
+				recv_len = uring_socket_recv(&ring, &client_addr, &buffer_recv, 200);
+			} else {
+				memset(buffer_recv, 0, DATAGRAM_SIZE);
+				memset(&client_addr, 0, sizeof(client_addr));
+				socklen_t client_addr_len = sizeof(client_addr);
+				recv_len = (int) recvfrom(server_socket, buffer_recv, DATAGRAM_SIZE, 0, (struct sockaddr *) &client_addr, &client_addr_len);
+				syscalls++;
+			}
+			// Sender done and every reply submitted
+			if (recv_len < 0)
+				break;
+
+			received++;
+			server_build_reply(buffer_recv, buffer_reply, &timings);
+			int reply_len = codec_datagram_size(buffer_reply);
+			if (backend == 1) {
+				uring_socket_send(&ring, &client_addr, buffer_reply, reply_len);
+			} else {
+				sendto(server_socket, buffer_reply, reply_len, 0, (struct sockaddr *) &client_addr, sizeof(client_addr));
+				syscalls++;
+			}
+		}
+
+		pthread_join(sender_thread, NULL);
+		// Final receive timeout is not part of the measurement
+		double elapsed_secs = uring_now_secs(CLOCK_MONOTONIC) - start - 0.2;
+		double cpu_secs = uring_now_secs(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+		if (backend == 1) {
+			syscalls = ring.syscalls;
+			uring_socket_free(&ring);
+		}
+		close(server_socket);
+
+		printf("IOT_SERVER: >> %-8s: %.0f datagrams/s - receiver %.2f us CPU per datagram - %.3f syscalls per datagram - %ld received (%ld replies lost)\n",
+				(backend == 1) ? "io_uring" : "classic", received / elapsed_secs, 1e6 * cpu_secs / ((received > 0) ? received : 1),
+				(double) syscalls / ((received > 0) ? received : 1), received, sender.lost);
+	}
+}
+
+
+
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+
+	return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size) {
+
+	int result = (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+	return (result < 0) ? -errno : result;
+}
+
+
+
+/*
+ * Publishes prepared SQEs and enters the kernel once: submit only, or submit and wait for a completion
+ * returns number of SQEs submitted (-errno on error, e.g. -EINTR or -ETIME)
+ */
+static int uring_submit(uring_socket* ring, bool wait, int timeout_ms) {
+
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+	struct __kernel_timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000LL };
+	struct io_uring_getevents_arg wait_arg;
+	memset(&wait_arg, 0, sizeof(wait_arg));
+	wait_arg.ts = (uint64_t) (uintptr_t) &timeout;
+
+	ring->syscalls++;
+	int result = wait ? uring_enter(ring->ring_fd, ring->sq_pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &wait_arg, sizeof(wait_arg))
+			: uring_enter(ring->ring_fd, ring->sq_pending, 0, 0, NULL, 0);
+	if (result > 0)
+		ring->sq_pending -= (unsigned) result;
+	return result;
+}
+
+
+
+static struct io_uring_sqe* uring_get_sqe(uring_socket* ring) {
+
+	unsigned entries = *ring->sq_mask + 1;
+	if ((ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) >= entries) {
+		uring_submit(ring, false, 0);
+		if ((ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) >= entries)
+			return NULL;
+	}
+
+	unsigned index = ring->sq_local_tail & *ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	ring->sq_local_tail++;
+	ring->sq_pending++;
+
+	return sqe;
+}
+
+
+
+/*
+ * Multishot recvmsg: one submission keeps posting a completion (with its own provided buffer) per datagram
+ */
+static void uring_arm_recv(uring_socket* ring) {
+
+	struct io_uring_sqe* sqe = uring_get_sqe(ring);
+	if (sqe == NULL)
+		return;
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = ring->socket;
+	sqe->addr = (uint64_t) (uintptr_t) &ring->recv_msg;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_TRUNC;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->user_data = URING_TAG_RECV;
+	ring->recv_armed = true;
+}
+
+
+
+/*
+ * Handles one completion: frees reply slots, decodes datagrams in provided buffers
+ * returns datagram length (-1: not a datagram)
+ */
+static int uring_complete(uring_socket* ring, struct io_uring_cqe* cqe, struct sockaddr_in* client_addr, uint8_t** datagram) {
+
+	if (cqe->user_data != URING_TAG_RECV) {
+		int index = (int) cqe->user_data;
+		ring->slots[index].next_free = ring->free_slot;
+		ring->free_slot = index;
+		if (cqe->res >= 0)
+			ring->replies++;
+		return -1;
+	}
+
+	// Without F_MORE the multishot receive has ended (e.g. -ENOBUFS): armed again on next receive
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		ring->recv_armed = false;
+		ring->rearms++;
+	}
+	if ((cqe->res < 0) || !(cqe->flags & IORING_CQE_F_BUFFER))
+		return -1;
+
+	int buffer_id = (int) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+	uint8_t* buffer = ring->buffers + ((size_t) buffer_id * URING_BUFFER_SIZE);
+	struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*) buffer;
+	int header_size = sizeof(*out) + ring->recv_msg.msg_namelen + ring->recv_msg.msg_controllen;
+
+	memset(client_addr, 0, sizeof(*client_addr));
+	memcpy(client_addr, buffer + sizeof(*out), (out->namelen < sizeof(*client_addr)) ? out->namelen : sizeof(*client_addr));
+
+	// Truncated datagrams are dropped (as by the classic backend): their tail, e.g. the EOP flag, is missing
+	int length = (int) out->payloadlen;
+	if ((out->flags & MSG_TRUNC) || (length > (cqe->res - header_size))) {
+		uring_buffer_recycle(ring, buffer_id);
+		ring->truncated++;
+		return -1;
+	}
+
+	*datagram = buffer + header_size;
+	ring->held_buffer = buffer_id;
+	ring->datagrams++;
+	return length;
+}
+
+
+
+static void uring_buffer_recycle(uring_socket* ring, int buffer_id) {
+
+	struct io_uring_buf* buffer = &ring->buf_ring->bufs[ring->buf_tail & (URING_BUFFERS - 1)];
+	buffer->addr = (uint64_t) (uintptr_t) (ring->buffers + ((size_t) buffer_id * URING_BUFFER_SIZE));
+	buffer->len = URING_BUFFER_SIZE;
+	buffer->bid = (uint16_t) buffer_id;
+	ring->buf_tail++;
+	__atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+
+
+static int uring_bench_socket(uint16_t* port) {
+
+	int bench_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (bench_socket < 0)
+		return -1;
+
+	struct timeval intervals = { 0, 200000 };
+	setsockopt(bench_socket, SOL_SOCKET, SO_RCVTIMEO, &intervals, sizeof(intervals));
+
+	struct sockaddr_in bench_addr;
+	memset(&bench_addr, 0, sizeof(bench_addr));
+	bench_addr.sin_family = AF_INET;
+	bench_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t bench_addr_len = sizeof(bench_addr);
+	if ((bind(bench_socket, (struct sockaddr *) &bench_addr, sizeof(bench_addr)) < 0)
+			|| (getsockname(bench_socket, (struct sockaddr *) &bench_addr, &bench_addr_len) < 0)) {
+		close(bench_socket);
+		return -1;
+	}
+
+	*port = bench_addr.sin_port;
+	return bench_socket;
+}
+
+
+
+/*
+ * Sender keeps up to 64 datagrams unacknowledged; replies missing after 200 ms count as lost
+ */
+static void* uring_bench_send(void* arg) {
+
+	uring_bench_sender* sender = (uring_bench_sender*) arg;
+	int send_socket = uring_bench_socket(&(uint16_t) { 0 });
+	if (send_socket < 0) {
+		sender->lost = sender->n_datagrams;
+		return NULL;
+	}
+
+	struct sockaddr_in server_addr;
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server_addr.sin_port = sender->port;
+	connect(send_socket, (struct sockaddr *) &server_addr, sizeof(server_addr));
+
+	long int sent = 0;
+	uint8_t buffer_reply[DATAGRAM_SIZE];
+	while ((sender->acked + sender->lost) < sender->n_datagrams) {
+		while ((sent < sender->n_datagrams) && ((sent - sender->acked - sender->lost) < 64)) {
+			send(send_socket, sender->datagram, sender->length, 0);
+			sent++;
+		}
+		if (recv(send_socket, buffer_reply, DATAGRAM_SIZE, 0) > 0)
+			sender->acked++;
+		else
+			sender->lost = sent - sender->acked;
+	}
+
+	close(send_socket);
+	return NULL;
+}
+
+
+
+static double uring_now_secs(clockid_t clock) {
+
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
@@ -0,0 +1,105 @@
+/*
+ * uring_socket.h
+ *
+ *  Created on: Oct 2026
+ *      Author: Nicolas Villanueva
+ */
+
+#ifndef URING_SOCKET_H_
+#define URING_SOCKET_H_
+
+
+#include <stdint.h>			// For register types (e.g. uint8_t)
+#include <stdbool.h>		// For bool
+#include <stddef.h>			// For size_t
+#include <sys/socket.h>		// For msghdr struct
+#include <netinet/in.h>		// For sockaddr_in struct
+#include <linux/io_uring.h>	// For io_uring kernel interface (no liburing needed)
+
+#include "iot_lib.h"
+
+
+
+/* MACROS AND CONSTANTS */
+
+#define URING_ENTRIES			256		// Submission queue entries
+#define URING_CQ_ENTRIES		4096	// Completion queue entries (room for multishot receive bursts)
+#define URING_BUFFERS			1024	// Provided receive buffers (power of 2)
+#define URING_BUFFER_GROUP		0
+#define URING_BUFFER_SIZE		(sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + DATAGRAM_SIZE)
+#define URING_SEND_SLOTS		256		// Replies in flight
+#define URING_SUBMIT_BATCH		32		// Queued replies are submitted once this many are pending (or before waiting)
+#define URING_TAG_RECV			UINT64_MAX	// user_data of the multishot receive (sends: their slot index)
+
+
+
+/* TYPE DEFINITIONS */
+
+// Reply owned by the ring until its completion arrives
+typedef struct {
+	struct msghdr		msg;
+	struct iovec		iov;
+	struct sockaddr_in	addr;
+	uint8_t				data	[DATAGRAM_SIZE];
+	int					next_free;
+} uring_send_slot;
+
+
+typedef struct {
+	int					ring_fd;
+	int					socket;
+
+	// Submission queue (shared with kernel)
+	unsigned*			sq_head;
+	unsigned*			sq_tail;
+	unsigned*			sq_mask;
+	unsigned*			sq_array;
+	struct io_uring_sqe*	sqes;
+	unsigned			sq_local_tail;		// SQEs prepared but not yet published
+	unsigned			sq_pending;			// Published, not yet passed to io_uring_enter()
+
+	// Completion queue (shared with kernel)
+	unsigned*			cq_head;
+	unsigned*			cq_tail;
+	unsigned*			cq_mask;
+	struct io_uring_cqe*	cqes;
+
+	void*				sq_ring;
+	size_t				sq_ring_size;
+	void*				cq_ring;
+	size_t				cq_ring_size;
+	size_t				sqes_size;
+
+	// Provided buffer ring: kernel picks a buffer per datagram, no copy into a caller buffer
+	struct io_uring_buf_ring*	buf_ring;
+	size_t				buf_ring_size;
+	uint8_t*			buffers;
+	uint16_t			buf_tail;
+	int					held_buffer;		// Buffer of last returned datagram (-1: none), recycled on next receive
+	struct msghdr		recv_msg;
+	bool				recv_armed;
+
+	uring_send_slot*	slots;
+	int					free_slot;
+
+	unsigned long		syscalls;
+	unsigned long		datagrams;
+	unsigned long		replies;
+	unsigned long		rearms;				// Multishot receive ended (e.g. buffers exhausted) and was resubmitted
+	unsigned long		truncated;			// Datagrams larger than DATAGRAM_SIZE, dropped
+} uring_socket;
+
+
+
+/* FUNCTION DECLARATIONS */
+
+int		uring_socket_init		(uring_socket* ring, int server_socket);		// returns -1 if kernel lacks a needed feature
+void	uring_socket_free		(uring_socket* ring);
+int		uring_socket_recv		(uring_socket* ring, struct sockaddr_in* client_addr, uint8_t** datagram, int timeout_ms);
+int		uring_socket_send		(uring_socket* ring, struct sockaddr_in* client_addr, uint8_t* buffer, int length);
+void	uring_socket_print_stats	(uring_socket* ring);
+void	uring_socket_benchmark	(int n_datagrams);
+
+
+
+#endif /* URING_SOCKET_H_ */